@@ -0,0 +1,48 @@
+#ifndef WOW_DAEMON_H
+#define WOW_DAEMON_H
+
+/*
+ * daemon.h -- Optional background daemon holding warm network state
+ *
+ * `wow daemon start` forks a long-lived process listening on
+ * $XDG_RUNTIME_DIR/wow/daemon.sock.  It keeps an HTTP connection pool
+ * (open sockets, TLS sessions, parsed CA roots) and an in-memory cache
+ * of compact index /info bodies alive across invocations, so back-to-back
+ * `wow lock`, `wow sync` and `wowx` runs skip the TLS handshakes and
+ * index fetches they would otherwise repeat.
+ *
+ * The compact index provider asks the daemon first; when no daemon is
+ * listening (or it fails mid-request) it fetches in-process as before.
+ * The daemon is strictly opt-in: nothing starts it implicitly.
+ *
+ * Environment:
+ *   WOW_NO_DAEMON=1     never talk to the daemon
+ *   WOW_DAEMON_TTL=S    seconds an /info body is served from memory
+ *                       without asking upstream (default 0); after that
+ *                       it is revalidated by ETag before being served
+ *   WOW_DAEMON_IDLE=S   daemon exits after S idle seconds (default 1800)
+ */
+
+#include <stddef.h>
+
+struct wow_response;
+
+/*
+ * Path of the daemon socket.  Returns -1 (without printing) when
+ * $XDG_RUNTIME_DIR is unset or the path does not fit.
+ */
+int wow_daemon_socket_path(char *buf, size_t bufsz);
+
+/*
+ * GET url through the daemon.  On success fills resp exactly as
+ * wow_http_get() would (body NUL-terminated; release with
+ * wow_response_free()) and returns 0.  Returns -1, silently, when there
+ * is no daemon or it could not answer; the caller then fetches itself.
+ * After the first failure the process stops trying.
+ */
+int wow_daemon_get(const char *url, struct wow_response *resp);
+
+/* wow daemon start|stop|status|run */
+int cmd_daemon(int argc, char *argv[]);
+
+#endif
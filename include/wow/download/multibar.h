@@ -2,6 +2,7 @@
 #define WOW_MULTIBAR_H
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stddef.h>
 
 /*
@@ -9,15 +10,22 @@
  *
  * Supports two modes:
  *
- * 1. Fixed mode (n_bars == n_total): one row per download.
+ * 1. Fixed mode (n_bars == n_total): one slot per download.
  *    Good for small batches (2-8 files).
  *
- * 2. Worker mode (n_bars < n_total): one row per worker thread,
+ * 2. Worker mode (n_bars < n_total): one slot per worker thread,
  *    plus a status line showing [completed/total].  Workers call
  *    wow_multibar_reset() to reuse their bar slot for the next
  *    download.  Good for large batches (100+ files).
  *
- * Thread-safe: all update/finish/fail/reset acquire the internal mutex.
+ * Any number of slots may exist; at most WOW_MULTIBAR_ROWS (fewer on a
+ * short terminal) are drawn, the furthest along first, and the status
+ * line accounts for the rest.
+ *
+ * Lock-free on the hot path: update/finish/fail/reset only touch
+ * atomic counters.  On a terminal, a renderer thread started by
+ * wow_multibar_start() redraws every WOW_MULTIBAR_FRAME_MS with one
+ * write() per frame, so chunk callbacks never block on the terminal.
  *
  * Fixed mode usage:
  *   wow_multibar_t mb;
@@ -37,52 +45,69 @@
  *   wow_multibar_reset(&mb, 0, "rack-3.1.12.gem");
  */
 
-#define WOW_MULTIBAR_MAX 64
+#define WOW_MULTIBAR_ROWS     16   /* Most bar rows drawn at once */
+#define WOW_MULTIBAR_FRAME_MS 50   /* Renderer period (20 fps) */
 
 /* Per-bar slot state */
 typedef struct {
-    const char *name;           /* Label shown to user */
-    size_t      current;        /* Bytes received so far */
-    size_t      total;          /* Expected total (0 if unknown) */
-    int         finished;       /* 1 if complete */
-    int         failed;         /* 1 if errored */
-    size_t      _last_reported; /* Internal: for HTTP callback delta tracking */
+    _Atomic(const char *) name;      /* Label shown to user */
+    atomic_size_t         current;   /* Bytes received so far */
+    atomic_size_t         total;     /* Expected total (0 if unknown) */
+    atomic_int            finished;  /* 1 if complete */
+    atomic_int            failed;    /* 1 if errored */
+    size_t _last_reported;  /* Internal: HTTP callback delta tracking
+                             * (owned by the slot's worker) */
 } wow_bar_slot_t;
 
 /* Shared multi-bar state */
 typedef struct {
-    wow_bar_slot_t  slots[WOW_MULTIBAR_MAX];
-    int             n_bars;       /* Number of bar rows (== workers in worker mode) */
+    wow_bar_slot_t *slots;        /* n_bars slots */
+    int             n_bars;       /* Number of slots (== workers in worker mode) */
+    int             n_rows;       /* Bar rows drawn (<= n_bars) */
     int             n_total;      /* Total downloads in the batch */
-    int             n_completed;  /* Completed downloads so far */
-    int             n_failed;     /* Failed downloads so far */
-    size_t          total_bytes;  /* Total bytes downloaded across all items */
+    atomic_int      n_completed;  /* Completed downloads so far */
+    atomic_int      n_failed;     /* Failed downloads so far */
+    atomic_size_t   total_bytes;  /* Total bytes downloaded across all items */
     int             is_tty;       /* Whether stderr is a terminal */
     int             started;      /* Whether rows have been reserved */
-    int             has_status;   /* Whether we have a status line (worker mode) */
+    int             has_status;   /* Whether we have a status line */
     double          start_time;   /* For elapsed time */
-    int             max_nw;       /* High-water name width (only grows, like uv) */
-    pthread_mutex_t mu;           /* Serialises all rendering */
+    atomic_int      max_nw;       /* High-water name width (only grows, like uv) */
+
+    /* Renderer thread (TTY only) */
+    pthread_t       renderer;
+    int             renderer_running;
+    int             stop;         /* Guarded by mu */
+    pthread_mutex_t mu;           /* Renderer wake-up / shutdown only */
+    pthread_cond_t  cv;
+    char           *frame;        /* Frame buffer, one write() per frame */
+    size_t          frame_cap;
+    int            *order;        /* Scratch: slot order for a frame */
+    int            *keys;         /* Scratch: sort keys for a frame */
 } wow_multibar_t;
 
 /*
  * Initialise the multi-bar display.
- * n_bars:  number of bar rows (one per worker in worker mode).
+ * n_bars:  number of bar slots (one per worker in worker mode).
  * n_total: total number of downloads in the batch.
- * If n_bars == n_total, fixed mode (no status line).
- * If n_bars < n_total, worker mode (status line shown).
+ * If n_bars == n_total, fixed mode (no status line unless some slots
+ * are not drawn).  If n_bars < n_total, worker mode (status line shown).
+ * Returns 0, or -1 on allocation failure (the display is then inert).
  */
-void wow_multibar_init(wow_multibar_t *mb, int n_bars, int n_total);
+int wow_multibar_init(wow_multibar_t *mb, int n_bars, int n_total);
 
 /* Set the name for bar at index i.  Call before wow_multibar_start(). */
 void wow_multibar_set_name(wow_multibar_t *mb, int i, const char *name);
 
-/* Reserve terminal rows.  Call once from the main thread before spawning. */
+/*
+ * Reserve terminal rows and start the renderer thread.  Call once from
+ * the main thread before spawning workers.
+ */
 void wow_multibar_start(wow_multibar_t *mb);
 
 /*
  * Reset bar i for a new download (worker mode).  Thread-safe.
- * Clears progress, sets new name, re-renders the bar.
+ * Clears progress and sets the new name; the next frame shows it.
  */
 void wow_multibar_reset(wow_multibar_t *mb, int i, const char *name);
 
@@ -92,13 +117,19 @@ void wow_multibar_reset(wow_multibar_t *mb, int i, const char *name);
  */
 void wow_multibar_update(wow_multibar_t *mb, int i, size_t delta, size_t total);
 
+/* Bytes received so far on bar i (0 if out of range).  Thread-safe. */
+size_t wow_multibar_current(wow_multibar_t *mb, int i);
+
 /* Mark bar i as finished (tick mark).  Thread-safe.  Increments completed count. */
 void wow_multibar_finish(wow_multibar_t *mb, int i);
 
 /* Mark bar i as failed (cross mark).  Thread-safe.  Increments failed count. */
 void wow_multibar_fail(wow_multibar_t *mb, int i);
 
-/* Destroy mutex.  Call after all threads have joined. */
+/*
+ * Stop the renderer after drawing the final frame, and free
+ * everything.  Call after all worker threads have joined.
+ */
 void wow_multibar_destroy(wow_multibar_t *mb);
 
 /*
@@ -22,8 +22,10 @@
 int wow_ensure_bundler_shim(const char *ruby_prefix);
 
 /*
- * Ensure lib/wow_preload.rb exists.
- * This stubs Kernel#gem as a no-op since gems are already on RUBYLIB.
+ * Ensure lib/wow_preload.rb exists and is current.
+ * This stubs Kernel#gem as a no-op since gems are already on RUBYLIB,
+ * and — when WOW_REQUIRE_INDEX names a require index — resolves
+ * `require` through it before Ruby's load-path search.
  *
  * ruby_prefix: The Ruby installation prefix
  *
@@ -76,4 +78,77 @@ int wow_exec_gem_binary(const char *ruby_bin, const char *ruby_api,
                         const char *env_dir, const char *exe_path,
                         int user_argc, char **user_argv);
 
+/*
+ * Derive the Ruby installation prefix from its binary path
+ * (".../bin/ruby" → "...").
+ */
+void wow_exec_ruby_prefix(const char *ruby_bin, char *prefix,
+                          size_t prefix_sz);
+
+/*
+ * Build the RUBYLIB value used by wow_exec_gem_binary() into rubylib:
+ * shims dir, each gem's .require_paths under env_dir (NULL to skip),
+ * then the stdlib and its arch dir.
+ *
+ * Returns the length written (0 if nothing was found).
+ */
+size_t wow_exec_build_rubylib(const char *ruby_prefix, const char *ruby_api,
+                              const char *env_dir, char *rubylib,
+                              size_t rubylib_sz);
+
+/*
+ * Write <env_dir>/.wow-env: the precomputed load path, executable map
+ * and LD_LIBRARY_PATH for this environment, so launchers can skip the
+ * filesystem scans.  Call after every change to env_dir/gems.
+ * Written atomically (temp file + rename).
+ *
+ * ruby_version (e.g. "3.3.6") and the mtime of lock_path (the
+ * Gemfile.lock the environment was installed from; NULL for none) are
+ * recorded so a manifest for another Ruby or lock counts as stale.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int wow_env_manifest_write(const char *ruby_bin, const char *ruby_version,
+                           const char *ruby_api, const char *env_dir,
+                           const char *lock_path);
+
+/*
+ * Write <env_dir>/.wow-require-index: every feature reachable through
+ * rubylib (a RUBYLIB value as built by wow_exec_build_rubylib()) mapped
+ * to its absolute path, in load-path order.  The gem preload uses it to
+ * resolve `require` without probing each load-path directory.
+ *
+ * index_path receives the absolute path of the written index.
+ * Returns 0 on success, -1 on error.
+ */
+int wow_require_index_write(const char *env_dir, const char *rubylib,
+                            char *index_path, size_t index_path_sz);
+
+/*
+ * Exec binary_name using <env_dir>/.wow-env.
+ *
+ * gem_name: prefer the executable from this gem (NULL for any gem).
+ *
+ * Does not return on success.  Returns -1 without side effects if the
+ * manifest is missing, stale (different Ruby binary or version, env
+ * path or lock_path, lock_path or gems/ changed since it was written)
+ * or doesn't list binary_name — callers then fall back to
+ * wow_find_gem_binary() + wow_exec_gem_binary().  Returns 1 if execve
+ * itself failed.
+ */
+int wow_env_manifest_exec(const char *ruby_bin, const char *ruby_version,
+                          const char *env_dir, const char *lock_path,
+                          const char *gem_name, const char *binary_name,
+                          int user_argc, char **user_argv);
+
+/*
+ * Is <env_dir>/.wow-env current — written by this wow for ruby_bin at
+ * ruby_version and env_dir, lock_path and gems/ untouched since, and
+ * ruby_bin not replaced after it?  Installers that changed nothing use
+ * it to skip the rewrite (and the require index walk).  Returns 1 if
+ * current, 0 otherwise.
+ */
+int wow_env_manifest_current(const char *ruby_bin, const char *ruby_version,
+                             const char *env_dir, const char *lock_path);
+
 #endif
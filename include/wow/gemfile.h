@@ -10,6 +10,8 @@
 #include "wow/gemfile/lexer.h"
 #include "wow/gemfile/eval.h"
 #include "wow/gemfile/parse.h"
+#include "wow/gemfile/cache.h"
+#include "wow/gemfile/edit.h"
 
 /* Forward declarations for CLI handlers */
 int cmd_gemfile_parse(int argc, char *argv[]);
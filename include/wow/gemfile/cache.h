@@ -0,0 +1,49 @@
+#ifndef WOW_GEMFILE_CACHE_H
+#define WOW_GEMFILE_CACHE_H
+
+/*
+ * cache.h -- on-disk cache of Gemfile parse results
+ *
+ * wow_gemfile_parse_file() stores each successful parse under
+ * $XDG_CACHE_HOME/wow/gemfile/<key> (~/.cache/wow/gemfile by default).
+ * The key hashes the Gemfile text together with everything that can
+ * change its meaning before evaluation starts: the absolute path
+ * (__FILE__, eval_gemfile resolution), RUBY_VERSION from the environment,
+ * RUBY_PLATFORM and the wow version.  Inputs discovered during evaluation
+ * -- ENV lookups and eval_gemfile includes -- are stored in the entry and
+ * re-checked on load; any difference is a miss.
+ *
+ * A hit skips the lexer, evaluator and parser entirely.  The cache is
+ * best-effort: every failure reads as a miss and nothing is printed.
+ * Stores keep it bounded (wow_cache_trim): entries unused for 30 days
+ * go, then the least recently used beyond 512.
+ * Set WOW_NO_GEMFILE_CACHE=1 to bypass it.
+ */
+
+#include <stddef.h>
+
+#include "wow/gemfile/eval.h"
+#include "wow/gemfile/types.h"
+
+/*
+ * Cache key for the Gemfile at path whose contents are buf[0..len).
+ * Writes 64 hex digits + NUL to hex (hexsz >= 65).
+ * Returns 0 on success, -1 if the cache is disabled or unavailable.
+ */
+int wow_gemfile_cache_key(const char *path, const char *buf, int len,
+                          char *hex, size_t hexsz);
+
+/*
+ * Load the entry for key into gf if it exists and its recorded inputs
+ * still match.  Returns 0 on a hit, -1 on a miss (gf untouched).
+ */
+int wow_gemfile_cache_load(const char *key, struct wow_gemfile *gf);
+
+/*
+ * Store gf under key with the inputs it was evaluated against.
+ * Written atomically (temp file + rename).  Returns 0 or -1.
+ */
+int wow_gemfile_cache_store(const char *key, const struct wow_gemfile *gf,
+                            const struct wow_eval_inputs *in);
+
+#endif
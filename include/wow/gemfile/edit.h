@@ -0,0 +1,30 @@
+#ifndef WOW_GEMFILE_EDIT_H
+#define WOW_GEMFILE_EDIT_H
+
+/*
+ * edit.h -- in-place Gemfile edits for `wow add` / `wow remove`
+ *
+ * Edits are textual: only the affected lines change, so comments,
+ * groups and formatting elsewhere in the Gemfile survive.  The file
+ * is replaced atomically (write to a temp file, then rename).
+ */
+
+/*
+ * Add `gem "name", "c1", "c2"` after the last top-level gem line (or
+ * at the end of the file).  constraints may be NULL when n is 0.
+ * name must be [A-Za-z0-9._-]+ and no constraint may contain '"', '\',
+ * '#' or a line break; anything else is refused before the file is
+ * touched.  Returns 0 on success, -1 on error (diagnostic on stderr).
+ */
+int wow_gemfile_edit_add(const char *path, const char *name,
+                         char **constraints, int n_constraints);
+
+/*
+ * Remove every `gem "name"` declaration, including continuation lines
+ * of a declaration split over several lines with trailing commas.
+ * Returns the number of declarations removed (0 if none), or -1 on
+ * error (diagnostic on stderr).
+ */
+int wow_gemfile_edit_remove(const char *path, const char *name);
+
+#endif
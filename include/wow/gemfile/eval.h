@@ -96,6 +96,35 @@ struct wow_eval_tok {
     struct wow_token tok;
 };
 
+/* ------------------------------------------------------------------ */
+/* Recorded inputs                                                     */
+/* ------------------------------------------------------------------ */
+
+/*
+ * Everything outside the Gemfile text that an evaluation looked at: ENV
+ * lookups and eval_gemfile includes.  The parse cache stores these next
+ * to the result and only reuses it while they are unchanged.
+ */
+#define WOW_EVAL_MAX_INPUTS  64
+
+enum wow_eval_input_kind { WOW_INPUT_ENV, WOW_INPUT_FILE };
+
+struct wow_eval_input {
+    enum wow_eval_input_kind kind;
+    char *name;         /* ENV key, or resolved eval_gemfile path        */
+    char *value;        /* ENV value, or SHA-256 hex of the file;
+                         * NULL when unset / missing                     */
+};
+
+struct wow_eval_inputs {
+    struct wow_eval_input v[WOW_EVAL_MAX_INPUTS];
+    int  n;
+    bool overflow;      /* too many to record: result is not cacheable   */
+};
+
+/* Free the names and values held by in (not in itself). */
+void wow_eval_inputs_free(struct wow_eval_inputs *in);
+
 /* ------------------------------------------------------------------ */
 /* Evaluator context                                                   */
 /* ------------------------------------------------------------------ */
@@ -141,6 +170,10 @@ struct wow_eval_ctx {
     /* Recursion depth (for eval_gemfile) */
     int recurse_depth;
 
+    /* Where to record ENV / eval_gemfile inputs, or NULL (set by the
+     * caller after wow_eval_init; shared with nested eval_gemfile) */
+    struct wow_eval_inputs *inputs;
+
     /* Error state: non-zero means evaluation failed */
     int error;
     int error_line;
@@ -178,6 +211,9 @@ void wow_eval_free(struct wow_eval_ctx *ctx);
  */
 int wow_eval_next(struct wow_eval_ctx *ctx, struct wow_token *out_tok);
 
+/* RUBY_PLATFORM as the evaluator reports it (fixed at build time). */
+const char *wow_eval_ruby_platform(void);
+
 /*
  * Compare two dot-separated version strings numerically.
  * Returns <0, 0, or >0 (like strcmp but with numeric segment ordering).
@@ -2,19 +2,23 @@
 #define WOW_GEMS_H
 
 /*
- * Gem management — download, inspect, and unpack .gem files.
+ * Gem management — download, inspect, unpack and verify .gem files.
  * This is a convenience header that includes all gems submodules.
  */
 
 #include "wow/gems/download.h"
+#include "wow/gems/ext.h"
+#include "wow/gems/installed.h"
 #include "wow/gems/list.h"
 #include "wow/gems/meta.h"
 #include "wow/gems/unpack.h"
+#include "wow/gems/verify.h"
 
 /* Forward declarations for CLI handlers */
 int cmd_gem_download(int argc, char *argv[]);
 int cmd_gem_list(int argc, char *argv[]);
 int cmd_gem_meta(int argc, char *argv[]);
 int cmd_gem_unpack(int argc, char *argv[]);
+int cmd_cache(int argc, char *argv[]);
 
 #endif
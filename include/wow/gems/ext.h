@@ -0,0 +1,87 @@
+#ifndef WOW_GEMS_EXT_H
+#define WOW_GEMS_EXT_H
+
+#include <stddef.h>
+
+#include "wow/gems/meta.h"
+
+/*
+ * Native extension builds with a content-addressed artefact cache.
+ *
+ * Compiling a C extension (nokogiri, prism, json, ...) is by far the most
+ * expensive step of installing a gem.  The result only depends on the
+ * gem's contents, the Ruby ABI and the host, so the files an extension
+ * build installs into the gem's lib/ are kept in
+ *
+ *   $XDG_CACHE_HOME/wow/ext/<name>-<version>/<key>/
+ *
+ * (~/.cache/wow/ext when XDG_CACHE_HOME is unset), where <key> is the
+ * SHA-256 of:
+ *   gem checksum · Ruby API version · rbconfig arch · wow platform triple
+ *
+ * Any later install of the same gem for the same Ruby and host — another
+ * project, a wowx tool, a re-sync after `rm -rf vendor` — restores those
+ * files by hard link (copy across filesystems) instead of compiling.
+ */
+
+/* Directory holding cached extension builds.  Returns 0 or -1. */
+int wow_ext_cache_dir(char *buf, size_t bufsz);
+
+/*
+ * Does the unpacked gem already ship compiled code?  Looks for .so or
+ * .bundle files in lib/ and one level below (platform-specific gems
+ * such as nokogiri-1.16.0-x86_64-linux).  Returns 1 if so, 0 otherwise.
+ */
+int wow_gem_has_native_lib(const char *gem_dir);
+
+/*
+ * One gem whose extensions need building (or restoring from the cache).
+ * gem_path is the .gem the directory was unpacked from; its checksum is
+ * part of the cache key.
+ */
+struct wow_ext_job {
+    char              *gem_path;
+    char              *gem_dir;
+    struct wow_gemspec spec;        /* owned by the job */
+    int                rc;          /* 0 ok, -1 failed or dependency failed */
+    int                cached;      /* restored from the cache, not built */
+    double             secs;        /* wall time for the whole gem */
+    double            *ext_secs;    /* per extension, spec.n_extensions */
+};
+
+/* All extension work for one install (zero-initialise before use) */
+struct wow_ext_plan {
+    struct wow_ext_job *jobs;
+    size_t              n, cap;
+    double              secs;       /* wall time of wow_ext_plan_run */
+};
+
+/*
+ * Queue an unpacked gem.  Takes ownership of *spec (it is zeroed, or
+ * freed on failure).  Returns 0 on success, -1 on allocation failure.
+ */
+int wow_ext_plan_add(struct wow_ext_plan *p, const char *gem_path,
+                     const char *gem_dir, struct wow_gemspec *spec);
+
+/*
+ * Build every queued gem: restore from the cache where possible,
+ * otherwise run ruby extconf.rb && make && make install into
+ * <gem_dir>/lib.  Gems build concurrently under a GNU make jobserver
+ * sized to the CPU count; a gem waits for queued gems it depends on.
+ * Build output goes to <ext dir>/wow-build.log and is printed on failure.
+ *
+ * A cache that cannot be read or written only costs a rebuild.
+ * Returns 0 if every gem succeeded, -1 otherwise (errors printed).
+ */
+int wow_ext_plan_run(struct wow_ext_plan *p, const char *ruby_bin,
+                     const char *ruby_api);
+
+/*
+ * Print "Built N native extensions, restored M from cache, K failed in T"
+ * (zero counts left out) and one line per extension
+ */
+void wow_ext_plan_report(const struct wow_ext_plan *p);
+
+void wow_ext_plan_free(struct wow_ext_plan *p);
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef WOW_GEMS_INSTALLED_H
+#define WOW_GEMS_INSTALLED_H
+
+#include <stddef.h>
+
+/*
+ * Install-state manifest for a bundle (<env>/.wow-installed, next to
+ * gems/).
+ *
+ * `wow sync` used to decide what was installed by stat()ing every
+ * gems/<name>-<version> directory.  That costs a syscall per gem, never
+ * notices gems that dropped out of the lock, and treats a directory left
+ * half-extracted by an interrupted sync as installed.  The manifest
+ * records a gem only once its install has fully finished (unpacked, and
+ * native extensions built), so the directory listing is no longer
+ * trusted on its own.
+ *
+ * The file is an append-only log, one record per line, TAB-separated:
+ *
+ *   wow-installed<TAB>2
+ *   +<TAB><entry><TAB><name><TAB><version><TAB><platform>
+ *       <TAB><sha256><TAB><mode>          (one line)
+ *   -<TAB><entry>
+ *   gems-mtime<TAB><sec>.<nsec>
+ *
+ * <entry> is the directory under gems/; <platform> is the variant that
+ * was unpacked into it ("ruby" for generic gems), since the directory
+ * name alone does not say; <sha256> is the .gem it came from ("-" if
+ * unknown); <mode> is "gem", "ext" (extensions compiled), "ext-cached"
+ * (restored from the ext cache), "ext-pending" (unpacked, but extensions
+ * not built for want of a Ruby) or "adopted" (found on disk before the
+ * manifest existed).  Each record is appended with a single
+ * write() as soon as the step it describes has finished; a torn final
+ * line is ignored.  wow_installed_commit() compacts the log into a fresh
+ * file (temp + rename) ending with the gems/ mtime, which lets the next
+ * sync trust the manifest without looking at gems/ at all.
+ */
+
+struct wow_installed_gem {
+    char *entry;                /* "rack-3.1.7"                       */
+    char *name;
+    char *version;
+    char *platform;             /* "ruby" for generic gems            */
+    char  sha256[65];           /* "-" when unknown                   */
+    char  mode[16];
+};
+
+struct wow_installed {
+    char                     env_dir[256];
+    struct wow_installed_gem *gems;
+    size_t                   n, cap;
+    int                      exists;   /* a manifest was found         */
+    int                      fresh;    /* gems/ unchanged since commit */
+    int                      fd;       /* append handle, or -1         */
+};
+
+/*
+ * Read <env_dir>/.wow-installed.  A missing or unreadable manifest
+ * leaves m empty with exists = 0.  Returns -1 only on allocation
+ * failure (message printed).
+ */
+int wow_installed_load(struct wow_installed *m, const char *env_dir);
+
+/* Record for entry, or NULL */
+const struct wow_installed_gem *
+wow_installed_find(const struct wow_installed *m, const char *entry);
+
+/*
+ * Record for entry if it describes a complete install of platform
+ * (NULL = "ruby"), else NULL.  "ext-pending" records never count.
+ */
+const struct wow_installed_gem *
+wow_installed_find_complete(const struct wow_installed *m, const char *entry,
+                            const char *platform);
+
+/*
+ * Record a finished install (replacing any earlier record for entry)
+ * and append it to the log.  platform and sha256 may be NULL.
+ * Returns 0 or -1.
+ */
+int wow_installed_add(struct wow_installed *m, const char *entry,
+                      const char *name, const char *version,
+                      const char *platform, const char *sha256,
+                      const char *mode);
+
+/* Forget entry (before its directory is removed).  Returns 0 or -1. */
+int wow_installed_remove(struct wow_installed *m, const char *entry);
+
+/*
+ * Rewrite the manifest compactly, stamped with the current gems/ mtime.
+ * Returns 0 or -1 (message printed); on failure the log still holds
+ * every record, so nothing is lost.
+ */
+int wow_installed_commit(struct wow_installed *m);
+
+void wow_installed_free(struct wow_installed *m);
+
+/*
+ * gems/ entries to remove, given the solved entries[0..n_solved):
+ * recorded gems that are no longer solved and, unless the manifest is
+ * known to describe gems/ exactly (m->fresh), directories nobody
+ * recorded (left by older syncs or other tools).  Appends strdup'd
+ * names to *stale / *n_stale (initially NULL / 0; the caller frees
+ * them).  Returns 0 or -1 (message printed).
+ */
+int wow_installed_stale(const struct wow_installed *m,
+                        const char *const *solved, int n_solved,
+                        char ***stale, int *n_stale);
+
+/*
+ * Delete gems/<entry> for each of entries[0..n) on a pool of threads.
+ * Returns the number of directories that could not be removed.
+ */
+int wow_installed_prune(const char *env_dir, char *const *entries, int n);
+
+#endif
@@ -39,4 +39,17 @@ int wow_gemspec_parse(const char *gem_path, struct wow_gemspec *spec);
 
 void wow_gemspec_free(struct wow_gemspec *spec);
 
+/*
+ * Write the per-gem marker files consumed by wow's exec layer into an
+ * unpacked gem directory:
+ *   .require_paths — one load path per line (RUBYLIB construction)
+ *   .executables   — one binary name per line (binary discovery)
+ *
+ * Markers for empty lists are not written (readers default to "lib"
+ * and a bindir scan respectively).
+ * Returns 0 on success, -1 if a marker could not be written.
+ */
+int wow_gemspec_write_markers(const struct wow_gemspec *spec,
+                              const char *gem_dir);
+
 #endif
@@ -0,0 +1,40 @@
+#ifndef WOW_GEMS_VERIFY_H
+#define WOW_GEMS_VERIFY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Offline integrity check of cached .gem files.
+ *
+ * Every .gem carries checksums.yaml.gz, which lists the SHA-256 of its
+ * metadata.gz and data.tar.gz members.  Verification indexes each
+ * archive, then hashes the members in place (no extraction) across all
+ * gems at once on a pool of threads, and compares.  Gems built before
+ * RubyGems wrote SHA-256 checksums are counted as unchecked.
+ */
+
+struct wow_gem_verify_opts {
+    int jobs;                   /* hashing threads, <= 0 = one per CPU  */
+    int remove;                 /* delete corrupt gems                  */
+    int verbose;                /* print every gem, not just failures   */
+};
+
+struct wow_gem_verify_stats {
+    int      total;
+    int      ok;
+    int      unchecked;         /* no SHA-256 checksums in the archive  */
+    int      corrupt;
+    int      removed;
+    uint64_t bytes;             /* member bytes hashed                  */
+};
+
+/*
+ * Verify every *.gem in dir (the gem cache when dir is NULL).  Corrupt
+ * gems are reported on stdout as they are found.
+ * Returns 0 if the scan ran (check st->corrupt), -1 on error.
+ */
+int wow_gem_verify_dir(const char *dir, const struct wow_gem_verify_opts *o,
+                       struct wow_gem_verify_stats *st);
+
+#endif
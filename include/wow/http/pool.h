@@ -37,6 +37,13 @@ int  wow_http_pool_init(struct wow_http_pool *p, int max_conns);
 int  wow_http_pool_get(struct wow_http_pool *p, const char *url,
                        struct wow_response *resp);
 
+/*
+ * Conditional GET: sends If-None-Match: etag when etag is non-NULL.
+ * An unchanged resource comes back as status 304 with no body.
+ */
+int  wow_http_pool_get_if(struct wow_http_pool *p, const char *url,
+                          const char *etag, struct wow_response *resp);
+
 /* Close all pooled connections and free resources. */
 void wow_http_pool_cleanup(struct wow_http_pool *p);
 
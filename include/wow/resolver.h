@@ -11,6 +11,8 @@
 #include "wow/resolver/pubgrub.h"
 #include "wow/resolver/provider.h"
 #include "wow/resolver/lockfile.h"
+#include "wow/resolver/solcache.h"
+#include "wow/resolver/stats.h"
 
 /* Forward declarations for CLI handlers */
 int cmd_resolve(int argc, char *argv[]);
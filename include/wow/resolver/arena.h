@@ -11,6 +11,11 @@
  * IMPORTANT: The arena uses realloc() to grow, which may move the
  * buffer.  Never store raw pointers into the arena — use wow_aoff
  * offsets instead, and dereference via the WOW_ARENA_* macros.
+ *
+ * The exception is a fixed arena (wow_arena_init_fixed): its buffer is
+ * one address-space reservation that never moves, so pointers into it
+ * stay valid until destroy — which is what lets several threads read
+ * a shared provider while another appends to it.
  */
 
 #include <stddef.h>
@@ -50,15 +55,27 @@ typedef struct wow_arena {
     char  *buf;
     size_t used;
     size_t cap;
+    size_t reserved;     /* fixed arena: size of the mapping, else 0 */
+    int    mem_sys;      /* enum wow_mem_sys charged for growth (util/mem.h) */
+    size_t mem_charged;  /* bytes charged so far, released on destroy */
 } wow_arena;
 
 /* ------------------------------------------------------------------ */
 /* API                                                                 */
 /* ------------------------------------------------------------------ */
 
-/* Initialise an arena. Does not allocate — first alloc triggers growth. */
+/* Initialise an arena. Does not allocate — first alloc triggers growth.
+ * Growth is charged to WOW_MEM_OTHER; set a->mem_sys to attribute it. */
 void wow_arena_init(wow_arena *a);
 
+/*
+ * Initialise a fixed arena: reserve `reserve` bytes of address space up
+ * front (pages are only committed as they are used) so the buffer never
+ * moves.  Allocations beyond the reservation fail.  Returns 0, or -1 if
+ * the reservation could not be made.
+ */
+int wow_arena_init_fixed(wow_arena *a, size_t reserve);
+
 /* Allocate n bytes (8-byte aligned). Returns NULL on OOM. */
 void *wow_arena_alloc(wow_arena *a, size_t n);
 
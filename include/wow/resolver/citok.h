@@ -0,0 +1,58 @@
+#ifndef WOW_RESOLVER_CITOK_H
+#define WOW_RESOLVER_CITOK_H
+
+/*
+ * citok.h -- Delimiter scan for compact index bodies
+ *
+ * Every byte the compact index grammar splits on -- '\n', ' ', '|',
+ * ',', ':' and '&' -- is located in one pass over the body, sixteen or
+ * thirty-two bytes at a time (SSE2, or AVX2 when the CPU has it; a
+ * table-driven scalar loop elsewhere).  The result is a table of byte
+ * offsets in ascending order; the byte at each offset says which
+ * delimiter it is, and the text between two neighbouring offsets is a
+ * token.  The provider's line parser walks this table instead of
+ * calling strchr/strstr and copying lines into scratch buffers.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t *pos;      /* offsets of delimiter bytes, ascending */
+    size_t    n;
+    size_t    cap;
+} wow_ci_toks;
+
+/* True for the bytes wow_ci_tokenize() records */
+static inline int wow_ci_is_delim(unsigned char c)
+{
+    return c == '\n' || c == ' ' || c == '|' || c == ',' || c == ':' ||
+           c == '&';
+}
+
+/*
+ * Replace t's contents with the delimiter offsets of buf[0..len).
+ * len must be below 4 GiB.  t may be reused across calls (zero it
+ * before first use).  Returns 0, or -1 on allocation failure.
+ */
+int wow_ci_tokenize(const char *buf, size_t len, wow_ci_toks *t);
+
+void wow_ci_toks_free(wow_ci_toks *t);
+
+/*
+ * Write the delimiter offsets of buf[0..len) to out, which must have
+ * room for len entries (for short inputs such as a single line, where
+ * a stack array beats a heap table).  Returns the number written.
+ */
+size_t wow_ci_tokenize_into(const char *buf, size_t len, uint32_t *out);
+
+/* Scan kernel in use: "avx2", "sse2" or "scalar" */
+const char *wow_ci_tok_backend(void);
+
+/*
+ * Switch kernel by name (tests and benchmarks).  Returns 0, or -1 if
+ * the CPU lacks it.  Not safe while other threads are scanning.
+ */
+int wow_ci_tok_set_backend(const char *name);
+
+#endif
@@ -13,6 +13,7 @@
  */
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #define WOW_VER_MAX_SEGS    16
 #define WOW_VER_SEG_STRSZ   64
@@ -63,6 +64,9 @@ typedef struct {
  */
 int wow_gemver_parse(const char *s, wow_gemver *v);
 
+/* Same, for the len bytes at s (need not be NUL-terminated) */
+int wow_gemver_parse_n(const char *s, size_t len, wow_gemver *v);
+
 /*
  * Compare two parsed versions.
  * Returns <0 if a < b, 0 if a == b, >0 if a > b.
@@ -86,6 +90,13 @@ bool wow_gemver_match(const wow_gem_constraints *cs, const wow_gemver *v);
  */
 int wow_gem_constraints_parse(const char *s, wow_gem_constraints *cs);
 
+/*
+ * Parse one constraint ("~> 4.0") from the len bytes at s, which need
+ * not be NUL-terminated.  Returns 0 on success, -1 on parse error.
+ */
+int wow_gem_constraint_parse_n(const char *s, size_t len,
+                               wow_gem_constraint *c);
+
 /*
  * Format a constraint set back to string for display.
  * Writes to buf (max bufsz chars). Returns buf.
@@ -2,12 +2,17 @@
 #define WOW_RESOLVER_LOCKFILE_H
 
 /*
- * lockfile.h -- Bundler-format Gemfile.lock writer
+ * lockfile.h -- Bundler-format Gemfile.lock writer and reader
  *
  * Extracted from cmd_lock() so that both `wow lock` and `wow sync`
- * can share the same lockfile writing logic.
+ * can share the same lockfile writing logic.  The reader lets
+ * `wow sync` install straight from an up-to-date lock without
+ * touching the network.
  */
 
+#include <stddef.h>
+
+#include "wow/resolver/provider.h"
 #include "wow/resolver/pubgrub.h"
 #include "wow/gemfile/types.h"
 
@@ -32,4 +37,132 @@ int wow_write_lockfile(const char *path, wow_solver *solver,
  */
 void wow_join_constraints(char **cs, int n, char *buf, size_t bufsz);
 
+/* ------------------------------------------------------------------ */
+/* Reader                                                              */
+/* ------------------------------------------------------------------ */
+
+/* One "name (version[-platform])" entry under GEM specs */
+struct wow_lock_spec {
+    char  *name;
+    char  *version;
+    char  *platform;          /* NULL = generic "ruby" gem */
+    char **dep_names;
+    char **dep_constraints;   /* "~> 1.2, >= 1.2.3", or NULL for any */
+    int    n_deps;
+};
+
+/* One DEPENDENCIES entry */
+struct wow_lock_dep {
+    char *name;
+    char *constraint;         /* NULL for any version */
+};
+
+struct wow_lockfile {
+    char                 *remote;        /* GEM remote, or NULL */
+    struct wow_lock_spec *specs;
+    int                   n_specs;
+    char                **platforms;
+    int                   n_platforms;
+    struct wow_lock_dep  *deps;
+    int                   n_deps;
+    char                 *ruby_version;  /* RUBY VERSION, or NULL */
+    char                 *bundled_with;  /* BUNDLED WITH, or NULL */
+};
+
+/*
+ * Parse a Bundler-format Gemfile.lock.  Only the rubygems GEM section
+ * is read into specs; GIT and PATH sections are skipped (wow does not
+ * install from them).  A "!" pin marker on a dependency is dropped.
+ *
+ * Returns 0 on success, -1 if the file cannot be read (errno set) or
+ * is malformed (message printed).  Free with wow_lockfile_free().
+ */
+int  wow_lockfile_parse(const char *path, struct wow_lockfile *lf);
+void wow_lockfile_free(struct wow_lockfile *lf);
+
+/*
+ * Pick the spec to install for each locked gem on this host.  A lock
+ * may carry several variants of one version (nokogiri generic plus
+ * x86_64-linux and arm64-darwin); the first matching entry of plats
+ * wins, then the generic gem.
+ *
+ * On success *out is a malloc'd array sorted by name whose strings
+ * point into lf, and 0 is returned.  Returns -1 with a reason in why
+ * if a gem has no variant usable here or memory runs out.
+ */
+int wow_lockfile_select(const struct wow_lockfile *lf,
+                        const char *const *plats, int n_plats,
+                        wow_resolved_pkg **out, int *n_out,
+                        char *why, size_t whysz);
+
+/* wow_lockfile_select() for this host's platforms (wow_ci_host_platforms) */
+int wow_lockfile_select_host(const struct wow_lockfile *lf,
+                             wow_resolved_pkg **out, int *n_out,
+                             char *why, size_t whysz);
+
+/*
+ * Is the lock still a valid resolution of the Gemfile?  True when the
+ * source matches, DEPENDENCIES lists exactly the Gemfile's gems with
+ * the same constraints (compared as parsed sets, so order and spacing
+ * do not matter), and the selected packages (wow_lockfile_select_host
+ * output) satisfy every Gemfile constraint and the dependencies of
+ * their own specs.  Variants for other platforms are not consulted.
+ *
+ * Returns 1 if so, 0 with a reason in why otherwise.
+ */
+int wow_lockfile_satisfies(const struct wow_lockfile *lf,
+                           const struct wow_gemfile *gf,
+                           const char *source,
+                           const wow_resolved_pkg *pkgs, int n_pkgs,
+                           char *why, size_t whysz);
+
+/* ------------------------------------------------------------------ */
+/* Lock-seeded provider                                                */
+/* ------------------------------------------------------------------ */
+
+/*
+ * Wraps a real provider so that re-resolving prefers the versions
+ * already in Gemfile.lock.  A locked version is offered through
+ * preferred_version, and its dependencies and platform come from the
+ * lock itself.  The solver still checks it against the version list,
+ * so a locked version that has been yanked is not reused.  Anything
+ * else falls through to the inner provider: a gem whose locked version
+ * no longer fits, or a new gem.  Adding one gem to a large app
+ * therefore parses index dependencies only for the packages it
+ * actually touches.
+ */
+struct wow_lock_prov_deps;
+
+typedef struct {
+    const struct wow_lockfile *lf;
+    const wow_resolved_pkg    *pkgs;    /* wow_lockfile_select output */
+    int                        n_pkgs;  /* 0 = pass everything through */
+    wow_provider              *inner;
+    struct wow_lock_prov_deps *deps;    /* parsed lazily, per pkgs[i] */
+} wow_lock_provider;
+
+/*
+ * lf and pkgs are borrowed and must outlive the provider.  A lock for
+ * a different source than `source` is ignored.  Returns 0, or -1 on
+ * allocation failure.
+ */
+int wow_lock_provider_init(wow_lock_provider *lp,
+                           const struct wow_lockfile *lf,
+                           const wow_resolved_pkg *pkgs, int n_pkgs,
+                           const char *source, wow_provider *inner);
+wow_provider wow_lock_provider_as_provider(wow_lock_provider *lp);
+void wow_lock_provider_destroy(wow_lock_provider *lp);
+
+/*
+ * Warm ci with /info for every gem in the lock's GEM specs before a
+ * solve.  The solver lists the versions of nearly all of them, seeded
+ * or not (a seeded solve checks each locked version is still in the
+ * index), one package at a time as it reaches each; fetching them
+ * together up front turns that serial chain into one parallel burst
+ * (wow_ci_provider_prefetch).
+ * Returns the number of packages fetched, or -1 on allocation failure.
+ */
+int wow_lockfile_prefetch(const struct wow_lockfile *lf,
+                          wow_ci_provider *ci);
+
 #endif
@@ -9,7 +9,9 @@
  * PubGrub solver can discover packages and their dependencies.
  *
  * Each package is fetched at most once and cached in memory for the
- * duration of the resolve.
+ * duration of the resolve.  A provider is used by one solver at a time
+ * unless it was set up with wow_ci_provider_init_shared(), in which case
+ * any number of solvers on different threads may use it at once.
  *
  * All persistent pointers into the provider arena are stored as
  * wow_aoff offsets — see arena.h for rationale.
@@ -29,6 +31,8 @@ struct wow_ci_dep {
 struct wow_ci_ver_deps {
     wow_aoff deps_offset;   /* offset to wow_ci_dep[] in arena */
     int      n_deps;
+    int      platform;      /* 0 = generic "ruby" gem, else 1 + index
+                             * into the provider's platforms[] */
 };
 
 /* ------------------------------------------------------------------ */
@@ -40,13 +44,39 @@ struct wow_ci_pkg {
     wow_aoff  versions_offset;   /* offset to wow_gemver[] in arena */
     int       n_versions;
     wow_aoff  ver_deps_offset;   /* offset to wow_ci_ver_deps[] in arena */
+    wow_aoff  digest;            /* SHA-256 hex of the /info body ("404"
+                                  * if none), or WOW_AOFF_NULL when the
+                                  * provider was not recording digests */
 };
 
 /* ------------------------------------------------------------------ */
 /* Compact index provider context                                      */
 /* ------------------------------------------------------------------ */
 
-#define WOW_CI_MAX_PKGS 1024
+#define WOW_CI_MAX_PKGS 2048
+
+/*
+ * Host platforms, most preferred first.  A compact index line such as
+ * "1.16.0-x86_64-linux" is kept only when its platform is in this list;
+ * for each version the provider keeps the single best variant (a
+ * listed platform beats the generic "ruby" gem) together with that
+ * variant's dependencies, so the solver resolves against exactly the
+ * artefact that will be installed.
+ */
+#define WOW_CI_MAX_PLATFORMS 4
+#define WOW_CI_PLATFORM_LEN  32
+
+/* Index traffic for one resolve (reported by --stats) */
+typedef struct {
+    int    cache_hits;     /* package lookups answered from memory */
+    int    cache_misses;   /* lookups that went to the network */
+    int    prefetched;     /* of which fetched ahead by _prefetch() */
+    int    not_found;      /* of which /info returned 404 */
+    int    via_daemon;     /* of which answered through `wow daemon` */
+    size_t fetch_bytes;    /* /info response bodies received */
+    double fetch_secs;     /* wall time in HTTP */
+    double parse_secs;     /* wall time parsing compact index data */
+} wow_ci_stats;
 
 typedef struct {
     struct wow_ci_pkg  pkgs[WOW_CI_MAX_PKGS];
@@ -60,31 +90,116 @@ typedef struct {
     wow_gemver         ruby_ver;
     bool               has_ruby_ver;
 
+    /* Record a digest of every /info body (for the solution cache) */
+    bool               digest_bodies;
+
+    /* Native gem platforms accepted for this host (see above) */
+    char               platforms[WOW_CI_MAX_PLATFORMS][WOW_CI_PLATFORM_LEN];
+    int                n_platforms;
+
     /* Connection pool for HTTP Keep-Alive */
     struct wow_http_pool *pool;
+
+    /* Lock, in-flight fetches and per-fetch pools when shared, else NULL */
+    struct wow_ci_shared *shared;
+
+    wow_ci_stats       stats;
 } wow_ci_provider;
 
 /*
  * Initialise a compact index provider.
- * source_url:    gem source (e.g. "https://rubygems.org").
+ * source_url:    gem source (e.g. "https://rubygems.org"), or
+ *                file:///dir to replay recorded index data from
+ *                dir/info/{name} without touching the network.
  * pool:          HTTP connection pool (caller-owned, must outlive provider).
  *                Pass NULL to use individual connections (slower).
  * ruby_version:  target Ruby version string (e.g. "3.4.8") for filtering
  *                versions by compact index ruby: metadata.  Pass NULL to
  *                disable metadata filtering.
+ *
+ * Platforms default to the host's (wow_ci_host_platforms); call
+ * wow_ci_provider_set_platforms() before resolving to override.
  */
 void wow_ci_provider_init(wow_ci_provider *p, const char *source_url,
                            struct wow_http_pool *pool,
                            const char *ruby_version);
 
+/*
+ * Initialise a provider that several threads may resolve against at
+ * once (wow workspace).  Its arena is a fixed reservation of
+ * WOW_CI_SHARED_RESERVE bytes so cached data never moves; lookups of
+ * cached packages take no lock; a miss fetches outside the lock with one
+ * of n_fetchers private HTTP pools, and concurrent misses on the same
+ * package wait for a single fetch.  Returns 0, or -1 (message printed).
+ */
+#define WOW_CI_SHARED_RESERVE ((size_t)1 << 30)
+
+int wow_ci_provider_init_shared(wow_ci_provider *p, const char *source_url,
+                                int n_fetchers, const char *ruby_version);
+
+/*
+ * Digest of the /info data cached for name (see wow_ci_pkg.digest), or
+ * NULL if name is not cached or was added before digest_bodies was set.
+ */
+const char *wow_ci_provider_digest(wow_ci_provider *p, const char *name);
+
+/*
+ * Fetch /info for every name not already cached, up to `threads` at a
+ * time (<= 0: WOW_CI_PREFETCH_JOBS), and add them to the cache before
+ * the solver asks.  Names may repeat.  The calling thread fetches
+ * through the provider's pool; the others open their own connections.
+ * A name whose fetch fails is left uncached, so the solver's own lookup
+ * retries it and reports the error.  Returns the number of packages
+ * added, or -1 on allocation failure.
+ */
+#define WOW_CI_PREFETCH_JOBS 8
+
+int wow_ci_provider_prefetch(wow_ci_provider *p, const char *const *names,
+                             int n, int threads);
+
+/*
+ * RubyGems platform strings for this machine, most specific first:
+ *   glibc Linux:  x86_64-linux-gnu, x86_64-linux   (aarch64-… likewise)
+ *   musl Linux:   x86_64-linux-musl
+ *   macOS:        arm64-darwin / x86_64-darwin
+ * Returns the number written (0 on unknown hosts: generic gems only).
+ */
+int wow_ci_host_platforms(char out[][WOW_CI_PLATFORM_LEN], int max);
+
+/* Replace the accepted platform list (n = 0: generic gems only) */
+void wow_ci_provider_set_platforms(wow_ci_provider *p,
+                                   const char *const *platforms, int n);
+
 /*
  * Build a wow_provider struct pointing at this compact index provider.
- * The returned struct's .ctx points at p, with list_versions and get_deps
- * bound to the compact index callbacks.
+ * The returned struct's .ctx points at p, with list_versions, get_deps
+ * and get_platform bound to the compact index callbacks.
  */
 wow_provider wow_ci_provider_as_provider(wow_ci_provider *p);
 
 /* Free all resources owned by the provider. */
 void wow_ci_provider_destroy(wow_ci_provider *p);
 
+/*
+ * Parse a single compact index version line ("version deps|metadata",
+ * trailing newline already stripped).  Dependencies are stored in arena
+ * as a wow_ci_dep[] at *deps_offset_out.  Exposed for the provider and
+ * `wow debug bench`.
+ *
+ * *platform_out is 0 for a generic gem, or 1 + the index of the
+ * version's platform in platforms[]; other platforms are skipped (-1).
+ *
+ * When ruby_ver is non-NULL, the metadata section after '|' is checked
+ * for a ruby: constraint.  If the target Ruby version doesn't satisfy
+ * it, the version is skipped (-1).
+ *
+ * Returns 0 on success, -1 to skip (platform/metadata filter), -2 on error.
+ */
+int wow_ci_parse_line(wow_arena *arena, const char *line,
+                      const wow_gemver *ruby_ver,
+                      const char (*platforms)[WOW_CI_PLATFORM_LEN],
+                      int n_platforms,
+                      wow_gemver *ver_out, int *platform_out,
+                      wow_aoff *deps_offset_out, int *n_deps_out);
+
 #endif
@@ -36,6 +36,10 @@ typedef struct {
     .min_inclusive = true, .max_inclusive = true })
 /* NONE is detected by: has_min && has_max && min > max */
 
+/* Intersect two ranges.  The result may be empty. */
+wow_ver_range wow_ver_range_intersect(const wow_ver_range *a,
+                                      const wow_ver_range *b);
+
 /* ------------------------------------------------------------------ */
 /* Terms and incompatibilities                                         */
 /* ------------------------------------------------------------------ */
@@ -52,6 +56,7 @@ enum wow_incomp_cause {
     CAUSE_ROOT,        /* direct requirement from user's Gemfile */
     CAUSE_DEPENDENCY,  /* package X version V depends on Y */
     CAUSE_CONFLICT,    /* derived from two conflicting incompatibilities */
+    CAUSE_NO_VERSIONS, /* no listed version of X is left in the range */
 };
 
 /* An incompatibility: set of terms that cannot all be true simultaneously */
@@ -76,8 +81,12 @@ typedef struct {
     bool          positive;       /* true = must be in range, false = must NOT */
     int           decision_level;
     wow_aoff      cause;          /* offset to wow_incomp; WOW_AOFF_NULL = none */
+    int           prev;           /* previous assignment to package, or -1 */
+    int           n_incomps;      /* decisions: incompatibilities when made */
 } wow_assignment;
 
+struct wow_pkg_slot;              /* interned package name (pubgrub.c) */
+
 /* ------------------------------------------------------------------ */
 /* Package version provider                                            */
 /* ------------------------------------------------------------------ */
@@ -105,6 +114,24 @@ typedef struct {
                     wow_gem_constraints **dep_constraints_out,
                     int *n_deps_out);
 
+    /*
+     * Optional (may be NULL).  Platform of the artefact the provider
+     * would install for this version, e.g. "x86_64-linux", or NULL for
+     * the generic "ruby" gem.  The string must outlive the provider.
+     */
+    const char *(*get_platform)(void *ctx, const char *package,
+                                const wow_gemver *version);
+
+    /*
+     * Optional (may be NULL).  Version to decide on before any other,
+     * e.g. the one in the existing Gemfile.lock, or NULL for none.
+     * While it is still allowed the solver takes it without calling
+     * list_versions, so unchanged parts of a lock cost no index
+     * fetches.  The pointer must stay valid for the duration of the
+     * solve.
+     */
+    const wow_gemver *(*preferred_version)(void *ctx, const char *package);
+
     void *ctx;
 } wow_provider;
 
@@ -115,8 +142,36 @@ typedef struct {
 typedef struct {
     const char *name;
     wow_gemver  version;
+    const char *platform;   /* NULL = generic "ruby" gem */
 } wow_resolved_pkg;
 
+/* ------------------------------------------------------------------ */
+/* Solver statistics                                                   */
+/* ------------------------------------------------------------------ */
+
+/*
+ * Counters filled in by wow_solve, reset at wow_solver_init.  Cheap
+ * enough to keep on unconditionally; `wow resolve --stats` and
+ * `wow lock --stats` print them.
+ */
+typedef struct {
+    int    decisions;            /* versions chosen (again after backjumps) */
+    int    preferred;            /* of which taken from preferred_version */
+    int    propagations;         /* assignments derived by unit propagation */
+    int    conflicts;            /* conflicts found by propagation */
+    int    backjumps;            /* conflicts resolved by backjumping */
+    int    backjump_levels;      /* decision levels undone, in total */
+    int    learned;              /* incompatibilities derived from conflicts */
+    int    list_versions_calls;  /* provider callbacks made */
+    int    get_deps_calls;
+    int    max_decision_level;
+    int    max_assignments;      /* partial solution high-water mark */
+    int    n_incomps;            /* incompatibilities at the end */
+    size_t arena_peak;           /* solver arena high-water mark, bytes */
+    double solve_secs;           /* wall time of wow_solve */
+    double provider_secs;        /* of which inside provider callbacks */
+} wow_solver_stats;
+
 /* ------------------------------------------------------------------ */
 /* Solver state                                                        */
 /* ------------------------------------------------------------------ */
@@ -127,6 +182,8 @@ typedef struct {
     /* Incompatibilities (dynamic array of offsets into arena) */
     wow_aoff        *incomps;
     int              n_incomps, incomps_cap;
+    int              n_propagated; /* the partial solution is a fixpoint
+                                    * of unit propagation over this many */
 
     /* Partial solution (dynamic array) */
     wow_assignment  *assignments;
@@ -135,12 +192,20 @@ typedef struct {
     int              decision_level;
     wow_provider    *provider;
 
+    /* Package names, interned so equal names share one arena offset,
+     * each with its latest assignment (open addressing, names_cap a
+     * power of two) */
+    struct wow_pkg_slot *names;
+    int              n_names, names_cap;
+
     /* Solution output */
     wow_resolved_pkg *solution;
     int               n_solved;
 
     /* Error output */
     char              error_msg[4096];
+
+    wow_solver_stats  stats;
 } wow_solver;
 
 /* ------------------------------------------------------------------ */
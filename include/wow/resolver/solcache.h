@@ -0,0 +1,69 @@
+#ifndef WOW_RESOLVER_SOLCACHE_H
+#define WOW_RESOLVER_SOLCACHE_H
+
+/*
+ * solcache.h -- on-disk cache of solved resolutions
+ *
+ * Repeated resolves of the same roots (wowx re-creating a tool env, CI
+ * jobs locking an unchanged Gemfile) reach the same answer.  Each
+ * successful solve is stored under $XDG_CACHE_HOME/wow/solution/<key>
+ * (~/.cache/wow/solution by default), where the key hashes the
+ * normalised root names and constraints, the gem source, the target
+ * Ruby version, the accepted platforms and a caller-supplied seed (the
+ * lockfile that steered the solve, if any).
+ *
+ * The entry also records the digest of every /info file the solve read.
+ * A hit fetches those files in one parallel burst
+ * (wow_ci_provider_prefetch) and compares digests: if any gem gained a
+ * release or changed its dependencies the entry is a miss, otherwise
+ * the stored solution is returned without running the solver.  Either
+ * way the provider is left warm, so lockfile writing and a fallback
+ * solve cost no further fetches.
+ *
+ * The cache is best-effort: every failure reads as a miss and nothing
+ * is printed.  Stores keep it bounded (wow_cache_trim): entries unused
+ * for 30 days go, then the least recently used beyond 512.
+ * Set WOW_NO_SOLUTION_CACHE=1 to bypass it.
+ *
+ *   char key[65];
+ *   int cached = wow_solcache_key(&ci, names, cs, n, NULL,
+ *                                 key, sizeof(key)) == 0;
+ *   if (!cached || wow_solcache_load(key, &ci, &solver) != 0) {
+ *       rc = wow_solve(&solver, names, cs, n);
+ *       if (rc == 0 && cached) wow_solcache_store(key, &ci, &solver);
+ *   }
+ */
+
+#include <stddef.h>
+
+#include "wow/resolver/provider.h"
+#include "wow/resolver/pubgrub.h"
+
+/*
+ * Compute the cache key for solving names/cs against ci, and switch ci
+ * to recording /info digests.  Call before ci fetches anything (before
+ * any prefetch) so that every package it caches carries a digest.
+ * seed is extra input the solution depends on, or NULL.
+ * Writes 64 hex digits + NUL to hex (hexsz >= 65).
+ * Returns 0, or -1 if the cache is disabled or unavailable.
+ */
+int wow_solcache_key(wow_ci_provider *ci, const char *const *names,
+                     const wow_gem_constraints *cs, int n,
+                     const char *seed, char *hex, size_t hexsz);
+
+/*
+ * Fill s->solution / s->n_solved as wow_solve() would, if key has an
+ * entry and every /info file it recorded is unchanged in ci.  s must
+ * be initialised and not yet solved.  Returns 0 on a hit, -1 on a miss.
+ */
+int wow_solcache_load(const char *key, wow_ci_provider *ci, wow_solver *s);
+
+/*
+ * Store s's solution under key with the digests of everything ci has
+ * cached.  Skipped (-1) if any package lacks a digest.  Written
+ * atomically (temp file + rename).  Returns 0 or -1.
+ */
+int wow_solcache_store(const char *key, wow_ci_provider *ci,
+                       const wow_solver *s);
+
+#endif
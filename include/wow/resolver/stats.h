@@ -0,0 +1,43 @@
+#ifndef WOW_RESOLVER_STATS_H
+#define WOW_RESOLVER_STATS_H
+
+/*
+ * stats.h -- Resolver statistics report
+ *
+ * Combines the solver's counters (wow_solver_stats) with the compact
+ * index provider's traffic (wow_ci_stats) into the report printed by
+ * `wow resolve --stats`, `wow lock --stats` and `wow sync --stats`.
+ * --stats=json emits the same numbers as one JSON object so CI can diff
+ * them across commits and flag pathological Gemfiles.  When memory
+ * accounting is on (wow_mem_enable) the per-subsystem counters and
+ * per-phase RSS samples are appended.
+ */
+
+#include <stdio.h>
+
+#include "wow/resolver/provider.h"
+#include "wow/resolver/pubgrub.h"
+
+/* How --stats was spelled on the command line */
+enum wow_stats_mode {
+    WOW_STATS_OFF,
+    WOW_STATS_TEXT,    /* --stats */
+    WOW_STATS_JSON,    /* --stats=json */
+};
+
+/*
+ * Recognise --stats / --stats=json.  Returns 1 and sets *mode if arg is
+ * one of them, 0 otherwise.
+ */
+int wow_stats_flag(const char *arg, enum wow_stats_mode *mode);
+
+/*
+ * Print the report.  ss may be NULL when no solve ran (a sync satisfied
+ * by the lockfile); ci may be NULL when no compact index provider was
+ * involved.  Text goes to out as a table; JSON as a single line.
+ */
+void wow_resolve_stats_print(FILE *out, enum wow_stats_mode mode,
+                             const wow_solver_stats *ss,
+                             const wow_ci_provider *ci);
+
+#endif
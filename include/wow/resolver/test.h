@@ -4,6 +4,8 @@
  * Provides:
  *   wow debug version-test  — hardcoded version matching tests
  *   wow debug pubgrub-test  — hardcoded PubGrub solver tests
+ *   wow debug bench-resolve — resolver benchmark over a recorded corpus
+ *   wow debug bench         — microbenchmarks for core primitives
  */
 
 #ifndef WOW_RESOLVER_TEST_H
@@ -15,4 +17,10 @@ int cmd_debug_version_test(int argc, char *argv[]);
 /* PubGrub resolver algorithm tests */
 int cmd_debug_pubgrub_test(int argc, char *argv[]);
 
+/* Offline resolver benchmark (tests/bench/resolve) */
+int cmd_debug_bench_resolve(int argc, char *argv[]);
+
+/* Microbenchmarks: version/constraint/index parsing, SHA-256, gunzip, tar */
+int cmd_debug_bench(int argc, char *argv[]);
+
 #endif
@@ -31,6 +31,9 @@ int wow_resolve_ruby_version(const char *input, char *full_ver, size_t bufsz);
 /* Find .ruby-version file walking up directory tree */
 int wow_find_ruby_version(char *buf, size_t bufsz);
 
+/* Same, starting from dir (absolute) instead of the working directory */
+int wow_find_ruby_version_in(const char *dir, char *buf, size_t bufsz);
+
 /* Get path to ruby binary for a version */
 int wow_ruby_bin_path(const char *version, char *buf, size_t bufsz);
 
@@ -9,4 +9,23 @@
 /* Create shims in the shims directory */
 int wow_create_shims(const char *wow_binary_path);
 
+/* Non-zero if name (argv[0] basename, ".com" stripped) is one of the
+ * shim names created by wow_create_shims(). */
+int wow_is_shim_name(const char *name);
+
+/*
+ * Shim dispatch: resolve .ruby-version from cwd and execve the managed
+ * binary named progname.  Only returns on failure (exit status 1, error
+ * already printed).
+ *
+ * Resolution is cached in the WOW_SHIM_CACHE environment variable, which
+ * the exec'd Ruby inherits — so a test suite spawning ruby thousands of
+ * times re-validates with a handful of stat()s instead of re-walking
+ * and re-reading .ruby-version.  The entry is keyed by the cwd's
+ * device/inode and is invalidated by any change to the .ruby-version
+ * file (inode or mtime) or to a directory between cwd and it (mtime —
+ * catches a new .ruby-version appearing closer to cwd).
+ */
+int wow_shim_exec(const char *progname, char *argv[]);
+
 #endif
@@ -10,4 +10,8 @@
 
 int cmd_sync(int argc, char *argv[]);
 
+/* Edit the Gemfile (add or remove gems), then sync */
+int cmd_add(int argc, char *argv[]);
+int cmd_remove(int argc, char *argv[]);
+
 #endif
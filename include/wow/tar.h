@@ -21,6 +21,31 @@
 int wow_tar_extract_gz(const char *gz_path, const char *dest_dir,
                        int strip_components);
 
+/*
+ * Observer for the raw (still compressed) bytes of a streamed archive.
+ * Called once per read chunk, in order — suitable for incremental
+ * hashing while extraction proceeds.
+ */
+typedef void (*wow_tar_tee_fn)(const void *data, size_t len, void *ctx);
+
+/*
+ * Extract a gzipped tar archive read from a file descriptor (typically
+ * the read end of a pipe fed by an HTTP download).  Same security
+ * guarantees as wow_tar_extract_gz().
+ *
+ * tee:     optional; receives every compressed byte read from fd.
+ * tee_ctx: passed through to tee.
+ *
+ * The input is always read to EOF, even when extraction fails, so a
+ * producer writing into a pipe is never left blocked.  fd is not
+ * closed.  On failure dest_dir may hold partial output — extract into
+ * a staging directory and discard it.
+ *
+ * Returns 0 on success, -1 on error (messages printed to stderr).
+ */
+int wow_tar_extract_gz_fd(int fd, const char *dest_dir, int strip_components,
+                          wow_tar_tee_fn tee, void *tee_ctx);
+
 /*
  * Extract an uncompressed tar archive to a destination directory.
  * Same interface and security guarantees as wow_tar_extract_gz().
@@ -46,6 +71,13 @@ typedef int (*wow_tar_list_fn)(const char *name, size_t size,
  */
 int wow_tar_list(const char *tar_path, wow_tar_list_fn fn, void *ctx);
 
+/*
+ * Iterate entries in a gzipped tar, calling fn for each.  Entry data is
+ * decompressed and skipped, never written.  Returns 0 on success, -1 on
+ * error.
+ */
+int wow_tar_list_gz(const char *gz_path, wow_tar_list_fn fn, void *ctx);
+
 /*
  * Extract a single named entry from an uncompressed tar to a buffer.
  *
@@ -68,4 +100,24 @@ int wow_tar_read_entry(const char *tar_path, const char *entry_name,
 int wow_tar_extract_entry_to_fd(const char *tar_path, const char *entry_name,
                                 int fd);
 
+/*
+ * Where one member's data sits inside an uncompressed tar, for callers
+ * that read or hash the bytes in place.
+ */
+struct wow_tar_member {
+    char     name[256];
+    uint64_t offset;            /* first data byte in the archive */
+    size_t   size;
+    char     typeflag;
+};
+
+/*
+ * Index the entries of an uncompressed tar without reading their data
+ * (one pread() per header).  Stores up to max entries in out.
+ *
+ * Returns the number of entries in the archive (which may exceed max),
+ * or -1 if it is unreadable or malformed.  Nothing is printed.
+ */
+int wow_tar_index(const char *tar_path, struct wow_tar_member *out, int max);
+
 #endif
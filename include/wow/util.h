@@ -2,7 +2,7 @@
 #define WOW_UTIL_H
 
 /*
- * Utility functions — time, colour, paths, hashing, compression.
+ * Utility functions — time, colour, paths, hashing, compression, tracing.
  * Convenience header that includes all util submodules.
  */
 
@@ -11,5 +11,7 @@
 #include "wow/util/path.h"
 #include "wow/util/sha256.h"
 #include "wow/util/gunzip.h"
+#include "wow/util/trace.h"
+#include "wow/util/mem.h"
 
 #endif
@@ -0,0 +1,64 @@
+#ifndef WOW_UTIL_MEM_H
+#define WOW_UTIL_MEM_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Allocation accounting and peak-RSS sampling, reported by --stats.
+ *
+ * Off by default; wow_mem_enable() switches it on.  Memory is tracked per
+ * subsystem from two sources:
+ *   - arenas (wow_arena_* grows and frees are charged to the arena's
+ *     mem_sys tag);
+ *   - the wow_mem_* wrappers below, which the larger work buffers go
+ *     through.
+ * Counters are atomic, so download and build threads can charge them
+ * without a lock.  When accounting is off, arenas pay a single branch
+ * and the wrappers are malloc plus a 16-byte size header.
+ *
+ * wow_mem_phase() samples current and peak RSS at a phase boundary
+ * ("resolve", "download", ...) so the report shows where the process
+ * grew, including memory nobody charged to a subsystem.
+ */
+
+enum wow_mem_sys {
+    WOW_MEM_OTHER,      /* untagged arenas */
+    WOW_MEM_SOLVER,     /* PubGrub solver arena */
+    WOW_MEM_INDEX,      /* compact index provider arena */
+    WOW_MEM_SYNC,       /* cmd_sync work arrays (specs, paths, URLs) */
+    WOW_MEM_DOWNLOAD,   /* per-download receive buffers */
+    WOW_MEM_NSYS
+};
+
+/* Non-zero when accounting is on */
+extern int wow_mem_on;
+
+/* Switch accounting on (idempotent).  Samples a "start" phase. */
+void wow_mem_enable(void);
+
+/* Charge (delta > 0) or release (delta < 0) bytes against sys */
+void wow_mem_charge(enum wow_mem_sys sys, ptrdiff_t delta);
+
+/*
+ * malloc/calloc/realloc/free with accounting.  Blocks carry their size
+ * and subsystem in a header, so they must be released with
+ * wow_mem_free() and resized with wow_mem_realloc(), never with the
+ * libc functions.
+ */
+void *wow_mem_malloc(enum wow_mem_sys sys, size_t size);
+void *wow_mem_calloc(enum wow_mem_sys sys, size_t n, size_t size);
+void *wow_mem_realloc(void *p, size_t size);
+void  wow_mem_free(void *p);
+
+/* Sample RSS at the end of a phase (name must outlive the process) */
+void wow_mem_phase(const char *name);
+
+/*
+ * Print subsystem counters and phase samples: a table, or (json != 0)
+ * a JSON object with no trailing newline, for embedding in a larger
+ * report.
+ */
+void wow_mem_report(FILE *out, int json);
+
+#endif
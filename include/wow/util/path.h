@@ -6,4 +6,15 @@
 /* Recursive mkdir -p. Returns 0 on success, -1 on error. */
 int wow_mkdirs(char *path, mode_t mode);
 
+/*
+ * Keep a flat cache directory bounded.  At most once a day (tracked by
+ * the mtime of <dir>/.trim) delete entries not modified for max_age
+ * seconds, then the oldest until at most max_entries remain.  Names
+ * starting with '.' are left alone.  Best effort: errors are ignored.
+ */
+void wow_cache_trim(const char *dir, long max_age, int max_entries);
+
+/* Mark a cache entry as used: its mtime is its age for wow_cache_trim */
+void wow_cache_touch(const char *path);
+
 #endif
@@ -2,6 +2,22 @@
 #define WOW_UTIL_SHA256_H
 
 #include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The block function is chosen at runtime: x86-64 SHA extensions,
+ * ARMv8 SHA2 instructions, or portable C.  WOW_SHA256=<name> overrides
+ * the choice when that backend is usable.
+ */
+
+/* Name of the backend in use: "sha-ni", "armv8" or "portable" */
+const char *wow_sha256_backend(void);
+
+/*
+ * Switch backend by name (tests and benchmarks).  Returns 0, or -1 if
+ * the CPU lacks it.  Not safe while other threads are hashing.
+ */
+int wow_sha256_set_backend(const char *name);
 
 /*
  * Compute SHA-256 of a file and return as hex string.
@@ -14,4 +30,48 @@
  */
 int wow_sha256_file(const char *path, char *out_hex, size_t hex_sz);
 
+/*
+ * Incremental SHA-256 for data that never lands on disc as a whole
+ * (e.g. a download streamed straight into an extractor).
+ *
+ *   wow_sha256_ctx *h = wow_sha256_new();
+ *   wow_sha256_update(h, buf, n);   (any number of times)
+ *   wow_sha256_final(h, hex, sizeof(hex));
+ *   wow_sha256_free(h);
+ *
+ * The context is opaque.
+ * wow_sha256_new() returns NULL on allocation failure.
+ * wow_sha256_final() returns 0 on success, -1 if hex_sz < 65.
+ */
+typedef struct wow_sha256_ctx wow_sha256_ctx;
+
+wow_sha256_ctx *wow_sha256_new(void);
+void wow_sha256_update(wow_sha256_ctx *h, const void *data, size_t len);
+int  wow_sha256_final(wow_sha256_ctx *h, char *out_hex, size_t hex_sz);
+void wow_sha256_free(wow_sha256_ctx *h);
+
+/*
+ * Batch hashing: many files (or byte ranges of files) on a pool of
+ * threads.  Meant for bulk checks such as `wow cache verify`, where a
+ * single core would otherwise be the bottleneck.
+ *
+ *   path:    file to read.
+ *   offset:  first byte to hash.
+ *   length:  bytes to hash, or -1 for everything up to EOF.
+ *   hex:     receives the digest, "" on failure.
+ *   err:     0, or the errno that stopped it (EIO: range past EOF).
+ *
+ * threads <= 0 means one per CPU.  Nothing is printed.  Returns the
+ * number of jobs that failed.
+ */
+struct wow_sha256_job {
+    const char *path;
+    uint64_t    offset;
+    int64_t     length;
+    char        hex[65];
+    int         err;
+};
+
+int wow_sha256_files(struct wow_sha256_job *jobs, int n, int threads);
+
 #endif
@@ -0,0 +1,47 @@
+#ifndef WOW_UTIL_TRACE_H
+#define WOW_UTIL_TRACE_H
+
+#include <stdint.h>
+
+/*
+ * Span tracing in Chrome trace-event format (opens in Perfetto or
+ * chrome://tracing).
+ *
+ *   WOW_TRACE=out.json wow sync
+ *
+ * Each thread records complete ("X") events into its own buffer; the
+ * buffers are merged and written once, at exit or just before wow
+ * execs into Ruby.  When WOW_TRACE is unset every call is a single
+ * predictable branch.
+ *
+ *   uint64_t t0 = wow_trace_begin();
+ *   ... work ...
+ *   wow_trace_end(t0, "download", "gem", label);
+ *
+ * cat and name must be string literals (or otherwise outlive the
+ * process); detail is copied and may be NULL.
+ */
+
+/* Read WOW_TRACE and arm tracing.  Call once, early in main(). */
+void wow_trace_init(void);
+
+/* Non-zero when tracing is armed */
+extern int wow_trace_on;
+
+/* Start timestamp for a span (0 when tracing is off) */
+uint64_t wow_trace_begin(void);
+
+/* Record a span that started at t0 (no-op when t0 is 0) */
+void wow_trace_end(uint64_t t0, const char *cat, const char *name,
+                   const char *detail);
+
+/* Label the calling thread in the trace ("download-3", "ext-build") */
+void wow_trace_thread_name(const char *name);
+
+/*
+ * Write the trace file now.  Idempotent; also runs at exit.  Call
+ * before execve so the run is not lost.
+ */
+void wow_trace_flush(void);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef WOW_WORKSPACE_H
+#define WOW_WORKSPACE_H
+
+/*
+ * workspace.h -- `wow workspace`: lock many Gemfiles in one process
+ *
+ * A monorepo's services each have their own Gemfile but mostly depend
+ * on the same gems.  `wow workspace lock` parses every member Gemfile
+ * in parallel and resolves them concurrently against one shared
+ * compact index provider, so each /info file is fetched and parsed once
+ * for the whole workspace rather than once per service.
+ */
+
+int cmd_workspace(int argc, char *argv[]);
+
+#endif
@@ -0,0 +1,931 @@
+/*
+ * daemon.c -- `wow daemon`: warm HTTP pool and /info cache over a socket
+ *
+ * Usage:
+ *   wow daemon start    fork a daemon (no-op if one is already running)
+ *   wow daemon stop     ask the running daemon to exit
+ *   wow daemon status   print its counters (exit 1 if none is running)
+ *   wow daemon run      serve in the foreground (debugging, supervisors)
+ *
+ * Protocol (one request per line, any number per connection):
+ *   GET <url>\n   ->  "<status> <len>\n" then <len> body bytes;
+ *                     status 0 means the daemon's own fetch failed
+ *   STATUS\n      ->  "200 <len>\n" then a human-readable summary
+ *   STOP\n        ->  "200 0\n", then the daemon exits
+ *
+ * A poll() loop reads request lines; GETs are answered by a few worker
+ * threads, each with its own warm HTTP pool, so a miss only holds up
+ * the client that asked for it.
+ *
+ * Only 200 responses for compact index /info URLs are cached.  A body
+ * younger than WOW_DAEMON_TTL seconds (default 0) is served from memory;
+ * an older one is revalidated upstream with If-None-Match first, so by
+ * default every answer is as fresh as an in-process fetch and a hit
+ * saves the body transfer and handshake rather than the round trip.
+ * The cache holds raw bodies rather than parsed provider state because
+ * parsing depends on each client's Ruby version and platforms — and is
+ * cheap next to the fetch.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "wow/daemon.h"
+#include "wow/http.h"
+#include "wow/util/fmt.h"
+#include "wow/util/path.h"
+#include "wow/util/time.h"
+#include "wow/util/trace.h"
+
+#define DAEMON_SOCK_NAME      "daemon.sock"
+#define DAEMON_LOG_NAME       "daemon.log"
+#define DAEMON_MAX_CLIENTS    64
+#define DAEMON_MAX_URL        2048
+#define DAEMON_CACHE_MAX      (256u * 1024 * 1024)  /* bytes of bodies */
+#define DAEMON_DEFAULT_TTL    0     /* always revalidate */
+#define DAEMON_DEFAULT_IDLE   1800
+#define DAEMON_IO_TIMEOUT     5     /* seconds, daemon side */
+#define DAEMON_WORKERS        8     /* concurrent GETs */
+#define DAEMON_WORKER_CONNS   4     /* warm upstream connections each */
+
+/* Client side: the daemon fetches on our behalf, so allow for that */
+#define DAEMON_CLIENT_TIMEOUT (WOW_HTTP_TIMEOUT_SECS + 5)
+
+/* ------------------------------------------------------------------ */
+/* Paths and socket I/O (shared by both ends)                          */
+/* ------------------------------------------------------------------ */
+
+static int runtime_dir(char *buf, size_t bufsz)
+{
+    const char *xdg = getenv("XDG_RUNTIME_DIR");
+    if (!xdg || !xdg[0]) return -1;
+    int n = snprintf(buf, bufsz, "%s/wow", xdg);
+    return (n < 0 || (size_t)n >= bufsz) ? -1 : 0;
+}
+
+int wow_daemon_socket_path(char *buf, size_t bufsz)
+{
+    char dir[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    if (runtime_dir(dir, sizeof(dir)) != 0) return -1;
+    int n = snprintf(buf, bufsz, "%s/" DAEMON_SOCK_NAME, dir);
+    return (n < 0 || (size_t)n >= bufsz) ? -1 : 0;
+}
+
+static int send_all(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int recv_all(int fd, void *buf, size_t len)
+{
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Read one '\n'-terminated line (terminator stripped).  Lines are short,
+ * so byte-at-a-time is fine and never reads past the body that follows. */
+static int recv_line(int fd, char *buf, size_t cap)
+{
+    size_t n = 0;
+    for (;;) {
+        char c;
+        if (recv_all(fd, &c, 1) != 0) return -1;
+        if (c == '\n') break;
+        if (n + 1 >= cap) return -1;
+        buf[n++] = c;
+    }
+    buf[n] = '\0';
+    return 0;
+}
+
+static void set_timeouts(int fd, int secs)
+{
+    struct timeval tv = { .tv_sec = secs, .tv_usec = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+static int daemon_connect(void)
+{
+    struct sockaddr_un sa = { .sun_family = AF_UNIX };
+    if (wow_daemon_socket_path(sa.sun_path, sizeof(sa.sun_path)) != 0)
+        return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    set_timeouts(fd, DAEMON_CLIENT_TIMEOUT);
+    return fd;
+}
+
+/*
+ * Send one request line and read the reply into *body (NUL-terminated,
+ * malloc'd).  Returns the reply status (0 = daemon-side failure) or -1
+ * if the connection broke.
+ */
+static int daemon_request(int fd, const char *line, char **body,
+                          size_t *len)
+{
+    *body = NULL;
+    *len = 0;
+    if (send_all(fd, line, strlen(line)) != 0) return -1;
+
+    char hdr[64];
+    int status;
+    size_t blen;
+    if (recv_line(fd, hdr, sizeof(hdr)) != 0 ||
+        sscanf(hdr, "%d %zu", &status, &blen) != 2 ||
+        blen > WOW_HTTP_MAX_BODY)
+        return -1;
+
+    char *b = malloc(blen + 1);
+    if (!b) return -1;
+    if (recv_all(fd, b, blen) != 0) {
+        free(b);
+        return -1;
+    }
+    b[blen] = '\0';
+    *body = b;
+    *len = blen;
+    return status;
+}
+
+/* ------------------------------------------------------------------ */
+/* Client                                                              */
+/* ------------------------------------------------------------------ */
+
+/* Idle daemon connections.  A fetching thread takes one (or connects a
+ * fresh one) and runs its request without holding any lock, so
+ * concurrent fetchers -- a shared provider, prefetch workers -- each
+ * talk to the daemon over their own socket */
+#define DAEMON_CLIENT_IDLE    8
+
+static int client_idle[DAEMON_CLIENT_IDLE];
+static int n_client_idle;
+static int client_off;      /* no daemon, or it broke: stop asking */
+static pthread_mutex_t client_mu = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t client_once = PTHREAD_ONCE_INIT;
+
+static void client_init(void)
+{
+    const char *no = getenv("WOW_NO_DAEMON");
+    if (no && no[0] && strcmp(no, "0") != 0) client_off = 1;
+}
+
+static void client_disable(void)
+{
+    pthread_mutex_lock(&client_mu);
+    client_off = 1;
+    while (n_client_idle > 0) close(client_idle[--n_client_idle]);
+    pthread_mutex_unlock(&client_mu);
+}
+
+static int client_take(void)
+{
+    pthread_once(&client_once, client_init);
+
+    int fd = -1, off;
+    pthread_mutex_lock(&client_mu);
+    off = client_off;
+    if (!off && n_client_idle > 0) fd = client_idle[--n_client_idle];
+    pthread_mutex_unlock(&client_mu);
+    if (off || fd >= 0) return fd;
+
+    if ((fd = daemon_connect()) < 0) client_disable();
+    return fd;
+}
+
+static void client_give(int fd)
+{
+    pthread_mutex_lock(&client_mu);
+    if (!client_off && n_client_idle < DAEMON_CLIENT_IDLE) {
+        client_idle[n_client_idle++] = fd;
+        fd = -1;
+    }
+    pthread_mutex_unlock(&client_mu);
+    if (fd >= 0) close(fd);
+}
+
+int wow_daemon_get(const char *url, struct wow_response *resp)
+{
+    char line[DAEMON_MAX_URL + 8];
+    int n = snprintf(line, sizeof(line), "GET %s\n", url);
+    if (n < 0 || (size_t)n >= sizeof(line) || strchr(url, '\n'))
+        return -1;
+
+    int fd = client_take();
+    if (fd < 0) return -1;
+
+    uint64_t t0 = wow_trace_begin();
+    char *body;
+    size_t len;
+    int status = daemon_request(fd, line, &body, &len);
+    wow_trace_end(t0, "daemon", "get", url);
+
+    if (status < 0) {
+        close(fd);
+        client_disable();
+        return -1;
+    }
+    client_give(fd);
+    if (status == 0) {      /* daemon's fetch failed; try ourselves */
+        free(body);
+        return -1;
+    }
+
+    memset(resp, 0, sizeof(*resp));
+    resp->status = status;
+    resp->body = body;
+    resp->body_len = len;
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* Daemon: /info cache                                                 */
+/* ------------------------------------------------------------------ */
+
+struct cache_ent {
+    uint64_t hash;
+    char    *url;
+    char    *body;
+    size_t   len;
+    char    *etag;          /* for revalidation; may be NULL */
+    double   fetched;       /* last fetched or revalidated */
+};
+
+/* A GET handed from the poll loop to the workers */
+struct daemon_job {
+    struct daemon_job *next;
+    int                fd;
+    char               url[];
+};
+
+/* A client whose GET a worker has answered; ok = 0 closes it */
+struct daemon_done {
+    int fd;
+    int ok;
+};
+
+struct daemon;
+
+struct daemon_worker {
+    struct daemon        *d;
+    pthread_t             tid;
+    struct wow_http_pool  pool;     /* per worker: pools are not shared */
+};
+
+struct daemon {
+    int                   lfd;
+    int                   wake[2];  /* workers -> poll loop */
+    struct daemon_worker  workers[DAEMON_WORKERS];
+    int                   n_workers;
+
+    /* mu guards everything below */
+    pthread_mutex_t       mu;
+    pthread_cond_t        more;
+    struct daemon_job    *jobs, **jobs_tail;
+    struct daemon_done    done[DAEMON_MAX_CLIENTS];
+    int                   n_done;
+    int                   stopping;
+    struct cache_ent     *ents;
+    int                   n_ents, cap_ents;
+    size_t                bytes;
+    double                ttl, idle, started, last_active;
+    long                  requests, hits, revalidated, fetches, failures;
+};
+
+static volatile sig_atomic_t daemon_stop;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    daemon_stop = 1;
+}
+
+static uint64_t url_hash(const char *s)
+{
+    uint64_t h = 0xcbf29ce484222325ull;     /* FNV-1a */
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+static struct cache_ent *cache_find(struct daemon *d, const char *url,
+                                    uint64_t h)
+{
+    for (int i = 0; i < d->n_ents; i++) {
+        struct cache_ent *e = &d->ents[i];
+        if (e->hash == h && strcmp(e->url, url) == 0) return e;
+    }
+    return NULL;
+}
+
+static void cache_drop(struct daemon *d, int i)
+{
+    d->bytes -= d->ents[i].len;
+    free(d->ents[i].url);
+    free(d->ents[i].body);
+    free(d->ents[i].etag);
+    d->ents[i] = d->ents[--d->n_ents];
+}
+
+/* Takes ownership of body on success; returns -1 (body still the
+ * caller's) if it could not be stored */
+static int cache_put(struct daemon *d, const char *url, uint64_t h,
+                     char *body, size_t len, const char *etag)
+{
+    if (len > DAEMON_CACHE_MAX / 4) return -1;
+
+    struct cache_ent *e = cache_find(d, url, h);
+    if (e) cache_drop(d, (int)(e - d->ents));
+
+    /* Evict oldest until the new body fits */
+    while (d->n_ents > 0 && d->bytes + len > DAEMON_CACHE_MAX) {
+        int oldest = 0;
+        for (int i = 1; i < d->n_ents; i++)
+            if (d->ents[i].fetched < d->ents[oldest].fetched) oldest = i;
+        cache_drop(d, oldest);
+    }
+
+    if (d->n_ents == d->cap_ents) {
+        int nc = d->cap_ents ? d->cap_ents * 2 : 256;
+        struct cache_ent *ne = realloc(d->ents, (size_t)nc * sizeof(*ne));
+        if (!ne) return -1;
+        d->ents = ne;
+        d->cap_ents = nc;
+    }
+    char *u = strdup(url);
+    char *t = etag ? strdup(etag) : NULL;
+    if (!u || (etag && !t)) {
+        free(u);
+        free(t);
+        return -1;
+    }
+
+    e = &d->ents[d->n_ents++];
+    e->hash = h;
+    e->url = u;
+    e->body = body;
+    e->len = len;
+    e->etag = t;
+    e->fetched = wow_now_secs();
+    d->bytes += len;
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* Daemon: requests                                                    */
+/* ------------------------------------------------------------------ */
+
+static int reply(int fd, int status, const char *body, size_t len)
+{
+    char hdr[64];
+    int n = snprintf(hdr, sizeof(hdr), "%d %zu\n", status, len);
+    if (send_all(fd, hdr, (size_t)n) != 0) return -1;
+    return len ? send_all(fd, body, len) : 0;
+}
+
+/* Copy of a cached body, taken under d->mu so the reply can be sent
+ * after the lock is dropped (the entry may be evicted meanwhile) */
+static char *cache_copy(const struct cache_ent *e)
+{
+    char *b = malloc(e->len ? e->len : 1);
+    if (b) memcpy(b, e->body, e->len);
+    return b;
+}
+
+/*
+ * Runs on a worker.  A body younger than the TTL is served from memory;
+ * an older one is revalidated with If-None-Match and served again on a
+ * 304, so a stale body never reaches a client unchecked.
+ */
+static int serve_get(struct daemon *d, struct wow_http_pool *pool, int fd,
+                     const char *url)
+{
+    uint64_t h = url_hash(url);
+    int info = strstr(url, "/info/") != NULL;
+    char *etag = NULL, *body = NULL;
+    size_t len = 0;
+
+    pthread_mutex_lock(&d->mu);
+    struct cache_ent *e = info ? cache_find(d, url, h) : NULL;
+    if (e && wow_now_secs() - e->fetched < d->ttl &&
+        (body = cache_copy(e)) != NULL) {
+        len = e->len;
+        d->hits++;
+    } else if (e && e->etag) {
+        etag = strdup(e->etag);
+    }
+    d->fetches += !body;
+    pthread_mutex_unlock(&d->mu);
+    if (body) {
+        int rc = reply(fd, 200, body, len);
+        free(body);
+        return rc;
+    }
+
+    struct wow_response resp;
+    if (wow_http_pool_get_if(pool, url, etag, &resp) != 0) {
+        free(etag);
+        pthread_mutex_lock(&d->mu);
+        d->failures++;
+        pthread_mutex_unlock(&d->mu);
+        return reply(fd, 0, NULL, 0);
+    }
+
+    if (resp.status == 304) {
+        /* Unchanged -- unless the entry moved on while we asked, in
+         * which case the client refetches for itself */
+        pthread_mutex_lock(&d->mu);
+        e = cache_find(d, url, h);
+        if (e && e->etag && etag && strcmp(e->etag, etag) == 0 &&
+            (body = cache_copy(e)) != NULL) {
+            len = e->len;
+            e->fetched = wow_now_secs();
+            d->revalidated++;
+        }
+        pthread_mutex_unlock(&d->mu);
+        free(etag);
+        wow_response_free(&resp);
+        int rc = body ? reply(fd, 200, body, len) : reply(fd, 0, NULL, 0);
+        free(body);
+        return rc;
+    }
+    free(etag);
+
+    int rc = reply(fd, resp.status, resp.body, resp.body_len);
+    if (resp.status == 200 && info) {
+        pthread_mutex_lock(&d->mu);
+        if (cache_put(d, url, h, resp.body, resp.body_len, resp.etag) == 0)
+            resp.body = NULL;
+        pthread_mutex_unlock(&d->mu);
+    }
+    wow_response_free(&resp);
+    return rc;
+}
+
+static void *daemon_worker(void *arg)
+{
+    struct daemon_worker *w = arg;
+    struct daemon *d = w->d;
+
+    pthread_mutex_lock(&d->mu);
+    for (;;) {
+        while (!d->jobs && !d->stopping)
+            pthread_cond_wait(&d->more, &d->mu);
+        if (d->stopping) break;
+
+        struct daemon_job *j = d->jobs;
+        if (!(d->jobs = j->next)) d->jobs_tail = &d->jobs;
+        pthread_mutex_unlock(&d->mu);
+
+        int ok = serve_get(d, &w->pool, j->fd, j->url) == 0;
+
+        pthread_mutex_lock(&d->mu);
+        d->done[d->n_done++] = (struct daemon_done){ j->fd, ok };
+        free(j);
+        /* A full pipe means the poll loop is already due to wake */
+        if (write(d->wake[1], "", 1) != 1) {}
+    }
+    pthread_mutex_unlock(&d->mu);
+    return NULL;
+}
+
+/* Queue a GET for the workers.  Returns -1 if it could not be queued. */
+static int queue_get(struct daemon *d, int fd, const char *url)
+{
+    size_t n = strlen(url) + 1;
+    struct daemon_job *j = malloc(sizeof(*j) + n);
+    if (!j) return -1;
+    j->next = NULL;
+    j->fd = fd;
+    memcpy(j->url, url, n);
+
+    pthread_mutex_lock(&d->mu);
+    *d->jobs_tail = j;
+    d->jobs_tail = &j->next;
+    pthread_cond_signal(&d->more);
+    pthread_mutex_unlock(&d->mu);
+    return 0;
+}
+
+static int serve_status(struct daemon *d, int fd)
+{
+    int reused = 0, opened = 0;
+    for (int i = 0; i < d->n_workers; i++) {
+        reused += __atomic_load_n(&d->workers[i].pool.reuse_count,
+                                  __ATOMIC_RELAXED);
+        opened += __atomic_load_n(&d->workers[i].pool.new_count,
+                                  __ATOMIC_RELAXED);
+    }
+
+    char bytes[16], text[512];
+    pthread_mutex_lock(&d->mu);
+    wow_fmt_bytes(d->bytes, bytes, sizeof(bytes));
+    int n = snprintf(text, sizeof(text),
+                     "pid          %d\n"
+                     "uptime       %.0fs\n"
+                     "cached       %d /info bodies, %s (ttl %.0fs)\n"
+                     "requests     %ld (%ld cache hits, %ld fetched, "
+                     "%ld revalidated, %ld failed)\n"
+                     "connections  %d reused, %d opened\n",
+                     (int)getpid(), wow_now_secs() - d->started,
+                     d->n_ents, bytes, d->ttl,
+                     d->requests, d->hits, d->fetches, d->revalidated,
+                     d->failures, reused, opened);
+    pthread_mutex_unlock(&d->mu);
+    if (n < 0) n = 0;
+    if ((size_t)n >= sizeof(text)) n = (int)sizeof(text) - 1;
+    return reply(fd, 200, text, (size_t)n);
+}
+
+/* Handle one request line from fd.  Returns 1 when a GET went to the
+ * workers (the client is theirs until it comes back through d->done),
+ * 0 when answered here, -1 when the client is done. */
+static int serve_one(struct daemon *d, int fd)
+{
+    char line[DAEMON_MAX_URL + 8];
+    if (recv_line(fd, line, sizeof(line)) != 0) return -1;
+
+    pthread_mutex_lock(&d->mu);
+    d->requests++;
+    pthread_mutex_unlock(&d->mu);
+    d->last_active = wow_now_secs();
+    if (strncmp(line, "GET ", 4) == 0)
+        return queue_get(d, fd, line + 4) == 0 ? 1 : -1;
+    if (strcmp(line, "STATUS") == 0)
+        return serve_status(d, fd);
+    if (strcmp(line, "STOP") == 0) {
+        daemon_stop = 1;
+        return reply(fd, 200, NULL, 0);
+    }
+    return -1;
+}
+
+static int env_secs(const char *name, int def)
+{
+    const char *s = getenv(name);
+    if (!s || !s[0]) return def;
+    char *end;
+    long v = strtol(s, &end, 10);
+    return (*end || v < 0) ? def : (int)v;
+}
+
+struct daemon_client {
+    int fd;
+    int busy;       /* a worker is answering it */
+};
+
+/*
+ * Accept and serve until STOP, a signal, or the idle timeout.  The poll
+ * loop only reads request lines; GETs run on DAEMON_WORKERS threads, so
+ * one client's upstream fetch never holds up another's.  A busy client
+ * is left out of the poll set until its worker reports back through the
+ * wake pipe.
+ */
+static int daemon_serve(int lfd, const char *sock_path)
+{
+    static struct daemon d;     /* large (worker pools); one per process */
+    d.lfd = lfd;
+    d.jobs_tail = &d.jobs;
+    pthread_mutex_init(&d.mu, NULL);
+    pthread_cond_init(&d.more, NULL);
+    d.ttl = env_secs("WOW_DAEMON_TTL", DAEMON_DEFAULT_TTL);
+    d.idle = env_secs("WOW_DAEMON_IDLE", DAEMON_DEFAULT_IDLE);
+    d.started = d.last_active = wow_now_secs();
+
+    if (pipe(d.wake) != 0) {
+        perror("wow: daemon: pipe");
+        close(lfd);
+        unlink(sock_path);
+        return 1;
+    }
+    fcntl(d.wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(d.wake[1], F_SETFL, O_NONBLOCK);
+
+    struct sigaction sa = { .sa_handler = on_signal };
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    /* A failed pthread_create just means fewer workers; with none at
+     * all GETs could never be answered, so give up */
+    for (int i = 0; i < DAEMON_WORKERS; i++) {
+        struct daemon_worker *w = &d.workers[d.n_workers];
+        w->d = &d;
+        wow_http_pool_init(&w->pool, DAEMON_WORKER_CONNS);
+        if (pthread_create(&w->tid, NULL, daemon_worker, w) != 0) {
+            wow_http_pool_cleanup(&w->pool);
+            break;
+        }
+        d.n_workers++;
+    }
+    int rc = 0;
+    if (d.n_workers == 0) {
+        fprintf(stderr, "wow: daemon: cannot start worker threads\n");
+        daemon_stop = 1;
+        rc = 1;
+    }
+
+    struct daemon_client clients[DAEMON_MAX_CLIENTS];
+    int n_clients = 0;
+    struct pollfd pfds[2 + DAEMON_MAX_CLIENTS];
+    int slot[DAEMON_MAX_CLIENTS];   /* pfds[2 + k] is clients[slot[k]] */
+
+    while (!daemon_stop) {
+        int np = 0, n_busy = 0;
+        pfds[0] = (struct pollfd){ .fd = lfd, .events = POLLIN };
+        pfds[1] = (struct pollfd){ .fd = d.wake[0], .events = POLLIN };
+        for (int i = 0; i < n_clients; i++) {
+            if (clients[i].busy) {
+                n_busy++;
+                continue;
+            }
+            pfds[2 + np] = (struct pollfd){ .fd = clients[i].fd,
+                                            .events = POLLIN };
+            slot[np++] = i;
+        }
+
+        int n = poll(pfds, (nfds_t)(2 + np), 1000);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("wow: daemon: poll");
+            break;
+        }
+        if (n == 0) {
+            if (d.idle > 0 && n_busy == 0 &&
+                wow_now_secs() - d.last_active > d.idle)
+                break;
+            continue;
+        }
+
+        /* Clients first, back to front so removal keeps indices valid */
+        for (int k = np - 1; k >= 0; k--) {
+            if (!(pfds[2 + k].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            int i = slot[k];
+            int served = serve_one(&d, clients[i].fd);
+            if (served > 0) {
+                clients[i].busy = 1;
+            } else if (served < 0) {
+                close(clients[i].fd);
+                clients[i] = clients[--n_clients];
+            }
+        }
+
+        /* Clients the workers are finished with */
+        if (pfds[1].revents & POLLIN) {
+            char buf[64];
+            while (read(d.wake[0], buf, sizeof(buf)) > 0) {}
+
+            pthread_mutex_lock(&d.mu);
+            for (int j = 0; j < d.n_done; j++) {
+                for (int i = 0; i < n_clients; i++) {
+                    if (clients[i].fd != d.done[j].fd) continue;
+                    if (d.done[j].ok) {
+                        clients[i].busy = 0;
+                    } else {
+                        close(clients[i].fd);
+                        clients[i] = clients[--n_clients];
+                    }
+                    break;
+                }
+            }
+            d.n_done = 0;
+            pthread_mutex_unlock(&d.mu);
+            d.last_active = wow_now_secs();
+        }
+
+        if (pfds[0].revents & POLLIN) {
+            int cfd = accept(lfd, NULL, NULL);
+            if (cfd < 0) continue;
+            if (n_clients == DAEMON_MAX_CLIENTS) {
+                close(cfd);     /* client falls back to in-process */
+                continue;
+            }
+            fcntl(cfd, F_SETFD, FD_CLOEXEC);
+            set_timeouts(cfd, DAEMON_IO_TIMEOUT);
+            clients[n_clients++] = (struct daemon_client){ cfd, 0 };
+            d.last_active = wow_now_secs();
+        }
+    }
+
+    /* Workers finish the fetch in hand; queued GETs are dropped (their
+     * clients see the connection close and fetch for themselves) */
+    pthread_mutex_lock(&d.mu);
+    d.stopping = 1;
+    pthread_cond_broadcast(&d.more);
+    pthread_mutex_unlock(&d.mu);
+    for (int i = 0; i < d.n_workers; i++) {
+        pthread_join(d.workers[i].tid, NULL);
+        wow_http_pool_cleanup(&d.workers[i].pool);
+    }
+    while (d.jobs) {
+        struct daemon_job *j = d.jobs;
+        d.jobs = j->next;
+        free(j);
+    }
+
+    for (int i = 0; i < n_clients; i++) close(clients[i].fd);
+    close(lfd);
+    close(d.wake[0]);
+    close(d.wake[1]);
+    unlink(sock_path);
+    while (d.n_ents > 0) cache_drop(&d, d.n_ents - 1);
+    free(d.ents);
+    pthread_cond_destroy(&d.more);
+    pthread_mutex_destroy(&d.mu);
+    return rc;
+}
+
+/* ------------------------------------------------------------------ */
+/* wow daemon start|stop|status|run                                    */
+/* ------------------------------------------------------------------ */
+
+/*
+ * The socket is only as private as its directory.  wow_mkdirs leaves an
+ * existing directory's mode alone, so check that it is ours and tighten
+ * it to 0700 before anything is bound inside it.
+ */
+static int runtime_dir_secure(const char *dir)
+{
+    struct stat st;
+    if (lstat(dir, &st) != 0) {
+        fprintf(stderr, "wow: %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+    if (!S_ISDIR(st.st_mode) || st.st_uid != getuid()) {
+        fprintf(stderr, "wow: %s is not a directory owned by you\n", dir);
+        return -1;
+    }
+    if ((st.st_mode & 07777) != 0700 && chmod(dir, 0700) != 0) {
+        fprintf(stderr, "wow: cannot chmod %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/* Bind the socket, replacing a stale one left by a dead daemon */
+static int daemon_listen(const char *sock_path)
+{
+    char dir[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    if (runtime_dir(dir, sizeof(dir)) != 0 || wow_mkdirs(dir, 0700) != 0) {
+        fprintf(stderr, "wow: cannot create %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+    if (runtime_dir_secure(dir) != 0) return -1;
+
+    struct sockaddr_un sa = { .sun_family = AF_UNIX };
+    snprintf(sa.sun_path, sizeof(sa.sun_path), "%s", sock_path);
+    unlink(sock_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 ||
+        bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0 ||
+        chmod(sock_path, 0600) != 0 ||
+        listen(fd, 16) != 0) {
+        fprintf(stderr, "wow: cannot listen on %s: %s\n", sock_path,
+                strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+/* Send a control request to a running daemon; prints any reply body */
+static int daemon_control(const char *line)
+{
+    int fd = daemon_connect();
+    if (fd < 0) return -1;
+    char *body;
+    size_t len;
+    int status = daemon_request(fd, line, &body, &len);
+    close(fd);
+    if (status < 0) return -1;
+    fwrite(body, 1, len, stdout);
+    free(body);
+    return 0;
+}
+
+static int daemon_start(const char *sock_path, int foreground)
+{
+    int probe = daemon_connect();
+    if (probe >= 0) {
+        close(probe);
+        printf("wow daemon already running (%s)\n", sock_path);
+        return 0;
+    }
+
+    int lfd = daemon_listen(sock_path);
+    if (lfd < 0) return 1;
+    if (foreground) return daemon_serve(lfd, sock_path) == 0 ? 0 : 1;
+
+    char dir[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    char log_path[sizeof(dir) + sizeof(DAEMON_LOG_NAME) + 1];
+    runtime_dir(dir, sizeof(dir));  /* fits: the socket path did */
+    snprintf(log_path, sizeof(log_path), "%s/" DAEMON_LOG_NAME, dir);
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("wow: fork");
+        close(lfd);
+        return 1;
+    }
+    if (pid == 0) {
+        setsid();
+        int null = open("/dev/null", O_RDWR);
+        int log = open(log_path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+        if (null >= 0) {
+            dup2(null, STDIN_FILENO);
+            dup2(null, STDOUT_FILENO);
+        }
+        if (log >= 0) dup2(log, STDERR_FILENO);
+        if (null > STDERR_FILENO) close(null);
+        if (log > STDERR_FILENO) close(log);
+        _exit(daemon_serve(lfd, sock_path));
+    }
+
+    close(lfd);
+    printf("Started wow daemon (pid %d, %s)\n", (int)pid, sock_path);
+    return 0;
+}
+
+static void daemon_usage(void)
+{
+    fprintf(stderr, "usage: wow daemon start|stop|status|run\n");
+}
+
+int cmd_daemon(int argc, char *argv[])
+{
+    if (argc != 2) {
+        daemon_usage();
+        return 1;
+    }
+
+    char sock_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+    if (wow_daemon_socket_path(sock_path, sizeof(sock_path)) != 0) {
+        fprintf(stderr, "wow: the daemon needs $XDG_RUNTIME_DIR "
+                "(unset, or the path is too long)\n");
+        return 1;
+    }
+
+    const char *sub = argv[1];
+    if (strcmp(sub, "start") == 0)
+        return daemon_start(sock_path, 0);
+    if (strcmp(sub, "run") == 0)
+        return daemon_start(sock_path, 1);
+    if (strcmp(sub, "status") == 0) {
+        if (daemon_control("STATUS\n") == 0) return 0;
+        printf("wow daemon is not running\n");
+        return 1;
+    }
+    if (strcmp(sub, "stop") == 0) {
+        if (daemon_control("STOP\n") == 0)
+            printf("Stopped wow daemon\n");
+        else
+            printf("wow daemon is not running\n");
+        return 0;
+    }
+
+    daemon_usage();
+    return 1;
+}
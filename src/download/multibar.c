@@ -2,8 +2,11 @@
  * multibar.c — concurrent multi-bar progress display
  *
  * Renders N progress bars simultaneously on the terminal, one per row.
- * A pthread mutex serialises all stderr writes to prevent interleaving.
- * ANSI cursor positioning moves to the correct row for each bar.
+ * Workers only bump atomic per-slot counters; a renderer thread draws
+ * the whole display (bars sorted by progress, then the status line)
+ * every WOW_MULTIBAR_FRAME_MS as a single write(), so neither the lock
+ * nor the terminal is on the download hot path.  ANSI cursor
+ * positioning moves to the correct row for each bar.
  *
  * Two modes:
  *   Fixed mode  (n_bars == n_total): one row per download.
@@ -17,6 +20,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -43,14 +47,24 @@ static double mb_now(void)
     return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
 }
 
-/* ── Rendering (internal, called with mutex held) ────────────────── */
+/* ── Rendering (renderer thread, or final frame after it stops) ──── */
 
-/*
- * Return the high-water name width (only grows, never shrinks — matching uv).
- */
-static int max_name_width(const wow_multibar_t *mb)
+/* A consistent-enough copy of one slot for drawing a frame */
+typedef struct {
+    const char *name;
+    size_t      current;
+    size_t      total;
+    int         finished;
+    int         failed;
+} slot_view_t;
+
+static void slot_load(const wow_bar_slot_t *s, slot_view_t *v)
 {
-    return mb->max_nw;
+    v->name = atomic_load_explicit(&s->name, memory_order_acquire);
+    v->current = atomic_load_explicit(&s->current, memory_order_relaxed);
+    v->total = atomic_load_explicit(&s->total, memory_order_relaxed);
+    v->finished = atomic_load_explicit(&s->finished, memory_order_relaxed);
+    v->failed = atomic_load_explicit(&s->failed, memory_order_relaxed);
 }
 
 /*
@@ -63,7 +77,7 @@ static int max_name_width(const wow_multibar_t *mb)
  * Every state (in-progress, finished, failed, waiting) is padded
  * to the same total visible width so all rows align.
  */
-static int render_bar(const wow_bar_slot_t *slot, char *line, size_t linesz,
+static int render_bar(const slot_view_t *slot, char *line, size_t linesz,
                       int nw)
 {
     int pos = 0;
@@ -167,12 +181,6 @@ static int render_bar(const wow_bar_slot_t *slot, char *line, size_t linesz,
     return pos;
 }
 
-/*
- * Render the status line (worker mode only).
- * Shows: [completed/total] total_bytes downloaded
- * Written at the cursor position (below all bars).
- * Must be called with mb->mu held.
- */
 /* Braille spinner frames (matching uv's tick_strings) */
 static const char *spinner[] = {
     "\xe2\xa0\x8b", "\xe2\xa0\x99", "\xe2\xa0\xb9", "\xe2\xa0\xb8",
@@ -181,92 +189,58 @@ static const char *spinner[] = {
 };
 #define N_SPINNER (sizeof(spinner) / sizeof(spinner[0]))
 
-static void render_status_line(wow_multibar_t *mb)
+/*
+ * Render the status line into buf.
+ * Shows: [completed/total] total_bytes downloaded
+ * Written at the cursor position (below all bars).
+ */
+static int render_status_line(wow_multibar_t *mb, char *out, size_t outsz)
 {
-    if (!mb->is_tty || !mb->has_status) return;
-
-    char out[256];
     int pos = 0;
+    size_t total_bytes = atomic_load(&mb->total_bytes);
+    int n_completed = atomic_load(&mb->n_completed);
+    int n_failed = atomic_load(&mb->n_failed);
     char bytes_str[16];
-    wow_fmt_bytes(mb->total_bytes, bytes_str, sizeof(bytes_str));
+    wow_fmt_bytes(total_bytes, bytes_str, sizeof(bytes_str));
 
     double elapsed = mb_now() - mb->start_time;
-    int done = mb->n_completed + mb->n_failed;
+    int done = n_completed + n_failed;
 
     /* Braille spinner (5 fps) — stops when all done */
     int frame = (int)(elapsed * 5.0) % (int)N_SPINNER;
 
-    WOW_BUF_APPEND(out, sizeof(out), pos, "\r\033[K");
+    WOW_BUF_APPEND(out, outsz, pos, "\r\033[K");
 
     if (done < mb->n_total)
-        WOW_BUF_APPEND(out, sizeof(out), pos,
+        WOW_BUF_APPEND(out, outsz, pos,
                    ANSI_WHITE "%s" WOW_ANSI_RESET " ", spinner[frame]);
 
-    WOW_BUF_APPEND(out, sizeof(out), pos,
+    WOW_BUF_APPEND(out, outsz, pos,
                WOW_ANSI_DIM "[%d/%d]" WOW_ANSI_RESET " %s downloaded",
                done, mb->n_total, bytes_str);
 
-    if (mb->n_failed > 0)
-        WOW_BUF_APPEND(out, sizeof(out), pos,
-                   " " WOW_ANSI_RED "(%d failed)" WOW_ANSI_RESET, mb->n_failed);
+    if (n_failed > 0)
+        WOW_BUF_APPEND(out, outsz, pos,
+                   " " WOW_ANSI_RED "(%d failed)" WOW_ANSI_RESET, n_failed);
 
-    if (elapsed > 0.5 && mb->total_bytes > 0) {
+    if (elapsed > 0.5 && total_bytes > 0) {
         char rate_str[16];
-        wow_fmt_bytes((size_t)((double)mb->total_bytes / elapsed),
+        wow_fmt_bytes((size_t)((double)total_bytes / elapsed),
                      rate_str, sizeof(rate_str));
         /* ⚡ = U+26A1 = \xe2\x9a\xa1 */
-        WOW_BUF_APPEND(out, sizeof(out), pos,
+        WOW_BUF_APPEND(out, outsz, pos,
                    " \xe2\x9a\xa1 " WOW_ANSI_BOLD "%s/s" WOW_ANSI_RESET,
                    rate_str);
     }
 
-    (void)write(STDERR_FILENO, out, (size_t)pos);
-}
-
-/*
- * Render bar i at its fixed terminal row.
- * Must be called with mb->mu held.  Uses save/restore cursor.
- *
- * Layout: the n_bars rows (+ optional status line) were reserved above
- * the current cursor line.  Bar 0 is the topmost, bar n_bars-1 is just
- * above the cursor (or above the status line in worker mode).
- * To reach bar i, move up (n_rows - i) lines where n_rows includes
- * the status line if present.
- */
-static void render_bar_at_row(wow_multibar_t *mb, int i)
-{
-    if (!mb->is_tty) return;
-
-    int nw = max_name_width(mb);
-    int n_rows = mb->n_bars + (mb->has_status ? 1 : 0);
-
-    char out[768];
-    int pos = 0;
-
-    /* Save cursor + move up to bar's row */
-    int up = n_rows - i;
-    WOW_BUF_APPEND(out, sizeof(out), pos, "\033[s\033[%dA", up);
-
-    /* Render the bar content */
-    char bar_buf[512];
-    int bar_len = render_bar(&mb->slots[i], bar_buf, sizeof(bar_buf), nw);
-    if ((size_t)(pos + bar_len) < sizeof(out) - 8) {
-        memcpy(out + pos, bar_buf, (size_t)bar_len);
-        pos += bar_len;
-    }
-
-    /* Restore cursor */
-    WOW_BUF_APPEND(out, sizeof(out), pos, "\033[u");
-
-    /* Single atomic write */
-    (void)write(STDERR_FILENO, out, (size_t)pos);
+    return pos < (int)outsz ? pos : (int)outsz - 1;
 }
 
 /*
  * Sort key for a bar slot.  Higher = rendered closer to the top.
  * Finished (101%) > in-progress by % > unknown-size > waiting > failed.
  */
-static int slot_progress_key(const wow_bar_slot_t *s)
+static int slot_progress_key(const slot_view_t *s)
 {
     if (!s->name)    return -200;   /* waiting — no work assigned yet */
     if (s->failed)   return -100;   /* failed — sink to bottom */
@@ -277,85 +251,151 @@ static int slot_progress_key(const wow_bar_slot_t *s)
 }
 
 /*
- * Re-render all bars sorted by progress (highest % at top).
- * Batches all bar writes into a single write() to avoid flicker.
- * Must be called with mb->mu held.
+ * Draw one frame: the n_rows furthest-along slots (highest % at the
+ * top), then the status line, as a single write().
  */
-static void render_all_sorted(wow_multibar_t *mb)
+static void render_frame(wow_multibar_t *mb)
 {
-    if (!mb->is_tty) return;
-
-    int nw = max_name_width(mb);
-
-    /* Build sort order: highest progress at row 0 (top) */
-    int order[WOW_MULTIBAR_MAX];
-    for (int i = 0; i < mb->n_bars; i++)
-        order[i] = i;
-
-    /* Insertion sort — n_bars is small (typically <= 16) */
-    for (int i = 1; i < mb->n_bars; i++) {
-        int tmp = order[i];
-        int tmp_key = slot_progress_key(&mb->slots[tmp]);
-        int j = i - 1;
-        while (j >= 0 && slot_progress_key(&mb->slots[order[j]]) < tmp_key) {
-            order[j + 1] = order[j];
-            j--;
-        }
-        order[j + 1] = tmp;
+    int nw = atomic_load(&mb->max_nw);
+
+    for (int i = 0; i < mb->n_bars; i++) {
+        slot_view_t v;
+        slot_load(&mb->slots[i], &v);
+        mb->keys[i] = slot_progress_key(&v);
+        mb->order[i] = i;
     }
 
-    /* Render all bars into one buffer for a single atomic write */
-    int n_rows = mb->n_bars + (mb->has_status ? 1 : 0);
-    char out[8192];
+    /* Partial selection sort: only the drawn rows need ordering, and
+     * earlier slots win ties so rows stay put */
+    for (int r = 0; r < mb->n_rows; r++) {
+        int best = r;
+        for (int j = r + 1; j < mb->n_bars; j++)
+            if (mb->keys[mb->order[j]] > mb->keys[mb->order[best]])
+                best = j;
+        int pick = mb->order[best];
+        memmove(&mb->order[r + 1], &mb->order[r],
+                (size_t)(best - r) * sizeof(int));
+        mb->order[r] = pick;
+    }
+
+    int n_rows = mb->n_rows + (mb->has_status ? 1 : 0);
+    char *out = mb->frame;
+    size_t outsz = mb->frame_cap;
     int pos = 0;
 
-    for (int row = 0; row < mb->n_bars; row++) {
-        int slot = order[row];
-        int up = n_rows - row;
-        WOW_BUF_APPEND(out, sizeof(out), pos, "\033[s\033[%dA", up);
+    for (int row = 0; row < mb->n_rows; row++) {
+        slot_view_t v;
+        slot_load(&mb->slots[mb->order[row]], &v);
+
+        WOW_BUF_APPEND(out, outsz, pos, "\033[s\033[%dA", n_rows - row);
 
         char bar_buf[512];
-        int bar_len = render_bar(&mb->slots[slot], bar_buf, sizeof(bar_buf),
-                                 nw);
-        if ((size_t)(pos + bar_len) < sizeof(out) - 16) {
+        int bar_len = render_bar(&v, bar_buf, sizeof(bar_buf), nw);
+        if (bar_len > (int)sizeof(bar_buf) - 1)
+            bar_len = (int)sizeof(bar_buf) - 1;
+        if ((size_t)(pos + bar_len) < outsz - 16) {
             memcpy(out + pos, bar_buf, (size_t)bar_len);
             pos += bar_len;
         }
 
-        WOW_BUF_APPEND(out, sizeof(out), pos, "\033[u");
+        WOW_BUF_APPEND(out, outsz, pos, "\033[u");
     }
 
+    if (mb->has_status && (size_t)pos < outsz)
+        pos += render_status_line(mb, out + pos, outsz - (size_t)pos);
+
+    if (pos > (int)outsz) pos = (int)outsz;
     (void)write(STDERR_FILENO, out, (size_t)pos);
 }
 
+static void *renderer_main(void *arg)
+{
+    wow_multibar_t *mb = arg;
+
+    for (;;) {
+        render_frame(mb);
+
+        pthread_mutex_lock(&mb->mu);
+        if (!mb->stop) {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += (long)WOW_MULTIBAR_FRAME_MS * 1000000L;
+            if (until.tv_nsec >= 1000000000L) {
+                until.tv_sec++;
+                until.tv_nsec -= 1000000000L;
+            }
+            while (!mb->stop &&
+                   pthread_cond_timedwait(&mb->cv, &mb->mu, &until) == 0)
+                ;
+        }
+        int stop = mb->stop;
+        pthread_mutex_unlock(&mb->mu);
+        if (stop) break;
+    }
+    return NULL;
+}
+
+/* Rows available for bars: WOW_MULTIBAR_ROWS, or fewer on a short tty */
+static int max_rows(void)
+{
+    int rows = WOW_MULTIBAR_ROWS;
+    struct winsize ws;
+    if (ioctl(STDERR_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 &&
+        ws.ws_row - 2 < rows)
+        rows = ws.ws_row > 3 ? ws.ws_row - 2 : 1;
+    return rows;
+}
+
 /* ── Public API ──────────────────────────────────────────────────── */
 
-void wow_multibar_init(wow_multibar_t *mb, int n_bars, int n_total)
+int wow_multibar_init(wow_multibar_t *mb, int n_bars, int n_total)
 {
     memset(mb, 0, sizeof(*mb));
-    if (n_bars > WOW_MULTIBAR_MAX) n_bars = WOW_MULTIBAR_MAX;
-    mb->n_bars = n_bars;
     mb->n_total = n_total;
-    mb->has_status = (n_bars < n_total);
     mb->is_tty = isatty(STDERR_FILENO);
-    mb->max_nw = 20;  /* Minimum name column width (matches uv) */
+    atomic_init(&mb->max_nw, 20);  /* Minimum name column width (matches uv) */
+    atomic_init(&mb->n_completed, 0);
+    atomic_init(&mb->n_failed, 0);
+    atomic_init(&mb->total_bytes, 0);
     mb->start_time = mb_now();
     pthread_mutex_init(&mb->mu, NULL);
+    pthread_cond_init(&mb->cv, NULL);
+
+    if (n_bars <= 0) return 0;
+
+    mb->slots = calloc((size_t)n_bars, sizeof(*mb->slots));
+    mb->order = calloc((size_t)n_bars, sizeof(int));
+    mb->keys = calloc((size_t)n_bars, sizeof(int));
+    if (!mb->slots || !mb->order || !mb->keys) {
+        free(mb->slots); free(mb->order); free(mb->keys);
+        mb->slots = NULL; mb->order = NULL; mb->keys = NULL;
+        return -1;
+    }
+    mb->n_bars = n_bars;
+
+    mb->n_rows = n_bars;
+    if (mb->is_tty) {
+        int rows = max_rows();
+        if (mb->n_rows > rows) mb->n_rows = rows;
+    }
+    mb->has_status = (n_bars < n_total) || (mb->n_rows < n_bars);
+    return 0;
 }
 
 static void update_max_nw(wow_multibar_t *mb, const char *name)
 {
-    if (name) {
-        int len = (int)strlen(name);
-        if (len > mb->max_nw)
-            mb->max_nw = len;
-    }
+    if (!name) return;
+    int len = (int)strlen(name);
+    int cur = atomic_load(&mb->max_nw);
+    while (len > cur &&
+           !atomic_compare_exchange_weak(&mb->max_nw, &cur, len))
+        ;
 }
 
 void wow_multibar_set_name(wow_multibar_t *mb, int i, const char *name)
 {
     if (i >= 0 && i < mb->n_bars) {
-        mb->slots[i].name = name;
+        atomic_store(&mb->slots[i].name, name);
         update_max_nw(mb, name);
     }
 }
@@ -365,15 +405,15 @@ void wow_multibar_start(wow_multibar_t *mb)
     if (mb->started) return;
     mb->started = 1;
 
-    if (!mb->is_tty) return;
+    if (!mb->is_tty || mb->n_bars == 0) return;
 
     /*
-     * Reserve n_bars + (has_status ? 1 : 0) lines by printing newlines.
+     * Reserve n_rows + (has_status ? 1 : 0) lines by printing newlines.
      * The cursor stays at the bottom of the reserved area.
-     * render_bar_at_row() moves UP from here into the reserved rows;
-     * render_status_line() writes at the cursor position (bottom row).
+     * render_frame() moves UP from here into the reserved rows and
+     * writes the status line at the cursor position (bottom row).
      */
-    int n_rows = mb->n_bars + (mb->has_status ? 1 : 0);
+    int n_rows = mb->n_rows + (mb->has_status ? 1 : 0);
 
     char reserve[256];
     int pos = 0;
@@ -382,116 +422,123 @@ void wow_multibar_start(wow_multibar_t *mb)
 
     (void)write(STDERR_FILENO, reserve, (size_t)pos);
 
-    /* Render initial state for each bar + status line */
-    pthread_mutex_lock(&mb->mu);
-    for (int i = 0; i < mb->n_bars; i++)
-        render_bar_at_row(mb, i);
-    render_status_line(mb);
-    pthread_mutex_unlock(&mb->mu);
+    /* Frame: per row ~512 bytes of bar plus cursor moves, then status */
+    mb->frame_cap = (size_t)mb->n_rows * 600 + 512;
+    mb->frame = malloc(mb->frame_cap);
+    if (!mb->frame) return;
+
+    if (pthread_create(&mb->renderer, NULL, renderer_main, mb) == 0)
+        mb->renderer_running = 1;
 }
 
 void wow_multibar_reset(wow_multibar_t *mb, int i, const char *name)
 {
     if (i < 0 || i >= mb->n_bars) return;
 
-    pthread_mutex_lock(&mb->mu);
-
     wow_bar_slot_t *s = &mb->slots[i];
-    s->name = name;
-    s->current = 0;
-    s->total = 0;
-    s->finished = 0;
-    s->failed = 0;
+    atomic_store(&s->current, 0);
+    atomic_store(&s->total, 0);
+    atomic_store(&s->finished, 0);
+    atomic_store(&s->failed, 0);
     s->_last_reported = 0;
     update_max_nw(mb, name);
-
-    if (mb->is_tty)
-        render_all_sorted(mb);
-
-    pthread_mutex_unlock(&mb->mu);
+    atomic_store_explicit(&s->name, name, memory_order_release);
 }
 
 void wow_multibar_update(wow_multibar_t *mb, int i, size_t delta, size_t total)
 {
     if (i < 0 || i >= mb->n_bars) return;
 
-    pthread_mutex_lock(&mb->mu);
-
     wow_bar_slot_t *s = &mb->slots[i];
-    s->current += delta;
-    if (s->total == 0 && total > 0)
-        s->total = total;
+    size_t prev = atomic_fetch_add_explicit(&s->current, delta,
+                                            memory_order_relaxed);
+    if (total > 0) {
+        size_t unknown = 0;
+        atomic_compare_exchange_strong(&s->total, &unknown, total);
+    }
 
-    if (mb->is_tty) {
-        render_all_sorted(mb);
-        render_status_line(mb);
-    } else if (!s->finished && !s->failed && s->total > 0 &&
-               s->current == delta) {
+    if (!mb->is_tty && prev == 0 && total > 0) {
         /* Non-TTY: announce on first update when we know the size */
+        const char *name = atomic_load(&s->name);
         char tot_str[16];
-        wow_fmt_bytes(s->total, tot_str, sizeof(tot_str));
+        wow_fmt_bytes(total, tot_str, sizeof(tot_str));
         fprintf(stderr, "Downloading %s (%s)...\n",
-                s->name ? s->name : "?", tot_str);
+                name ? name : "?", tot_str);
     }
+}
 
-    pthread_mutex_unlock(&mb->mu);
+size_t wow_multibar_current(wow_multibar_t *mb, int i)
+{
+    if (i < 0 || i >= mb->n_bars) return 0;
+    return atomic_load(&mb->slots[i].current);
 }
 
 void wow_multibar_finish(wow_multibar_t *mb, int i)
 {
     if (i < 0 || i >= mb->n_bars) return;
 
-    pthread_mutex_lock(&mb->mu);
-
     wow_bar_slot_t *s = &mb->slots[i];
-    s->finished = 1;
-    mb->n_completed++;
-    mb->total_bytes += s->current;
-
-    if (mb->is_tty) {
-        render_all_sorted(mb);
-        render_status_line(mb);
-    } else {
+    size_t bytes = atomic_load(&s->current);
+    atomic_fetch_add(&mb->total_bytes, bytes);
+    atomic_store(&s->finished, 1);
+    int done = atomic_fetch_add(&mb->n_completed, 1) + 1 +
+               atomic_load(&mb->n_failed);
+
+    if (!mb->is_tty) {
+        const char *name = atomic_load(&s->name);
         char tot_str[16];
-        wow_fmt_bytes(s->current, tot_str, sizeof(tot_str));
+        wow_fmt_bytes(bytes, tot_str, sizeof(tot_str));
         fprintf(stderr, "[%d/%d] Downloaded %s (%s)\n",
-                mb->n_completed + mb->n_failed, mb->n_total,
-                s->name ? s->name : "?", tot_str);
+                done, mb->n_total, name ? name : "?", tot_str);
     }
-
-    pthread_mutex_unlock(&mb->mu);
 }
 
 void wow_multibar_fail(wow_multibar_t *mb, int i)
 {
     if (i < 0 || i >= mb->n_bars) return;
 
-    pthread_mutex_lock(&mb->mu);
-
-    mb->slots[i].failed = 1;
-    mb->n_failed++;
+    wow_bar_slot_t *s = &mb->slots[i];
+    atomic_store(&s->failed, 1);
+    int done = atomic_fetch_add(&mb->n_failed, 1) + 1 +
+               atomic_load(&mb->n_completed);
 
-    if (mb->is_tty) {
-        render_all_sorted(mb);
-        render_status_line(mb);
-    } else {
+    if (!mb->is_tty) {
+        const char *name = atomic_load(&s->name);
         fprintf(stderr, "[%d/%d] Failed: %s\n",
-                mb->n_completed + mb->n_failed, mb->n_total,
-                mb->slots[i].name ? mb->slots[i].name : "?");
+                done, mb->n_total, name ? name : "?");
     }
-
-    pthread_mutex_unlock(&mb->mu);
 }
 
 void wow_multibar_destroy(wow_multibar_t *mb)
 {
-    if (mb->is_tty && mb->started) {
+    if (mb->renderer_running) {
+        pthread_mutex_lock(&mb->mu);
+        mb->stop = 1;
+        pthread_cond_signal(&mb->cv);
+        pthread_mutex_unlock(&mb->mu);
+        pthread_join(mb->renderer, NULL);
+        mb->renderer_running = 0;
+    }
+
+    if (mb->is_tty && mb->started && mb->frame) {
         /*
-         * Move cursor below all bars + status line so subsequent
-         * output doesn't overwrite the final state.
+         * Final frame, then move the cursor below all bars + status
+         * line so subsequent output doesn't overwrite it.
          */
+        render_frame(mb);
         (void)write(STDERR_FILENO, "\n", 1);
     }
+
+    free(mb->frame);
+    free(mb->order);
+    free(mb->keys);
+    free(mb->slots);
+    mb->frame = NULL;
+    mb->order = NULL;
+    mb->keys = NULL;
+    mb->slots = NULL;
+    mb->n_bars = 0;
+    pthread_cond_destroy(&mb->cv);
     pthread_mutex_destroy(&mb->mu);
 }
 
@@ -500,11 +547,12 @@ void wow_multibar_destroy(wow_multibar_t *mb)
 void wow_multibar_http_callback(size_t received, size_t total, void *ctx)
 {
     wow_multibar_ctx_t *mc = (wow_multibar_ctx_t *)ctx;
+    if (mc->index < 0 || mc->index >= mc->mb->n_bars) return;
 
-    /* Calculate delta from previous call */
-    size_t prev = mc->mb->slots[mc->index]._last_reported;
-    size_t delta = received - prev;
-    mc->mb->slots[mc->index]._last_reported = received;
+    /* Calculate delta from previous call (slot owned by this worker) */
+    wow_bar_slot_t *s = &mc->mb->slots[mc->index];
+    size_t delta = received - s->_last_reported;
+    s->_last_reported = received;
 
     wow_multibar_update(mc->mb, mc->index, delta, total);
 
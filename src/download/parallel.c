@@ -12,20 +12,22 @@
  * Thread safety: wow_http_download_to_fd() is safe for concurrent
  * use — all TLS state is stack-local, GetSslRoots() uses cosmo_once,
  * GetEntropy() wraps getentropy(2).  The only shared mutable state
- * is the work queue (mutex-protected) and the multibar (has its own
- * internal mutex).
+ * is the work queue (mutex-protected) and the multibar (atomic
+ * counters, drawn by its own renderer thread).
  */
 
 #include <errno.h>
 #include <fcntl.h>
 #include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 #include "wow/http.h"
 #include "wow/download/multibar.h"
 #include "wow/download/parallel.h"
+#include "wow/util/trace.h"
 
 /* ── Work queue ──────────────────────────────────────────────────── */
 
@@ -64,6 +66,12 @@ static void *download_worker(void *arg)
     download_queue_t *q = wa->queue;
     int bar = wa->worker_id;
 
+    if (wow_trace_on) {
+        char tname[32];
+        snprintf(tname, sizeof(tname), "download-%d", bar);
+        wow_trace_thread_name(tname);
+    }
+
     for (;;) {
         int idx = queue_next(q);
         if (idx < 0)
@@ -92,13 +100,15 @@ static void *download_worker(void *arg)
         /* Download with multibar progress */
         wow_multibar_ctx_t ctx = { .mb = q->mb, .index = bar,
                                    .throttle_us = q->throttle_us };
+        uint64_t t0 = wow_trace_begin();
         int rc = wow_http_download_to_fd(spec->url, fd,
                                           wow_multibar_http_callback, &ctx);
         close(fd);
+        wow_trace_end(t0, "download", "gem", spec->label);
 
         if (rc == 0) {
             res->ok = 1;
-            res->bytes = q->mb->slots[bar].current;
+            res->bytes = wow_multibar_current(q->mb, bar);
             wow_multibar_finish(q->mb, bar);
         } else {
             res->ok = 0;
@@ -126,7 +136,8 @@ int wow_parallel_download(const wow_download_spec_t *specs,
 
     /* Initialise multi-bar display */
     wow_multibar_t mb;
-    wow_multibar_init(&mb, n_workers, n);
+    if (wow_multibar_init(&mb, n_workers, n) != 0)
+        fprintf(stderr, "wow: out of memory for progress display\n");
 
     /*
      * In fixed mode (n_workers == n), pre-set names.
@@ -15,6 +15,7 @@
 
 #include "wow/common.h"
 #include "wow/exec.h"
+#include "wow/util/trace.h"
 
 /*
  * Bounded string copy using memcpy instead of snprintf.
@@ -31,30 +32,27 @@
     (dst)[_len] = '\0';                                     \
 } while (0)
 
-/*
- * Build RUBYLIB and exec the binary.
- *
- * Does not return on success (execv replaces the process).
- * Pass env_dir=NULL for direct exec (user gems with binstubs).
- */
-int
-wow_exec_gem_binary(const char *ruby_bin, const char *ruby_api,
-                    const char *env_dir, const char *exe_path,
-                    int user_argc, char **user_argv)
+void
+wow_exec_ruby_prefix(const char *ruby_bin, char *prefix, size_t prefix_sz)
 {
-    /* Derive Ruby prefix: ruby_bin is .../bin/ruby → prefix is ... */
-    char prefix[WOW_DIR_PATH_MAX];
-    snprintf(prefix, sizeof(prefix), "%s", ruby_bin);
-    {
-        char *slash = strrchr(prefix, '/');
-        if (slash) {
-            *slash = '\0';  /* strip /ruby → .../bin */
-            slash = strrchr(prefix, '/');
-            if (slash) *slash = '\0';  /* strip /bin → prefix */
-        }
+    /* ruby_bin is .../bin/ruby → prefix is ... */
+    snprintf(prefix, prefix_sz, "%s", ruby_bin);
+    char *slash = strrchr(prefix, '/');
+    if (slash) {
+        *slash = '\0';  /* strip /ruby → .../bin */
+        slash = strrchr(prefix, '/');
+        if (slash) *slash = '\0';  /* strip /bin → prefix */
     }
+}
 
-    /* Bounded copy: GCC can track api[16] through all downstream snprintfs */
+size_t
+wow_exec_build_rubylib(const char *ruby_prefix, const char *ruby_api,
+                       const char *env_dir, char *rubylib, size_t rubylib_sz)
+{
+    /* Bounded copies: GCC can track prefix/api through all downstream
+     * snprintfs */
+    char prefix[WOW_DIR_PATH_MAX];
+    snprintf(prefix, sizeof(prefix), "%s", ruby_prefix);
     char api[16];
     snprintf(api, sizeof(api), "%s", ruby_api);
 
@@ -63,14 +61,13 @@ wow_exec_gem_binary(const char *ruby_bin, const char *ruby_api,
      * Order matters: shims shadow stdlib (e.g. bundler/setup.rb),
      * gems shadow default gems (e.g. prism 1.9 over bundled 0.19),
      * stdlib provides rubygems/rbconfig/etc. as fallback. */
-    char rubylib[32768];
-    rubylib[0] = '\0';
     size_t pos = 0;
+    rubylib[0] = '\0';
 
     /* Helper: append a path to RUBYLIB */
     #define RUBYLIB_APPEND(path) do {                           \
         size_t _plen = strlen(path);                            \
-        if (pos + _plen + 2 <= sizeof(rubylib)) {               \
+        if (pos + _plen + 2 <= rubylib_sz) {                    \
             if (pos > 0) rubylib[pos++] = ':';                  \
             memcpy(rubylib + pos, (path), _plen);               \
             pos += _plen;                                        \
@@ -198,6 +195,30 @@ wow_exec_gem_binary(const char *ruby_bin, const char *ruby_api,
 
     #undef RUBYLIB_APPEND
 
+    return pos;
+}
+
+/*
+ * Build RUBYLIB and exec the binary.
+ *
+ * Does not return on success (execv replaces the process).
+ * Pass env_dir=NULL for direct exec (user gems with binstubs).
+ */
+int
+wow_exec_gem_binary(const char *ruby_bin, const char *ruby_api,
+                    const char *env_dir, const char *exe_path,
+                    int user_argc, char **user_argv)
+{
+    uint64_t t0 = wow_trace_begin();
+
+    /* Derive Ruby prefix: ruby_bin is .../bin/ruby → prefix is ... */
+    char prefix[WOW_DIR_PATH_MAX];
+    wow_exec_ruby_prefix(ruby_bin, prefix, sizeof(prefix));
+
+    char rubylib[32768];
+    size_t pos = wow_exec_build_rubylib(prefix, ruby_api, env_dir,
+                                        rubylib, sizeof(rubylib));
+
     if (pos > 0)
         setenv("RUBYLIB", rubylib, 1);
 
@@ -239,6 +260,8 @@ wow_exec_gem_binary(const char *ruby_bin, const char *ruby_api,
         exec_argv[2 + i] = user_argv[i];
     exec_argv[nargs] = NULL;
 
+    wow_trace_end(t0, "exec", "setup", exe_path);
+    wow_trace_flush();
     execv(ruby_bin, exec_argv);
     fprintf(stderr, "wow: exec failed: %s\n", strerror(errno));
     free(exec_argv);
@@ -0,0 +1,456 @@
+/*
+ * exec/manifest.c — Precomputed run environment (.wow-env)
+ *
+ * wow_exec_gem_binary() derives RUBYLIB from the filesystem on every
+ * launch: opendir on gems/, an fopen per gem for .require_paths, a scan
+ * of the stdlib for rbconfig.rb, then wow_find_gem_binary() walks gems/
+ * again for the executable.  With a few hundred gems that is hundreds
+ * of syscalls before Ruby even starts.
+ *
+ * Installers (wow sync, wowx) do that work once and write the result to
+ * <env_dir>/.wow-env.  Launchers mmap it and go straight to execve:
+ * open + fstat + mmap + close, two stat()s to check the lockfile and the
+ * gems directory have not changed since, and the exec itself.
+ *
+ * Format (text, one record per line, fields separated by TAB):
+ *
+ *   wow-env<TAB>3
+ *   ruby<TAB><ruby_bin>
+ *   ruby-version<TAB><full Ruby version, e.g. 3.3.6>
+ *   env<TAB><env_dir as given to the writer>
+ *   lock-mtime<TAB><sec>.<nsec>, or - without a lockfile
+ *   gems-mtime<TAB><sec>.<nsec>
+ *   RUBYLIB<TAB><colon-separated load path>
+ *   RUBYOPT<TAB><options>
+ *   LD_LIBRARY_PATH<TAB><dir prepended to any inherited value>
+ *   WOW_REQUIRE_INDEX<TAB><absolute path>                (optional)
+ *   exe<TAB><binary><TAB><gem dir entry><TAB><path>      (repeated)
+ *
+ * Any mismatch (different Ruby binary or version, different env path,
+ * Gemfile.lock or gems/ touched since the write, binary not listed)
+ * makes the launcher fall back to the filesystem scan, so a stale
+ * manifest is never worse than none.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "wow/common.h"
+#include "wow/exec.h"
+#include "wow/util/trace.h"
+
+#define MANIFEST_NAME   ".wow-env"
+/* 2: the require index records its load path (older indexes are
+ * ignored by the preload, so their manifests must be rewritten)
+ * 3: ruby-version and lock-mtime records */
+#define MANIFEST_MAGIC  "wow-env\t3\n"
+
+/* ── Staleness keys ──────────────────────────────────────────────── */
+
+static void fmt_mtime(const struct stat *st, char *buf, size_t bufsz)
+{
+    snprintf(buf, bufsz, "%" PRId64 ".%09ld",
+             (int64_t)st->st_mtim.tv_sec, (long)st->st_mtim.tv_nsec);
+}
+
+/* "<sec>.<nsec>" of <env_dir>/gems, as recorded by the writer */
+static int gems_mtime(const char *env_dir, char *buf, size_t bufsz)
+{
+    char gems_dir[WOW_OS_PATH_MAX];
+    snprintf(gems_dir, sizeof(gems_dir), "%s/gems", env_dir);
+    struct stat gst;
+    if (stat(gems_dir, &gst) != 0) return -1;
+    fmt_mtime(&gst, buf, bufsz);
+    return 0;
+}
+
+/* "<sec>.<nsec>" of lock_path, or "-" if it is NULL or missing */
+static void lock_mtime(const char *lock_path, char *buf, size_t bufsz)
+{
+    struct stat lst;
+    if (lock_path && stat(lock_path, &lst) == 0)
+        fmt_mtime(&lst, buf, bufsz);
+    else
+        snprintf(buf, bufsz, "-");
+}
+
+/* ── Writer ──────────────────────────────────────────────────────── */
+
+/* Emit one exe record if <gems>/<entry>/{exe,bin}/<name> exists */
+static void emit_exe(FILE *f, const char *env, const char *entry,
+                     const char *name)
+{
+    static const char *bindirs[] = { "exe", "bin", NULL };
+    for (const char **bd = bindirs; *bd; bd++) {
+        char path[WOW_OS_PATH_MAX];
+        int n = snprintf(path, sizeof(path), "%s/gems/%s/%s/%s",
+                         env, entry, *bd, name);
+        if (n < 0 || (size_t)n >= sizeof(path)) return;
+        if (access(path, R_OK) == 0) {
+            fprintf(f, "exe\t%s\t%s\t%s\n", name, entry, path);
+            return;
+        }
+    }
+}
+
+/* No .executables marker (e.g. gem unpacked by an older wow): list the
+ * gem's exe/ directory, or bin/ if it has none. */
+static void emit_bindir_listing(FILE *f, const char *env, const char *entry)
+{
+    static const char *bindirs[] = { "exe", "bin", NULL };
+    for (const char **bd = bindirs; *bd; bd++) {
+        char dir_path[WOW_OS_PATH_MAX];
+        snprintf(dir_path, sizeof(dir_path), "%s/gems/%s/%s",
+                 env, entry, *bd);
+        DIR *d = opendir(dir_path);
+        if (!d) continue;
+
+        struct dirent *ent;
+        while ((ent = readdir(d)) != NULL) {
+            if (ent->d_name[0] == '.') continue;
+            char name[64];
+            if (strlen(ent->d_name) >= sizeof(name)) continue;
+            strcpy(name, ent->d_name);
+            emit_exe(f, env, entry, name);
+        }
+        closedir(d);
+        return;
+    }
+}
+
+int
+wow_env_manifest_write(const char *ruby_bin, const char *ruby_version,
+                       const char *ruby_api, const char *env_dir,
+                       const char *lock_path)
+{
+    /* Bounded copy so GCC can track sizes through compositions */
+    char env[WOW_DIR_PATH_MAX];
+    snprintf(env, sizeof(env), "%s", env_dir);
+
+    char prefix[WOW_DIR_PATH_MAX];
+    wow_exec_ruby_prefix(ruby_bin, prefix, sizeof(prefix));
+
+    /* The launcher skips these; make sure they exist now */
+    wow_ensure_bundler_shim(prefix);
+    wow_ensure_gem_preload(prefix);
+
+    char gems_dir[WOW_OS_PATH_MAX];
+    snprintf(gems_dir, sizeof(gems_dir), "%s/gems", env);
+    char gems_mt[48], lock_mt[48];
+    if (gems_mtime(env, gems_mt, sizeof(gems_mt)) != 0) return -1;
+    lock_mtime(lock_path, lock_mt, sizeof(lock_mt));
+
+    char *rubylib = malloc(32768);
+    if (!rubylib) return -1;
+    wow_exec_build_rubylib(prefix, ruby_api, env, rubylib, 32768);
+
+    char tmp_path[WOW_OS_PATH_MAX];
+    char final_path[WOW_OS_PATH_MAX];
+    snprintf(tmp_path, sizeof(tmp_path), "%s/" MANIFEST_NAME ".tmp", env);
+    snprintf(final_path, sizeof(final_path), "%s/" MANIFEST_NAME, env);
+
+    FILE *f = fopen(tmp_path, "w");
+    if (!f) {
+        fprintf(stderr, "wow: cannot write %s: %s\n",
+                tmp_path, strerror(errno));
+        free(rubylib);
+        return -1;
+    }
+
+    fputs(MANIFEST_MAGIC, f);
+    fprintf(f, "ruby\t%s\n", ruby_bin);
+    fprintf(f, "ruby-version\t%s\n", ruby_version);
+    fprintf(f, "env\t%s\n", env);
+    fprintf(f, "lock-mtime\t%s\n", lock_mt);
+    fprintf(f, "gems-mtime\t%s\n", gems_mt);
+    fprintf(f, "RUBYLIB\t%s\n", rubylib);
+    fprintf(f, "RUBYOPT\t-r%s/lib/wow_preload.rb\n", prefix);
+    fprintf(f, "LD_LIBRARY_PATH\t%s/lib\n", prefix);
+
+    /* Feature → path index for the preload's require hook */
+    char index_path[WOW_OS_PATH_MAX];
+    if (wow_require_index_write(env, rubylib, index_path,
+                                sizeof(index_path)) == 0)
+        fprintf(f, "WOW_REQUIRE_INDEX\t%s\n", index_path);
+    free(rubylib);
+
+    DIR *dir = opendir(gems_dir);
+    if (dir) {
+        struct dirent *ent;
+        while ((ent = readdir(dir)) != NULL) {
+            if (ent->d_name[0] == '.') continue;
+            char entry[128];
+            if (strlen(ent->d_name) >= sizeof(entry)) continue;
+            strcpy(entry, ent->d_name);
+
+            char exe_marker[WOW_OS_PATH_MAX];
+            snprintf(exe_marker, sizeof(exe_marker),
+                     "%s/gems/%s/.executables", env, entry);
+
+            FILE *ef = fopen(exe_marker, "r");
+            if (!ef) {
+                emit_bindir_listing(f, env, entry);
+                continue;
+            }
+            char line[64];
+            while (fgets(line, sizeof(line), ef)) {
+                char *nl = strchr(line, '\n');
+                if (nl) *nl = '\0';
+                if (line[0]) emit_exe(f, env, entry, line);
+            }
+            fclose(ef);
+        }
+        closedir(dir);
+    }
+
+    if (fclose(f) != 0 || rename(tmp_path, final_path) != 0) {
+        fprintf(stderr, "wow: cannot write %s: %s\n",
+                final_path, strerror(errno));
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+/* ── Launcher ────────────────────────────────────────────────────── */
+
+/*
+ * Field cursor over the mapped file.  Fields are [p, end) slices —
+ * nothing is copied until the final setenv/execv.
+ */
+struct mf_cursor {
+    const char *p, *end;
+};
+
+/* Next line as [*ls, *le), newline excluded.  Returns 0 at EOF. */
+static int mf_next_line(struct mf_cursor *c, const char **ls,
+                        const char **le)
+{
+    if (c->p >= c->end) return 0;
+    const char *nl = memchr(c->p, '\n', (size_t)(c->end - c->p));
+    *ls = c->p;
+    *le = nl ? nl : c->end;
+    c->p = nl ? nl + 1 : c->end;
+    return 1;
+}
+
+/* If [ls, le) starts with "key\t", return the value start, else NULL */
+static const char *mf_value(const char *ls, const char *le, const char *key)
+{
+    size_t kl = strlen(key);
+    if ((size_t)(le - ls) <= kl || memcmp(ls, key, kl) != 0 || ls[kl] != '\t')
+        return NULL;
+    return ls + kl + 1;
+}
+
+static int mf_eq(const char *v, const char *le, const char *s)
+{
+    size_t n = strlen(s);
+    return (size_t)(le - v) == n && memcmp(v, s, n) == 0;
+}
+
+static char *mf_dup(const char *v, const char *le)
+{
+    return strndup(v, (size_t)(le - v));
+}
+
+int
+wow_env_manifest_exec(const char *ruby_bin, const char *ruby_version,
+                      const char *env_dir, const char *lock_path,
+                      const char *gem_name, const char *binary_name,
+                      int user_argc, char **user_argv)
+{
+    uint64_t t0 = wow_trace_begin();
+    char path[WOW_OS_PATH_MAX];
+    int n = snprintf(path, sizeof(path), "%s/" MANIFEST_NAME, env_dir);
+    if (n < 0 || (size_t)n >= sizeof(path)) return -1;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= (off_t)strlen(MANIFEST_MAGIC)) {
+        close(fd);
+        return -1;
+    }
+    size_t len = (size_t)st.st_size;
+    const char *map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return -1;
+
+    int ret = -1;
+    char *rubylib = NULL, *rubyopt = NULL, *ldpath = NULL, *exe = NULL;
+    char *req_index = NULL;
+    char *exe_fallback = NULL;
+
+    if (memcmp(map, MANIFEST_MAGIC, strlen(MANIFEST_MAGIC)) != 0)
+        goto out;
+
+    struct mf_cursor c = { map + strlen(MANIFEST_MAGIC), map + len };
+    const char *ls, *le, *v;
+    int ruby_ok = 0, version_ok = 0, env_ok = 0, lock_ok = 0, mtime_ok = 0;
+    size_t glen = gem_name ? strlen(gem_name) : 0;
+
+    while (mf_next_line(&c, &ls, &le)) {
+        if ((v = mf_value(ls, le, "exe"))) {
+            /* exe<TAB>binary<TAB>entry<TAB>path */
+            const char *t1 = memchr(v, '\t', (size_t)(le - v));
+            if (!t1 || !mf_eq(v, t1, binary_name)) continue;
+            const char *entry = t1 + 1;
+            const char *t2 = memchr(entry, '\t', (size_t)(le - entry));
+            if (!t2) continue;
+            int gem_match = gem_name &&
+                            (size_t)(t2 - entry) > glen &&
+                            memcmp(entry, gem_name, glen) == 0 &&
+                            entry[glen] == '-';
+            if (gem_match && !exe) {
+                exe = mf_dup(t2 + 1, le);
+            } else if (!exe_fallback) {
+                exe_fallback = mf_dup(t2 + 1, le);
+            }
+        } else if ((v = mf_value(ls, le, "ruby"))) {
+            ruby_ok = mf_eq(v, le, ruby_bin);
+        } else if ((v = mf_value(ls, le, "ruby-version"))) {
+            version_ok = mf_eq(v, le, ruby_version);
+        } else if ((v = mf_value(ls, le, "env"))) {
+            env_ok = mf_eq(v, le, env_dir);
+        } else if ((v = mf_value(ls, le, "lock-mtime"))) {
+            char want[48];
+            lock_mtime(lock_path, want, sizeof(want));
+            lock_ok = mf_eq(v, le, want);
+        } else if ((v = mf_value(ls, le, "gems-mtime"))) {
+            char want[48];
+            if (gems_mtime(env_dir, want, sizeof(want)) == 0)
+                mtime_ok = mf_eq(v, le, want);
+        } else if ((v = mf_value(ls, le, "RUBYLIB"))) {
+            free(rubylib);
+            rubylib = mf_dup(v, le);
+        } else if ((v = mf_value(ls, le, "RUBYOPT"))) {
+            free(rubyopt);
+            rubyopt = mf_dup(v, le);
+        } else if ((v = mf_value(ls, le, "LD_LIBRARY_PATH"))) {
+            free(ldpath);
+            ldpath = mf_dup(v, le);
+        } else if ((v = mf_value(ls, le, "WOW_REQUIRE_INDEX"))) {
+            free(req_index);
+            req_index = mf_dup(v, le);
+        }
+
+        /* Header records come first; bail before scanning exe lines */
+        if (ls == map + strlen(MANIFEST_MAGIC) && !ruby_ok) goto out;
+    }
+
+    if (!exe) {
+        exe = exe_fallback;
+        exe_fallback = NULL;
+    }
+    if (!ruby_ok || !version_ok || !env_ok || !lock_ok || !mtime_ok ||
+        !exe || !rubyopt || !ldpath)
+        goto out;
+
+    if (rubylib && rubylib[0])
+        setenv("RUBYLIB", rubylib, 1);
+    setenv("RUBYOPT", rubyopt, 1);
+    if (req_index)
+        setenv("WOW_REQUIRE_INDEX", req_index, 1);
+
+    const char *existing = getenv("LD_LIBRARY_PATH");
+    if (existing && existing[0]) {
+        char combined[PATH_MAX * 2];
+        snprintf(combined, sizeof(combined), "%s:%s", ldpath, existing);
+        setenv("LD_LIBRARY_PATH", combined, 1);
+    } else {
+        setenv("LD_LIBRARY_PATH", ldpath, 1);
+    }
+
+    /* Build exec argv: ruby <script> [user_args...] */
+    int nargs = 2 + user_argc;
+    char **exec_argv = calloc((size_t)(nargs + 1), sizeof(char *));
+    if (!exec_argv) goto out;
+    exec_argv[0] = (char *)ruby_bin;
+    exec_argv[1] = exe;
+    for (int i = 0; i < user_argc; i++)
+        exec_argv[2 + i] = user_argv[i];
+    exec_argv[nargs] = NULL;
+
+    munmap((void *)map, len);
+    map = NULL;
+    wow_trace_end(t0, "exec", "manifest", binary_name);
+    wow_trace_flush();
+    execv(ruby_bin, exec_argv);
+    fprintf(stderr, "wow: exec failed: %s\n", strerror(errno));
+    free(exec_argv);
+    ret = 1;
+
+out:
+    if (map) munmap((void *)map, len);
+    free(rubylib);
+    free(rubyopt);
+    free(ldpath);
+    free(req_index);
+    free(exe);
+    free(exe_fallback);
+    return ret;
+}
+
+/* ── Freshness ───────────────────────────────────────────────────── */
+
+int
+wow_env_manifest_current(const char *ruby_bin, const char *ruby_version,
+                         const char *env_dir, const char *lock_path)
+{
+    char path[WOW_OS_PATH_MAX];
+    int n = snprintf(path, sizeof(path), "%s/" MANIFEST_NAME, env_dir);
+    if (n < 0 || (size_t)n >= sizeof(path)) return 0;
+
+    /* A Ruby reinstalled in place since the write may have moved its
+     * stdlib around */
+    struct stat mst, rst;
+    if (stat(path, &mst) != 0 || stat(ruby_bin, &rst) != 0) return 0;
+    if (rst.st_mtim.tv_sec > mst.st_mtim.tv_sec ||
+        (rst.st_mtim.tv_sec == mst.st_mtim.tv_sec &&
+         rst.st_mtim.tv_nsec > mst.st_mtim.tv_nsec))
+        return 0;
+
+    FILE *f = fopen(path, "r");
+    if (!f) return 0;
+
+    /* Only the header records; they precede the (long) RUBYLIB line */
+    char line[WOW_OS_PATH_MAX + 64];
+    int ruby_ok = 0, version_ok = 0, env_ok = 0, lock_ok = 0, mtime_ok = 0;
+    if (fgets(line, sizeof(line), f) && strcmp(line, MANIFEST_MAGIC) == 0) {
+        while (fgets(line, sizeof(line), f)) {
+            const char *le = line + strcspn(line, "\n");
+            const char *v;
+            if ((v = mf_value(line, le, "ruby"))) {
+                ruby_ok = mf_eq(v, le, ruby_bin);
+            } else if ((v = mf_value(line, le, "ruby-version"))) {
+                version_ok = mf_eq(v, le, ruby_version);
+            } else if ((v = mf_value(line, le, "env"))) {
+                env_ok = mf_eq(v, le, env_dir);
+            } else if ((v = mf_value(line, le, "lock-mtime"))) {
+                char want[48];
+                lock_mtime(lock_path, want, sizeof(want));
+                lock_ok = mf_eq(v, le, want);
+            } else if ((v = mf_value(line, le, "gems-mtime"))) {
+                char want[48];
+                mtime_ok = gems_mtime(env_dir, want, sizeof(want)) == 0 &&
+                           mf_eq(v, le, want);
+                break;
+            } else {
+                break;
+            }
+        }
+    }
+    fclose(f);
+    return ruby_ok && version_ok && env_ok && lock_ok && mtime_ok;
+}
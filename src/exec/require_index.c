@@ -0,0 +1,178 @@
+/*
+ * exec/require_index.c — Install-time require index (.wow-require-index)
+ *
+ * With hundreds of gems on RUBYLIB, every `require "x"` makes Ruby probe
+ * each load-path directory in turn (x.rb, then x.so) until one exists.
+ * That dominates boot time for large apps under `wow run`.
+ *
+ * At install time we already know the complete load path, so we walk it
+ * once and write every loadable feature with its absolute path:
+ *
+ *   <feature><TAB><absolute path>\n
+ *
+ * e.g. "active_support/core_ext\t/…/activesupport-7.1.3/lib/active_support/core_ext.rb".
+ * Each load-path directory is announced by a line with an empty
+ * feature ("\t<dir>") before its own features; the Ruby side only
+ * trusts the index while $LOAD_PATH still starts with those directories.
+ * Lines are emitted in load-path order; the Ruby side keeps the first
+ * occurrence of each feature, which is exactly the file Ruby's own
+ * search would pick.  Within one directory a .rb shadows a native
+ * extension of the same name, matching Ruby's per-directory extension
+ * order.
+ *
+ * The preload hook (PRELOAD_CONTENT in shims.c) loads the index when
+ * WOW_REQUIRE_INDEX names it and routes extensionless requires through
+ * it before falling back to the normal search.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "wow/common.h"
+#include "wow/exec.h"
+
+#define INDEX_NAME       ".wow-require-index"
+#define INDEX_MAX_DEPTH  24
+
+/* Loadable feature extensions, in Ruby's per-directory preference order */
+static const char *feature_ext(const char *name, size_t *stem_len)
+{
+    static const char *exts[] = { ".rb", ".so", ".bundle", NULL };
+    size_t len = strlen(name);
+    for (const char **e = exts; *e; e++) {
+        size_t el = strlen(*e);
+        if (len > el && strcmp(name + len - el, *e) == 0) {
+            *stem_len = len - el;
+            return *e;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Walk root/rel recursively, emitting features.  rel is the feature
+ * prefix ("" at the top, "active_support/" below).
+ */
+static void index_dir(FILE *out, const char *root, const char *rel,
+                      int depth)
+{
+    if (depth > INDEX_MAX_DEPTH) return;
+
+    char dir_path[WOW_OS_PATH_MAX];
+    int n = snprintf(dir_path, sizeof(dir_path), "%s/%s", root, rel);
+    if (n < 0 || (size_t)n >= sizeof(dir_path)) return;
+
+    DIR *d = opendir(dir_path);
+    if (!d) return;
+
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        if (ent->d_name[0] == '.') continue;
+
+        char child_rel[WOW_OS_PATH_MAX];
+        n = snprintf(child_rel, sizeof(child_rel), "%s%s", rel, ent->d_name);
+        if (n < 0 || (size_t)n >= sizeof(child_rel) - 1) continue;
+
+        char full[WOW_OS_PATH_MAX];
+        n = snprintf(full, sizeof(full), "%s/%s", root, child_rel);
+        if (n < 0 || (size_t)n >= sizeof(full)) continue;
+
+        struct stat st;
+        if (stat(full, &st) != 0) continue;
+
+        if (S_ISDIR(st.st_mode)) {
+            size_t cl = strlen(child_rel);
+            child_rel[cl] = '/';
+            child_rel[cl + 1] = '\0';
+            index_dir(out, root, child_rel, depth + 1);
+            continue;
+        }
+        if (!S_ISREG(st.st_mode)) continue;
+
+        size_t stem;
+        const char *ext = feature_ext(ent->d_name, &stem);
+        if (!ext) continue;
+
+        size_t feat_len = strlen(rel) + stem;
+
+        /* foo.so next to foo.rb: Ruby loads the .rb */
+        if (strcmp(ext, ".rb") != 0) {
+            char rb[WOW_OS_PATH_MAX];
+            n = snprintf(rb, sizeof(rb), "%s/%.*s.rb",
+                         root, (int)feat_len, child_rel);
+            if (n > 0 && (size_t)n < sizeof(rb) && access(rb, F_OK) == 0)
+                continue;
+        }
+
+        fprintf(out, "%.*s\t%s\n", (int)feat_len, child_rel, full);
+    }
+    closedir(d);
+}
+
+int
+wow_require_index_write(const char *env_dir, const char *rubylib,
+                        char *index_path, size_t index_path_sz)
+{
+    char cwd[WOW_DIR_PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd))) return -1;
+
+    /* Absolute index path: it is handed to Ruby via the environment */
+    char env[WOW_DIR_PATH_MAX];
+    if (env_dir[0] == '/') {
+        snprintf(env, sizeof(env), "%s", env_dir);
+    } else {
+        size_t cl = strlen(cwd), el = strlen(env_dir);
+        if (cl + 1 + el >= sizeof(env)) return -1;
+        memcpy(env, cwd, cl);
+        env[cl] = '/';
+        memcpy(env + cl + 1, env_dir, el + 1);
+    }
+
+    char tmp_path[WOW_OS_PATH_MAX];
+    snprintf(tmp_path, sizeof(tmp_path), "%s/" INDEX_NAME ".tmp", env);
+    int n = snprintf(index_path, index_path_sz, "%s/" INDEX_NAME, env);
+    if (n < 0 || (size_t)n >= index_path_sz) return -1;
+
+    FILE *out = fopen(tmp_path, "w");
+    if (!out) {
+        fprintf(stderr, "wow: cannot write %s: %s\n",
+                tmp_path, strerror(errno));
+        return -1;
+    }
+
+    /* One load-path entry at a time, in order */
+    const char *p = rubylib;
+    while (*p) {
+        const char *colon = strchr(p, ':');
+        size_t len = colon ? (size_t)(colon - p) : strlen(p);
+
+        char root[WOW_DIR_PATH_MAX];
+        if (len > 0 && len < sizeof(root) - 1) {
+            if (p[0] == '/')
+                n = snprintf(root, sizeof(root), "%.*s", (int)len, p);
+            else
+                n = snprintf(root, sizeof(root), "%s/%.*s",
+                             cwd, (int)len, p);
+            if (n > 0 && (size_t)n < sizeof(root)) {
+                fprintf(out, "\t%s\n", root);
+                index_dir(out, root, "", 0);
+            }
+        }
+
+        p += len;
+        if (*p == ':') p++;
+    }
+
+    if (fclose(out) != 0 || rename(tmp_path, index_path) != 0) {
+        fprintf(stderr, "wow: cannot write %s: %s\n",
+                index_path, strerror(errno));
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
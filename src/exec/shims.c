@@ -5,9 +5,11 @@
  * interfering with our RUBYLIB-based gem loading.
  */
 
+#include <fcntl.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include "wow/common.h"
 #include "wow/exec.h"
@@ -42,6 +44,14 @@ static const char BUNDLER_SHIM_CONTENT[] =
  * Gems call `gem "name", ">= x.y"` to activate via RubyGems.
  * Since we don't have gemspec files, this would fail. Our stub
  * makes these calls no-ops via RUBYOPT=-r< preload >.
+ *
+ * When the launcher sets WOW_REQUIRE_INDEX (see exec/require_index.c),
+ * extensionless and .rb requires are looked up in the install-time
+ * feature index and loaded by absolute path — one hash lookup instead
+ * of a probe per load-path entry.  Misses fall through to the normal
+ * search, so an incomplete index only costs speed.  So does any
+ * $LOAD_PATH that no longer starts with the directories the index was
+ * built from: the hook steps aside rather than override Ruby's choice.
  */
 static const char PRELOAD_CONTENT[] =
     "module Kernel\n"
@@ -49,6 +59,53 @@ static const char PRELOAD_CONTENT[] =
     "    true\n"
     "  end\n"
     "  private :gem\n"
+    "end\n"
+    "\n"
+    "if (wow_index = ENV[\"WOW_REQUIRE_INDEX\"]) && File.file?(wow_index)\n"
+    "  module WowRequireIndex\n"
+    "    MAP = {}\n"
+    "    DIRS = []\n"
+    "    File.foreach(ENV[\"WOW_REQUIRE_INDEX\"]) do |line|\n"
+    "      feature, path = line.chomp.split(\"\\t\", 2)\n"
+    "      next unless path\n"
+    "      if feature.empty?\n"
+    "        DIRS << File.expand_path(path)\n"
+    "      else\n"
+    "        MAP[feature] ||= path\n"
+    "      end\n"
+    "    end\n"
+    "    MAP.freeze\n"
+    "    DIRS.freeze\n"
+    "\n"
+    "    # Valid only while $LOAD_PATH starts with the load path the\n"
+    "    # index was built from (-I, an unshift or an app's lib/ in\n"
+    "    # front may shadow a feature); rechecked when it changes\n"
+    "    def self.current?\n"
+    "      key = [$LOAD_PATH.size, $LOAD_PATH.hash]\n"
+    "      return @current if key == @seen\n"
+    "      @seen = key\n"
+    "      @current = !DIRS.empty? && $LOAD_PATH.size >= DIRS.size &&\n"
+    "        $LOAD_PATH.first(DIRS.size).map { |d| File.expand_path(d) } == DIRS\n"
+    "    end\n"
+    "\n"
+    "    def self.lookup(feature)\n"
+    "      return nil unless feature.is_a?(String) && current?\n"
+    "      if feature.end_with?(\".rb\")\n"
+    "        hit = MAP[feature.delete_suffix(\".rb\")]\n"
+    "        hit if hit && hit.end_with?(\".rb\")\n"
+    "      elsif File.extname(feature).empty?\n"
+    "        MAP[feature]\n"
+    "      end\n"
+    "    end\n"
+    "  end\n"
+    "\n"
+    "  module Kernel\n"
+    "    alias_method :wow_require_without_index, :require\n"
+    "    def require(feature)\n"
+    "      wow_require_without_index(WowRequireIndex.lookup(feature) || feature)\n"
+    "    end\n"
+    "    private :require, :wow_require_without_index\n"
+    "  end\n"
     "end\n";
 
 int
@@ -79,6 +136,25 @@ wow_ensure_bundler_shim(const char *ruby_prefix)
     return 0;
 }
 
+/* Does path hold exactly PRELOAD_CONTENT? */
+static int preload_current(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+
+    char buf[sizeof(PRELOAD_CONTENT)];
+    size_t got = 0;
+    ssize_t n;
+    while (got < sizeof(buf) &&
+           (n = read(fd, buf + got, sizeof(buf) - got)) > 0)
+        got += (size_t)n;
+    close(fd);
+
+    /* One byte past the content must hit EOF */
+    return got == sizeof(PRELOAD_CONTENT) - 1 &&
+           memcmp(buf, PRELOAD_CONTENT, got) == 0;
+}
+
 int
 wow_ensure_gem_preload(const char *ruby_prefix)
 {
@@ -86,9 +162,11 @@ wow_ensure_gem_preload(const char *ruby_prefix)
     snprintf(preload_path, sizeof(preload_path),
              "%s/lib/wow_preload.rb", ruby_prefix);
 
-    struct stat st;
-    if (stat(preload_path, &st) == 0)
-        return 0;  /* Already exists */
+    /* Already exists and current.  Compare the bytes, not just the
+     * size: a preload from another wow release may differ by an edit
+     * of the same length. */
+    if (preload_current(preload_path))
+        return 0;
 
     /* Create directory */
     char preload_dir[WOW_OS_PATH_MAX];
@@ -0,0 +1,387 @@
+/*
+ * cache.c -- on-disk cache of Gemfile parse results
+ *
+ * Entry layout (all integers little-endian u32, strings length-prefixed,
+ * length 0xFFFFFFFF meaning NULL):
+ *
+ *   "WOWGFC1\n"
+ *   n_inputs, then per input: kind, name, value
+ *   source, ruby_version, has_gemspec, n_deps
+ *   per dep: name, constraints[], groups[], autorequire[],
+ *            autorequire_specified, platforms[]
+ *
+ * where each [] is a count (0xFFFFFFFF for a NULL array) followed by that
+ * many strings.  Entries are never modified in place, only replaced, so
+ * a reader sees either the old file or the new one.  A hit refreshes the
+ * entry's mtime; stores trim entries unused for CACHE_MAX_AGE, and the
+ * least recently used beyond CACHE_MAX_ENTRIES.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "wow/common.h"
+#include "wow/gemfile/cache.h"
+#include "wow/util/path.h"
+#include "wow/util/sha256.h"
+#include "wow/version.h"
+
+#define CACHE_MAGIC     "WOWGFC1\n"
+#define CACHE_MAGIC_LEN 8
+#define CACHE_MAX_SIZE  (4 * 1024 * 1024)
+#define CACHE_NULL      0xFFFFFFFFu
+
+/* One entry per Gemfile revision: bound the directory (wow_cache_trim) */
+#define CACHE_MAX_AGE     (30L * 24 * 60 * 60)
+#define CACHE_MAX_ENTRIES 512
+
+/* ------------------------------------------------------------------ */
+/* Location                                                            */
+/* ------------------------------------------------------------------ */
+
+static int cache_enabled(void)
+{
+    const char *off = getenv("WOW_NO_GEMFILE_CACHE");
+    return !(off && off[0] && strcmp(off, "0") != 0);
+}
+
+static int cache_dir(char *buf, size_t bufsz)
+{
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    int n;
+    if (xdg && xdg[0]) {
+        n = snprintf(buf, bufsz, "%s/wow/gemfile", xdg);
+    } else {
+        const char *home = getenv("HOME");
+        if (!home || !home[0]) return -1;
+        n = snprintf(buf, bufsz, "%s/.cache/wow/gemfile", home);
+    }
+    return (n < 0 || (size_t)n >= bufsz) ? -1 : 0;
+}
+
+static int entry_path(const char *key, char *buf, size_t bufsz)
+{
+    char dir[WOW_DIR_PATH_MAX];
+    if (cache_dir(dir, sizeof(dir)) != 0) return -1;
+    int n = snprintf(buf, bufsz, "%s/%s", dir, key);
+    return (n < 0 || (size_t)n >= bufsz) ? -1 : 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* Key                                                                 */
+/* ------------------------------------------------------------------ */
+
+static void hash_str(wow_sha256_ctx *h, const char *s)
+{
+    if (s) wow_sha256_update(h, s, strlen(s));
+    wow_sha256_update(h, "\n", 1);
+}
+
+int wow_gemfile_cache_key(const char *path, const char *buf, int len,
+                          char *hex, size_t hexsz)
+{
+    if (!cache_enabled()) return -1;
+
+    char abs[WOW_OS_PATH_MAX];
+    if (!realpath(path, abs)) return -1;
+
+    wow_sha256_ctx *h = wow_sha256_new();
+    if (!h) return -1;
+    hash_str(h, CACHE_MAGIC "wow " WOW_VERSION);
+    hash_str(h, abs);
+    hash_str(h, getenv("RUBY_VERSION"));
+    hash_str(h, wow_eval_ruby_platform());
+    wow_sha256_update(h, buf, (size_t)len);
+    int rc = wow_sha256_final(h, hex, hexsz);
+    wow_sha256_free(h);
+    return rc;
+}
+
+/* ------------------------------------------------------------------ */
+/* Writing                                                             */
+/* ------------------------------------------------------------------ */
+
+static void put_u32(FILE *f, uint32_t v)
+{
+    unsigned char b[4] = { (unsigned char)v, (unsigned char)(v >> 8),
+                           (unsigned char)(v >> 16),
+                           (unsigned char)(v >> 24) };
+    fwrite(b, 1, 4, f);
+}
+
+static void put_str(FILE *f, const char *s)
+{
+    if (!s) {
+        put_u32(f, CACHE_NULL);
+        return;
+    }
+    size_t len = strlen(s);
+    put_u32(f, (uint32_t)len);
+    fwrite(s, 1, len, f);
+}
+
+static void put_strv(FILE *f, char **v, int n)
+{
+    if (!v) {
+        put_u32(f, CACHE_NULL);
+        return;
+    }
+    put_u32(f, (uint32_t)n);
+    for (int i = 0; i < n; i++)
+        put_str(f, v[i]);
+}
+
+int wow_gemfile_cache_store(const char *key, const struct wow_gemfile *gf,
+                            const struct wow_eval_inputs *in)
+{
+    if (in->overflow) return -1;
+
+    char path[WOW_OS_PATH_MAX], tmp[WOW_OS_PATH_MAX];
+    if (entry_path(key, path, sizeof(path)) != 0) return -1;
+    int n = snprintf(tmp, sizeof(tmp), "%s.tmp.%d", path, (int)getpid());
+    if (n < 0 || (size_t)n >= sizeof(tmp)) return -1;
+
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        char dir[WOW_DIR_PATH_MAX];
+        if (cache_dir(dir, sizeof(dir)) != 0 || wow_mkdirs(dir, 0755) != 0)
+            return -1;
+        if (!(f = fopen(tmp, "wb"))) return -1;
+    }
+
+    fwrite(CACHE_MAGIC, 1, CACHE_MAGIC_LEN, f);
+    put_u32(f, (uint32_t)in->n);
+    for (int i = 0; i < in->n; i++) {
+        put_u32(f, (uint32_t)in->v[i].kind);
+        put_str(f, in->v[i].name);
+        put_str(f, in->v[i].value);
+    }
+
+    put_str(f, gf->source);
+    put_str(f, gf->ruby_version);
+    put_u32(f, gf->has_gemspec);
+    put_u32(f, (uint32_t)gf->n_deps);
+    for (size_t i = 0; i < gf->n_deps; i++) {
+        const struct wow_gemfile_dep *d = &gf->deps[i];
+        put_str(f, d->name);
+        put_strv(f, d->constraints, d->n_constraints);
+        put_strv(f, d->groups, d->n_groups);
+        put_strv(f, d->autorequire, d->n_autorequire);
+        put_u32(f, d->autorequire_specified);
+        put_strv(f, d->platforms, d->n_platforms);
+    }
+
+    int werr = ferror(f);
+    if (fclose(f) != 0) werr = 1;
+    if (werr || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+
+    char dir[WOW_DIR_PATH_MAX];
+    if (cache_dir(dir, sizeof(dir)) == 0)
+        wow_cache_trim(dir, CACHE_MAX_AGE, CACHE_MAX_ENTRIES);
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* Reading                                                             */
+/* ------------------------------------------------------------------ */
+
+/* Bounds-checked cursor over an entry; any overrun sets bad */
+struct reader {
+    const unsigned char *p, *end;
+    int bad;
+};
+
+static uint32_t get_u32(struct reader *r)
+{
+    if (r->bad || r->end - r->p < 4) {
+        r->bad = 1;
+        return 0;
+    }
+    uint32_t v = (uint32_t)r->p[0] | (uint32_t)r->p[1] << 8 |
+                 (uint32_t)r->p[2] << 16 | (uint32_t)r->p[3] << 24;
+    r->p += 4;
+    return v;
+}
+
+/* Returns a malloc'd copy; NULL for a NULL string or on error (check bad) */
+static char *get_str(struct reader *r)
+{
+    uint32_t len = get_u32(r);
+    if (r->bad || len == CACHE_NULL) return NULL;
+    if ((size_t)(r->end - r->p) < len) {
+        r->bad = 1;
+        return NULL;
+    }
+    char *s = strndup((const char *)r->p, len);
+    if (!s) r->bad = 1;
+    r->p += len;
+    return s;
+}
+
+static char **get_strv(struct reader *r, int *n)
+{
+    *n = 0;
+    uint32_t count = get_u32(r);
+    if (r->bad || count == CACHE_NULL) return NULL;
+    if (count > (size_t)(r->end - r->p) / 4) {
+        r->bad = 1;
+        return NULL;
+    }
+    char **v = calloc(count ? count : 1, sizeof(char *));
+    if (!v) {
+        r->bad = 1;
+        return NULL;
+    }
+    for (uint32_t i = 0; i < count && !r->bad; i++) {
+        if (!(v[i] = get_str(r))) r->bad = 1;
+        (*n)++;
+    }
+    return v;
+}
+
+static void strv_free(char **v, int n)
+{
+    for (int i = 0; i < n; i++) free(v[i]);
+    free(v);
+}
+
+static void dep_free(struct wow_gemfile_dep *d)
+{
+    free(d->name);
+    strv_free(d->constraints, d->n_constraints);
+    strv_free(d->groups, d->n_groups);
+    strv_free(d->autorequire, d->n_autorequire);
+    strv_free(d->platforms, d->n_platforms);
+}
+
+/* Does the input still hold the value it had when the entry was made? */
+static int input_matches(enum wow_eval_input_kind kind, const char *name,
+                         const char *value)
+{
+    if (kind == WOW_INPUT_ENV) {
+        const char *now = getenv(name);
+        if (!now || !value) return !now && !value;
+        return strcmp(now, value) == 0;
+    }
+
+    FILE *f = fopen(name, "rb");
+    if (!f) return value == NULL;
+    if (!value) {
+        fclose(f);
+        return 0;
+    }
+    wow_sha256_ctx *h = wow_sha256_new();
+    if (!h) {
+        fclose(f);
+        return 0;
+    }
+    char chunk[8192];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        wow_sha256_update(h, chunk, n);
+    int err = ferror(f);
+    fclose(f);
+    char hex[65];
+    wow_sha256_final(h, hex, sizeof(hex));
+    wow_sha256_free(h);
+    return !err && strcmp(hex, value) == 0;
+}
+
+static int read_entry(const char *path, unsigned char **out, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    struct stat st;
+    if (fstat(fileno(f), &st) != 0 || st.st_size < CACHE_MAGIC_LEN ||
+        st.st_size > CACHE_MAX_SIZE) {
+        fclose(f);
+        return -1;
+    }
+    unsigned char *buf = malloc((size_t)st.st_size);
+    if (!buf) {
+        fclose(f);
+        return -1;
+    }
+    size_t got = fread(buf, 1, (size_t)st.st_size, f);
+    fclose(f);
+    if (got != (size_t)st.st_size) {
+        free(buf);
+        return -1;
+    }
+    *out = buf;
+    *len = got;
+    return 0;
+}
+
+int wow_gemfile_cache_load(const char *key, struct wow_gemfile *gf)
+{
+    char path[WOW_OS_PATH_MAX];
+    if (!cache_enabled() || entry_path(key, path, sizeof(path)) != 0)
+        return -1;
+
+    unsigned char *buf;
+    size_t len;
+    if (read_entry(path, &buf, &len) != 0) return -1;
+    if (memcmp(buf, CACHE_MAGIC, CACHE_MAGIC_LEN) != 0) {
+        free(buf);
+        return -1;
+    }
+    struct reader r = { buf + CACHE_MAGIC_LEN, buf + len, 0 };
+
+    /* Recorded inputs first: a changed ENV value or include is a miss */
+    uint32_t n_inputs = get_u32(&r);
+    int valid = !r.bad && n_inputs <= WOW_EVAL_MAX_INPUTS;
+    for (uint32_t i = 0; valid && i < n_inputs; i++) {
+        uint32_t kind = get_u32(&r);
+        char *name = get_str(&r);
+        char *value = get_str(&r);
+        valid = !r.bad && name &&
+                (kind == WOW_INPUT_ENV || kind == WOW_INPUT_FILE) &&
+                input_matches((enum wow_eval_input_kind)kind, name, value);
+        free(name);
+        free(value);
+    }
+    if (!valid) {
+        free(buf);
+        return -1;
+    }
+
+    struct wow_gemfile tmp;
+    wow_gemfile_init(&tmp);
+    tmp.source = get_str(&r);
+    tmp.ruby_version = get_str(&r);
+    tmp.has_gemspec = get_u32(&r) != 0;
+    uint32_t n_deps = get_u32(&r);
+    for (uint32_t i = 0; i < n_deps && !r.bad; i++) {
+        struct wow_gemfile_dep d;
+        memset(&d, 0, sizeof(d));
+        d.name = get_str(&r);
+        d.constraints = get_strv(&r, &d.n_constraints);
+        d.groups = get_strv(&r, &d.n_groups);
+        d.autorequire = get_strv(&r, &d.n_autorequire);
+        d.autorequire_specified = get_u32(&r) != 0;
+        d.platforms = get_strv(&r, &d.n_platforms);
+        if (!d.name) r.bad = 1;
+        /* Added even when bad so wow_gemfile_free() releases it */
+        if (wow_gemfile_add_dep(&tmp, &d) != 0) {
+            dep_free(&d);
+            r.bad = 1;
+        }
+    }
+    free(buf);
+
+    if (r.bad || r.p != r.end) {
+        wow_gemfile_free(&tmp);
+        return -1;
+    }
+    *gf = tmp;
+    wow_cache_touch(path);
+    return 0;
+}
@@ -0,0 +1,221 @@
+/*
+ * edit.c -- in-place Gemfile edits for `wow add` / `wow remove`
+ *
+ * Line-based, like a person editing the file: the parser is only used
+ * by callers to decide whether an edit is needed.  A gem declaration
+ * is recognised by its first line,
+ *
+ *   gem "name" ...      gem 'name' ...      gem("name", ...)
+ *
+ * at any indent (inside group/platforms blocks too).  A declaration
+ * whose line ends in ',' continues on the next line.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "wow/common.h"
+#include "wow/gemfile/edit.h"
+
+static char *read_text(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "wow: cannot read %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long sz = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *buf = sz >= 0 ? malloc((size_t)sz + 1) : NULL;
+    if (!buf || fread(buf, 1, (size_t)sz, f) != (size_t)sz) {
+        fprintf(stderr, "wow: cannot read %s\n", path);
+        free(buf);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    buf[sz] = '\0';
+    *len = (size_t)sz;
+    return buf;
+}
+
+/* Write the pieces in order to path.tmp, then rename over path */
+static int write_text(const char *path, const char *a, size_t alen,
+                      const char *b, size_t blen, const char *c, size_t clen)
+{
+    char tmp[WOW_OS_PATH_MAX];
+    int n = snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    if (n < 0 || (size_t)n >= sizeof(tmp)) return -1;
+
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        fprintf(stderr, "wow: cannot write %s: %s\n", tmp, strerror(errno));
+        return -1;
+    }
+    int ok = fwrite(a, 1, alen, f) == alen &&
+             fwrite(b, 1, blen, f) == blen &&
+             fwrite(c, 1, clen, f) == clen;
+    if (fclose(f) != 0) ok = 0;
+    if (!ok || rename(tmp, path) != 0) {
+        fprintf(stderr, "wow: cannot write %s: %s\n", path, strerror(errno));
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+static const char *skip_ws(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+/* Does the line [p, end) start a gem declaration?  name NULL = any gem */
+static int is_gem_line(const char *p, const char *end, const char *name)
+{
+    p = skip_ws(p, end);
+    if (end - p < 4 || strncmp(p, "gem", 3) != 0) return 0;
+    p += 3;
+    if (*p != ' ' && *p != '\t' && *p != '(') return 0;
+    if (*p == '(') p++;
+    p = skip_ws(p, end);
+    if (p >= end || (*p != '"' && *p != '\'')) return 0;
+    if (!name) return 1;
+
+    char q = *p++;
+    size_t nl = strlen(name);
+    return (size_t)(end - p) > nl && strncmp(p, name, nl) == 0 &&
+           p[nl] == q;
+}
+
+/* Does the line [p, end) end in ',' (ignoring trailing whitespace)? */
+static int continues(const char *p, const char *end)
+{
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t' ||
+                       end[-1] == '\r'))
+        end--;
+    return end > p && end[-1] == ',';
+}
+
+/* RubyGems' name charset; anything else could break out of the quotes */
+static int valid_name(const char *name)
+{
+    if (!name[0]) return 0;
+    for (const char *p = name; *p; p++)
+        if (!((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+              (*p >= '0' && *p <= '9') || *p == '.' || *p == '_' ||
+              *p == '-'))
+            return 0;
+    return 1;
+}
+
+/* A constraint goes inside "..." verbatim: no quote, escape, comment
+ * or line break */
+static int valid_constraint(const char *c)
+{
+    return !strpbrk(c, "\"\\#\n\r");
+}
+
+int wow_gemfile_edit_add(const char *path, const char *name,
+                         char **constraints, int n_constraints)
+{
+    if (!valid_name(name)) {
+        fprintf(stderr, "wow: invalid gem name: %s\n", name);
+        return -1;
+    }
+    for (int i = 0; i < n_constraints; i++) {
+        if (!valid_constraint(constraints[i])) {
+            fprintf(stderr, "wow: invalid constraint for %s: %s\n",
+                    name, constraints[i]);
+            return -1;
+        }
+    }
+
+    size_t len;
+    char *buf = read_text(path, &len);
+    if (!buf) return -1;
+
+    /* Insertion point: after the last top-level gem declaration */
+    const char *end = buf + len;
+    const char *insert = NULL;
+    for (const char *line = buf; line < end; ) {
+        const char *eol = memchr(line, '\n', (size_t)(end - line));
+        const char *next = eol ? eol + 1 : end;
+        if (line[0] == 'g' && is_gem_line(line, eol ? eol : end, NULL)) {
+            while (next < end && continues(line, eol ? eol : end)) {
+                line = next;
+                eol = memchr(line, '\n', (size_t)(end - line));
+                next = eol ? eol + 1 : end;
+            }
+            insert = next;
+        }
+        line = next;
+    }
+
+    if (!insert) insert = end;
+
+    /* Appending to a file without a trailing newline needs one first */
+    int need_nl = insert == end && len > 0 && buf[len - 1] != '\n';
+
+    char decl[1024];
+    int pos = snprintf(decl, sizeof(decl), "%sgem \"%s\"",
+                       need_nl ? "\n" : "", name);
+    for (int i = 0; i < n_constraints; i++) {
+        if (pos < 0 || (size_t)pos >= sizeof(decl)) break;
+        pos += snprintf(decl + pos, sizeof(decl) - (size_t)pos,
+                        ", \"%s\"", constraints[i]);
+    }
+    if (pos < 0 || (size_t)pos >= sizeof(decl) - 1) {
+        fprintf(stderr, "wow: gem declaration too long\n");
+        free(buf);
+        return -1;
+    }
+    decl[pos++] = '\n';
+
+    size_t head = (size_t)(insert - buf);
+    int rc = write_text(path, buf, head, decl, (size_t)pos,
+                        insert, len - head);
+    free(buf);
+    return rc;
+}
+
+int wow_gemfile_edit_remove(const char *path, const char *name)
+{
+    size_t len;
+    char *buf = read_text(path, &len);
+    if (!buf) return -1;
+
+    char *out = malloc(len + 1);
+    if (!out) { free(buf); return -1; }
+
+    const char *end = buf + len;
+    size_t olen = 0;
+    int removed = 0;
+    for (const char *line = buf; line < end; ) {
+        const char *eol = memchr(line, '\n', (size_t)(end - line));
+        const char *next = eol ? eol + 1 : end;
+        if (is_gem_line(line, eol ? eol : end, name)) {
+            while (next < end && continues(line, eol ? eol : end)) {
+                line = next;
+                eol = memchr(line, '\n', (size_t)(end - line));
+                next = eol ? eol + 1 : end;
+            }
+            removed++;
+        } else {
+            memcpy(out + olen, line, (size_t)(next - line));
+            olen += (size_t)(next - line);
+        }
+        line = next;
+    }
+
+    int rc = removed;
+    if (removed > 0 && write_text(path, out, olen, "", 0, "", 0) != 0)
+        rc = -1;
+    free(out);
+    free(buf);
+    return rc;
+}
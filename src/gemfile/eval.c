@@ -16,6 +16,7 @@
 
 #include "wow/gemfile/eval.h"
 #include "wow/gemfile/lexer.h"
+#include "wow/util/sha256.h"
 #include "parser.h"
 
 /* ------------------------------------------------------------------ */
@@ -70,6 +71,41 @@ static void eval_error(struct wow_eval_ctx *ctx, int line,
     va_end(ap);
 }
 
+/* Record an input the result depends on (first lookup of each wins) */
+static void note_input(struct wow_eval_ctx *ctx,
+                       enum wow_eval_input_kind kind,
+                       const char *name, const char *value)
+{
+    struct wow_eval_inputs *in = ctx->inputs;
+    if (!in || in->overflow) return;
+    for (int i = 0; i < in->n; i++)
+        if (in->v[i].kind == kind && strcmp(in->v[i].name, name) == 0)
+            return;
+    if (in->n == WOW_EVAL_MAX_INPUTS) {
+        in->overflow = true;
+        return;
+    }
+    struct wow_eval_input *e = &in->v[in->n];
+    e->kind = kind;
+    e->name = strdup(name);
+    e->value = value ? strdup(value) : NULL;
+    if (!e->name || (value && !e->value)) {
+        free(e->name);
+        free(e->value);
+        in->overflow = true;
+        return;
+    }
+    in->n++;
+}
+
+/* getenv() that records the lookup */
+static const char *env_get(struct wow_eval_ctx *ctx, const char *key)
+{
+    const char *val = getenv(key);
+    note_input(ctx, WOW_INPUT_ENV, key, val);
+    return val;
+}
+
 /* ------------------------------------------------------------------ */
 /* Block stack                                                         */
 /* ------------------------------------------------------------------ */
@@ -360,7 +396,7 @@ static struct wow_eval_val eval_atom(struct wow_eval_ctx *ctx,
                     char *key = tok_strip(ctx->line[*pos].tok, 1, 1);
                     (*pos)++;  /* skip key string */
                     if (peek(ctx, *pos, end) == RBRACKET) (*pos)++;
-                    const char *val = getenv(key);
+                    const char *val = env_get(ctx, key);
                     free(key);
                     free(name);
                     if (val) return val_string(ctx, val, false);
@@ -389,7 +425,7 @@ static struct wow_eval_val eval_atom(struct wow_eval_ctx *ctx,
                             }
                         }
                         if (peek(ctx, *pos, end) == RPAREN) (*pos)++;
-                        const char *val = key ? getenv(key) : NULL;
+                        const char *val = key ? env_get(ctx, key) : NULL;
                         free(key);
                         free(method);
                         free(name);
@@ -412,7 +448,7 @@ static struct wow_eval_val eval_atom(struct wow_eval_ctx *ctx,
                         if (peek(ctx, *pos, end) == STRING) {
                             char *key = tok_strip(ctx->line[*pos].tok, 1, 1);
                             (*pos)++;
-                            found = getenv(key) != NULL;
+                            found = env_get(ctx, key) != NULL;
                             free(key);
                         }
                         if (peek(ctx, *pos, end) == RPAREN) (*pos)++;
@@ -1155,16 +1191,34 @@ static void process_line(struct wow_eval_ctx *ctx)
             } else {
                 /* Read and parse the included file */
                 FILE *f = fopen(resolved, "rb");
+                if (!f) note_input(ctx, WOW_INPUT_FILE, resolved, NULL);
                 if (f) {
                     fseek(f, 0, SEEK_END);
                     long sz = ftell(f);
                     fseek(f, 0, SEEK_SET);
+                    /* Skipped includes make the result uncacheable */
+                    if ((sz < 0 || sz >= 1024 * 1024) && ctx->inputs)
+                        ctx->inputs->overflow = true;
                     if (sz >= 0 && sz < 1024 * 1024) {
                         char *buf = malloc((size_t)sz + 1);
                         if (buf) {
                             fread(buf, 1, (size_t)sz, f);
                             buf[sz] = '\0';
 
+                            if (ctx->inputs) {
+                                char hex[65];
+                                wow_sha256_ctx *h = wow_sha256_new();
+                                if (h) {
+                                    wow_sha256_update(h, buf, (size_t)sz);
+                                    wow_sha256_final(h, hex, sizeof(hex));
+                                    wow_sha256_free(h);
+                                    note_input(ctx, WOW_INPUT_FILE,
+                                               resolved, hex);
+                                } else {
+                                    ctx->inputs->overflow = true;
+                                }
+                            }
+
                             /* Sub-lexer + sub-evaluator sharing our state */
                             struct wow_lexer sub_lex;
                             wow_lexer_init(&sub_lex, buf, (int)sz);
@@ -1174,6 +1228,7 @@ static void process_line(struct wow_eval_ctx *ctx)
                                           ctx->ruby_version, resolved,
                                           buf, (int)sz);
                             sub.recurse_depth = ctx->recurse_depth + 1;
+                            sub.inputs = ctx->inputs;
 
                             /* Copy variables from parent */
                             for (int i = 0; i < ctx->n_vars; i++) {
@@ -1259,32 +1314,45 @@ void wow_eval_init(struct wow_eval_ctx *ctx, struct wow_lexer *lex,
     }
 
     ctx->ruby_engine = "ruby";
+    ctx->ruby_platform = wow_eval_ruby_platform();
+}
 
-    /* RUBY_PLATFORM is determined at compile time. For APE binaries this
-     * reflects the build host, not necessarily the runtime platform.
-     * In practice this is fine — Gemfile platform checks almost always
-     * test for "ruby" engine, not specific architecture strings. */
+/* RUBY_PLATFORM is determined at compile time. For APE binaries this
+ * reflects the build host, not necessarily the runtime platform.
+ * In practice this is fine — Gemfile platform checks almost always
+ * test for "ruby" engine, not specific architecture strings. */
+const char *wow_eval_ruby_platform(void)
+{
 #if defined(__x86_64__) || defined(_M_X64)
 # if defined(__linux__) || defined(__COSMOPOLITAN__)
-    ctx->ruby_platform = "x86_64-linux";
+    return "x86_64-linux";
 # elif defined(__APPLE__)
-    ctx->ruby_platform = "x86_64-darwin";
+    return "x86_64-darwin";
 # else
-    ctx->ruby_platform = "x86_64";
+    return "x86_64";
 # endif
 #elif defined(__aarch64__)
 # if defined(__linux__) || defined(__COSMOPOLITAN__)
-    ctx->ruby_platform = "aarch64-linux";
+    return "aarch64-linux";
 # elif defined(__APPLE__)
-    ctx->ruby_platform = "arm64-darwin";
+    return "arm64-darwin";
 # else
-    ctx->ruby_platform = "aarch64";
+    return "aarch64";
 # endif
 #else
-    ctx->ruby_platform = "unknown";
+    return "unknown";
 #endif
 }
 
+void wow_eval_inputs_free(struct wow_eval_inputs *in)
+{
+    for (int i = 0; i < in->n; i++) {
+        free(in->v[i].name);
+        free(in->v[i].value);
+    }
+    in->n = 0;
+}
+
 void wow_eval_free(struct wow_eval_ctx *ctx)
 {
     /* Free variable store */
@@ -2,7 +2,7 @@
  * glue.c -- wire the re2c lexer to the lemon parser
  *
  * Provides:
- *   wow_gemfile_parse_file()  -- parse a Gemfile from a path
+ *   wow_gemfile_parse_file()  -- parse a Gemfile from a path (cached)
  *   wow_gemfile_parse_buf()   -- parse from an in-memory buffer
  *   wow_gemfile_lex_file()    -- debug: print token stream
  */
@@ -12,11 +12,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "wow/gemfile/cache.h"
 #include "wow/gemfile/lexer.h"
 #include "wow/gemfile/eval.h"
 #include "wow/gemfile/types.h"
 #include "wow/gemfile/parse.h"
 #include "parser.h"
+#include "wow/util/trace.h"
 
 /* lemon-generated parser functions */
 void *ParseAlloc(void *(*mallocProc)(size_t));
@@ -248,12 +250,10 @@ int wow_gemfile_parse_buf(const char *buf, int len, struct wow_gemfile *gf)
     return rc;
 }
 
-int wow_gemfile_parse_file(const char *path, struct wow_gemfile *gf)
+/* Parse buf, read from path; ENV and eval_gemfile inputs go to inputs */
+static int parse_file(const char *path, const char *buf, int len,
+                      struct wow_gemfile *gf, struct wow_eval_inputs *inputs)
 {
-    int len = 0;
-    char *buf = read_file(path, &len);
-    if (!buf) return -1;
-
     /* Use the file-path-aware version for eval_gemfile support */
     wow_gemfile_init(gf);
 
@@ -273,9 +273,10 @@ int wow_gemfile_parse_file(const char *path, struct wow_gemfile *gf)
 
     struct wow_eval_ctx eval;
     wow_eval_init(&eval, &lex, NULL, path, start, slen);
+    eval.inputs = inputs;
 
     void *parser = ParseAlloc(malloc);
-    if (!parser) { wow_eval_free(&eval); free(buf); return -1; }
+    if (!parser) { wow_eval_free(&eval); return -1; }
 
     int rc = 0;
     struct wow_token tok;
@@ -335,6 +336,35 @@ int wow_gemfile_parse_file(const char *path, struct wow_gemfile *gf)
     if (rc == 0 && !gf->source)
         gf->source = strdup("locally installed gems");
 
+    return rc;
+}
+
+/*
+ * The on-disk parse cache (cache.h) is consulted first; a miss parses
+ * as usual and stores the result with the inputs evaluation used.
+ */
+int wow_gemfile_parse_file(const char *path, struct wow_gemfile *gf)
+{
+    uint64_t t0 = wow_trace_begin();
+    int len = 0;
+    char *buf = read_file(path, &len);
+    if (!buf) return -1;
+
+    char key[65];
+    int cacheable = wow_gemfile_cache_key(path, buf, len,
+                                          key, sizeof(key)) == 0;
+    if (cacheable && wow_gemfile_cache_load(key, gf) == 0) {
+        free(buf);
+        wow_trace_end(t0, "gemfile", "cache-hit", path);
+        return 0;
+    }
+
+    struct wow_eval_inputs inputs = { .n = 0 };
+    int rc = parse_file(path, buf, len, gf, &inputs);
+    if (rc == 0 && cacheable)
+        wow_gemfile_cache_store(key, gf, &inputs);
+    wow_eval_inputs_free(&inputs);
     free(buf);
+    wow_trace_end(t0, "gemfile", "parse", path);
     return rc;
 }
@@ -7,8 +7,13 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "wow/gems.h"
+#include "wow/util/fmt.h"
+#include "wow/util/sha256.h"
+#include "wow/util/time.h"
 
 int cmd_gem_download(int argc, char *argv[])
 {
@@ -70,3 +75,55 @@ int cmd_gem_unpack(int argc, char *argv[])
     }
     return wow_gem_unpack(argv[1], argv[2]) == 0 ? 0 : 1;
 }
+
+static void cache_usage(void)
+{
+    fprintf(stderr,
+            "usage: wow cache verify [-j N] [--remove] [-v] [DIR]\n"
+            "\n"
+            "Check every cached .gem against its checksums.yaml.gz.\n"
+            "DIR defaults to the gem cache.  --remove deletes corrupt\n"
+            "gems so the next sync downloads them again.\n");
+}
+
+int cmd_cache(int argc, char *argv[])
+{
+    if (argc < 2 || strcmp(argv[1], "verify") != 0) {
+        cache_usage();
+        return 1;
+    }
+
+    struct wow_gem_verify_opts o = { 0, 0, 0 };
+    const char *dir = NULL;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            o.jobs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--remove") == 0) {
+            o.remove = 1;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            o.verbose = 1;
+        } else if (argv[i][0] == '-' || dir) {
+            cache_usage();
+            return 1;
+        } else {
+            dir = argv[i];
+        }
+    }
+
+    double t0 = wow_now_secs();
+    struct wow_gem_verify_stats st;
+    if (wow_gem_verify_dir(dir, &o, &st) != 0)
+        return 1;
+    double secs = wow_now_secs() - t0;
+
+    char sz[16];
+    wow_fmt_bytes((size_t)st.bytes, sz, sizeof(sz));
+    printf("Verified %d gem%s (%s) in %.2fs [sha256: %s]: "
+           "%d ok, %d unchecked, %d corrupt",
+           st.total, st.total == 1 ? "" : "s", sz, secs,
+           wow_sha256_backend(), st.ok, st.unchecked, st.corrupt);
+    if (o.remove && st.corrupt > 0)
+        printf(", %d removed", st.removed);
+    printf("\n");
+    return st.corrupt > 0 ? 1 : 0;
+}
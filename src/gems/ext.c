@@ -0,0 +1,1026 @@
+/*
+ * gems/ext.c — native extension builds and the extension artefact cache
+ *
+ * Build strategy for a gem that declares extensions:
+ *   1. Platform binary already present in lib/ → nothing to do
+ *   2. Cached build for (gem checksum, Ruby API, arch, platform) → link
+ *   3. Build from source: ruby extconf.rb && make && make install,
+ *      then store what the install added to lib/ in the cache
+ *
+ * Cache entries are written to <key>.tmp.<pid> and renamed into place,
+ * so a reader only ever sees complete entries and concurrent installs
+ * of the same gem at worst both compile.
+ *
+ * Scheduling: all gems of a solution are built concurrently by a small
+ * worker pool.  A gem waits for the gems it depends on (directly) that
+ * also have extensions.  Parallelism is capped by a GNU make jobserver
+ * that wow creates with one token per CPU: a worker holds a token for
+ * the duration of its build (that is make's implicit job slot) and every
+ * make borrows further tokens from the shared pipe, so the whole
+ * machine is used without ever running more than ncpu jobs at once.
+ * Build output goes to <ext dir>/wow-build.log and is shown on failure.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "wow/common.h"
+#include "wow/gems/ext.h"
+#include "wow/rubies/resolve.h"
+#include "wow/util/colour.h"
+#include "wow/util/path.h"
+#include "wow/util/sha256.h"
+#include "wow/util/time.h"
+#include "wow/util/trace.h"
+
+#define EXT_MAX_DEPTH 16
+#define EXT_LOG_NAME  "wow-build.log"
+
+extern char **environ;
+
+/* Bounded copy without snprintf (see wowx_main.c for the rationale) */
+#define SCOPY(dst, src) do {                              \
+    size_t _len = strlen(src);                             \
+    if (_len >= sizeof(dst)) _len = sizeof(dst) - 1;       \
+    memcpy((dst), (src), _len);                             \
+    (dst)[_len] = '\0';                                     \
+} while (0)
+
+/* ── Cache directory ─────────────────────────────────────────────── */
+
+int wow_ext_cache_dir(char *buf, size_t bufsz)
+{
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    if (xdg && xdg[0]) {
+        int n = snprintf(buf, bufsz, "%s/wow/ext", xdg);
+        if (n < 0 || (size_t)n >= bufsz) return -1;
+    } else {
+        const char *home = getenv("HOME");
+        if (!home) {
+            fprintf(stderr, "wow: $HOME not set\n");
+            return -1;
+        }
+        int n = snprintf(buf, bufsz, "%s/.cache/wow/ext", home);
+        if (n < 0 || (size_t)n >= bufsz) return -1;
+    }
+    return 0;
+}
+
+/* ── Process helper ──────────────────────────────────────────────── */
+
+/*
+ * Run a command in a given working directory with an explicit
+ * environment, wait for completion.  Child stdout and stderr go to
+ * log_fd so concurrent builds don't interleave on the terminal.
+ * Only async-signal-safe calls happen between fork and exec (other
+ * worker threads may hold malloc locks).
+ * Returns the exit code, or -1 on fork/exec failure.
+ */
+static int run_cmd(const char *cwd, const char *const argv[],
+                   char *const envp[], int log_fd)
+{
+    pid_t pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "wow: fork failed: %s\n", strerror(errno));
+        return -1;
+    }
+    if (pid == 0) {
+        dup2(log_fd, STDOUT_FILENO);
+        dup2(log_fd, STDERR_FILENO);
+        if (cwd && chdir(cwd) != 0)
+            _exit(127);
+        execve(argv[0], (char *const *)argv, envp);
+        _exit(127);
+    }
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/* ── Jobserver ───────────────────────────────────────────────────── */
+
+struct jobserver {
+    int  fds[2];            /* read, write ends of the token pipe */
+    int  slots;             /* total tokens (CPU count) */
+    char makeflags[96];     /* MAKEFLAGS value advertising the pipe */
+};
+
+static int cpu_count(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+/*
+ * Create the token pipe.  The fds are deliberately inheritable: every
+ * make we spawn finds them via --jobserver-fds (accepted by GNU make
+ * 3.81 through 4.4; newer makes treat it as --jobserver-auth).
+ */
+static int jobserver_open(struct jobserver *js, int slots)
+{
+    if (pipe(js->fds) != 0) return -1;
+    js->slots = slots;
+    for (int i = 0; i < slots; i++) {
+        if (write(js->fds[1], "+", 1) != 1) {
+            close(js->fds[0]);
+            close(js->fds[1]);
+            return -1;
+        }
+    }
+    snprintf(js->makeflags, sizeof(js->makeflags),
+             " -j%d --jobserver-fds=%d,%d", slots, js->fds[0], js->fds[1]);
+    return 0;
+}
+
+static void jobserver_close(struct jobserver *js)
+{
+    close(js->fds[0]);
+    close(js->fds[1]);
+}
+
+static void token_acquire(const struct jobserver *js)
+{
+    char c;
+    while (read(js->fds[0], &c, 1) < 0 && errno == EINTR)
+        ;
+}
+
+static void token_release(const struct jobserver *js)
+{
+    while (write(js->fds[1], "+", 1) < 0 && errno == EINTR)
+        ;
+}
+
+/* ── Ruby layout helpers ─────────────────────────────────────────── */
+
+/* <prefix>/bin/ruby → <prefix> */
+static void ruby_prefix(const char *ruby_bin, char *buf, size_t bufsz)
+{
+    snprintf(buf, bufsz, "%s", ruby_bin);
+    char *sl = strrchr(buf, '/');
+    if (sl) { *sl = '\0'; sl = strrchr(buf, '/'); if (sl) *sl = '\0'; }
+}
+
+/*
+ * Name of the arch subdirectory of <prefix>/lib/ruby/<api> holding
+ * rbconfig.rb, e.g. "x86_64-linux".  Returns 0 if found, -1 otherwise.
+ */
+static int rbconfig_arch(const char *prefix, const char *ruby_api,
+                         char *arch, size_t arch_sz)
+{
+    char api[16];
+    SCOPY(api, ruby_api);
+
+    char stdlib_dir[WOW_OS_PATH_MAX];
+    snprintf(stdlib_dir, sizeof(stdlib_dir), "%s/lib/ruby/%s", prefix, api);
+
+    DIR *sd = opendir(stdlib_dir);
+    if (!sd) return -1;
+
+    int found = -1;
+    struct dirent *se;
+    while ((se = readdir(sd)) != NULL) {
+        if (se->d_name[0] == '.') continue;
+
+        char name[128];
+        SCOPY(name, se->d_name);
+
+        char candidate[WOW_OS_PATH_MAX];
+        snprintf(candidate, sizeof(candidate),
+                 "%s/lib/ruby/%s/%s/rbconfig.rb", prefix, api, name);
+        if (access(candidate, R_OK) == 0) {
+            snprintf(arch, arch_sz, "%s", name);
+            found = 0;
+            break;
+        }
+    }
+    closedir(sd);
+    return found;
+}
+
+/* ── Native library detection ────────────────────────────────────── */
+
+static int is_native_name(const char *name)
+{
+    size_t len = strlen(name);
+    return (len > 3 && strcmp(name + len - 3, ".so") == 0) ||
+           (len > 7 && strcmp(name + len - 7, ".bundle") == 0);
+}
+
+int wow_gem_has_native_lib(const char *gem_dir)
+{
+    /* Bounded copy so GCC can track sizes through compositions */
+    char dir[WOW_DIR_PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", gem_dir);
+
+    char lib_dir[WOW_OS_PATH_MAX];
+    snprintf(lib_dir, sizeof(lib_dir), "%s/lib", dir);
+
+    /* Only one level deep under lib/ — that covers the common case
+     * (lib/prism/prism.so, lib/x86_64-linux/foo.so). */
+    DIR *d1 = opendir(lib_dir);
+    if (!d1) return 0;
+
+    struct dirent *e1;
+    while ((e1 = readdir(d1)) != NULL) {
+        if (e1->d_name[0] == '.') continue;
+        if (is_native_name(e1->d_name)) {
+            closedir(d1);
+            return 1;
+        }
+        char entry[128];
+        SCOPY(entry, e1->d_name);
+
+        char sub[WOW_OS_PATH_MAX];
+        snprintf(sub, sizeof(sub), "%s/lib/%s", dir, entry);
+        struct stat st;
+        if (stat(sub, &st) != 0 || !S_ISDIR(st.st_mode)) continue;
+
+        DIR *d2 = opendir(sub);
+        if (!d2) continue;
+        struct dirent *e2;
+        while ((e2 = readdir(d2)) != NULL) {
+            if (is_native_name(e2->d_name)) {
+                closedir(d2);
+                closedir(d1);
+                return 1;
+            }
+        }
+        closedir(d2);
+    }
+    closedir(d1);
+    return 0;
+}
+
+/* ── Build from source ───────────────────────────────────────────── */
+
+/* Is env entry e the variable name? */
+static int env_is(const char *e, const char *name)
+{
+    size_t len = strlen(name);
+    return strncmp(e, name, len) == 0 && e[len] == '=';
+}
+
+/*
+ * Child environment for extconf.rb and make: the current environment
+ * with LD_LIBRARY_PATH, RUBYLIB and MAKEFLAGS replaced.
+ *
+ * Pre-built rubies have hardcoded load paths from the build machine,
+ * so we need LD_LIBRARY_PATH (for libruby.so) and RUBYLIB (for
+ * stdlib: mkmf, rubygems, etc.) — same fix as wow_exec_gem_binary().
+ * Built per call rather than with setenv() because builds run on
+ * several threads at once.  Returns a malloc'd array (free the array
+ * only; strings live in vars).
+ */
+struct build_env {
+    char ld[PATH_MAX * 2 + 16];
+    char rubylib[PATH_MAX * 2 + 8];
+    char makeflags[128];
+};
+
+static char **build_envp(struct build_env *vars, const char *ruby_bin,
+                         const char *ruby_api, const char *makeflags)
+{
+    char prefix[WOW_DIR_PATH_MAX];
+    ruby_prefix(ruby_bin, prefix, sizeof(prefix));
+
+    char api[16];
+    SCOPY(api, ruby_api);
+
+    const char *existing_ld = getenv("LD_LIBRARY_PATH");
+    if (existing_ld && existing_ld[0])
+        snprintf(vars->ld, sizeof(vars->ld), "LD_LIBRARY_PATH=%s/lib:%s",
+                 prefix, existing_ld);
+    else
+        snprintf(vars->ld, sizeof(vars->ld), "LD_LIBRARY_PATH=%s/lib",
+                 prefix);
+
+    /* RUBYLIB — stdlib + arch-specific dir (for mkmf, rbconfig, etc.) */
+    int n = snprintf(vars->rubylib, sizeof(vars->rubylib),
+                     "RUBYLIB=%s/lib/ruby/%s", prefix, api);
+    char arch[128];
+    if (n > 0 && (size_t)n < sizeof(vars->rubylib) &&
+        rbconfig_arch(prefix, api, arch, sizeof(arch)) == 0)
+        snprintf(vars->rubylib + n, sizeof(vars->rubylib) - (size_t)n,
+                 ":%s/lib/ruby/%s/%s", prefix, api, arch);
+
+    snprintf(vars->makeflags, sizeof(vars->makeflags), "MAKEFLAGS=%s",
+             makeflags);
+
+    size_t count = 0;
+    for (char **e = environ; *e; e++) count++;
+
+    char **envp = malloc((count + 4) * sizeof(char *));
+    if (!envp) return NULL;
+
+    size_t k = 0;
+    for (char **e = environ; *e; e++) {
+        if (env_is(*e, "LD_LIBRARY_PATH") || env_is(*e, "RUBYLIB") ||
+            env_is(*e, "MAKEFLAGS") || env_is(*e, "MFLAGS") ||
+            env_is(*e, "MAKELEVEL"))
+            continue;
+        envp[k++] = *e;
+    }
+    envp[k++] = vars->ld;
+    envp[k++] = vars->rubylib;
+    envp[k++] = vars->makeflags;
+    envp[k] = NULL;
+    return envp;
+}
+
+/* Copy a build log to stderr (after a failure) */
+static void dump_log(const char *log_path)
+{
+    static pthread_mutex_t mu = PTHREAD_MUTEX_INITIALIZER;
+    FILE *f = fopen(log_path, "r");
+    if (!f) return;
+    pthread_mutex_lock(&mu);
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        fwrite(buf, 1, n, stderr);
+    pthread_mutex_unlock(&mu);
+    fclose(f);
+}
+
+/*
+ * Build one extension: ruby extconf.rb && make && make install into
+ * <gem_dir>/lib.  ext_path is relative to gem_dir, e.g.
+ * "ext/prism/extconf.rb".  makeflags carries the jobserver.
+ */
+static int build_ext(const char *gem_dir, const char *ext_path,
+                     const char *ruby_bin, const char *ruby_api,
+                     const char *makeflags)
+{
+    /* Bounded copies so GCC can track sizes through compositions */
+    char gdir[WOW_DIR_PATH_MAX];
+    snprintf(gdir, sizeof(gdir), "%s", gem_dir);
+    char ext[128];
+    snprintf(ext, sizeof(ext), "%s", ext_path);
+
+    /* Extract the directory containing extconf.rb */
+    char ext_dir[WOW_OS_PATH_MAX];
+    snprintf(ext_dir, sizeof(ext_dir), "%s/%s", gdir, ext);
+    char *slash = strrchr(ext_dir, '/');
+    if (slash) *slash = '\0';
+
+    char extconf[WOW_OS_PATH_MAX];
+    snprintf(extconf, sizeof(extconf), "%s/%s", gdir, ext);
+    if (access(extconf, R_OK) != 0) {
+        fprintf(stderr, "wow: extension not found: %s\n", ext_path);
+        return -1;
+    }
+
+    char log_path[WOW_OS_PATH_MAX];
+    int n = snprintf(log_path, sizeof(log_path), "%s/" EXT_LOG_NAME, ext_dir);
+    if (n < 0 || (size_t)n >= sizeof(log_path)) return -1;
+    int log_fd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                      0644);
+    if (log_fd < 0) {
+        fprintf(stderr, "wow: cannot create %s: %s\n",
+                log_path, strerror(errno));
+        return -1;
+    }
+
+    struct build_env vars;
+    char **envp = build_envp(&vars, ruby_bin, ruby_api, makeflags);
+    if (!envp) {
+        fprintf(stderr, "wow: out of memory\n");
+        close(log_fd);
+        return -1;
+    }
+
+    if (wow_use_colour())
+        fprintf(stderr, WOW_ANSI_DIM "Building native extension: %s..."
+                WOW_ANSI_RESET "\n", ext_path);
+    else
+        fprintf(stderr, "Building native extension: %s...\n", ext_path);
+
+    /* make install into the gem's own lib/ directory.
+     * extconf.rb-generated Makefiles support sitearchdir/sitelibdir
+     * overrides to control where .so and .rb files land.
+     *
+     * NB: this duplicates .so files — the build artefact stays in ext/
+     * and the installed copy goes to lib/.  We can't skip the install
+     * step because the build layout doesn't match the require layout
+     * (e.g. ext/racc/cparse/cparse.so vs lib/racc/cparse.so).
+     * TODO: clean ext/ build artefacts after install to reclaim space. */
+    char sitearch[WOW_OS_PATH_MAX];
+    char sitelib[WOW_OS_PATH_MAX];
+    snprintf(sitearch, sizeof(sitearch), "sitearchdir=%s/lib", gdir);
+    snprintf(sitelib, sizeof(sitelib), "sitelibdir=%s/lib", gdir);
+
+    /* No -j: parallelism comes from the jobserver in MAKEFLAGS */
+    const char *extconf_argv[] = { ruby_bin, "extconf.rb", NULL };
+    const char *make_argv[] = { "/usr/bin/make", NULL };
+    const char *install_argv[] = {
+        "/usr/bin/make", "install", sitearch, sitelib, NULL
+    };
+    struct { const char *what; const char *const *argv; } steps[] = {
+        { "extconf.rb",   extconf_argv },
+        { "make",         make_argv },
+        { "make install", install_argv },
+    };
+
+    int ret = 0;
+    for (size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); i++) {
+        int rc = run_cmd(ext_dir, steps[i].argv, envp, log_fd);
+        if (rc != 0) {
+            dump_log(log_path);
+            fprintf(stderr, "wow: %s failed (exit %d) in %s\n",
+                    steps[i].what, rc, ext_dir);
+            ret = -1;
+            break;
+        }
+    }
+
+    free(envp);
+    close(log_fd);
+    return ret;
+}
+
+/* ── File tree helpers ───────────────────────────────────────────── */
+
+typedef int (*walk_fn)(const char *rel, const char *full, void *ctx);
+
+/*
+ * Call fn for every regular file below root/rel.  rel is "" at the top
+ * and carries a trailing slash below it.  Stops at the first non-zero
+ * return and propagates it.
+ */
+static int walk_files(const char *root, const char *rel, int depth,
+                      walk_fn fn, void *ctx)
+{
+    if (depth > EXT_MAX_DEPTH) return 0;
+
+    char dir_path[WOW_OS_PATH_MAX];
+    int n = snprintf(dir_path, sizeof(dir_path), "%s/%s", root, rel);
+    if (n < 0 || (size_t)n >= sizeof(dir_path)) return 0;
+
+    DIR *d = opendir(dir_path);
+    if (!d) return 0;
+
+    int rc = 0;
+    struct dirent *ent;
+    while (rc == 0 && (ent = readdir(d)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+            continue;
+
+        char child_rel[WOW_OS_PATH_MAX];
+        n = snprintf(child_rel, sizeof(child_rel), "%s%s", rel, ent->d_name);
+        if (n < 0 || (size_t)n >= sizeof(child_rel) - 1) continue;
+
+        char full[WOW_OS_PATH_MAX];
+        n = snprintf(full, sizeof(full), "%s/%s", root, child_rel);
+        if (n < 0 || (size_t)n >= sizeof(full)) continue;
+
+        struct stat st;
+        if (lstat(full, &st) != 0) continue;
+
+        if (S_ISDIR(st.st_mode)) {
+            size_t cl = strlen(child_rel);
+            child_rel[cl] = '/';
+            child_rel[cl + 1] = '\0';
+            rc = walk_files(root, child_rel, depth + 1, fn, ctx);
+        } else if (S_ISREG(st.st_mode)) {
+            rc = fn(child_rel, full, ctx);
+        }
+    }
+    closedir(d);
+    return rc;
+}
+
+/*
+ * Hard link src → dst when allow_link, falling back to a byte copy
+ * (cross-device).  Cache entries are always stored as copies so that a
+ * build rewriting its output in place can never alter the cache.
+ */
+static int link_or_copy(const char *src, const char *dst, int allow_link)
+{
+    unlink(dst);
+    if (allow_link && link(src, dst) == 0) return 0;
+
+    FILE *in = fopen(src, "rb");
+    if (!in) return -1;
+    FILE *out = fopen(dst, "wb");
+    if (!out) { fclose(in); return -1; }
+
+    char buf[16384];
+    size_t n;
+    int rc = 0;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        if (fwrite(buf, 1, n, out) != n) { rc = -1; break; }
+    }
+    if (ferror(in)) rc = -1;
+    fclose(in);
+    if (fclose(out) != 0) rc = -1;
+
+    /* Preserve the executable bit of shared objects */
+    struct stat st;
+    if (rc == 0 && stat(src, &st) == 0)
+        chmod(dst, st.st_mode & 07777);
+    if (rc != 0) unlink(dst);
+    return rc;
+}
+
+/* Create the parent directories of path */
+static int mkdirs_parent(const char *path)
+{
+    char parent[WOW_OS_PATH_MAX];
+    snprintf(parent, sizeof(parent), "%s", path);
+    char *sl = strrchr(parent, '/');
+    if (!sl) return 0;
+    *sl = '\0';
+    return wow_mkdirs(parent, 0755);
+}
+
+/* Place full at dest_root/rel, creating directories as needed */
+static int place_file(const char *full, const char *dest_root,
+                      const char *rel, int allow_link)
+{
+    char dst[WOW_OS_PATH_MAX];
+    int n = snprintf(dst, sizeof(dst), "%s/%s", dest_root, rel);
+    if (n < 0 || (size_t)n >= sizeof(dst)) return -1;
+    if (mkdirs_parent(dst) != 0) return -1;
+    return link_or_copy(full, dst, allow_link);
+}
+
+static int rmtree(const char *path)
+{
+    struct stat st;
+    if (lstat(path, &st) != 0) return 0;
+    if (!S_ISDIR(st.st_mode)) return unlink(path);
+
+    DIR *d = opendir(path);
+    if (!d) return -1;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+            continue;
+        char child[WOW_OS_PATH_MAX];
+        int n = snprintf(child, sizeof(child), "%s/%s", path, ent->d_name);
+        if (n > 0 && (size_t)n < sizeof(child))
+            rmtree(child);
+    }
+    closedir(d);
+    return rmdir(path);
+}
+
+/* ── lib/ snapshot (what did the build add?) ─────────────────────── */
+
+struct snapshot {
+    char **paths;
+    size_t n, cap;
+};
+
+static int snapshot_add(const char *rel, const char *full, void *ctx)
+{
+    (void)full;
+    struct snapshot *s = ctx;
+    if (s->n == s->cap) {
+        size_t cap = s->cap ? s->cap * 2 : 64;
+        char **p = realloc(s->paths, cap * sizeof(*p));
+        if (!p) return -1;
+        s->paths = p;
+        s->cap = cap;
+    }
+    s->paths[s->n] = strdup(rel);
+    if (!s->paths[s->n]) return -1;
+    s->n++;
+    return 0;
+}
+
+static int str_cmp(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static void snapshot_free(struct snapshot *s)
+{
+    for (size_t i = 0; i < s->n; i++) free(s->paths[i]);
+    free(s->paths);
+}
+
+struct store_ctx {
+    const struct snapshot *before;
+    const char *dest;
+    size_t n_stored;
+};
+
+static int store_new_file(const char *rel, const char *full, void *ctx)
+{
+    struct store_ctx *sc = ctx;
+    if (sc->before->n > 0 &&
+        bsearch(&rel, sc->before->paths, sc->before->n,
+                sizeof(char *), str_cmp))
+        return 0;
+    if (place_file(full, sc->dest, rel, 0) != 0) return -1;
+    sc->n_stored++;
+    return 0;
+}
+
+static int restore_file(const char *rel, const char *full, void *ctx)
+{
+    return place_file(full, (const char *)ctx, rel, 1);
+}
+
+/* ── Cache key ───────────────────────────────────────────────────── */
+
+static int ext_cache_key(const char *gem_path, const char *ruby_bin,
+                         const char *ruby_api, char *key, size_t key_sz)
+{
+    char gem_sha[65];
+    if (wow_sha256_file(gem_path, gem_sha, sizeof(gem_sha)) != 0)
+        return -1;
+
+    char prefix[WOW_DIR_PATH_MAX];
+    ruby_prefix(ruby_bin, prefix, sizeof(prefix));
+    char arch[128];
+    if (rbconfig_arch(prefix, ruby_api, arch, sizeof(arch)) != 0)
+        return -1;
+
+    wow_platform_t plat;
+    wow_detect_platform(&plat);
+
+    char material[512];
+    int n = snprintf(material, sizeof(material), "wow-ext\t1\n%s\n%s\n%s\n%s\n",
+                     gem_sha, ruby_api, arch, plat.wow_id);
+    if (n < 0 || (size_t)n >= sizeof(material)) return -1;
+
+    wow_sha256_ctx *h = wow_sha256_new();
+    if (!h) return -1;
+    wow_sha256_update(h, material, (size_t)n);
+    int rc = wow_sha256_final(h, key, key_sz);
+    wow_sha256_free(h);
+    return rc;
+}
+
+/* ── Cached install of one gem ───────────────────────────────────── */
+
+static int install_one(struct wow_ext_job *job, const char *ruby_bin,
+                       const char *ruby_api, const struct jobserver *js)
+{
+    const struct wow_gemspec *spec = &job->spec;
+
+    char lib_dir[WOW_OS_PATH_MAX];
+    snprintf(lib_dir, sizeof(lib_dir), "%s/lib", job->gem_dir);
+
+    /* Locate the cache entry; any failure here just disables caching */
+    char entry[WOW_OS_PATH_MAX] = "";
+    {
+        char cache[WOW_DIR_PATH_MAX];
+        char key[65];
+        char label[128];
+        snprintf(label, sizeof(label), "%s-%s", spec->name, spec->version);
+        if (wow_ext_cache_dir(cache, sizeof(cache)) == 0 &&
+            ext_cache_key(job->gem_path, ruby_bin, ruby_api,
+                          key, sizeof(key)) == 0)
+            snprintf(entry, sizeof(entry), "%s/%s/%s", cache, label, key);
+    }
+
+    /* Cache hit: link the built files into lib/, no compiler involved */
+    struct stat st;
+    if (entry[0] && stat(entry, &st) == 0 && S_ISDIR(st.st_mode)) {
+        if (walk_files(entry, "", 0, restore_file, lib_dir) == 0) {
+            job->cached = 1;
+            return 0;
+        }
+        fprintf(stderr, "wow: warning: cannot restore cached build of "
+                "%s-%s, rebuilding\n", spec->name, spec->version);
+    }
+
+    /* Remember what lib/ held before the build */
+    struct snapshot before = { 0 };
+    if (entry[0] && walk_files(lib_dir, "", 0, snapshot_add, &before) != 0) {
+        snapshot_free(&before);
+        before = (struct snapshot){ 0 };
+        entry[0] = '\0';
+    }
+    if (before.n > 1)
+        qsort(before.paths, before.n, sizeof(char *), str_cmp);
+
+    /* This token is make's implicit job slot */
+    token_acquire(js);
+    int ret = 0;
+    for (size_t e = 0; e < spec->n_extensions; e++) {
+        double t0 = wow_now_secs();
+        if (build_ext(job->gem_dir, spec->extensions[e], ruby_bin,
+                      ruby_api, js->makeflags) != 0) {
+            fprintf(stderr, "wow: native extension build failed for "
+                    "%s-%s (%s)\n", spec->name, spec->version,
+                    spec->extensions[e]);
+            ret = -1;
+            break;
+        }
+        job->ext_secs[e] = wow_now_secs() - t0;
+    }
+    token_release(js);
+
+    /* Store the new files: build into a private tmp dir, then rename */
+    if (ret == 0 && entry[0]) {
+        char tmp[WOW_OS_PATH_MAX];
+        int n = snprintf(tmp, sizeof(tmp), "%s.tmp.%d", entry, (int)getpid());
+        if (n > 0 && (size_t)n < sizeof(tmp) && wow_mkdirs(tmp, 0755) == 0) {
+            struct store_ctx sc = { &before, tmp, 0 };
+            if (walk_files(lib_dir, "", 0, store_new_file, &sc) != 0 ||
+                rename(tmp, entry) != 0)
+                rmtree(tmp);   /* lost a race or out of space: harmless */
+        }
+    }
+
+    snapshot_free(&before);
+    return ret;
+}
+
+/* ── Plan ────────────────────────────────────────────────────────── */
+
+int wow_ext_plan_add(struct wow_ext_plan *p, const char *gem_path,
+                     const char *gem_dir, struct wow_gemspec *spec)
+{
+    if (p->n == p->cap) {
+        size_t cap = p->cap ? p->cap * 2 : 8;
+        struct wow_ext_job *jobs = realloc(p->jobs, cap * sizeof(*jobs));
+        if (!jobs) goto oom;
+        p->jobs = jobs;
+        p->cap = cap;
+    }
+
+    struct wow_ext_job *job = &p->jobs[p->n];
+    memset(job, 0, sizeof(*job));
+    job->gem_path = strdup(gem_path);
+    job->gem_dir = strdup(gem_dir);
+    job->ext_secs = calloc(spec->n_extensions ? spec->n_extensions : 1,
+                           sizeof(double));
+    if (!job->gem_path || !job->gem_dir || !job->ext_secs) {
+        free(job->gem_path); free(job->gem_dir); free(job->ext_secs);
+        goto oom;
+    }
+    job->spec = *spec;
+    memset(spec, 0, sizeof(*spec));
+    p->n++;
+    return 0;
+
+oom:
+    fprintf(stderr, "wow: out of memory\n");
+    wow_gemspec_free(spec);
+    return -1;
+}
+
+void wow_ext_plan_free(struct wow_ext_plan *p)
+{
+    for (size_t i = 0; i < p->n; i++) {
+        free(p->jobs[i].gem_path);
+        free(p->jobs[i].gem_dir);
+        free(p->jobs[i].ext_secs);
+        wow_gemspec_free(&p->jobs[i].spec);
+    }
+    free(p->jobs);
+    memset(p, 0, sizeof(*p));
+}
+
+enum { JOB_PENDING, JOB_RUNNING, JOB_DONE };
+
+typedef struct {
+    struct wow_ext_plan    *plan;
+    int                    *state;      /* JOB_* per job */
+    const char             *ruby_bin;
+    const char             *ruby_api;
+    const struct jobserver *js;
+    pthread_mutex_t         mu;
+    pthread_cond_t          cv;
+} ext_queue_t;
+
+/* Job i waits for job j when j is one of its (direct) dependencies */
+static int job_waits_on(const struct wow_ext_job *a,
+                        const struct wow_ext_job *b)
+{
+    for (size_t d = 0; d < a->spec.n_deps; d++)
+        if (strcmp(a->spec.deps[d].name, b->spec.name) == 0)
+            return 1;
+    return 0;
+}
+
+/*
+ * Pick the next runnable job under q->mu.  Returns its index, or -1
+ * when nothing is left.  Blocks while every pending job is waiting on
+ * a running one.  A job whose dependency failed is marked failed
+ * without being built.
+ */
+static int queue_next(ext_queue_t *q)
+{
+    struct wow_ext_plan *p = q->plan;
+    for (;;) {
+        int pending = 0, running = 0;
+        for (size_t i = 0; i < p->n; i++) {
+            if (q->state[i] == JOB_RUNNING) running++;
+            if (q->state[i] != JOB_PENDING) continue;
+            pending++;
+
+            int blocked = 0, dep_failed = 0;
+            for (size_t j = 0; j < p->n; j++) {
+                if (j == i || !job_waits_on(&p->jobs[i], &p->jobs[j]))
+                    continue;
+                if (q->state[j] != JOB_DONE) blocked = 1;
+                else if (p->jobs[j].rc != 0) dep_failed = 1;
+            }
+            if (dep_failed && !blocked) {
+                p->jobs[i].rc = -1;
+                q->state[i] = JOB_DONE;
+                pthread_cond_broadcast(&q->cv);
+                return queue_next(q);
+            }
+            if (!blocked) {
+                q->state[i] = JOB_RUNNING;
+                return (int)i;
+            }
+        }
+        if (pending == 0) return -1;
+
+        /* Dependency cycle among extension gems: break it in order */
+        if (running == 0) {
+            for (size_t i = 0; i < p->n; i++) {
+                if (q->state[i] == JOB_PENDING) {
+                    q->state[i] = JOB_RUNNING;
+                    return (int)i;
+                }
+            }
+        }
+        pthread_cond_wait(&q->cv, &q->mu);
+    }
+}
+
+static void *ext_worker(void *arg)
+{
+    ext_queue_t *q = arg;
+    wow_trace_thread_name("ext-build");
+    pthread_mutex_lock(&q->mu);
+    for (;;) {
+        int i = queue_next(q);
+        if (i < 0) break;
+        pthread_mutex_unlock(&q->mu);
+
+        struct wow_ext_job *job = &q->plan->jobs[i];
+        double t0 = wow_now_secs();
+        uint64_t tt = wow_trace_begin();
+        int rc = install_one(job, q->ruby_bin, q->ruby_api, q->js);
+        if (wow_trace_on) {
+            char what[160];
+            snprintf(what, sizeof(what), "%s-%s",
+                     job->spec.name, job->spec.version);
+            wow_trace_end(tt, "ext", job->cached ? "restore" : "build",
+                          what);
+        }
+
+        pthread_mutex_lock(&q->mu);
+        job->rc = rc;
+        job->secs = wow_now_secs() - t0;
+        q->state[i] = JOB_DONE;
+        pthread_cond_broadcast(&q->cv);
+    }
+    pthread_mutex_unlock(&q->mu);
+    return NULL;
+}
+
+int wow_ext_plan_run(struct wow_ext_plan *p, const char *ruby_bin,
+                     const char *ruby_api)
+{
+    if (p->n == 0) return 0;
+
+    double t0 = wow_now_secs();
+
+    struct jobserver js;
+    int slots = cpu_count();
+    if (jobserver_open(&js, slots) != 0) {
+        fprintf(stderr, "wow: cannot create make jobserver: %s\n",
+                strerror(errno));
+        return -1;
+    }
+
+    ext_queue_t q = {
+        .plan     = p,
+        .state    = calloc(p->n, sizeof(int)),
+        .ruby_bin = ruby_bin,
+        .ruby_api = ruby_api,
+        .js       = &js,
+    };
+    int n_workers = (int)p->n < slots ? (int)p->n : slots;
+    pthread_t *threads = calloc((size_t)n_workers, sizeof(pthread_t));
+    if (!q.state || !threads) {
+        fprintf(stderr, "wow: out of memory\n");
+        free(q.state);
+        free(threads);
+        jobserver_close(&js);
+        return -1;
+    }
+    pthread_mutex_init(&q.mu, NULL);
+    pthread_cond_init(&q.cv, NULL);
+
+    /* A failed pthread_create just means fewer workers; the calling
+     * thread drains whatever is left. */
+    int started = 0;
+    for (int i = 0; i < n_workers; i++) {
+        if (pthread_create(&threads[started], NULL, ext_worker, &q) == 0)
+            started++;
+    }
+    if (started == 0)
+        ext_worker(&q);
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    pthread_cond_destroy(&q.cv);
+    pthread_mutex_destroy(&q.mu);
+    free(threads);
+    free(q.state);
+    jobserver_close(&js);
+
+    p->secs = wow_now_secs() - t0;
+
+    for (size_t i = 0; i < p->n; i++)
+        if (p->jobs[i].rc != 0) return -1;
+    return 0;
+}
+
+/* ── Summary ─────────────────────────────────────────────────────── */
+
+static void fmt_secs(double secs, char *buf, size_t bufsz)
+{
+    if (secs < 1.0)
+        snprintf(buf, bufsz, "%.0fms", secs * 1000.0);
+    else
+        snprintf(buf, bufsz, "%.2fs", secs);
+}
+
+void wow_ext_plan_report(const struct wow_ext_plan *p)
+{
+    if (p->n == 0) return;
+
+    int colour = wow_use_colour();
+    size_t n_built = 0, n_cached = 0, n_failed = 0;
+    for (size_t i = 0; i < p->n; i++) {
+        size_t n_ext = p->jobs[i].spec.n_extensions;
+        if (p->jobs[i].rc != 0)
+            n_failed += n_ext;
+        else if (p->jobs[i].cached)
+            n_cached += n_ext;
+        else
+            n_built += n_ext;
+    }
+
+    /* "Built 3 native extensions, restored 12 from cache, 1 failed" */
+    char head[128];
+    size_t off = 0;
+    if (n_built > 0 || (n_cached == 0 && n_failed == 0))
+        off += (size_t)snprintf(head + off, sizeof(head) - off,
+                                "Built %zu native extensions", n_built);
+    if (n_cached > 0)
+        off += (size_t)snprintf(head + off, sizeof(head) - off,
+                                off ? ", restored %zu from cache"
+                                    : "Restored %zu native extensions "
+                                      "from cache", n_cached);
+    if (n_failed > 0)
+        snprintf(head + off, sizeof(head) - off,
+                 off ? ", %zu failed" : "%zu native extensions failed",
+                 n_failed);
+
+    char total[32];
+    fmt_secs(p->secs, total, sizeof(total));
+    if (colour)
+        fprintf(stderr, "%s" WOW_ANSI_BOLD "%s" WOW_ANSI_RESET " in "
+                WOW_ANSI_DIM "%s" WOW_ANSI_RESET "\n",
+                n_failed ? WOW_ANSI_RED : WOW_ANSI_GREEN, head, total);
+    else
+        fprintf(stderr, "%s in %s\n", head, total);
+
+    for (size_t i = 0; i < p->n; i++) {
+        const struct wow_ext_job *job = &p->jobs[i];
+        for (size_t e = 0; e < job->spec.n_extensions; e++) {
+            char t[32];
+            if (job->rc != 0)
+                snprintf(t, sizeof(t), "failed");
+            else if (job->cached)
+                snprintf(t, sizeof(t), "cached");
+            else
+                fmt_secs(job->ext_secs[e], t, sizeof(t));
+
+            if (colour)
+                fprintf(stderr, " " WOW_ANSI_BOLD "%s" WOW_ANSI_RESET
+                        " (%s) %s " WOW_ANSI_DIM "%s" WOW_ANSI_RESET "\n",
+                        job->spec.name, job->spec.version,
+                        job->spec.extensions[e], t);
+            else
+                fprintf(stderr, " %s (%s) %s %s\n",
+                        job->spec.name, job->spec.version,
+                        job->spec.extensions[e], t);
+        }
+    }
+}
@@ -0,0 +1,441 @@
+/*
+ * gems/installed.c — Install-state manifest (.wow-installed)
+ *
+ * See installed.h for the format.  Loading is one read of the log,
+ * replayed into an array; the gems/ directory is stat()ed once to decide
+ * whether the last compaction still describes it.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "wow/common.h"
+#include "wow/gems/installed.h"
+#include "wow/util/trace.h"
+
+#define INSTALLED_NAME   ".wow-installed"
+#define INSTALLED_MAGIC  "wow-installed\t2\n"
+#define PRUNE_MAX_JOBS   16
+
+/* ── Helpers ─────────────────────────────────────────────────────── */
+
+static int cpu_count(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+static int manifest_path(const struct wow_installed *m, const char *suffix,
+                         char *buf, size_t bufsz)
+{
+    int n = snprintf(buf, bufsz, "%s/" INSTALLED_NAME "%s",
+                     m->env_dir, suffix);
+    return (n < 0 || (size_t)n >= bufsz) ? -1 : 0;
+}
+
+/* "<sec>.<nsec>" of gems/, or "" if it cannot be stat()ed */
+static void gems_mtime(const char *env_dir, char *buf, size_t bufsz)
+{
+    char gems[WOW_OS_PATH_MAX];
+    struct stat st;
+    buf[0] = '\0';
+    snprintf(gems, sizeof(gems), "%s/gems", env_dir);
+    if (stat(gems, &st) == 0)
+        snprintf(buf, bufsz, "%" PRId64 ".%09ld",
+                 (int64_t)st.st_mtim.tv_sec, (long)st.st_mtim.tv_nsec);
+}
+
+static ptrdiff_t find_index(const struct wow_installed *m, const char *entry)
+{
+    for (size_t i = 0; i < m->n; i++)
+        if (strcmp(m->gems[i].entry, entry) == 0) return (ptrdiff_t)i;
+    return -1;
+}
+
+static void gem_free(struct wow_installed_gem *g)
+{
+    free(g->entry);
+    free(g->name);
+    free(g->version);
+    free(g->platform);
+}
+
+/* Insert or replace in memory only */
+static int put(struct wow_installed *m, const char *entry, const char *name,
+               const char *version, const char *platform, const char *sha256,
+               const char *mode)
+{
+    struct wow_installed_gem g = { 0 };
+    g.entry = strdup(entry);
+    g.name = strdup(name);
+    g.version = strdup(version);
+    g.platform = strdup(platform && platform[0] ? platform : "ruby");
+    if (!g.entry || !g.name || !g.version || !g.platform) {
+        gem_free(&g);
+        return -1;
+    }
+    snprintf(g.sha256, sizeof(g.sha256), "%s",
+             sha256 && sha256[0] ? sha256 : "-");
+    snprintf(g.mode, sizeof(g.mode), "%s", mode);
+
+    ptrdiff_t i = find_index(m, entry);
+    if (i >= 0) {
+        gem_free(&m->gems[i]);
+        m->gems[i] = g;
+        return 0;
+    }
+    if (m->n == m->cap) {
+        size_t cap = m->cap ? m->cap * 2 : 64;
+        struct wow_installed_gem *p = realloc(m->gems, cap * sizeof(*p));
+        if (!p) {
+            gem_free(&g);
+            return -1;
+        }
+        m->gems = p;
+        m->cap = cap;
+    }
+    m->gems[m->n++] = g;
+    return 0;
+}
+
+static void drop(struct wow_installed *m, const char *entry)
+{
+    ptrdiff_t i = find_index(m, entry);
+    if (i < 0) return;
+    gem_free(&m->gems[i]);
+    m->gems[i] = m->gems[--m->n];
+}
+
+/* Split line (NUL-terminated, no '\n') on TABs; returns field count */
+static int split_tabs(char *line, char **f, int max)
+{
+    int n = 0;
+    while (n < max) {
+        f[n++] = line;
+        char *tab = strchr(line, '\t');
+        if (!tab) break;
+        *tab = '\0';
+        line = tab + 1;
+    }
+    return n;
+}
+
+/* Append one complete line to the log with a single write() */
+static int append(struct wow_installed *m, const char *line, size_t len)
+{
+    if (m->fd < 0) {
+        char path[WOW_OS_PATH_MAX];
+        if (manifest_path(m, "", path, sizeof(path)) != 0) return -1;
+        int fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) return -1;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size == 0 &&
+            write(fd, INSTALLED_MAGIC, strlen(INSTALLED_MAGIC)) < 0) {
+            close(fd);
+            return -1;
+        }
+        m->fd = fd;
+    }
+    m->fresh = 0;
+    return write(m->fd, line, len) == (ssize_t)len ? 0 : -1;
+}
+
+/* ── Load ────────────────────────────────────────────────────────── */
+
+int wow_installed_load(struct wow_installed *m, const char *env_dir)
+{
+    memset(m, 0, sizeof(*m));
+    m->fd = -1;
+    snprintf(m->env_dir, sizeof(m->env_dir), "%s", env_dir);
+
+    char path[WOW_OS_PATH_MAX];
+    if (manifest_path(m, "", path, sizeof(path)) != 0) return 0;
+    FILE *f = fopen(path, "rb");
+    if (!f) return 0;
+
+    uint64_t t0 = wow_trace_begin();
+    struct stat st;
+    char *buf = NULL;
+    if (fstat(fileno(f), &st) == 0 && st.st_size > 0)
+        buf = malloc((size_t)st.st_size + 1);
+    size_t len = buf ? fread(buf, 1, (size_t)st.st_size, f) : 0;
+    fclose(f);
+    if (!buf) return 0;
+    buf[len] = '\0';
+
+    size_t ml = strlen(INSTALLED_MAGIC);
+    if (len < ml || memcmp(buf, INSTALLED_MAGIC, ml) != 0) {
+        free(buf);
+        return 0;
+    }
+    m->exists = 1;
+
+    /* Replay; only newline-terminated lines count */
+    char stamp[64] = "";
+    int stamp_last = 0, rc = 0;
+    char *p = buf + ml;
+    char *nl;
+    while (rc == 0 && (nl = strchr(p, '\n')) != NULL) {
+        *nl = '\0';
+        char *fld[7];
+        int nf = split_tabs(p, fld, 7);
+        stamp_last = 0;
+        if (nf == 7 && strcmp(fld[0], "+") == 0) {
+            rc = put(m, fld[1], fld[2], fld[3], fld[4], fld[5], fld[6]);
+        } else if (nf == 2 && strcmp(fld[0], "-") == 0) {
+            drop(m, fld[1]);
+        } else if (nf == 2 && strcmp(fld[0], "gems-mtime") == 0) {
+            snprintf(stamp, sizeof(stamp), "%s", fld[1]);
+            stamp_last = 1;
+        }
+        p = nl + 1;
+    }
+    free(buf);
+    if (rc != 0) {
+        fprintf(stderr, "wow: out of memory\n");
+        return -1;
+    }
+
+    /* Trust the records without probing gems/ only if nothing was
+     * appended after the last compaction and gems/ is as it was then */
+    if (stamp_last) {
+        char now[64];
+        gems_mtime(env_dir, now, sizeof(now));
+        m->fresh = now[0] && strcmp(now, stamp) == 0;
+    }
+    wow_trace_end(t0, "install", "manifest-load", path);
+    return 0;
+}
+
+const struct wow_installed_gem *
+wow_installed_find(const struct wow_installed *m, const char *entry)
+{
+    ptrdiff_t i = find_index(m, entry);
+    return i >= 0 ? &m->gems[i] : NULL;
+}
+
+const struct wow_installed_gem *
+wow_installed_find_complete(const struct wow_installed *m, const char *entry,
+                            const char *platform)
+{
+    const struct wow_installed_gem *g = wow_installed_find(m, entry);
+    if (!g || strcmp(g->mode, "ext-pending") == 0 ||
+        strcmp(g->platform, platform ? platform : "ruby") != 0)
+        return NULL;
+    return g;
+}
+
+/* ── Update ──────────────────────────────────────────────────────── */
+
+int wow_installed_add(struct wow_installed *m, const char *entry,
+                      const char *name, const char *version,
+                      const char *platform, const char *sha256,
+                      const char *mode)
+{
+    if (put(m, entry, name, version, platform, sha256, mode) != 0)
+        return -1;
+    const struct wow_installed_gem *g = wow_installed_find(m, entry);
+    char line[1024];
+    int n = snprintf(line, sizeof(line), "+\t%s\t%s\t%s\t%s\t%s\t%s\n",
+                     g->entry, g->name, g->version, g->platform, g->sha256,
+                     g->mode);
+    if (n < 0 || (size_t)n >= sizeof(line)) return -1;
+    return append(m, line, (size_t)n);
+}
+
+int wow_installed_remove(struct wow_installed *m, const char *entry)
+{
+    drop(m, entry);
+    char line[512];
+    int n = snprintf(line, sizeof(line), "-\t%s\n", entry);
+    if (n < 0 || (size_t)n >= sizeof(line)) return -1;
+    return append(m, line, (size_t)n);
+}
+
+int wow_installed_commit(struct wow_installed *m)
+{
+    char path[WOW_OS_PATH_MAX], tmp[WOW_OS_PATH_MAX];
+    if (manifest_path(m, "", path, sizeof(path)) != 0 ||
+        manifest_path(m, ".tmp", tmp, sizeof(tmp)) != 0)
+        return -1;
+
+    FILE *f = fopen(tmp, "w");
+    if (!f) {
+        fprintf(stderr, "wow: cannot write %s: %s\n", tmp, strerror(errno));
+        return -1;
+    }
+    fputs(INSTALLED_MAGIC, f);
+    for (size_t i = 0; i < m->n; i++) {
+        const struct wow_installed_gem *g = &m->gems[i];
+        fprintf(f, "+\t%s\t%s\t%s\t%s\t%s\t%s\n",
+                g->entry, g->name, g->version, g->platform, g->sha256,
+                g->mode);
+    }
+    char stamp[64];
+    gems_mtime(m->env_dir, stamp, sizeof(stamp));
+    if (stamp[0]) fprintf(f, "gems-mtime\t%s\n", stamp);
+
+    int werr = ferror(f);
+    if (fclose(f) != 0) werr = 1;
+    if (werr || rename(tmp, path) != 0) {
+        fprintf(stderr, "wow: cannot write %s: %s\n", path, strerror(errno));
+        unlink(tmp);
+        return -1;
+    }
+
+    /* Later appends go to the new file */
+    if (m->fd >= 0) {
+        close(m->fd);
+        m->fd = -1;
+    }
+    m->exists = 1;
+    m->fresh = stamp[0] != '\0';
+    return 0;
+}
+
+void wow_installed_free(struct wow_installed *m)
+{
+    for (size_t i = 0; i < m->n; i++) gem_free(&m->gems[i]);
+    free(m->gems);
+    if (m->fd >= 0) close(m->fd);
+    memset(m, 0, sizeof(*m));
+    m->fd = -1;
+}
+
+/* ── Stale set ───────────────────────────────────────────────────── */
+
+static int entry_cmp(const void *a, const void *b)
+{
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static int add_stale(char ***stale, int *n, int *cap, const char *entry)
+{
+    if (*n == *cap) {
+        int c = *cap ? *cap * 2 : 16;
+        char **p = realloc(*stale, (size_t)c * sizeof(char *));
+        if (!p) return -1;
+        *stale = p;
+        *cap = c;
+    }
+    if (!((*stale)[*n] = strdup(entry))) return -1;
+    (*n)++;
+    return 0;
+}
+
+int wow_installed_stale(const struct wow_installed *m,
+                        const char *const *solved, int n_solved,
+                        char ***stale, int *n_stale)
+{
+    const char **sorted = malloc(((size_t)n_solved + 1) * sizeof(char *));
+    if (!sorted) {
+        fprintf(stderr, "wow: out of memory\n");
+        return -1;
+    }
+    for (int i = 0; i < n_solved; i++) sorted[i] = solved[i];
+    qsort(sorted, (size_t)n_solved, sizeof(char *), entry_cmp);
+
+    int cap = 0, rc = 0;
+    for (size_t i = 0; rc == 0 && i < m->n; i++) {
+        const char *e = m->gems[i].entry;
+        if (!bsearch(&e, sorted, (size_t)n_solved, sizeof(char *),
+                     entry_cmp))
+            rc = add_stale(stale, n_stale, &cap, e);
+    }
+
+    DIR *d = NULL;
+    if (rc == 0 && !m->fresh) {
+        char gems[WOW_OS_PATH_MAX];
+        snprintf(gems, sizeof(gems), "%s/gems", m->env_dir);
+        d = opendir(gems);
+    }
+    struct dirent *de;
+    while (rc == 0 && d && (de = readdir(d)) != NULL) {
+        const char *e = de->d_name;
+        if (e[0] == '.' || wow_installed_find(m, e) ||
+            bsearch(&e, sorted, (size_t)n_solved, sizeof(char *),
+                    entry_cmp))
+            continue;
+        rc = add_stale(stale, n_stale, &cap, e);
+    }
+    if (d) closedir(d);
+    free(sorted);
+    if (rc != 0) fprintf(stderr, "wow: out of memory\n");
+    return rc;
+}
+
+/* ── Prune ───────────────────────────────────────────────────────── */
+
+static int rmtree(const char *path)
+{
+    struct stat st;
+    if (lstat(path, &st) != 0) return errno == ENOENT ? 0 : -1;
+    if (!S_ISDIR(st.st_mode)) return unlink(path);
+
+    DIR *d = opendir(path);
+    if (!d) return -1;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+            continue;
+        char child[WOW_OS_PATH_MAX];
+        int n = snprintf(child, sizeof(child), "%s/%s", path, ent->d_name);
+        if (n > 0 && (size_t)n < sizeof(child))
+            rmtree(child);
+    }
+    closedir(d);
+    return rmdir(path);
+}
+
+struct prune_queue {
+    const char  *env_dir;
+    char *const *entries;
+    int          n;
+    int          next;
+    int          failed;
+};
+
+static void *prune_worker(void *arg)
+{
+    struct prune_queue *q = arg;
+    int i;
+    while ((i = __atomic_fetch_add(&q->next, 1, __ATOMIC_RELAXED)) < q->n) {
+        char dir[WOW_OS_PATH_MAX];
+        int n = snprintf(dir, sizeof(dir), "%s/gems/%s",
+                         q->env_dir, q->entries[i]);
+        if (n < 0 || (size_t)n >= sizeof(dir) || rmtree(dir) != 0)
+            __atomic_fetch_add(&q->failed, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+int wow_installed_prune(const char *env_dir, char *const *entries, int n)
+{
+    if (n <= 0) return 0;
+    struct prune_queue q = { env_dir, entries, n, 0, 0 };
+
+    int jobs = cpu_count();
+    if (jobs > PRUNE_MAX_JOBS) jobs = PRUNE_MAX_JOBS;
+    if (jobs > n) jobs = n;
+
+    /* A failed pthread_create just means fewer workers; the calling
+     * thread drains whatever is left. */
+    pthread_t threads[PRUNE_MAX_JOBS];
+    int started = 0;
+    for (int i = 1; i < jobs; i++) {
+        if (pthread_create(&threads[started], NULL, prune_worker, &q) == 0)
+            started++;
+    }
+    prune_worker(&q);
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    return q.failed;
+}
@@ -14,6 +14,7 @@
 
 #include <yaml.h>
 
+#include "wow/common.h"
 #include "wow/gems/meta.h"
 #include "wow/tar.h"
 #include "wow/util/gunzip.h"
@@ -436,3 +437,37 @@ void wow_gemspec_free(struct wow_gemspec *spec)
     free(spec->extensions);
     memset(spec, 0, sizeof(*spec));
 }
+
+/* ── Marker files for the exec layer ─────────────────────────────── */
+
+static int write_lines(const char *gem_dir, const char *marker,
+                       char **lines, size_t n)
+{
+    if (n == 0) return 0;
+
+    char path[WOW_OS_PATH_MAX];
+    int len = snprintf(path, sizeof(path), "%s/%s", gem_dir, marker);
+    if (len < 0 || (size_t)len >= sizeof(path)) return -1;
+
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "wow: cannot write %s\n", path);
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++)
+        fprintf(f, "%s\n", lines[i]);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+int wow_gemspec_write_markers(const struct wow_gemspec *spec,
+                              const char *gem_dir)
+{
+    int rc = 0;
+    if (write_lines(gem_dir, ".require_paths", spec->require_paths,
+                    spec->n_require_paths) != 0)
+        rc = -1;
+    if (write_lines(gem_dir, ".executables", spec->executables,
+                    spec->n_executables) != 0)
+        rc = -1;
+    return rc;
+}
@@ -23,8 +23,9 @@
 #include "wow/gems/unpack.h"
 #include "wow/internal/util.h"
 #include "wow/tar.h"
+#include "wow/util/trace.h"
 
-int wow_gem_unpack_q(const char *gem_path, const char *dest_dir, int quiet)
+static int unpack(const char *gem_path, const char *dest_dir, int quiet)
 {
     int ret = -1;
     int fd = -1;
@@ -90,6 +91,14 @@ cleanup:
     return ret;
 }
 
+int wow_gem_unpack_q(const char *gem_path, const char *dest_dir, int quiet)
+{
+    uint64_t t0 = wow_trace_begin();
+    int rc = unpack(gem_path, dest_dir, quiet);
+    wow_trace_end(t0, "gems", "unpack", gem_path);
+    return rc;
+}
+
 int wow_gem_unpack(const char *gem_path, const char *dest_dir)
 {
     return wow_gem_unpack_q(gem_path, dest_dir, 0);
@@ -0,0 +1,388 @@
+/*
+ * gems/verify.c — check cached .gem files against their own checksums
+ *
+ * Two passes over the cache:
+ *   1. Index each .gem (tar headers only) and read checksums.yaml.gz,
+ *      turning every listed member into a (path, offset, length) job
+ *   2. Hash all jobs together with wow_sha256_files(), so a cache of
+ *      thousands of gems keeps every core (or the disc) busy
+ *
+ * Nothing is extracted; the members are hashed where they sit.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "wow/common.h"
+#include "wow/gems/download.h"
+#include "wow/gems/verify.h"
+#include "wow/internal/util.h"
+#include "wow/tar.h"
+#include "wow/util/gunzip.h"
+#include "wow/util/sha256.h"
+
+#define MAX_MEMBERS    16
+#define MAX_SUMS       8
+#define CHECKSUMS_MAX  (64 * 1024)
+
+enum { GEM_OK, GEM_UNCHECKED, GEM_CORRUPT };
+
+struct gem_check {
+    char *path;
+    int   status;
+    char  why[128];
+    int   first_job;
+    int   n_jobs;
+};
+
+struct expected_sum {
+    char name[64];
+    char hex[65];
+};
+
+/* Hash jobs for every gem, with the digest each one should produce */
+struct job_list {
+    struct wow_sha256_job *v;
+    struct expected_sum   *want;
+    int                    n, cap;
+};
+
+/* ── checksums.yaml ──────────────────────────────────────────────── */
+
+static char *trim(char *s)
+{
+    while (*s == ' ' || *s == '\t') s++;
+    char *e = s + strlen(s);
+    while (e > s && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\r')) e--;
+    *e = '\0';
+    if (e - s >= 2 && (*s == '"' || *s == '\'') && e[-1] == *s) {
+        e[-1] = '\0';
+        s++;
+    }
+    return s;
+}
+
+static int is_sha256_hex(const char *s)
+{
+    for (int i = 0; i < 64; i++) {
+        char c = s[i];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+            return 0;
+    }
+    return s[64] == '\0';
+}
+
+/*
+ * Pull "member: hex" pairs out of the SHA256: mapping.  RubyGems writes
+ * a flat two-level document, so a line scanner is enough.
+ * Returns the number of sums found.
+ */
+static int parse_sums(char *yaml, struct expected_sum *out, int max)
+{
+    int n = 0, in_sha256 = 0;
+    char *save = NULL;
+    for (char *line = strtok_r(yaml, "\n", &save); line;
+         line = strtok_r(NULL, "\n", &save)) {
+        int indented = (line[0] == ' ' || line[0] == '\t');
+        if (!indented) {
+            in_sha256 = strcmp(trim(line), "SHA256:") == 0;
+            continue;
+        }
+        if (!in_sha256 || n >= max) continue;
+
+        char *colon = strstr(line, ": ");
+        if (!colon) continue;
+        *colon = '\0';
+        char *key = trim(line);
+        char *val = trim(colon + 2);
+        if (!is_sha256_hex(val) || strlen(key) >= sizeof(out[n].name))
+            continue;
+        snprintf(out[n].name, sizeof(out[n].name), "%s", key);
+        memcpy(out[n].hex, val, 65);
+        n++;
+    }
+    return n;
+}
+
+/* Read and inflate checksums.yaml.gz.  Returns malloc'd text or NULL. */
+static char *read_checksums(const char *path, const struct wow_tar_member *m)
+{
+    if (m->size == 0 || m->size > CHECKSUMS_MAX) return NULL;
+    uint8_t *gz = malloc(m->size);
+    if (!gz) return NULL;
+
+    char *text = NULL;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        if (pread(fd, gz, m->size, (off_t)m->offset) == (ssize_t)m->size) {
+            uint8_t *raw;
+            size_t len;
+            if (wow_gunzip(gz, m->size, &raw, &len, CHECKSUMS_MAX) == 0) {
+                text = malloc(len + 1);
+                if (text) {
+                    memcpy(text, raw, len);
+                    text[len] = '\0';
+                }
+                free(raw);
+            }
+        }
+        close(fd);
+    }
+    free(gz);
+    return text;
+}
+
+/* ── Pass 1: index ───────────────────────────────────────────────── */
+
+static int add_job(struct job_list *js, const char *path,
+                   const struct wow_tar_member *m,
+                   const struct expected_sum *sum)
+{
+    if (js->n == js->cap) {
+        int cap = js->cap ? js->cap * 2 : 256;
+        struct wow_sha256_job *v = realloc(js->v, (size_t)cap * sizeof(*v));
+        if (!v) return -1;
+        js->v = v;
+        struct expected_sum *w = realloc(js->want, (size_t)cap * sizeof(*w));
+        if (!w) return -1;
+        js->want = w;
+        js->cap = cap;
+    }
+    struct wow_sha256_job *j = &js->v[js->n];
+    memset(j, 0, sizeof(*j));
+    j->path = path;
+    j->offset = m->offset;
+    j->length = (int64_t)m->size;
+    js->want[js->n] = *sum;
+    js->n++;
+    return 0;
+}
+
+static const struct wow_tar_member *
+find_member(const struct wow_tar_member *v, int n, const char *name)
+{
+    for (int i = 0; i < n; i++)
+        if (v[i].typeflag == '0' && strcmp(v[i].name, name) == 0)
+            return &v[i];
+    return NULL;
+}
+
+static int index_gem(struct gem_check *g, struct job_list *js)
+{
+    struct wow_tar_member mem[MAX_MEMBERS];
+    int n = wow_tar_index(g->path, mem, MAX_MEMBERS);
+    g->first_job = js->n;
+    g->n_jobs = 0;
+
+    if (n < 0) {
+        g->status = GEM_CORRUPT;
+        snprintf(g->why, sizeof(g->why), "not a readable tar archive");
+        return 0;
+    }
+    if (n > MAX_MEMBERS) n = MAX_MEMBERS;
+
+    static const char *required[] = { "metadata.gz", "data.tar.gz" };
+    for (size_t i = 0; i < sizeof(required) / sizeof(required[0]); i++) {
+        if (!find_member(mem, n, required[i])) {
+            g->status = GEM_CORRUPT;
+            snprintf(g->why, sizeof(g->why), "missing %s", required[i]);
+            return 0;
+        }
+    }
+
+    const struct wow_tar_member *cm = find_member(mem, n, "checksums.yaml.gz");
+    if (!cm) {
+        g->status = GEM_UNCHECKED;
+        snprintf(g->why, sizeof(g->why), "no checksums.yaml.gz");
+        return 0;
+    }
+    char *yaml = read_checksums(g->path, cm);
+    if (!yaml) {
+        g->status = GEM_CORRUPT;
+        snprintf(g->why, sizeof(g->why), "unreadable checksums.yaml.gz");
+        return 0;
+    }
+
+    struct expected_sum sums[MAX_SUMS];
+    int ns = parse_sums(yaml, sums, MAX_SUMS);
+    free(yaml);
+    if (ns == 0) {
+        g->status = GEM_UNCHECKED;
+        snprintf(g->why, sizeof(g->why), "no SHA256 checksums");
+        return 0;
+    }
+
+    g->status = GEM_OK;
+    for (int i = 0; i < ns; i++) {
+        const struct wow_tar_member *m = find_member(mem, n, sums[i].name);
+        if (!m) {
+            g->status = GEM_CORRUPT;
+            snprintf(g->why, sizeof(g->why), "missing %.63s", sums[i].name);
+            js->n = g->first_job;
+            g->n_jobs = 0;
+            return 0;
+        }
+        if (add_job(js, g->path, m, &sums[i]) != 0) return -1;
+        g->n_jobs++;
+    }
+    return 0;
+}
+
+/* ── Driver ──────────────────────────────────────────────────────── */
+
+static int cmp_str(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Sorted full paths of *.gem in dir */
+static int list_gems(const char *dir, char ***out, int *n_out)
+{
+    DIR *d = opendir(dir);
+    if (!d) {
+        if (errno == ENOENT) {
+            *out = NULL;
+            *n_out = 0;
+            return 0;
+        }
+        fprintf(stderr, "wow: cannot open %s: %s\n", dir, strerror(errno));
+        return -1;
+    }
+
+    char **v = NULL;
+    int n = 0, cap = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        size_t len = strlen(ent->d_name);
+        if (len <= 4 || strcmp(ent->d_name + len - 4, ".gem") != 0)
+            continue;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 256;
+            char **nv = realloc(v, (size_t)cap * sizeof(*nv));
+            if (!nv) goto oom;
+            v = nv;
+        }
+        size_t sz = strlen(dir) + len + 2;
+        if (!(v[n] = malloc(sz))) goto oom;
+        snprintf(v[n], sz, "%s/%s", dir, ent->d_name);
+        n++;
+    }
+    closedir(d);
+    if (n > 1) qsort(v, (size_t)n, sizeof(*v), cmp_str);
+    *out = v;
+    *n_out = n;
+    return 0;
+
+oom:
+    closedir(d);
+    for (int i = 0; i < n; i++) free(v[i]);
+    free(v);
+    fprintf(stderr, "wow: out of memory\n");
+    return -1;
+}
+
+static void report(const struct gem_check *g, const char *label,
+                   int colour)
+{
+    const char *base = strrchr(g->path, '/');
+    base = base ? base + 1 : g->path;
+    if (colour && g->status == GEM_CORRUPT)
+        printf(WOW_ANSI_RED "  %-9s" WOW_ANSI_RESET " %s"
+               WOW_ANSI_DIM " (%s)" WOW_ANSI_RESET "\n", label, base, g->why);
+    else if (g->why[0])
+        printf("  %-9s %s (%s)\n", label, base, g->why);
+    else
+        printf("  %-9s %s\n", label, base);
+}
+
+int wow_gem_verify_dir(const char *dir, const struct wow_gem_verify_opts *o,
+                       struct wow_gem_verify_stats *st)
+{
+    memset(st, 0, sizeof(*st));
+
+    char cache[WOW_OS_PATH_MAX];
+    if (!dir) {
+        if (wow_gem_cache_dir(cache, sizeof(cache)) != 0) return -1;
+        dir = cache;
+    }
+
+    char **paths;
+    int n;
+    if (list_gems(dir, &paths, &n) != 0) return -1;
+
+    int ret = -1;
+    struct job_list js = { 0 };
+    struct gem_check *gems = calloc(n > 0 ? (size_t)n : 1, sizeof(*gems));
+    if (!gems) {
+        fprintf(stderr, "wow: out of memory\n");
+        goto done;
+    }
+
+    for (int i = 0; i < n; i++) {
+        gems[i].path = paths[i];
+        if (index_gem(&gems[i], &js) != 0) {
+            fprintf(stderr, "wow: out of memory\n");
+            goto done;
+        }
+    }
+
+    wow_sha256_files(js.v, js.n, o->jobs);
+
+    int colour = wow_use_colour();
+    for (int i = 0; i < n; i++) {
+        struct gem_check *g = &gems[i];
+        for (int k = 0; k < g->n_jobs && g->status == GEM_OK; k++) {
+            const struct wow_sha256_job *j = &js.v[g->first_job + k];
+            const struct expected_sum *w = &js.want[g->first_job + k];
+            st->bytes += (uint64_t)j->length;
+            if (j->err == EIO)
+                snprintf(g->why, sizeof(g->why), "%s: truncated", w->name);
+            else if (j->err)
+                snprintf(g->why, sizeof(g->why), "%s: %s",
+                         w->name, strerror(j->err));
+            else if (strcmp(j->hex, w->hex) != 0)
+                snprintf(g->why, sizeof(g->why), "%s: checksum mismatch",
+                         w->name);
+            else
+                continue;
+            g->status = GEM_CORRUPT;
+        }
+
+        st->total++;
+        switch (g->status) {
+        case GEM_OK:
+            st->ok++;
+            if (o->verbose) report(g, "ok", colour);
+            break;
+        case GEM_UNCHECKED:
+            st->unchecked++;
+            if (o->verbose) report(g, "unchecked", colour);
+            break;
+        default:
+            st->corrupt++;
+            report(g, "corrupt", colour);
+            if (o->remove) {
+                if (unlink(g->path) == 0)
+                    st->removed++;
+                else
+                    fprintf(stderr, "wow: cannot remove %s: %s\n",
+                            g->path, strerror(errno));
+            }
+            break;
+        }
+    }
+    ret = 0;
+
+done:
+    free(js.v);
+    free(js.want);
+    free(gems);
+    for (int i = 0; i < n; i++) free(paths[i]);
+    free(paths);
+    return ret;
+}
@@ -21,6 +21,7 @@
 #include "wow/http/client.h"
 #include "wow/http/proxy.h"
 #include "wow/defaults.h"
+#include "wow/util/mem.h"
 #include "wow/version.h"
 
 /* Global verbose flag for HTTP debugging (set by --verbose or -v) */
@@ -531,6 +532,7 @@ static int do_get_to_fd(const char *host, const char *port, int usessl,
     int sock = -1;
     char *request = NULL;
     char *raw = NULL;
+    size_t raw_charged = 0;     /* receive buffer bytes charged (--stats) */
     struct HttpMessage msg;
     int msg_inited = 0;
 
@@ -596,6 +598,8 @@ static int do_get_to_fd(const char *host, const char *port, int usessl,
             char *tmp = realloc(raw, rawn);
             if (!tmp) { fprintf(stderr, "wow: out of memory\n"); goto fail; }
             raw = tmp;
+            wow_mem_charge(WOW_MEM_DOWNLOAD, (ptrdiff_t)(rawn - raw_charged));
+            raw_charged = rawn;
         }
 
         ssize_t rc;
@@ -671,6 +675,12 @@ static int do_get_to_fd(const char *host, const char *port, int usessl,
                 break;
             }
 
+            /* Non-2xx bodies (redirect stubs, error pages) must never
+             * reach out_fd — callers may be streaming into a hasher or
+             * an extractor.  Headers are all the caller needs. */
+            if (msg.status < 200 || msg.status > 299)
+                goto done_fd;
+
             /* Extract Content-Length for progress */
             if (HasHeader(kHttpContentLength)) {
                 ssize_t cl = ParseContentLength(
@@ -789,6 +799,7 @@ done_fd:
 fail:
 cleanup_fd:
     if (msg_inited) DestroyHttpMessage(&msg);
+    wow_mem_charge(WOW_MEM_DOWNLOAD, -(ptrdiff_t)raw_charged);
     free(raw);
     free(request);
     if (tls_inited) {
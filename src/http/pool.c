@@ -228,21 +228,24 @@ static char *extract_header(const struct HttpMessage *m, const char *raw,
  * Connection: keep-alive and returns whether to keep the connection.
  */
 static int pool_do_get(struct wow_pool_entry *e, const char *path,
-                       struct wow_response *resp, int *keep_alive) {
+                       const char *etag, struct wow_response *resp,
+                       int *keep_alive) {
     char *request = NULL;
     char *raw = NULL;
     struct HttpMessage msg;
     int msg_inited = 0;
     *keep_alive = 0;
 
-    /* Build request with keep-alive */
+    /* Build request with keep-alive (conditional when etag is given) */
     appendf(&request,
             "GET %s HTTP/1.1\r\n"
             "Host: %s:%s\r\n"
             "User-Agent: " WOW_HTTP_USER_AGENT "\r\n"
-            "Connection: keep-alive\r\n"
-            "\r\n",
+            "Connection: keep-alive\r\n",
             path, e->host, e->port);
+    if (etag)
+        appendf(&request, "If-None-Match: %s\r\n", etag);
+    appendf(&request, "\r\n");
 
     /* Send */
     size_t reqlen = appendz(request).i;
@@ -321,6 +324,9 @@ static int pool_do_get(struct wow_pool_entry *e, const char *path,
                     *keep_alive = 1;
             }
 
+            /* No body, whatever the framing headers say */
+            if (msg.status == 304 || msg.status == 204) goto done;
+
             if (HasHeader(kHttpTransferEncoding) &&
                 !HeaderEqualCase(kHttpTransferEncoding, "identity")) {
                 if (!HeaderEqualCase(kHttpTransferEncoding, "chunked"))
@@ -425,6 +431,11 @@ fail:
 
 int wow_http_pool_get(struct wow_http_pool *p, const char *url,
                       struct wow_response *resp) {
+    return wow_http_pool_get_if(p, url, NULL, resp);
+}
+
+int wow_http_pool_get_if(struct wow_http_pool *p, const char *url,
+                         const char *etag, struct wow_response *resp) {
     memset(resp, 0, sizeof(*resp));
     char *current_url = strdup(url);
     if (!current_url) return -1;
@@ -497,7 +508,8 @@ int wow_http_pool_get(struct wow_http_pool *p, const char *url,
 
             memset(&single, 0, sizeof(single));
             int keep_alive = 0;
-            rc = pool_do_get(&p->entries[slot], pathstr, &single, &keep_alive);
+            rc = pool_do_get(&p->entries[slot], pathstr, etag, &single,
+                             &keep_alive);
             pool_release(p, slot, keep_alive && rc == 0);
 
             if (rc != 0 || single.status != 429) break;
@@ -9,6 +9,7 @@
 #include <unistd.h>
 #include <stdbool.h>
 
+#include "wow/daemon.h"
 #include "wow/http.h"
 #include "wow/internal/util.h"
 #include "wow/init.h"
@@ -18,9 +19,11 @@
 #include "wow/gemfile.h"
 #include "wow/resolver.h"
 #include "wow/sync.h"
+#include "wow/workspace.h"
 #include "wow/exec.h"
 #include "wow/rubies/resolve.h"
 #include "wow/defaults.h"
+#include "wow/util/trace.h"
 
 /* External verbose flag from http.c */
 extern int wow_http_debug;
@@ -29,12 +32,6 @@ extern int wow_http_debug;
 
 typedef int (*cmd_fn)(int argc, char *argv[]);
 
-static int cmd_stub(int argc, char *argv[]) {
-    (void)argc;
-    printf("wow %s: not yet implemented\n", argv[0]);
-    return 1;
-}
-
 /*
  * wow run <command> [args...]
  *
@@ -76,7 +73,13 @@ static int cmd_run(int argc, char *argv[])
     snprintf(env_dir, sizeof(env_dir),
              "vendor/bundle/ruby/%s", ruby_api);
 
-    /* ---- 4. Find the binary in vendor bundle ---- */
+    /* ---- 4. Precomputed environment from `wow sync` (.wow-env) ---- */
+    int mrc = wow_env_manifest_exec(ruby_bin, ruby_full, env_dir,
+                                    "Gemfile.lock", NULL, binary_name,
+                                    user_argc, user_argv);
+    if (mrc != -1) return mrc;
+
+    /* ---- 5. Find the binary in vendor bundle ---- */
     char exe_path[WOW_OS_PATH_MAX];
     if (wow_find_gem_binary(env_dir, NULL, binary_name,
                             exe_path, sizeof(exe_path)) != 0) {
@@ -86,7 +89,7 @@ static int cmd_run(int argc, char *argv[])
         return 1;
     }
 
-    /* ---- 5. Exec the binary with proper environment ---- */
+    /* ---- 6. Exec the binary with proper environment ---- */
     return wow_exec_gem_binary(ruby_bin, ruby_api, env_dir, exe_path,
                                user_argc, user_argv);
 }
@@ -199,12 +202,16 @@ static int cmd_debug_gemfile_lex(int argc, char *argv[]) {
 /* Declared in tests/resolver/ — linked into wow.com */
 int cmd_debug_version_test(int argc, char *argv[]);
 int cmd_debug_pubgrub_test(int argc, char *argv[]);
+int cmd_debug_bench_resolve(int argc, char *argv[]);
+int cmd_debug_bench(int argc, char *argv[]);
 
 static void print_debug_usage(void) {
     printf("wow debug — Developer/debugging commands\n\n");
     printf("Usage: wow debug <subcommand> [args...]\n\n");
     printf("Subcommands:\n");
+    printf("  bench          Microbenchmark core primitives (parsers, hashing, tar)\n");
     printf("  bench-pool     Benchmark HTTP pool vs no-pool\n");
+    printf("  bench-resolve  Benchmark the resolver on a recorded corpus\n");
     printf("  gemfile-lex    Lex a Gemfile (tokenizer output)\n");
     printf("  version-test   Run gem version parsing tests\n");
     printf("  pubgrub-test   Run PubGrub resolver tests\n");
@@ -218,6 +225,9 @@ static int cmd_debug(int argc, char *argv[]) {
     
     const char *subcmd = argv[1];
     
+    if (strcmp(subcmd, "bench") == 0) {
+        return cmd_debug_bench(argc - 1, argv + 1);
+    }
     if (strcmp(subcmd, "bench-pool") == 0) {
         return cmd_bench_pool(argc - 1, argv + 1);
     }
@@ -230,6 +240,9 @@ static int cmd_debug(int argc, char *argv[]) {
     if (strcmp(subcmd, "pubgrub-test") == 0) {
         return cmd_debug_pubgrub_test(argc - 1, argv + 1);
     }
+    if (strcmp(subcmd, "bench-resolve") == 0) {
+        return cmd_debug_bench_resolve(argc - 1, argv + 1);
+    }
 
     fprintf(stderr, "unknown debug subcommand: %s\n\n", subcmd);
     print_debug_usage();
@@ -244,12 +257,15 @@ static const struct {
     { "init",   "Create a new project",          cmd_init },
     { "sync",   "Install gems from Gemfile.lock", cmd_sync },
     { "lock",   "Resolve and lock dependencies",  cmd_lock },
+    { "workspace", "Lock every Gemfile in a monorepo", cmd_workspace },
     { "resolve", "Resolve gem dependencies",       cmd_resolve },
-    { "add",    "Add a gem to Gemfile",           cmd_stub },
-    { "remove", "Remove a gem from Gemfile",      cmd_stub },
+    { "add",    "Add a gem to Gemfile",           cmd_add },
+    { "remove", "Remove a gem from Gemfile",      cmd_remove },
     { "run",    "Run a command with bundled gems", cmd_run },
     { "rubies", "Manage Ruby installations",      cmd_ruby },
     { "bundle", "Bundler compatibility shim",     cmd_bundle },
+    { "daemon", "Keep caches warm between runs",  cmd_daemon },
+    { "cache",  "Verify the gem cache",           cmd_cache },
     { "curl",   "Fetch a URL (HTTP client)",      cmd_fetch },
     { "gem-info",    "Show gem info from rubygems",   cmd_gem_info },
     { "gem-download", "Download a .gem file",          cmd_gem_download },
@@ -290,11 +306,12 @@ static void print_usage(void) {
 }
 
 int main(int argc, char *argv[]) {
-    ShowCrashReports();
-
     /*
      * Shim dispatch: if invoked as "ruby", "irb", etc. via symlink
      * or hard link, find .ruby-version and exec the managed Ruby binary.
+     * This runs before anything else (including ShowCrashReports, which
+     * installs signal handlers) so shims reach execve as cheaply as
+     * possible — see wow_shim_exec().
      */
     const char *progname = strrchr(argv[0], '/');
     progname = progname ? progname + 1 : argv[0];
@@ -310,6 +327,11 @@ int main(int argc, char *argv[]) {
         }
     }
 
+    if (wow_is_shim_name(progname))
+        return wow_shim_exec(progname, argv);
+
+    ShowCrashReports();
+
     /* When invoked via the APE loader (e.g. /usr/bin/ape /usr/local/bin/wow),
      * argv[0] may be the loader path rather than the binary's own name.
      * Fall back to /proc/self/exe to discover our real identity. */
@@ -334,33 +356,12 @@ int main(int argc, char *argv[]) {
     }
 
     if (strcmp(progname, "wow") != 0) {
-        /* Shim mode */
-        char version[32];
-        if (wow_find_ruby_version(version, sizeof(version)) != 0) {
-            fprintf(stderr,
-                    "wow: no .ruby-version found (looked from cwd to /)\n");
-            return 1;
-        }
-
-        char base[WOW_DIR_PATH_MAX];
-        if (wow_ruby_base_dir(base, sizeof(base)) != 0) return 1;
-
-        char bin_path[WOW_OS_PATH_MAX];
-        snprintf(bin_path, sizeof(bin_path), "%s/%s/bin/%s",
-                 base, version, progname);
-
-        if (access(bin_path, X_OK) != 0) {
-            fprintf(stderr, "wow: Ruby %s not installed "
-                    "(run: wow rubies install %s)\n", version, version);
-            return 1;
-        }
-
-        execv(bin_path, argv);
-        fprintf(stderr, "wow: exec %s failed: %s\n",
-                bin_path, strerror(errno));
-        return 1;
+        /* Shim under a name we don't create ourselves (user-made link) */
+        return wow_shim_exec(progname, argv);
     }
 
+    wow_trace_init();
+
     if (argc < 2) {
         print_usage();
         return 1;
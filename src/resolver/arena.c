@@ -2,12 +2,16 @@
  * arena.c -- Simple bump allocator for PubGrub data
  *
  * Starts at 64 KiB, doubles on growth. All allocations are 8-byte aligned.
+ * A fixed arena "grows" inside its mmap reservation instead of calling
+ * realloc, so its buffer address never changes.
  */
 
 #include "wow/resolver/arena.h"
+#include "wow/util/mem.h"
 
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 
 #define ARENA_INITIAL_CAP (64 * 1024)
 #define ARENA_ALIGN       8
@@ -17,6 +21,20 @@ void wow_arena_init(wow_arena *a)
     a->buf  = NULL;
     a->used = 0;
     a->cap  = 0;
+    a->reserved = 0;
+    a->mem_sys = WOW_MEM_OTHER;
+    a->mem_charged = 0;
+}
+
+int wow_arena_init_fixed(wow_arena *a, size_t reserve)
+{
+    wow_arena_init(a);
+    void *p = mmap(NULL, reserve, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) return -1;
+    a->buf = p;
+    a->reserved = reserve;
+    return 0;
 }
 
 static int arena_grow(wow_arena *a, size_t needed)
@@ -25,10 +43,23 @@ static int arena_grow(wow_arena *a, size_t needed)
     while (new_cap < a->used + needed)
         new_cap *= 2;
 
-    char *nb = realloc(a->buf, new_cap);
-    if (!nb) return -1;
+    /* A fixed arena only commits more of its reservation; buf is never
+     * written, so readers on other threads may keep using it. */
+    char *nb = NULL;
+    if (a->reserved) {
+        if (a->used + needed > a->reserved) return -1;
+        if (new_cap > a->reserved) new_cap = a->reserved;
+    } else {
+        nb = realloc(a->buf, new_cap);
+        if (!nb) return -1;
+    }
 
-    a->buf = nb;
+    if (wow_mem_on) {
+        wow_mem_charge((enum wow_mem_sys)a->mem_sys,
+                       (ptrdiff_t)(new_cap - a->cap));
+        a->mem_charged += new_cap - a->cap;
+    }
+    if (nb) a->buf = nb;
     a->cap = new_cap;
     return 0;
 }
@@ -83,8 +114,14 @@ void wow_arena_reset(wow_arena *a)
 
 void wow_arena_destroy(wow_arena *a)
 {
-    free(a->buf);
+    wow_mem_charge((enum wow_mem_sys)a->mem_sys, -(ptrdiff_t)a->mem_charged);
+    a->mem_charged = 0;
+    if (a->reserved)
+        munmap(a->buf, a->reserved);
+    else
+        free(a->buf);
     a->buf  = NULL;
     a->used = 0;
     a->cap  = 0;
+    a->reserved = 0;
 }
@@ -0,0 +1,221 @@
+/*
+ * citok.c -- Delimiter scan for compact index bodies
+ *
+ * Each kernel compares a block of bytes against the six delimiters at
+ * once, folds the matches into a bitmask and emits one offset per set
+ * bit.  Bodies are processed in fixed-size chunks so the offset table
+ * grows with the number of delimiters found, not with the body size.
+ */
+
+#include "wow/resolver/citok.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define CHUNK 4096
+
+/* Scan p[0..len) and write base + offset of every delimiter to out */
+typedef size_t (*scan_fn)(const uint8_t *p, size_t len, uint32_t base,
+                          uint32_t *out);
+
+/* ------------------------------------------------------------------ */
+/* Scalar kernel                                                       */
+/* ------------------------------------------------------------------ */
+
+static const uint8_t delim_tab[256] = {
+    ['\n'] = 1, [' '] = 1, ['|'] = 1, [','] = 1, [':'] = 1, ['&'] = 1,
+};
+
+static size_t scan_scalar(const uint8_t *p, size_t len, uint32_t base,
+                          uint32_t *out)
+{
+    size_t n = 0;
+    for (size_t i = 0; i < len; i++) {
+        out[n] = base + (uint32_t)i;
+        n += delim_tab[p[i]];
+    }
+    return n;
+}
+
+/* ------------------------------------------------------------------ */
+/* x86-64 kernels                                                      */
+/* ------------------------------------------------------------------ */
+
+#if defined(__x86_64__)
+
+static inline size_t emit_bits(uint32_t m, uint32_t at, uint32_t *out)
+{
+    size_t n = 0;
+    while (m) {
+        out[n++] = at + (uint32_t)__builtin_ctz(m);
+        m &= m - 1;
+    }
+    return n;
+}
+
+/* SSE2 is part of the x86-64 baseline, so this needs no detection */
+static size_t scan_sse2(const uint8_t *p, size_t len, uint32_t base,
+                        uint32_t *out)
+{
+    const __m128i nl = _mm_set1_epi8('\n'), sp = _mm_set1_epi8(' ');
+    const __m128i pi = _mm_set1_epi8('|'),  co = _mm_set1_epi8(',');
+    const __m128i cl = _mm_set1_epi8(':'),  am = _mm_set1_epi8('&');
+    size_t n = 0, i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i b = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(b, nl),
+                                      _mm_cmpeq_epi8(b, sp)),
+                         _mm_or_si128(_mm_cmpeq_epi8(b, pi),
+                                      _mm_cmpeq_epi8(b, co))),
+            _mm_or_si128(_mm_cmpeq_epi8(b, cl), _mm_cmpeq_epi8(b, am)));
+        n += emit_bits((uint32_t)_mm_movemask_epi8(m), base + (uint32_t)i,
+                       out + n);
+    }
+    return n + scan_scalar(p + i, len - i, base + (uint32_t)i, out + n);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_avx2(const uint8_t *p, size_t len, uint32_t base,
+                        uint32_t *out)
+{
+    const __m256i nl = _mm256_set1_epi8('\n'), sp = _mm256_set1_epi8(' ');
+    const __m256i pi = _mm256_set1_epi8('|'),  co = _mm256_set1_epi8(',');
+    const __m256i cl = _mm256_set1_epi8(':'),  am = _mm256_set1_epi8('&');
+    size_t n = 0, i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i b = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i m = _mm256_or_si256(
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(b, nl),
+                                            _mm256_cmpeq_epi8(b, sp)),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(b, pi),
+                                            _mm256_cmpeq_epi8(b, co))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(b, cl),
+                            _mm256_cmpeq_epi8(b, am)));
+        n += emit_bits((uint32_t)_mm256_movemask_epi8(m),
+                       base + (uint32_t)i, out + n);
+    }
+    return n + scan_scalar(p + i, len - i, base + (uint32_t)i, out + n);
+}
+
+/* AVX2 in cpuid, and the OS saving YMM state (OSXSAVE + XCR0) */
+static int have_avx2(void)
+{
+    uint32_t a, b, c, d;
+    __asm__ volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d)
+                             : "a"(0), "c"(0));
+    if (a < 7) return 0;
+    __asm__ volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d)
+                             : "a"(1), "c"(0));
+    if (!(c & (1u << 27)) || !(c & (1u << 28)))    /* OSXSAVE, AVX */
+        return 0;
+    uint32_t xlo, xhi;
+    __asm__ volatile("xgetbv" : "=a"(xlo), "=d"(xhi) : "c"(0));
+    if ((xlo & 6) != 6) return 0;                  /* XMM | YMM */
+    __asm__ volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d)
+                             : "a"(7), "c"(0));
+    return (b >> 5) & 1;                           /* AVX2 */
+}
+
+#endif /* __x86_64__ */
+
+/* ------------------------------------------------------------------ */
+/* Kernel selection                                                    */
+/* ------------------------------------------------------------------ */
+
+static const struct kernel {
+    const char *name;
+    scan_fn     fn;
+    int       (*available)(void);
+} kernels[] = {
+#if defined(__x86_64__)
+    { "avx2",   scan_avx2,   have_avx2 },
+    { "sse2",   scan_sse2,   NULL },
+#endif
+    { "scalar", scan_scalar, NULL },
+};
+
+#define N_KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+static const struct kernel *chosen;
+
+static const struct kernel *find_kernel(const char *name)
+{
+    for (size_t i = 0; i < N_KERNELS; i++) {
+        const struct kernel *k = &kernels[i];
+        if (name && strcmp(name, k->name) != 0) continue;
+        if (!k->available || k->available()) return k;
+    }
+    return NULL;
+}
+
+/* Racing first calls all compute the same answer, so no lock is needed */
+static const struct kernel *kernel(void)
+{
+    const struct kernel *k = __atomic_load_n(&chosen, __ATOMIC_ACQUIRE);
+    if (!k) {
+        k = find_kernel(NULL);
+        __atomic_store_n(&chosen, k, __ATOMIC_RELEASE);
+    }
+    return k;
+}
+
+const char *wow_ci_tok_backend(void)
+{
+    return kernel()->name;
+}
+
+int wow_ci_tok_set_backend(const char *name)
+{
+    const struct kernel *k = find_kernel(name);
+    if (!k) return -1;
+    __atomic_store_n(&chosen, k, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* Public API                                                          */
+/* ------------------------------------------------------------------ */
+
+int wow_ci_tokenize(const char *buf, size_t len, wow_ci_toks *t)
+{
+    t->n = 0;
+    if (len > UINT32_MAX) return -1;
+
+    scan_fn scan = kernel()->fn;
+    const uint8_t *p = (const uint8_t *)buf;
+    for (size_t off = 0; off < len; off += CHUNK) {
+        size_t clen = len - off < CHUNK ? len - off : CHUNK;
+
+        /* A chunk can add at most clen offsets */
+        if (t->cap - t->n < clen) {
+            size_t cap = t->cap ? t->cap : CHUNK;
+            while (cap - t->n < clen) cap *= 2;
+            uint32_t *np = realloc(t->pos, cap * sizeof(*np));
+            if (!np) return -1;
+            t->pos = np;
+            t->cap = cap;
+        }
+        t->n += scan(p + off, clen, (uint32_t)off, t->pos + t->n);
+    }
+    return 0;
+}
+
+size_t wow_ci_tokenize_into(const char *buf, size_t len, uint32_t *out)
+{
+    if (len > UINT32_MAX) return 0;
+    return kernel()->fn((const uint8_t *)buf, len, 0, out);
+}
+
+void wow_ci_toks_free(wow_ci_toks *t)
+{
+    free(t->pos);
+    t->pos = NULL;
+    t->n = t->cap = 0;
+}
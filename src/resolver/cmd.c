@@ -2,10 +2,16 @@
  * cmd.c -- Resolver CLI subcommands
  *
  * Provides:
- *   wow resolve <gem> [<gem>...]     — resolve dependencies
- *   wow lock [Gemfile]               — resolve + write Gemfile.lock
+ *   wow resolve [--stats[=json]] <gem> [<gem>...]
+ *                                    — resolve dependencies
+ *   wow lock [--update] [--stats[=json]] [Gemfile]
+ *                                    — resolve + write Gemfile.lock
  *   wow debug version-test           — hardcoded version matching tests
  *   wow debug pubgrub-test           — hardcoded PubGrub solver tests
+ *
+ * --stats prints solver, index and memory statistics to stderr (a
+ * table, or one JSON object with =json) whether or not resolution
+ * succeeds.
  */
 
 #include <stdio.h>
@@ -16,6 +22,9 @@
 #include "wow/resolver/test.h"
 #include "wow/gemfile.h"
 #include "wow/http.h"
+#include "wow/rubies/resolve.h"
+#include "wow/util/mem.h"
+#include "wow/util/sha256.h"
 #include "wow/version.h"
 
 /* ------------------------------------------------------------------ */
@@ -24,14 +33,22 @@
 
 int cmd_resolve(int argc, char *argv[])
 {
-    if (argc < 2) {
-        fprintf(stderr, "usage: wow resolve <gem> [<gem>...]\n");
-        return 1;
+    /* Collect gem names from argv (skip argv[0] which is "resolve");
+     * options are compacted out in place */
+    enum wow_stats_mode stats = WOW_STATS_OFF;
+    int n_gems = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!wow_stats_flag(argv[i], &stats))
+            argv[1 + n_gems++] = argv[i];
     }
-
-    /* Collect gem names from argv (skip argv[0] which is "resolve") */
+    if (stats != WOW_STATS_OFF) wow_mem_enable();
     const char **names = (const char **)(argv + 1);
-    int n_gems = argc - 1;
+
+    if (n_gems < 1) {
+        fprintf(stderr,
+                "usage: wow resolve [--stats[=json]] <gem> [<gem>...]\n");
+        return 1;
+    }
 
     /* Parse optional version constraints: "sinatra:~>4.0" or just "sinatra" */
     const char **root_names = calloc((size_t)n_gems, sizeof(char *));
@@ -82,6 +99,8 @@ int cmd_resolve(int argc, char *argv[])
     fflush(stdout);
 
     int rc = wow_solve(&solver, root_names, root_cs, n_gems);
+    wow_mem_phase("resolve");
+    wow_resolve_stats_print(stderr, stats, &solver.stats, &ci);
     if (rc != 0) {
         fprintf(stderr, "\nResolution failed:\n%s\n", solver.error_msg);
         wow_solver_destroy(&solver);
@@ -94,8 +113,13 @@ int cmd_resolve(int argc, char *argv[])
 
     printf("Resolved %d packages:\n", solver.n_solved);
     for (int i = 0; i < solver.n_solved; i++) {
-        printf("  %s %s\n", solver.solution[i].name,
-               solver.solution[i].version.raw);
+        if (solver.solution[i].platform)
+            printf("  %s %s (%s)\n", solver.solution[i].name,
+                   solver.solution[i].version.raw,
+                   solver.solution[i].platform);
+        else
+            printf("  %s %s\n", solver.solution[i].name,
+                   solver.solution[i].version.raw);
     }
 
     wow_solver_destroy(&solver);
@@ -129,12 +153,36 @@ static int resolved_cmp(const void *a, const void *b)
 }
 
 /* ------------------------------------------------------------------ */
-/* wow lock [Gemfile]                                                  */
+/* wow lock [--update] [Gemfile]                                       */
 /* ------------------------------------------------------------------ */
 
+static void lock_cleanup(wow_lock_provider *lp, struct wow_lockfile *lf,
+                         wow_resolved_pkg *locked)
+{
+    wow_lock_provider_destroy(lp);
+    free(locked);
+    if (lf) wow_lockfile_free(lf);
+}
+
+/*
+ * An existing Gemfile.lock seeds the solve: locked versions are kept
+ * wherever they still fit, and only packages whose constraints changed
+ * are fetched.  --update ignores the locked versions and picks the
+ * newest, but still fetches the index data for every locked gem in one
+ * parallel burst before solving starts.
+ */
 int cmd_lock(int argc, char *argv[])
 {
-    const char *gemfile_path = (argc > 1) ? argv[1] : "Gemfile";
+    const char *gemfile_path = "Gemfile";
+    int update = 0;
+    enum wow_stats_mode stats = WOW_STATS_OFF;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--update") == 0)
+            update = 1;
+        else if (!wow_stats_flag(argv[i], &stats))
+            gemfile_path = argv[i];
+    }
+    if (stats != WOW_STATS_OFF) wow_mem_enable();
 
     /* 1. Parse Gemfile */
     struct wow_gemfile gemfile;
@@ -142,6 +190,7 @@ int cmd_lock(int argc, char *argv[])
         fprintf(stderr, "wow: failed to parse %s\n", gemfile_path);
         return 1;
     }
+    wow_mem_phase("parse");
 
     if (gemfile.n_deps == 0) {
         printf("No dependencies in %s\n", gemfile_path);
@@ -187,24 +236,74 @@ int cmd_lock(int argc, char *argv[])
         }
     }
 
-    /* 3. Resolve */
+    /* 3. Resolve — against the project's Ruby when .ruby-version says,
+     * so precompiled gems are only chosen if they support it */
+    char ruby_full[32];
+    const char *ruby_ver = NULL;
+    if (wow_find_ruby_version(ruby_full, sizeof(ruby_full)) == 0)
+        ruby_ver = ruby_full;
+
     struct wow_http_pool pool;
     wow_http_pool_init(&pool, 4);
 
     wow_ci_provider ci;
-    wow_ci_provider_init(&ci, source, &pool, NULL);
+    wow_ci_provider_init(&ci, source, &pool, ruby_ver);
+    wow_provider ci_prov = wow_ci_provider_as_provider(&ci);
+
+    struct wow_lockfile lock;
+    int have_lock = wow_lockfile_parse("Gemfile.lock", &lock) == 0;
+    wow_resolved_pkg *locked = NULL;
+    int n_locked = 0;
+    char why[256];
+    if (have_lock && !update)
+        wow_lockfile_select_host(&lock, &locked, &n_locked,
+                                 why, sizeof(why));
+
+    wow_lock_provider lock_prov;
+    if (wow_lock_provider_init(&lock_prov, have_lock && !update ? &lock : NULL,
+                               locked, n_locked, source, &ci_prov) != 0) {
+        fprintf(stderr, "wow: out of memory\n");
+        lock_cleanup(&lock_prov, have_lock ? &lock : NULL, locked);
+        wow_ci_provider_destroy(&ci);
+        wow_http_pool_cleanup(&pool);
+        free(root_names); free(root_cs);
+        wow_gemfile_free(&gemfile);
+        return 1;
+    }
 
-    wow_provider prov = wow_ci_provider_as_provider(&ci);
+    wow_provider prov = wow_lock_provider_as_provider(&lock_prov);
     wow_solver solver;
     wow_solver_init(&solver, &prov);
 
     printf("Resolving dependencies for %s...\n", gemfile_path);
     fflush(stdout);
 
-    int rc = wow_solve(&solver, root_names, root_cs, gemfile.n_deps);
+    /* An earlier solve of the same roots stands if none of the index
+     * data it read has changed; a lock that seeds the solve is part of
+     * the key.  Keyed before any fetch so every package gets a digest. */
+    char seed[65], skey[65];
+    int cached = (lock_prov.n_pkgs == 0 ||
+                  wow_sha256_file("Gemfile.lock", seed, sizeof(seed)) == 0) &&
+                 wow_solcache_key(&ci, root_names, root_cs,
+                                  (int)gemfile.n_deps,
+                                  lock_prov.n_pkgs ? seed : NULL,
+                                  skey, sizeof(skey)) == 0;
+
+    /* The lock names nearly every package the solve will visit */
+    if (have_lock)
+        wow_lockfile_prefetch(&lock, &ci);
+
+    int rc = 0;
+    if (!cached || wow_solcache_load(skey, &ci, &solver) != 0) {
+        rc = wow_solve(&solver, root_names, root_cs, gemfile.n_deps);
+        if (rc == 0 && cached) wow_solcache_store(skey, &ci, &solver);
+    }
+    wow_mem_phase("resolve");
+    wow_resolve_stats_print(stderr, stats, &solver.stats, &ci);
     if (rc != 0) {
         fprintf(stderr, "\nResolution failed:\n%s\n", solver.error_msg);
         wow_solver_destroy(&solver);
+        lock_cleanup(&lock_prov, have_lock ? &lock : NULL, locked);
         wow_ci_provider_destroy(&ci);
         wow_http_pool_cleanup(&pool);
         free(root_names); free(root_cs);
@@ -221,6 +320,7 @@ int cmd_lock(int argc, char *argv[])
     /* 5. Write Gemfile.lock */
     if (wow_write_lockfile("Gemfile.lock", &solver, &prov, &gemfile, source) != 0) {
         wow_solver_destroy(&solver);
+        lock_cleanup(&lock_prov, have_lock ? &lock : NULL, locked);
         wow_ci_provider_destroy(&ci);
         wow_http_pool_cleanup(&pool);
         free(root_names); free(root_cs);
@@ -232,6 +332,7 @@ int cmd_lock(int argc, char *argv[])
 
     /* Cleanup */
     wow_solver_destroy(&solver);
+    lock_cleanup(&lock_prov, have_lock ? &lock : NULL, locked);
     wow_ci_provider_destroy(&ci);
     wow_http_pool_cleanup(&pool);
     free(root_names);
@@ -22,24 +22,32 @@
 /* ------------------------------------------------------------------ */
 
 int wow_gemver_parse(const char *s, wow_gemver *v)
+{
+    if (!s) return -1;
+    return wow_gemver_parse_n(s, strlen(s), v);
+}
+
+int wow_gemver_parse_n(const char *s, size_t len, wow_gemver *v)
 {
     if (!s || !v) return -1;
 
     memset(v, 0, sizeof(*v));
-    snprintf(v->raw, sizeof(v->raw), "%s", s);
+    memcpy(v->raw, s, len < sizeof(v->raw) ? len : sizeof(v->raw) - 1);
+
+    const char *e = s + len;
 
     /* Skip leading whitespace */
-    while (isspace((unsigned char)*s)) s++;
-    if (*s == '\0') return -1;
+    while (s < e && isspace((unsigned char)*s)) s++;
+    if (s == e) return -1;
 
-    while (*s && v->n_segs < WOW_VER_MAX_SEGS) {
+    while (s < e && v->n_segs < WOW_VER_MAX_SEGS) {
         wow_ver_seg *seg = &v->segs[v->n_segs];
 
         if (isdigit((unsigned char)*s)) {
             /* Numeric segment */
             seg->is_str = false;
             seg->num = 0;
-            while (isdigit((unsigned char)*s)) {
+            while (s < e && isdigit((unsigned char)*s)) {
                 seg->num = seg->num * 10 + (*s - '0');
                 s++;
             }
@@ -48,7 +56,7 @@ int wow_gemver_parse(const char *s, wow_gemver *v)
             seg->is_str = true;
             v->prerelease = true;
             int i = 0;
-            while (isalnum((unsigned char)*s) &&
+            while (s < e && isalnum((unsigned char)*s) &&
                    i < WOW_VER_SEG_STRSZ - 1) {
                 seg->str[i++] = *s++;
             }
@@ -60,10 +68,10 @@ int wow_gemver_parse(const char *s, wow_gemver *v)
         v->n_segs++;
 
         /* Skip separator (dot) */
-        if (*s == '.') {
-            s++;
-        } else if (*s == '\0') {
+        if (s == e) {
             break;
+        } else if (*s == '.') {
+            s++;
         } else if (isalpha((unsigned char)*s)) {
             /* Transition from numeric to alpha without dot:
              * e.g. "4.0.0beta2" — treat as new segment */
@@ -142,40 +150,43 @@ int wow_gemver_cmp(const wow_gemver *a, const wow_gemver *b)
 /* ------------------------------------------------------------------ */
 
 /*
- * Parse operator prefix from s, advance *pp past it.
+ * Parse operator prefix from [*pp, e), advance *pp past it.
  * Returns the operator enum value.
  */
-static enum wow_ver_op parse_op(const char **pp)
+static enum wow_ver_op parse_op(const char **pp, const char *e)
 {
     const char *p = *pp;
 
-    while (isspace((unsigned char)*p)) p++;
+    while (p < e && isspace((unsigned char)*p)) p++;
 
-    if (p[0] == '~' && p[1] == '>') {
+    char c0 = p < e ? p[0] : '\0';
+    char c1 = p + 1 < e ? p[1] : '\0';
+
+    if (c0 == '~' && c1 == '>') {
         *pp = p + 2;
         return WOW_OP_PESSIMISTIC;
     }
-    if (p[0] == '>' && p[1] == '=') {
+    if (c0 == '>' && c1 == '=') {
         *pp = p + 2;
         return WOW_OP_GTE;
     }
-    if (p[0] == '<' && p[1] == '=') {
+    if (c0 == '<' && c1 == '=') {
         *pp = p + 2;
         return WOW_OP_LTE;
     }
-    if (p[0] == '!' && p[1] == '=') {
+    if (c0 == '!' && c1 == '=') {
         *pp = p + 2;
         return WOW_OP_NEQ;
     }
-    if (p[0] == '>') {
+    if (c0 == '>') {
         *pp = p + 1;
         return WOW_OP_GT;
     }
-    if (p[0] == '<') {
+    if (c0 == '<') {
         *pp = p + 1;
         return WOW_OP_LT;
     }
-    if (p[0] == '=') {
+    if (c0 == '=') {
         *pp = p + 1;
         return WOW_OP_EQ;
     }
@@ -185,37 +196,40 @@ static enum wow_ver_op parse_op(const char **pp)
     return WOW_OP_EQ;
 }
 
+int wow_gem_constraint_parse_n(const char *s, size_t len,
+                               wow_gem_constraint *c)
+{
+    const char *e = s + len;
+    const char *p = s;
+    c->op = parse_op(&p, e);
+
+    /* Skip whitespace between operator and version */
+    while (p < e && isspace((unsigned char)*p)) p++;
+
+    return wow_gemver_parse_n(p, (size_t)(e - p), &c->ver);
+}
+
 int wow_gem_constraints_parse(const char *s, wow_gem_constraints *cs)
 {
     if (!s || !cs) return -1;
 
     memset(cs, 0, sizeof(*cs));
 
-    /* Work on a mutable copy */
-    char buf[1024];
-    snprintf(buf, sizeof(buf), "%s", s);
-
-    char *tok = buf;
+    const char *tok = s;
     while (tok && *tok && cs->count < WOW_MAX_CONSTRAINTS) {
         /* Find next comma (constraint separator) */
-        char *comma = strchr(tok, ',');
-        if (comma) *comma = '\0';
+        const char *comma = strchr(tok, ',');
+        const char *end = comma ? comma : tok + strlen(tok);
 
         /* Skip leading whitespace */
-        while (isspace((unsigned char)*tok)) tok++;
-        if (*tok == '\0') {
+        while (tok < end && isspace((unsigned char)*tok)) tok++;
+        if (tok == end) {
             tok = comma ? comma + 1 : NULL;
             continue;
         }
 
-        wow_gem_constraint *c = &cs->items[cs->count];
-        const char *p = tok;
-        c->op = parse_op(&p);
-
-        /* Skip whitespace between operator and version */
-        while (isspace((unsigned char)*p)) p++;
-
-        if (wow_gemver_parse(p, &c->ver) != 0)
+        if (wow_gem_constraint_parse_n(tok, (size_t)(end - tok),
+                                       &cs->items[cs->count]) != 0)
             return -1;
 
         cs->count++;
@@ -1,19 +1,29 @@
 /*
- * lockfile.c -- Bundler-format Gemfile.lock writer
+ * lockfile.c -- Bundler-format Gemfile.lock writer and reader
  *
  * Writes the four sections of a Gemfile.lock:
- *   GEM          — source remote + resolved gem specs with deps
- *   PLATFORMS    — ruby (platform-specific gems out of scope)
+ *   GEM          — source remote + resolved gem specs with deps;
+ *                  precompiled gems carry their platform, as Bundler
+ *                  writes them: "nokogiri (1.16.0-x86_64-linux)"
+ *   PLATFORMS    — the host platform, plus "ruby" when any chosen
+ *                  spec is generic (as Bundler writes it)
  *   DEPENDENCIES — Gemfile's direct deps with constraints
  *   BUNDLED WITH — wow version string
+ *
+ * The reader accepts the same layout as written by Bundler: section
+ * headers at column 0, "remote:"/"specs:" at 2 spaces, specs at 4 and
+ * their deps at 6, DEPENDENCIES and PLATFORMS entries at 2.
  */
 
+#include <ctype.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "wow/resolver/lockfile.h"
+#include "wow/resolver/provider.h"
+#include "wow/util/trace.h"
 #include "wow/version.h"
 
 /* ------------------------------------------------------------------ */
@@ -42,6 +52,12 @@ static int dep_sort_cmp(const void *a, const void *b)
     return strcmp(ea->name, eb->name);
 }
 
+/* qsort comparator for an array of C strings */
+static int str_ptr_cmp(const void *a, const void *b)
+{
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
 /* qsort comparator for Gemfile deps by name */
 static int gemfile_dep_cmp(const void *a, const void *b)
 {
@@ -53,9 +69,9 @@ static int gemfile_dep_cmp(const void *a, const void *b)
 /* Public API                                                          */
 /* ------------------------------------------------------------------ */
 
-int wow_write_lockfile(const char *path, wow_solver *solver,
-                       wow_provider *prov, struct wow_gemfile *gf,
-                       const char *source)
+static int write_lockfile(const char *path, wow_solver *solver,
+                          wow_provider *prov, struct wow_gemfile *gf,
+                          const char *source)
 {
     FILE *f = fopen(path, "w");
     if (!f) {
@@ -74,9 +90,15 @@ int wow_write_lockfile(const char *path, wow_solver *solver,
     fprintf(f, "  specs:\n");
 
     for (int i = 0; i < solver->n_solved; i++) {
-        fprintf(f, "    %s (%s)\n",
-                solver->solution[i].name,
-                solver->solution[i].version.raw);
+        if (solver->solution[i].platform)
+            fprintf(f, "    %s (%s-%s)\n",
+                    solver->solution[i].name,
+                    solver->solution[i].version.raw,
+                    solver->solution[i].platform);
+        else
+            fprintf(f, "    %s (%s)\n",
+                    solver->solution[i].name,
+                    solver->solution[i].version.raw);
 
         /* Re-query deps from provider (still cached, no HTTP) */
         const char **dep_names = NULL;
@@ -111,9 +133,24 @@ int wow_write_lockfile(const char *path, wow_solver *solver,
         }
     }
 
-    /* PLATFORMS section */
+    /* PLATFORMS section — the host's platform as Bundler spells it (the
+     * least specific wow_ci_host_platforms entry: "x86_64-linux", not
+     * "-gnu"), plus "ruby" when any spec is generic; sorted */
     fprintf(f, "\nPLATFORMS\n");
-    fprintf(f, "  ruby\n");
+    {
+        char host[WOW_CI_MAX_PLATFORMS][WOW_CI_PLATFORM_LEN];
+        int n_host = wow_ci_host_platforms(host, WOW_CI_MAX_PLATFORMS);
+        int generic = n_host == 0;
+        for (int i = 0; i < solver->n_solved && !generic; i++)
+            generic = !solver->solution[i].platform;
+        const char *plats[2];
+        int n_plats = 0;
+        if (generic) plats[n_plats++] = "ruby";
+        if (n_host > 0) plats[n_plats++] = host[n_host - 1];
+        qsort(plats, (size_t)n_plats, sizeof(plats[0]), str_ptr_cmp);
+        for (int k = 0; k < n_plats; k++)
+            fprintf(f, "  %s\n", plats[k]);
+    }
 
     /* DEPENDENCIES section */
     fprintf(f, "\nDEPENDENCIES\n");
@@ -138,3 +175,635 @@ int wow_write_lockfile(const char *path, wow_solver *solver,
     fclose(f);
     return 0;
 }
+
+int wow_write_lockfile(const char *path, wow_solver *solver,
+                       wow_provider *prov, struct wow_gemfile *gf,
+                       const char *source)
+{
+    uint64_t t0 = wow_trace_begin();
+    int rc = write_lockfile(path, solver, prov, gf, source);
+    wow_trace_end(t0, "lockfile", "write", path);
+    return rc;
+}
+
+/* ------------------------------------------------------------------ */
+/* Reader                                                              */
+/* ------------------------------------------------------------------ */
+
+enum lock_section {
+    SEC_NONE, SEC_GEM, SEC_OTHER_SOURCE, SEC_PLATFORMS,
+    SEC_DEPENDENCIES, SEC_RUBY_VERSION, SEC_BUNDLED_WITH, SEC_UNKNOWN
+};
+
+static int grow(void **arr, int n, int *cap, size_t elem)
+{
+    if (n < *cap) return 0;
+    int nc = *cap ? *cap * 2 : 16;
+    void *p = realloc(*arr, (size_t)nc * elem);
+    if (!p) return -1;
+    *arr = p;
+    *cap = nc;
+    return 0;
+}
+
+/*
+ * Split "name (constraint)" or "name" into a malloc'd name and
+ * constraint (NULL when absent).  A trailing "!" (Bundler's marker for
+ * a gem pinned to a GIT/PATH source) is dropped.
+ */
+static int split_entry(const char *s, char **name, char **paren)
+{
+    const char *sp = strchr(s, ' ');
+    size_t nlen = sp ? (size_t)(sp - s) : strlen(s);
+    if (nlen > 0 && s[nlen - 1] == '!') nlen--;
+    if (nlen == 0) return -1;
+
+    *name = strndup(s, nlen);
+    *paren = NULL;
+    if (!*name) return -1;
+
+    if (sp) {
+        const char *open = strchr(sp, '(');
+        const char *close = open ? strrchr(open, ')') : NULL;
+        if (open && close && close > open + 1) {
+            *paren = strndup(open + 1, (size_t)(close - open - 1));
+            if (!*paren) { free(*name); return -1; }
+        }
+    }
+    return 0;
+}
+
+/*
+ * "1.16.0-x86_64-linux" → version "1.16.0", platform "x86_64-linux".
+ * The platform starts at the first '-' followed by a letter; gem
+ * versions themselves never contain '-'.
+ */
+static int split_version(char *ver, char **platform)
+{
+    *platform = NULL;
+    for (char *p = ver; *p; p++) {
+        if (*p == '-' && isalpha((unsigned char)p[1])) {
+            *platform = strdup(p + 1);
+            if (!*platform) return -1;
+            *p = '\0';
+            break;
+        }
+    }
+    return 0;
+}
+
+static enum lock_section section_for(const char *line)
+{
+    if (strcmp(line, "GEM") == 0)          return SEC_GEM;
+    if (strcmp(line, "GIT") == 0 ||
+        strcmp(line, "PATH") == 0)         return SEC_OTHER_SOURCE;
+    if (strcmp(line, "PLATFORMS") == 0)    return SEC_PLATFORMS;
+    if (strcmp(line, "DEPENDENCIES") == 0) return SEC_DEPENDENCIES;
+    if (strcmp(line, "RUBY VERSION") == 0) return SEC_RUBY_VERSION;
+    if (strcmp(line, "BUNDLED WITH") == 0) return SEC_BUNDLED_WITH;
+    return SEC_UNKNOWN;   /* CHECKSUMS, PLUGIN SOURCE, ... */
+}
+
+int wow_lockfile_parse(const char *path, struct wow_lockfile *lf)
+{
+    memset(lf, 0, sizeof(*lf));
+
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+
+    int spec_cap = 0, plat_cap = 0, dep_cap = 0, dep_of_cap = 0;
+    enum lock_section sec = SEC_NONE;
+    int in_gem_specs = 0;
+    int seen_gem = 0;
+    int lineno = 0;
+    char *line = NULL;
+    size_t line_cap = 0;
+    ssize_t len;
+    int rc = 0;
+
+    while ((len = getline(&line, &line_cap, f)) >= 0) {
+        lineno++;
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            line[--len] = '\0';
+        if (len == 0) continue;
+
+        int indent = 0;
+        while (line[indent] == ' ') indent++;
+        const char *text = line + indent;
+
+        if (indent == 0) {
+            sec = section_for(text);
+            /* Only the first GEM section is the rubygems source */
+            if (sec == SEC_GEM && seen_gem) sec = SEC_OTHER_SOURCE;
+            if (sec == SEC_GEM) seen_gem = 1;
+            in_gem_specs = 0;
+            continue;
+        }
+
+        switch (sec) {
+        case SEC_GEM:
+            if (indent == 2) {
+                if (strncmp(text, "remote: ", 8) == 0) {
+                    free(lf->remote);
+                    lf->remote = strdup(text + 8);
+                    if (!lf->remote) goto oom;
+                }
+                in_gem_specs = strcmp(text, "specs:") == 0;
+            } else if (in_gem_specs && indent == 4) {
+                if (grow((void **)&lf->specs, lf->n_specs, &spec_cap,
+                         sizeof(*lf->specs)) != 0)
+                    goto oom;
+                struct wow_lock_spec *sp = &lf->specs[lf->n_specs];
+                memset(sp, 0, sizeof(*sp));
+                if (split_entry(text, &sp->name, &sp->version) != 0)
+                    goto oom;
+                lf->n_specs++;
+                dep_of_cap = 0;
+                if (!sp->version) {
+                    fprintf(stderr, "wow: %s:%d: spec without version\n",
+                            path, lineno);
+                    rc = -1;
+                    goto out;
+                }
+                if (split_version(sp->version, &sp->platform) != 0)
+                    goto oom;
+            } else if (in_gem_specs && indent == 6 && lf->n_specs > 0) {
+                struct wow_lock_spec *sp = &lf->specs[lf->n_specs - 1];
+                if (sp->n_deps == dep_of_cap) {
+                    int nc = dep_of_cap ? dep_of_cap * 2 : 8;
+                    char **nn = realloc(sp->dep_names,
+                                        (size_t)nc * sizeof(char *));
+                    if (!nn) goto oom;
+                    sp->dep_names = nn;
+                    char **cc = realloc(sp->dep_constraints,
+                                        (size_t)nc * sizeof(char *));
+                    if (!cc) goto oom;
+                    sp->dep_constraints = cc;
+                    dep_of_cap = nc;
+                }
+                if (split_entry(text, &sp->dep_names[sp->n_deps],
+                                &sp->dep_constraints[sp->n_deps]) != 0)
+                    goto oom;
+                sp->n_deps++;
+            }
+            break;
+
+        case SEC_PLATFORMS:
+            if (grow((void **)&lf->platforms, lf->n_platforms, &plat_cap,
+                     sizeof(char *)) != 0)
+                goto oom;
+            lf->platforms[lf->n_platforms] = strdup(text);
+            if (!lf->platforms[lf->n_platforms]) goto oom;
+            lf->n_platforms++;
+            break;
+
+        case SEC_DEPENDENCIES:
+            if (indent != 2) break;
+            if (grow((void **)&lf->deps, lf->n_deps, &dep_cap,
+                     sizeof(*lf->deps)) != 0)
+                goto oom;
+            if (split_entry(text, &lf->deps[lf->n_deps].name,
+                            &lf->deps[lf->n_deps].constraint) != 0)
+                goto oom;
+            lf->n_deps++;
+            break;
+
+        case SEC_RUBY_VERSION:
+            if (!lf->ruby_version && !(lf->ruby_version = strdup(text)))
+                goto oom;
+            break;
+
+        case SEC_BUNDLED_WITH:
+            if (!lf->bundled_with && !(lf->bundled_with = strdup(text)))
+                goto oom;
+            break;
+
+        default:
+            break;
+        }
+    }
+    goto out;
+
+oom:
+    fprintf(stderr, "wow: out of memory reading %s\n", path);
+    rc = -1;
+out:
+    free(line);
+    fclose(f);
+    if (rc != 0) wow_lockfile_free(lf);
+    return rc;
+}
+
+void wow_lockfile_free(struct wow_lockfile *lf)
+{
+    for (int i = 0; i < lf->n_specs; i++) {
+        struct wow_lock_spec *sp = &lf->specs[i];
+        for (int d = 0; d < sp->n_deps; d++) {
+            free(sp->dep_names[d]);
+            free(sp->dep_constraints[d]);
+        }
+        free(sp->dep_names);
+        free(sp->dep_constraints);
+        free(sp->name);
+        free(sp->version);
+        free(sp->platform);
+    }
+    free(lf->specs);
+    for (int i = 0; i < lf->n_platforms; i++)
+        free(lf->platforms[i]);
+    free(lf->platforms);
+    for (int i = 0; i < lf->n_deps; i++) {
+        free(lf->deps[i].name);
+        free(lf->deps[i].constraint);
+    }
+    free(lf->deps);
+    free(lf->remote);
+    free(lf->ruby_version);
+    free(lf->bundled_with);
+    memset(lf, 0, sizeof(*lf));
+}
+
+/* Rank of a spec's platform on this host: 0 best, n_plats = generic,
+ * -1 unusable here */
+static int platform_rank(const char *platform, const char *const *plats,
+                         int n_plats)
+{
+    if (!platform || strcmp(platform, "ruby") == 0) return n_plats;
+    for (int k = 0; k < n_plats; k++)
+        if (strcmp(platform, plats[k]) == 0) return k;
+    return -1;
+}
+
+static int resolved_name_cmp(const void *a, const void *b)
+{
+    const wow_resolved_pkg *pa = a, *pb = b;
+    return strcmp(pa->name, pb->name);
+}
+
+int wow_lockfile_select(const struct wow_lockfile *lf,
+                        const char *const *plats, int n_plats,
+                        wow_resolved_pkg **out, int *n_out,
+                        char *why, size_t whysz)
+{
+    *out = NULL;
+    *n_out = 0;
+    if (lf->n_specs == 0) {
+        snprintf(why, whysz, "lockfile has no specs");
+        return -1;
+    }
+
+    wow_resolved_pkg *pkgs = calloc((size_t)lf->n_specs, sizeof(*pkgs));
+    int *rank = calloc((size_t)lf->n_specs, sizeof(int));
+    if (!pkgs || !rank) {
+        free(pkgs); free(rank);
+        snprintf(why, whysz, "out of memory");
+        return -1;
+    }
+
+    /* One entry per gem name, keeping its best variant for this host */
+    int n = 0;
+    for (int i = 0; i < lf->n_specs; i++) {
+        const struct wow_lock_spec *sp = &lf->specs[i];
+        int r = platform_rank(sp->platform, plats, n_plats);
+
+        int j = 0;
+        while (j < n && strcmp(pkgs[j].name, sp->name) != 0) j++;
+        if (j == n) {
+            pkgs[n].name = sp->name;
+            rank[n] = -1;
+            n++;
+        }
+        if (r < 0 || (rank[j] >= 0 && rank[j] <= r)) continue;
+
+        if (wow_gemver_parse(sp->version, &pkgs[j].version) != 0) {
+            snprintf(why, whysz, "invalid version for %s: %s",
+                     sp->name, sp->version);
+            free(pkgs); free(rank);
+            return -1;
+        }
+        pkgs[j].platform = r < n_plats ? sp->platform : NULL;
+        rank[j] = r;
+    }
+
+    for (int j = 0; j < n; j++) {
+        if (rank[j] < 0) {
+            snprintf(why, whysz, "no variant of %s for this platform",
+                     pkgs[j].name);
+            free(pkgs); free(rank);
+            return -1;
+        }
+    }
+    free(rank);
+
+    qsort(pkgs, (size_t)n, sizeof(*pkgs), resolved_name_cmp);
+    *out = pkgs;
+    *n_out = n;
+    return 0;
+}
+
+int wow_lockfile_select_host(const struct wow_lockfile *lf,
+                             wow_resolved_pkg **out, int *n_out,
+                             char *why, size_t whysz)
+{
+    char host[WOW_CI_MAX_PLATFORMS][WOW_CI_PLATFORM_LEN];
+    const char *host_ptrs[WOW_CI_MAX_PLATFORMS];
+    int n_host = wow_ci_host_platforms(host, WOW_CI_MAX_PLATFORMS);
+    for (int k = 0; k < n_host; k++)
+        host_ptrs[k] = host[k];
+    return wow_lockfile_select(lf, host_ptrs, n_host, out, n_out,
+                               why, whysz);
+}
+
+static const wow_resolved_pkg *find_pkg(const wow_resolved_pkg *pkgs,
+                                        int n_pkgs, const char *name)
+{
+    wow_resolved_pkg key = { .name = name };
+    return bsearch(&key, pkgs, (size_t)n_pkgs, sizeof(*pkgs),
+                   resolved_name_cmp);
+}
+
+/* Does pkg satisfy constraint string c (NULL = any)?  -1 if c is bad */
+static int pkg_matches(const wow_resolved_pkg *pkg, const char *c)
+{
+    if (!c) return 1;
+    wow_gem_constraints cs;
+    if (wow_gem_constraints_parse(c, &cs) != 0) return -1;
+    return wow_gemver_match(&cs, &pkg->version) ? 1 : 0;
+}
+
+/* The lock spec wow_lockfile_select picked for pkg (same platform), or
+ * NULL */
+static const struct wow_lock_spec *selected_spec(const struct wow_lockfile *lf,
+                                                 const wow_resolved_pkg *pkg)
+{
+    for (int k = 0; k < lf->n_specs; k++) {
+        const struct wow_lock_spec *c = &lf->specs[k];
+        if (strcmp(c->name, pkg->name) == 0 &&
+            strcmp(c->version, pkg->version.raw) == 0 &&
+            (pkg->platform ? c->platform &&
+                             strcmp(c->platform, pkg->platform) == 0
+                           : !c->platform || strcmp(c->platform, "ruby") == 0))
+            return c;
+    }
+    return NULL;
+}
+
+static int constraint_eq(const wow_gem_constraint *a,
+                         const wow_gem_constraint *b)
+{
+    /* "~> 1.0" and "~> 1.0.0" compare equal as versions but differ */
+    return a->op == b->op && wow_gemver_cmp(&a->ver, &b->ver) == 0 &&
+           (a->op != WOW_OP_PESSIMISTIC || a->ver.n_segs == b->ver.n_segs);
+}
+
+static int constraint_in(const wow_gem_constraint *c,
+                         const wow_gem_constraints *set)
+{
+    for (int i = 0; i < set->count; i++)
+        if (constraint_eq(c, &set->items[i])) return 1;
+    return 0;
+}
+
+/* Do constraint strings a and b (NULL or "" = any) name the same set,
+ * whatever their order and spacing?  Unparseable never matches. */
+static int same_constraints(const char *a, const char *b)
+{
+    wow_gem_constraints ca, cb;
+    if (wow_gem_constraints_parse(a && a[0] ? a : ">= 0", &ca) != 0 ||
+        wow_gem_constraints_parse(b && b[0] ? b : ">= 0", &cb) != 0)
+        return 0;
+    for (int i = 0; i < ca.count; i++)
+        if (!constraint_in(&ca.items[i], &cb)) return 0;
+    for (int i = 0; i < cb.count; i++)
+        if (!constraint_in(&cb.items[i], &ca)) return 0;
+    return 1;
+}
+
+/* Compare source URLs ignoring a trailing slash */
+static int same_source(const char *a, const char *b)
+{
+    size_t la = strlen(a), lb = strlen(b);
+    if (la > 0 && a[la - 1] == '/') la--;
+    if (lb > 0 && b[lb - 1] == '/') lb--;
+    return la == lb && strncmp(a, b, la) == 0;
+}
+
+int wow_lockfile_satisfies(const struct wow_lockfile *lf,
+                           const struct wow_gemfile *gf,
+                           const char *source,
+                           const wow_resolved_pkg *pkgs, int n_pkgs,
+                           char *why, size_t whysz)
+{
+    if (!lf->remote || !same_source(lf->remote, source)) {
+        snprintf(why, whysz, "source changed to %s", source);
+        return 0;
+    }
+
+    if ((size_t)lf->n_deps != gf->n_deps) {
+        snprintf(why, whysz, "Gemfile has %zu dependencies, lock has %d",
+                 gf->n_deps, lf->n_deps);
+        return 0;
+    }
+
+    /* Direct deps: same names, same constraints, locked versions fit */
+    for (size_t i = 0; i < gf->n_deps; i++) {
+        const struct wow_gemfile_dep *gd = &gf->deps[i];
+        char joined[512] = "";
+        if (gd->n_constraints > 0)
+            wow_join_constraints(gd->constraints, gd->n_constraints,
+                                 joined, sizeof(joined));
+
+        const struct wow_lock_dep *ld = NULL;
+        for (int k = 0; k < lf->n_deps && !ld; k++)
+            if (strcmp(lf->deps[k].name, gd->name) == 0)
+                ld = &lf->deps[k];
+        if (!ld) {
+            snprintf(why, whysz, "%s is not in the lock", gd->name);
+            return 0;
+        }
+        if (!same_constraints(ld->constraint, joined)) {
+            snprintf(why, whysz, "constraint for %s changed", gd->name);
+            return 0;
+        }
+
+        const wow_resolved_pkg *pkg = find_pkg(pkgs, n_pkgs, gd->name);
+        if (!pkg || pkg_matches(pkg, joined[0] ? joined : NULL) != 1) {
+            snprintf(why, whysz, "locked %s does not satisfy the Gemfile",
+                     gd->name);
+            return 0;
+        }
+    }
+
+    /* Closure: the deps of every spec that would be installed here are
+     * locked at a fitting version (other platforms' variants may
+     * depend on gems this host never needs) */
+    for (int i = 0; i < n_pkgs; i++) {
+        const struct wow_lock_spec *sp = selected_spec(lf, &pkgs[i]);
+        if (!sp) {
+            snprintf(why, whysz, "%s %s is not in the lock", pkgs[i].name,
+                     pkgs[i].version.raw);
+            return 0;
+        }
+        for (int d = 0; d < sp->n_deps; d++) {
+            const wow_resolved_pkg *pkg =
+                find_pkg(pkgs, n_pkgs, sp->dep_names[d]);
+            if (!pkg || pkg_matches(pkg, sp->dep_constraints[d]) != 1) {
+                snprintf(why, whysz, "%s (required by %s) is not locked "
+                         "at a matching version", sp->dep_names[d],
+                         sp->name);
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/* ------------------------------------------------------------------ */
+/* Lock-seeded provider                                                */
+/* ------------------------------------------------------------------ */
+
+struct wow_lock_prov_deps {
+    const char         **names;     /* point into the lockfile */
+    wow_gem_constraints *cs;
+    int                  n;
+    int                  loaded;
+};
+
+int wow_lock_provider_init(wow_lock_provider *lp,
+                           const struct wow_lockfile *lf,
+                           const wow_resolved_pkg *pkgs, int n_pkgs,
+                           const char *source, wow_provider *inner)
+{
+    memset(lp, 0, sizeof(*lp));
+    lp->inner = inner;
+    if (!lf || !lf->remote || !same_source(lf->remote, source) ||
+        n_pkgs <= 0)
+        return 0;
+
+    lp->deps = calloc((size_t)n_pkgs, sizeof(*lp->deps));
+    if (!lp->deps) return -1;
+    lp->lf = lf;
+    lp->pkgs = pkgs;
+    lp->n_pkgs = n_pkgs;
+    return 0;
+}
+
+/* The locked entry for package if `version` is the locked one */
+static int locked_index(const wow_lock_provider *lp, const char *package,
+                        const wow_gemver *version)
+{
+    const wow_resolved_pkg *pkg = find_pkg(lp->pkgs, lp->n_pkgs, package);
+    if (!pkg) return -1;
+    if (version && wow_gemver_cmp(&pkg->version, version) != 0) return -1;
+    return (int)(pkg - lp->pkgs);
+}
+
+/* Parse the lock's deps for pkgs[i] (the selected variant's spec) */
+static int load_locked_deps(wow_lock_provider *lp, int i)
+{
+    struct wow_lock_prov_deps *d = &lp->deps[i];
+    if (d->loaded) return 0;
+
+    const struct wow_lock_spec *sp = selected_spec(lp->lf, &lp->pkgs[i]);
+    if (!sp) return -1;
+
+    if (sp->n_deps > 0) {
+        d->names = calloc((size_t)sp->n_deps, sizeof(char *));
+        d->cs = calloc((size_t)sp->n_deps, sizeof(wow_gem_constraints));
+        if (!d->names || !d->cs) {
+            free(d->names); free(d->cs);
+            d->names = NULL; d->cs = NULL;
+            return -1;
+        }
+    }
+    for (int k = 0; k < sp->n_deps; k++) {
+        const char *c = sp->dep_constraints[k];
+        d->names[k] = sp->dep_names[k];
+        if (wow_gem_constraints_parse(c ? c : ">= 0", &d->cs[k]) != 0) {
+            fprintf(stderr, "wow: Gemfile.lock: invalid constraint for "
+                    "%s: %s\n", sp->dep_names[k], c);
+            return -1;
+        }
+    }
+    d->n = sp->n_deps;
+    d->loaded = 1;
+    return 0;
+}
+
+static int lp_list_versions(void *ctx, const char *package,
+                            const wow_gemver **out, int *n_out)
+{
+    wow_lock_provider *lp = ctx;
+    return lp->inner->list_versions(lp->inner->ctx, package, out, n_out);
+}
+
+static int lp_get_deps(void *ctx, const char *package,
+                       const wow_gemver *version,
+                       const char ***dep_names_out,
+                       wow_gem_constraints **dep_constraints_out,
+                       int *n_deps_out)
+{
+    wow_lock_provider *lp = ctx;
+    int i = locked_index(lp, package, version);
+    if (i >= 0 && load_locked_deps(lp, i) == 0) {
+        *dep_names_out = lp->deps[i].names;
+        *dep_constraints_out = lp->deps[i].cs;
+        *n_deps_out = lp->deps[i].n;
+        return 0;
+    }
+    return lp->inner->get_deps(lp->inner->ctx, package, version,
+                               dep_names_out, dep_constraints_out,
+                               n_deps_out);
+}
+
+static const char *lp_get_platform(void *ctx, const char *package,
+                                   const wow_gemver *version)
+{
+    wow_lock_provider *lp = ctx;
+    int i = locked_index(lp, package, version);
+    if (i >= 0) return lp->pkgs[i].platform;
+    if (!lp->inner->get_platform) return NULL;
+    return lp->inner->get_platform(lp->inner->ctx, package, version);
+}
+
+static const wow_gemver *lp_preferred_version(void *ctx,
+                                              const char *package)
+{
+    wow_lock_provider *lp = ctx;
+    int i = locked_index(lp, package, NULL);
+    return i >= 0 ? &lp->pkgs[i].version : NULL;
+}
+
+wow_provider wow_lock_provider_as_provider(wow_lock_provider *lp)
+{
+    wow_provider prov;
+    prov.list_versions = lp_list_versions;
+    prov.get_deps = lp_get_deps;
+    prov.get_platform = lp_get_platform;
+    prov.preferred_version = lp_preferred_version;
+    prov.ctx = lp;
+    return prov;
+}
+
+void wow_lock_provider_destroy(wow_lock_provider *lp)
+{
+    for (int i = 0; i < lp->n_pkgs; i++) {
+        free(lp->deps[i].names);
+        free(lp->deps[i].cs);
+    }
+    free(lp->deps);
+    memset(lp, 0, sizeof(*lp));
+}
+
+int wow_lockfile_prefetch(const struct wow_lockfile *lf,
+                          wow_ci_provider *ci)
+{
+    if (lf->n_specs == 0) return 0;
+    const char **names = malloc((size_t)lf->n_specs * sizeof(*names));
+    if (!names) return -1;
+    for (int i = 0; i < lf->n_specs; i++)
+        names[i] = lf->specs[i].name;
+    int rc = wow_ci_provider_prefetch(ci, names, lf->n_specs, 0);
+    free(names);
+    return rc;
+}
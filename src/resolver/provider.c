@@ -9,13 +9,34 @@
  *
  * - Deps are comma-separated before the pipe
  * - Multiple constraints per dep are &-separated
- * - Platform versions have a dash suffix: "1.0.0-java"
- * - We filter to ruby-platform-only (no dash, or -ruby)
+ * - Platform versions have a dash suffix: "1.0.0-x86_64-linux"
+ * - We keep generic versions (no dash, or -ruby) and the host's
+ *   platforms; per version only the best variant survives
+ *
+ * A file:// source reads <dir>/info/{name} from disk instead (a missing
+ * file is a 404), which is how the resolver benchmarks replay recorded
+ * index data.  WOW_CI_RECORD=<dir> saves every /info body fetched over
+ * HTTP to <dir>/info/{name} in the same layout.
+ *
+ * Over HTTP a running `wow daemon` is asked first (see daemon.h); it
+ * answers from its warm cache and pool, and in-process fetching is the
+ * fallback.
  */
 
+#include "wow/common.h"
+#include "wow/daemon.h"
+#include "wow/resolver/citok.h"
 #include "wow/resolver/provider.h"
 #include "wow/http.h"
-
+#include "wow/rubies/resolve.h"
+#include "wow/util/mem.h"
+#include "wow/util/path.h"
+#include "wow/util/sha256.h"
+#include "wow/util/time.h"
+#include "wow/util/trace.h"
+
+#include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -50,55 +71,113 @@ static wow_aoff arena_strndup_off(wow_arena *a, const char *s, size_t n)
 /* ------------------------------------------------------------------ */
 
 /*
- * Parse a single compact index version line into a wow_ci_pkg entry.
- * Returns 0 on success, -1 to skip (platform/metadata filter), -2 on error.
- *
- * When ruby_ver is non-NULL, the metadata section after '|' is checked
- * for a ruby: constraint.  If the target Ruby version doesn't satisfy
- * it, the version is skipped (-1).
- *
- * The line has already been stripped of trailing newline.
+ * One line of a tokenized /info body.  d[0..nd) are the offsets of the
+ * delimiters inside the line (see citok.h), counted from the start of
+ * the tokenized buffer; base is where the line starts in that buffer.
+ */
+struct ci_line {
+    const char     *s;
+    size_t          len;        /* without the '\n' or a trailing '\r' */
+    const uint32_t *d;
+    size_t          nd;
+    uint32_t        base;
+};
+
+/* Offset of delimiter k within the line */
+static inline size_t delim_at(const struct ci_line *ln, size_t k)
+{
+    return (size_t)(ln->d[k] - ln->base);
+}
+
+/* Index of the first delimiter c at or after index k, or ln->nd */
+static size_t next_delim(const struct ci_line *ln, size_t k, char c)
+{
+    while (k < ln->nd && ln->s[delim_at(ln, k)] != c) k++;
+    return k;
+}
+
+/*
+ * Parse the '&'-separated constraints in bytes [a, b) of the line, whose
+ * delimiters are indices [k, ke).  Pieces that are only whitespace are
+ * ignored, as wow_gem_constraints_parse() does with "a, , b".
  */
-static int parse_ci_line(wow_arena *arena, const char *line,
-                          const wow_gemver *ruby_ver,
-                          wow_gemver *ver_out,
-                          wow_aoff *deps_offset_out, int *n_deps_out)
+static int parse_amp_constraints(const struct ci_line *ln, size_t a,
+                                 size_t b, size_t k, size_t ke,
+                                 wow_gem_constraints *cs)
+{
+    cs->count = 0;
+    for (;;) {
+        while (k < ke && ln->s[delim_at(ln, k)] != '&') k++;
+        size_t end = k < ke ? delim_at(ln, k) : b;
+
+        const char *p = ln->s + a;
+        const char *e = ln->s + end;
+        while (p < e && (*p == ' ' || *p == '\t')) p++;
+        if (p < e) {
+            if (cs->count == WOW_MAX_CONSTRAINTS) break;
+            if (wow_gem_constraint_parse_n(p, (size_t)(e - p),
+                                           &cs->items[cs->count]) != 0)
+                return -1;
+            cs->count++;
+        }
+        if (k >= ke) break;
+        a = end + 1;
+        k++;
+    }
+    return cs->count > 0 ? 0 : -1;
+}
+
+static int parse_ci_line(wow_arena *arena, const struct ci_line *ln,
+                         const wow_gemver *ruby_ver,
+                         const char (*platforms)[WOW_CI_PLATFORM_LEN],
+                         int n_platforms,
+                         wow_gemver *ver_out, int *platform_out,
+                         wow_aoff *deps_offset_out, int *n_deps_out)
 {
     *n_deps_out = 0;
     *deps_offset_out = WOW_AOFF_NULL;
+    *platform_out = 0;
 
     /* Split: "version deps|metadata" */
-    const char *sp = strchr(line, ' ');
-    if (!sp) return -2;
+    size_t k_sp = next_delim(ln, 0, ' ');
+    if (k_sp == ln->nd) return -2;
+    size_t sp = delim_at(ln, k_sp);
 
     /* Version string (may have platform suffix: "1.0.0-java") */
-    size_t vlen = (size_t)(sp - line);
-    char vbuf[128];
-    if (vlen >= sizeof(vbuf)) return -2;
-    memcpy(vbuf, line, vlen);
-    vbuf[vlen] = '\0';
+    size_t vlen = sp;
+    if (vlen >= WOW_VER_RAW_SZ) return -2;
 
     /* Check for platform suffix: a dash followed by a letter */
     size_t effective_len = vlen;
-    for (size_t i = 0; i < vlen; i++) {
-        if (vbuf[i] == '-' && i + 1 < vlen &&
-            ((vbuf[i + 1] >= 'a' && vbuf[i + 1] <= 'z') ||
-             (vbuf[i + 1] >= 'A' && vbuf[i + 1] <= 'Z'))) {
-            /* Platform-specific version — check if it's "ruby" */
-            if (strcmp(vbuf + i + 1, "ruby") != 0)
-                return -1;  /* skip non-ruby platforms */
+    for (size_t i = 0; i + 1 < vlen; i++) {
+        char c = ln->s[i + 1];
+        if (ln->s[i] == '-' &&
+            ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))) {
+            /* Platform-specific version — "ruby" or one of the host's */
+            const char *plat = ln->s + i + 1;
+            size_t plen = vlen - i - 1;
+            if (plen != 4 || memcmp(plat, "ruby", 4) != 0) {
+                int k = 0;
+                while (k < n_platforms &&
+                       (strlen(platforms[k]) != plen ||
+                        memcmp(plat, platforms[k], plen) != 0))
+                    k++;
+                if (k == n_platforms)
+                    return -1;  /* skip other platforms (java, mingw, …) */
+                *platform_out = k + 1;
+            }
             effective_len = i;
             break;
         }
     }
-    vbuf[effective_len] = '\0';
 
-    if (wow_gemver_parse(vbuf, ver_out) != 0)
+    if (wow_gemver_parse_n(ln->s, effective_len, ver_out) != 0)
         return -2;
 
     /* Find the pipe separator */
-    const char *pipe = strchr(sp + 1, '|');
-    if (!pipe) return -2;
+    size_t k_pipe = next_delim(ln, k_sp + 1, '|');
+    if (k_pipe == ln->nd) return -2;
+    size_t pipe = delim_at(ln, k_pipe);
 
     /* Check ruby: metadata constraint before allocating deps.
      * Compact index metadata after '|':
@@ -107,172 +186,280 @@ static int parse_ci_line(wow_arena *arena, const char *line,
      * We filter on ruby: but not rubygems: — wowx doesn't use
      * RubyGems internals, so the rubygems constraint isn't meaningful. */
     if (ruby_ver) {
-        const char *meta = pipe + 1;
-        const char *rm = strstr(meta, "ruby:");
-        /* Ensure key boundary — not a substring of e.g. "rubygems:" */
-        while (rm && rm != meta && *(rm - 1) != ',')
-            rm = strstr(rm + 1, "ruby:");
-
-        if (rm) {
-            const char *val = rm + 5;  /* past "ruby:" */
-            const char *end = strchr(val, ',');
-            size_t rlen = end ? (size_t)(end - val) : strlen(val);
-
-            /* Convert & to , for constraint parsing */
-            char cbuf[128];
-            if (rlen < sizeof(cbuf)) {
-                char *wp = cbuf;
-                for (size_t i = 0; i < rlen; i++) {
-                    if (val[i] == '&') {
-                        *wp++ = ',';
-                        *wp++ = ' ';
-                    } else {
-                        *wp++ = val[i];
-                    }
-                }
-                *wp = '\0';
-
+        size_t a = pipe + 1, k = k_pipe + 1;
+        for (;;) {
+            size_t ke = next_delim(ln, k, ',');
+            size_t b = ke < ln->nd ? delim_at(ln, ke) : ln->len;
+            if (b - a >= 5 && memcmp(ln->s + a, "ruby:", 5) == 0) {
+                /* The key's own ':' is delimiter k; the value follows */
                 wow_gem_constraints rc;
-                if (wow_gem_constraints_parse(cbuf, &rc) == 0) {
-                    if (!wow_gemver_match(&rc, ruby_ver))
-                        return -1;  /* Ruby version incompatible */
-                }
+                if (parse_amp_constraints(ln, a + 5, b, k + 1, ke,
+                                          &rc) == 0 &&
+                    !wow_gemver_match(&rc, ruby_ver))
+                    return -1;  /* Ruby version incompatible */
+                break;
             }
+            if (ke == ln->nd) break;
+            a = b + 1;
+            k = ke + 1;
         }
     }
 
-    /* Parse deps between sp+1 and pipe */
-    const char *deps_start = sp + 1;
-    size_t deps_len = (size_t)(pipe - deps_start);
-
-    if (deps_len == 0 || (deps_len == 1 && *deps_start == ' ')) {
+    /* Deps between sp+1 and pipe: "name:c1&c2,name:c3" */
+    size_t deps_len = pipe - (sp + 1);
+    if (deps_len == 0 || (deps_len == 1 && ln->s[sp + 1] == ' ')) {
         /* No deps */
         return 0;
     }
 
-    /* Copy deps section to a mutable buffer — use malloc (NOT arena) so that
-     * tok/dep_name/constraints_raw pointers remain stable across arena growth */
-    char *deps_buf = malloc(deps_len + 1);
-    if (!deps_buf) return -2;
-    memcpy(deps_buf, deps_start, deps_len);
-    deps_buf[deps_len] = '\0';
-
-    /* Count colons to estimate dep count (each dep has exactly one colon) */
+    /* Count colons to size the deps array (each dep has exactly one) */
     int max_deps = 0;
-    for (size_t i = 0; i < deps_len; i++)
-        if (deps_buf[i] == ':') max_deps++;
-
-    if (max_deps == 0) { free(deps_buf); return 0; }
+    for (size_t k = k_sp + 1; k < k_pipe; k++)
+        if (ln->s[delim_at(ln, k)] == ':') max_deps++;
+    if (max_deps == 0) return 0;
 
     /* Allocate deps array in arena, remember offset */
     wow_aoff deps_off = wow_arena_alloc_off(
         arena, (size_t)max_deps * sizeof(struct wow_ci_dep));
-    if (deps_off == WOW_AOFF_NULL) { free(deps_buf); return -2; }
+    if (deps_off == WOW_AOFF_NULL) return -2;
     int n = 0;
 
-    char *tok = deps_buf;
-    while (tok && *tok) {
-        /* Find the next comma (dep separator) */
-        char *comma = strchr(tok, ',');
-        if (comma) *comma = '\0';
-
-        /* Split "name:c1&c2" at the colon */
-        char *colon = strchr(tok, ':');
-        if (colon && n < max_deps) {
-            *colon = '\0';
-            const char *dep_name = tok;
-            const char *constraints_raw = colon + 1;
-
-            /* Convert & to , for constraint parsing: "~> 4.0&>= 3.1" → "~> 4.0, >= 3.1" */
-            size_t clen = strlen(constraints_raw);
-            char *cbuf = wow_arena_alloc(arena, clen * 2 + 1);
-            if (!cbuf) { free(deps_buf); return -2; }
-            char *p = cbuf;
-            for (size_t i = 0; i < clen; i++) {
-                if (constraints_raw[i] == '&') {
-                    *p++ = ',';
-                    *p++ = ' ';
-                } else {
-                    *p++ = constraints_raw[i];
-                }
-            }
-            *p = '\0';
-
-            /* Re-fetch deps pointer — arena may have grown during cbuf alloc */
+    size_t a = sp + 1, k = k_sp + 1;
+    while (k <= k_pipe) {
+        /* Dep runs to the next ',' (or the pipe) */
+        size_t ke = k;
+        while (ke < k_pipe && ln->s[delim_at(ln, ke)] != ',') ke++;
+        size_t b = delim_at(ln, ke);
+
+        /* Split "name:c1&c2" at the first colon */
+        size_t kc = k;
+        while (kc < ke && ln->s[delim_at(ln, kc)] != ':') kc++;
+        if (kc < ke && n < max_deps) {
+            size_t colon = delim_at(ln, kc);
+
+            /* Parse straight into the arena; no allocation happens
+             * between fetching deps and using it */
             struct wow_ci_dep *deps = WOW_ARENA_PTR(arena, deps_off,
                                                      struct wow_ci_dep);
-
-            if (wow_gem_constraints_parse(cbuf, &deps[n].constraints) != 0) {
-                /* Skip unparseable constraint — better than failing entirely */
-                tok = comma ? comma + 1 : NULL;
-                continue;
+            if (parse_amp_constraints(ln, colon + 1, b, kc + 1, ke,
+                                      &deps[n].constraints) == 0) {
+                /* Store dep name — arena_strndup_off may grow the
+                 * arena (realloc), so the deps pointer is re-fetched
+                 * after it. */
+                wow_aoff name_off = arena_strndup_off(arena, ln->s + a,
+                                                      colon - a);
+                deps = WOW_ARENA_PTR(arena, deps_off, struct wow_ci_dep);
+                deps[n].name = name_off;
+                n++;
             }
-
-            /* Store dep name — arena_strndup_off may grow the arena
-             * (realloc), so we must NOT use the deps pointer until
-             * we re-fetch it AFTER the allocation. */
-            wow_aoff name_off = arena_strndup_off(arena, dep_name,
-                                                    strlen(dep_name));
-
-            /* Re-fetch deps — arena may have grown during strndup */
-            deps = WOW_ARENA_PTR(arena, deps_off, struct wow_ci_dep);
-            deps[n].name = name_off;
-            n++;
+            /* else: skip unparseable constraint — better than failing
+             * the whole version */
         }
 
-        tok = comma ? comma + 1 : NULL;
+        a = b + 1;
+        k = ke + 1;
     }
 
-    free(deps_buf);
     *deps_offset_out = deps_off;
     *n_deps_out = n;
     return 0;
 }
 
+int wow_ci_parse_line(wow_arena *arena, const char *line,
+                      const wow_gemver *ruby_ver,
+                      const char (*platforms)[WOW_CI_PLATFORM_LEN],
+                      int n_platforms,
+                      wow_gemver *ver_out, int *platform_out,
+                      wow_aoff *deps_offset_out, int *n_deps_out)
+{
+    size_t len = strlen(line);
+    uint32_t stack[512];
+    uint32_t *d = len <= 512 ? stack : malloc(len * sizeof(*d));
+    if (!d) return -2;
+
+    struct ci_line ln = { line, len, d, 0, 0 };
+    ln.nd = wow_ci_tokenize_into(line, len, d);
+    int rc = parse_ci_line(arena, &ln, ruby_ver, platforms, n_platforms,
+                           ver_out, platform_out, deps_offset_out,
+                           n_deps_out);
+    if (d != stack) free(d);
+    return rc;
+}
+
+/* Is variant a preferred over variant b?  Host platforms in list order
+ * beat the generic gem (0), which needs a compiler for native code. */
+static bool platform_better(int a, int b)
+{
+    if (a == 0) return false;
+    return b == 0 || a < b;
+}
+
 /* ------------------------------------------------------------------ */
 /* Fetch + parse compact index for a package                           */
 /* ------------------------------------------------------------------ */
 
+/* Serve url (file:///dir/info/name) from disk as if over HTTP */
+static int read_info_file(const char *url, struct wow_response *resp)
+{
+    memset(resp, 0, sizeof(*resp));
+    FILE *f = fopen(url + strlen("file://"), "rb");
+    if (!f) {
+        if (errno != ENOENT) return -1;
+        resp->status = 404;
+        return 0;
+    }
+
+    size_t cap = 16384, len = 0;
+    char *body = malloc(cap);
+    size_t n;
+    while (body && (n = fread(body + len, 1, cap - len - 1, f)) > 0) {
+        len += n;
+        if (cap - len - 1 == 0) {
+            char *nb = realloc(body, cap * 2);
+            if (!nb) { free(body); body = NULL; break; }
+            body = nb;
+            cap *= 2;
+        }
+    }
+    int err = ferror(f);
+    fclose(f);
+    if (!body || err) { free(body); return -1; }
+
+    body[len] = '\0';
+    resp->status = 200;
+    resp->body = body;
+    resp->body_len = len;
+    return 0;
+}
+
 /*
- * Fetch and parse the compact index for a package.
- * Adds to provider cache. Returns the cached pkg or NULL on error.
+ * Is name safe as a file name under info/?  Gem names use the RubyGems
+ * charset [A-Za-z0-9._-]; anything else (a slash, say) or a bare "."
+ * or ".." could write outside the record directory.
  */
-static struct wow_ci_pkg *fetch_package(wow_ci_provider *prov,
-                                         const char *name)
+static int recordable_name(const char *name)
+{
+    if (!name[0] || strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+        return 0;
+    for (const char *p = name; *p; p++)
+        if (!((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') ||
+              (*p >= '0' && *p <= '9') || *p == '.' || *p == '_' ||
+              *p == '-'))
+            return 0;
+    return 1;
+}
+
+/* WOW_CI_RECORD: keep a copy of each /info body (best effort) */
+static void record_info(const char *name, const struct wow_response *resp)
+{
+    const char *dir = getenv("WOW_CI_RECORD");
+    if (!dir || !dir[0]) return;
+    if (!recordable_name(name)) {
+        fprintf(stderr, "wow: not recording /info for invalid gem name: %s\n",
+                name);
+        return;
+    }
+
+    char path[WOW_OS_PATH_MAX];
+    snprintf(path, sizeof(path), "%s/info", dir);
+    if (wow_mkdirs(path, 0755) != 0) return;
+    snprintf(path, sizeof(path), "%s/info/%s", dir, name);
+
+    FILE *f = fopen(path, "wb");
+    if (!f) return;
+    fwrite(resp->body, 1, resp->body_len, f);
+    fclose(f);
+}
+
+/*
+ * GET /info/{name} (or read it from a file:// source) into resp.
+ * Touches no provider state besides *st, so the shared provider runs
+ * several at once outside its lock.  On success resp holds a 200 or 404
+ * response; anything else is reported and -1 returned.
+ */
+static int fetch_info(const wow_ci_provider *prov,
+                      struct wow_http_pool *pool, const char *name,
+                      struct wow_response *resp, wow_ci_stats *st)
 {
     /* Build URL: source_url/info/name */
     char url[512];
     snprintf(url, sizeof(url), "%s/info/%s", P_STR(prov->source_url), name);
 
     /* Fetch */
-    struct wow_response resp;
     int rc;
-    if (prov->pool)
-        rc = wow_http_pool_get(prov->pool, url, &resp);
+    uint64_t t0 = wow_trace_begin();
+    double start = wow_now_secs();
+    int local = strncmp(url, "file://", 7) == 0;
+    if (local)
+        rc = read_info_file(url, resp);
+    else if (wow_daemon_get(url, resp) == 0) {
+        rc = 0;
+        st->via_daemon++;
+    } else if (pool)
+        rc = wow_http_pool_get(pool, url, resp);
     else
-        rc = wow_http_get(url, &resp);
+        rc = wow_http_get(url, resp);
+    st->fetch_secs += wow_now_secs() - start;
+    wow_trace_end(t0, "provider", "fetch", name);
 
     if (rc != 0) {
         fprintf(stderr, "wow: failed to fetch %s\n", url);
-        return NULL;
+        return -1;
     }
+    st->fetch_bytes += resp->body_len;
+    if (resp->status == 200 && !local)
+        record_info(name, resp);
 
-    if (resp.status == 404) {
-        /* Package not found — return empty cache entry */
-        wow_response_free(&resp);
-        if (prov->n_pkgs >= WOW_CI_MAX_PKGS) return NULL;
-
-        struct wow_ci_pkg *pkg = &prov->pkgs[prov->n_pkgs++];
-        memset(pkg, 0, sizeof(*pkg));
-        pkg->name = wow_arena_strdup_off(&prov->arena, name);
-        return pkg;
+    if (resp->status != 200 && resp->status != 404) {
+        fprintf(stderr, "wow: %s returned HTTP %d\n", url, resp->status);
+        wow_response_free(resp);
+        return -1;
     }
+    return 0;
+}
 
-    if (resp.status != 200) {
-        fprintf(stderr, "wow: %s returned HTTP %d\n", url, resp.status);
-        wow_response_free(&resp);
-        return NULL;
-    }
+/*
+ * Make a filled-in package visible to find_cached().  The release store
+ * pairs with the acquire load there: a reader that sees the new count
+ * also sees the entry and everything it points at in the arena.
+ */
+static struct wow_ci_pkg *publish_pkg(wow_ci_provider *prov,
+                                      const struct wow_ci_pkg *pkg)
+{
+    int n = prov->n_pkgs;
+    prov->pkgs[n] = *pkg;
+    __atomic_store_n(&prov->n_pkgs, n + 1, __ATOMIC_RELEASE);
+    return &prov->pkgs[n];
+}
+
+/* Arena copy of the SHA-256 of resp's body ("404" for a missing gem) */
+static wow_aoff body_digest(wow_ci_provider *prov,
+                            const struct wow_response *resp)
+{
+    if (resp->status == 404)
+        return wow_arena_strdup_off(&prov->arena, "404");
+
+    char hex[65];
+    wow_sha256_ctx *h = wow_sha256_new();
+    if (!h) return WOW_AOFF_NULL;
+    wow_sha256_update(h, resp->body, resp->body_len);
+    wow_sha256_final(h, hex, sizeof(hex));
+    wow_sha256_free(h);
+    return wow_arena_strdup_off(&prov->arena, hex);
+}
+
+/*
+ * Parse a fetched /info response for a package and add it to the
+ * provider cache; consumes resp.  Returns the cached pkg or NULL on
+ * error.  Writes the arena, so on a shared provider the caller holds
+ * the provider lock.
+ */
+static struct wow_ci_pkg *add_package(wow_ci_provider *prov,
+                                      const char *name,
+                                      struct wow_response *fetched)
+{
+    struct wow_response resp = *fetched;    /* ours from here on */
+    struct wow_ci_pkg pkg = { 0 };
 
     if (prov->n_pkgs >= WOW_CI_MAX_PKGS) {
         fprintf(stderr, "wow: package cache full (max %d)\n",
@@ -281,10 +468,17 @@ static struct wow_ci_pkg *fetch_package(wow_ci_provider *prov,
         return NULL;
     }
 
-    /* Parse the response body line by line */
-    struct wow_ci_pkg *pkg = &prov->pkgs[prov->n_pkgs++];
-    memset(pkg, 0, sizeof(*pkg));
-    pkg->name = wow_arena_strdup_off(&prov->arena, name);
+    pkg.name = wow_arena_strdup_off(&prov->arena, name);
+    pkg.digest = WOW_AOFF_NULL;
+    if (prov->digest_bodies)
+        pkg.digest = body_digest(prov, &resp);
+
+    if (resp.status == 404) {
+        prov->stats.not_found++;
+        /* Package not found — publish an empty cache entry */
+        wow_response_free(&resp);
+        return publish_pkg(prov, &pkg);
+    }
 
     /* Temporary arrays — we don't know the count yet */
     int ver_cap = 128;
@@ -339,40 +533,76 @@ static struct wow_ci_pkg *fetch_package(wow_ci_provider *prov,
         }
     }
 
+    /* Find every delimiter in the body in one pass; lines and fields
+     * are then read off the table without copying. */
+    wow_ci_toks toks = { 0 };
+    if (wow_ci_tokenize(resp.body, resp.body_len, &toks) != 0) {
+        free(vers);
+        free(vdeps);
+        wow_response_free(&resp);
+        return NULL;
+    }
+
     /* Walk lines: skip everything before "---" header */
     bool past_header = false;
-    char *body = resp.body;
-    char *line = body;
-
-    while (line && *line) {
-        /* Find end of line */
-        char *eol = strchr(line, '\n');
-        if (eol) *eol = '\0';
-
+    bool seen_platform = false;
+    const char *body = resp.body;
+    size_t k = 0;
+
+    for (size_t start = 0; start < resp.body_len; ) {
+        /* Delimiters of this line run up to its '\n' */
+        size_t k0 = k;
+        while (k < toks.n && body[toks.pos[k]] != '\n') k++;
+        size_t eol = k < toks.n ? toks.pos[k] : resp.body_len;
+
+        struct ci_line ln = { body + start, eol - start, toks.pos + k0,
+                              k - k0, (uint32_t)start };
         /* Strip trailing \r */
-        size_t ll = strlen(line);
-        if (ll > 0 && line[ll - 1] == '\r')
-            line[ll - 1] = '\0';
+        if (ln.len > 0 && ln.s[ln.len - 1] == '\r')
+            ln.len--;
+
+        start = eol + 1;
+        k++;
 
         if (!past_header) {
-            if (strcmp(line, "---") == 0)
+            if (ln.len == 3 && memcmp(ln.s, "---", 3) == 0)
                 past_header = true;
-            line = eol ? eol + 1 : NULL;
             continue;
         }
 
-        if (line[0] == '\0') {
-            line = eol ? eol + 1 : NULL;
+        if (ln.len == 0)
             continue;
-        }
 
         /* Parse version line */
         wow_gemver ver;
         wow_aoff deps_offset = WOW_AOFF_NULL;
         int n_deps = 0;
-        int prc = parse_ci_line(&prov->arena, line,
-                                 prov->has_ruby_ver ? &prov->ruby_ver : NULL,
-                                 &ver, &deps_offset, &n_deps);
+        int plat = 0;
+        int prc = parse_ci_line(&prov->arena, &ln,
+                                prov->has_ruby_ver ? &prov->ruby_ver : NULL,
+                                (const char (*)[WOW_CI_PLATFORM_LEN])
+                                    prov->platforms,
+                                prov->n_platforms,
+                                &ver, &plat, &deps_offset, &n_deps);
+
+        /* Several variants of one version: keep the best for this host.
+         * Only packages that ship host platform gems pay for the scan. */
+        if (prc == 0 && plat != 0)
+            seen_platform = true;
+        if (prc == 0 && seen_platform) {
+            int dup = -1;
+            for (int i = n_ver - 1; i >= 0; i--) {
+                if (strcmp(vers[i].raw, ver.raw) == 0) { dup = i; break; }
+            }
+            if (dup >= 0) {
+                if (platform_better(plat, vdeps[dup].platform)) {
+                    vdeps[dup].deps_offset = deps_offset;
+                    vdeps[dup].n_deps = n_deps;
+                    vdeps[dup].platform = plat;
+                }
+                continue;
+            }
+        }
 
         if (prc == 0) {
             /* Grow arrays if needed */
@@ -382,6 +612,7 @@ static struct wow_ci_pkg *fetch_package(wow_ci_provider *prov,
                                (size_t)ver_cap * sizeof(wow_gemver));
                 if (!new_vers) {
                     free(vers); free(vdeps);
+                    wow_ci_toks_free(&toks);
                     wow_response_free(&resp);
                     return NULL;
                 }
@@ -390,6 +621,7 @@ static struct wow_ci_pkg *fetch_package(wow_ci_provider *prov,
                                 (size_t)ver_cap * sizeof(struct wow_ci_ver_deps));
                 if (!new_vdeps) {
                     free(vers); free(vdeps);
+                    wow_ci_toks_free(&toks);
                     wow_response_free(&resp);
                     return NULL;
                 }
@@ -399,23 +631,23 @@ static struct wow_ci_pkg *fetch_package(wow_ci_provider *prov,
             vers[n_ver] = ver;
             vdeps[n_ver].deps_offset = deps_offset;
             vdeps[n_ver].n_deps = n_deps;
+            vdeps[n_ver].platform = plat;
 
             /* DEBUG: flag any version with first segment >= 10 (suspicious) */
             if (getenv("WOW_DEBUG_RESOLVE") &&
                 ver.n_segs > 0 && !ver.segs[0].is_str && ver.segs[0].num >= 10) {
                 fprintf(stderr, "[provider] SUSPICIOUS parsed ver[%d] raw=\"%s\" "
-                        "segs[0]=%d n_segs=%d n_deps=%d from line: \"%s\"\n",
+                        "segs[0]=%d n_segs=%d n_deps=%d from line: \"%.*s\"\n",
                         n_ver, ver.raw, ver.segs[0].num, ver.n_segs,
-                        n_deps, line);
+                        n_deps, (int)ln.len, ln.s);
             }
 
             n_ver++;
         }
-        /* prc == -1: skip (platform-specific), prc == -2: parse error */
-
-        line = eol ? eol + 1 : NULL;
+        /* prc == -1: skip (other platform / Ruby), prc == -2: parse error */
     }
 
+    wow_ci_toks_free(&toks);
     wow_response_free(&resp);
 
     /* DEBUG: dump pre-sort version list for the package */
@@ -473,11 +705,11 @@ static struct wow_ci_pkg *fetch_package(wow_ci_provider *prov,
             &prov->arena, (size_t)n_ver * sizeof(wow_gemver));
         wow_aoff ver_deps_off = wow_arena_alloc_off(
             &prov->arena, (size_t)n_ver * sizeof(struct wow_ci_ver_deps));
-        pkg->n_versions = n_ver;
+        pkg.n_versions = n_ver;
 
         /* Store offsets — safe across future arena growth */
-        pkg->versions_offset = versions_off;
-        pkg->ver_deps_offset = ver_deps_off;
+        pkg.versions_offset = versions_off;
+        pkg.ver_deps_offset = ver_deps_off;
 
         /* Write data via computed pointers (both allocs are done,
          * so these pointers are valid until the next arena alloc) */
@@ -496,7 +728,7 @@ static struct wow_ci_pkg *fetch_package(wow_ci_provider *prov,
     free(vers);
     free(vdeps);
 
-    return pkg;
+    return publish_pkg(prov, &pkg);
 }
 
 /* ------------------------------------------------------------------ */
@@ -506,19 +738,239 @@ static struct wow_ci_pkg *fetch_package(wow_ci_provider *prov,
 static struct wow_ci_pkg *find_cached(wow_ci_provider *prov,
                                        const char *name)
 {
-    for (int i = 0; i < prov->n_pkgs; i++) {
+    int n = __atomic_load_n(&prov->n_pkgs, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < n; i++) {
         if (strcmp(P_STR(prov->pkgs[i].name), name) == 0)
             return &prov->pkgs[i];
     }
     return NULL;
 }
 
+/*
+ * Shared provider state (wow_ci_provider_init_shared).  Each fetch slot
+ * is an HTTP pool plus the name being fetched through it, so one name
+ * is never fetched twice at once and a thread that wants it waits for
+ * the first fetch to land instead.
+ */
+struct ci_fetch_slot {
+    struct wow_http_pool pool;
+    const char          *name;      /* in flight, or NULL when free */
+};
+
+struct wow_ci_shared {
+    pthread_mutex_t       mu;       /* guards the arena and writers */
+    pthread_cond_t        cv;       /* a fetch slot was released */
+    struct ci_fetch_slot *slots;
+    int                   n_slots;
+};
+
+static struct wow_ci_pkg *ensure_cached_shared(wow_ci_provider *prov,
+                                                const char *name)
+{
+    struct wow_ci_shared *sh = prov->shared;
+    int slot;
+
+    /* Hits, the common case, take no lock */
+    struct wow_ci_pkg *pkg = find_cached(prov, name);
+    if (pkg) {
+        __atomic_fetch_add(&prov->stats.cache_hits, 1, __ATOMIC_RELAXED);
+        return pkg;
+    }
+
+    pthread_mutex_lock(&sh->mu);
+    for (;;) {
+        pkg = find_cached(prov, name);
+        if (pkg) {
+            __atomic_fetch_add(&prov->stats.cache_hits, 1,
+                               __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&sh->mu);
+            return pkg;
+        }
+        int busy = 0;
+        slot = -1;
+        for (int i = 0; i < sh->n_slots; i++) {
+            if (!sh->slots[i].name) {
+                if (slot < 0) slot = i;
+            } else if (strcmp(sh->slots[i].name, name) == 0) {
+                busy = 1;
+            }
+        }
+        if (!busy && slot >= 0) break;
+        pthread_cond_wait(&sh->cv, &sh->mu);
+    }
+    sh->slots[slot].name = name;
+    prov->stats.cache_misses++;
+    pthread_mutex_unlock(&sh->mu);
+
+    wow_ci_stats st = { 0 };
+    struct wow_response resp;
+    int rc = fetch_info(prov, &sh->slots[slot].pool, name, &resp, &st);
+
+    pthread_mutex_lock(&sh->mu);
+    double t0 = wow_now_secs();
+    pkg = rc == 0 ? add_package(prov, name, &resp) : NULL;
+    prov->stats.parse_secs += wow_now_secs() - t0;
+    prov->stats.fetch_secs += st.fetch_secs;
+    prov->stats.fetch_bytes += st.fetch_bytes;
+    prov->stats.via_daemon += st.via_daemon;
+    sh->slots[slot].name = NULL;
+    pthread_cond_broadcast(&sh->cv);
+    pthread_mutex_unlock(&sh->mu);
+    return pkg;
+}
+
 static struct wow_ci_pkg *ensure_cached(wow_ci_provider *prov,
                                          const char *name)
 {
+    if (prov->shared)
+        return ensure_cached_shared(prov, name);
+
     struct wow_ci_pkg *pkg = find_cached(prov, name);
-    if (pkg) return pkg;
-    return fetch_package(prov, name);
+    if (pkg) {
+        prov->stats.cache_hits++;
+        return pkg;
+    }
+    prov->stats.cache_misses++;
+
+    /* Whatever fetch + add spend outside HTTP is parsing */
+    double t0 = wow_now_secs();
+    double http0 = prov->stats.fetch_secs;
+    struct wow_response resp;
+    pkg = NULL;
+    if (fetch_info(prov, prov->pool, name, &resp, &prov->stats) == 0)
+        pkg = add_package(prov, name, &resp);
+    prov->stats.parse_secs += (wow_now_secs() - t0) -
+                              (prov->stats.fetch_secs - http0);
+    return pkg;
+}
+
+const char *wow_ci_provider_digest(wow_ci_provider *p, const char *name)
+{
+    wow_ci_provider *prov = p;
+    struct wow_ci_pkg *pkg = find_cached(prov, name);
+    if (!pkg || pkg->digest == WOW_AOFF_NULL) return NULL;
+    return P_STR(pkg->digest);
+}
+
+/* ------------------------------------------------------------------ */
+/* Bulk prefetch                                                       */
+/* ------------------------------------------------------------------ */
+
+struct prefetch_queue {
+    wow_ci_provider      *prov;
+    const char          **names;    /* not yet cached, no duplicates */
+    struct wow_response  *resps;
+    int                  *ok;
+    int                   n;
+    int                   next;
+};
+
+/* One fetcher: its own HTTP pool (NULL = the provider's) and stats */
+struct prefetch_worker {
+    struct prefetch_queue *q;
+    struct wow_http_pool  *pool;
+    wow_ci_stats           st;
+};
+
+static void *prefetch_worker(void *arg)
+{
+    struct prefetch_worker *w = arg;
+    struct prefetch_queue *q = w->q;
+    int i;
+    while ((i = __atomic_fetch_add(&q->next, 1, __ATOMIC_RELAXED)) < q->n) {
+        if (q->prov->shared) {
+            q->ok[i] = ensure_cached_shared(q->prov, q->names[i]) != NULL;
+            continue;
+        }
+        q->ok[i] = fetch_info(q->prov, w->pool, q->names[i], &q->resps[i],
+                              &w->st) == 0;
+    }
+    return NULL;
+}
+
+int wow_ci_provider_prefetch(wow_ci_provider *p, const char *const *names,
+                             int n, int threads)
+{
+    if (n <= 0) return 0;
+    if (threads <= 0) threads = WOW_CI_PREFETCH_JOBS;
+    if (threads > WOW_CI_PREFETCH_JOBS) threads = WOW_CI_PREFETCH_JOBS;
+
+    struct prefetch_queue q = { .prov = p };
+    q.names = malloc((size_t)n * sizeof(*q.names));
+    q.resps = calloc((size_t)n, sizeof(*q.resps));
+    q.ok = calloc((size_t)n, sizeof(*q.ok));
+    struct prefetch_worker *ws = calloc((size_t)threads, sizeof(*ws));
+    struct wow_http_pool *pools = calloc((size_t)threads, sizeof(*pools));
+    if (!q.names || !q.resps || !q.ok || !ws || !pools) {
+        free(q.names); free(q.resps); free(q.ok); free(ws); free(pools);
+        return -1;
+    }
+
+    /* Only names the solver would otherwise fetch, each once */
+    for (int i = 0; i < n; i++) {
+        if (find_cached(p, names[i])) continue;
+        int dup = 0;
+        for (int j = 0; j < q.n && !dup; j++)
+            dup = strcmp(q.names[j], names[i]) == 0;
+        if (!dup) q.names[q.n++] = names[i];
+    }
+    if (threads > q.n) threads = q.n;
+
+    uint64_t t0 = wow_trace_begin();
+    double start = wow_now_secs();
+
+    /* The calling thread fetches through the provider's own pool, so its
+     * connections stay warm for the solve.  A failed pthread_create just
+     * means fewer workers; the calling thread drains whatever is left. */
+    pthread_t tids[WOW_CI_PREFETCH_JOBS];
+    int started = 0;
+    ws[0].q = &q;
+    ws[0].pool = p->pool;
+    for (int i = 1; i < threads; i++) {
+        ws[i].q = &q;
+        ws[i].pool = &pools[i];
+        wow_http_pool_init(&pools[i], 1);
+        if (pthread_create(&tids[started], NULL, prefetch_worker,
+                           &ws[i]) == 0)
+            started++;
+    }
+    prefetch_worker(&ws[0]);
+    for (int i = 0; i < started; i++)
+        pthread_join(tids[i], NULL);
+    for (int i = 1; i < threads; i++)
+        wow_http_pool_cleanup(&pools[i]);
+
+    /* Parse in request order; the fetched bodies are all in memory */
+    int added = 0;
+    double fetch_wall = wow_now_secs() - start;
+    double t_parse = wow_now_secs();
+    for (int i = 0; i < q.n; i++) {
+        if (p->shared) {
+            added += q.ok[i];
+            __atomic_fetch_add(&p->stats.prefetched, q.ok[i],
+                               __ATOMIC_RELAXED);
+            continue;
+        }
+        if (!q.ok[i]) continue;
+        p->stats.cache_misses++;
+        p->stats.prefetched++;
+        if (add_package(p, q.names[i], &q.resps[i])) added++;
+    }
+    if (!p->shared) {
+        for (int i = 0; i < threads; i++) {
+            p->stats.fetch_bytes += ws[i].st.fetch_bytes;
+            p->stats.via_daemon += ws[i].st.via_daemon;
+        }
+        p->stats.fetch_secs += fetch_wall;
+        p->stats.parse_secs += wow_now_secs() - t_parse;
+    }
+
+    char detail[48];
+    snprintf(detail, sizeof(detail), "%d of %d packages", added, q.n);
+    wow_trace_end(t0, "provider", "prefetch", detail);
+
+    free(q.names); free(q.resps); free(q.ok); free(ws); free(pools);
+    return added;
 }
 
 static int ci_list_versions(void *ctx, const char *package,
@@ -549,14 +1001,14 @@ static int ci_list_versions(void *ctx, const char *package,
 }
 
 /*
- * Static buffers for get_deps return values.
- * The PubGrub solver calls get_deps sequentially (never concurrently) —
- * each returned pointer is consumed before the next call. If we ever
- * parallelise resolution, these must become per-thread or arena-allocated.
+ * Per-thread buffers for get_deps return values.
+ * A solver calls get_deps sequentially — each returned pointer is
+ * consumed before the next call — but several solvers may share one
+ * provider (wow workspace), each on its own thread.
  */
 #define CI_MAX_DEPS_PER_VER 64
-static const char *ci_dep_names_buf[CI_MAX_DEPS_PER_VER];
-static wow_gem_constraints ci_dep_cs_buf[CI_MAX_DEPS_PER_VER];
+static _Thread_local const char *ci_dep_names_buf[CI_MAX_DEPS_PER_VER];
+static _Thread_local wow_gem_constraints ci_dep_cs_buf[CI_MAX_DEPS_PER_VER];
 
 static int ci_get_deps(void *ctx, const char *package,
                         const wow_gemver *version,
@@ -606,16 +1058,76 @@ static int ci_get_deps(void *ctx, const char *package,
     return 0;
 }
 
+static const char *ci_get_platform(void *ctx, const char *package,
+                                   const wow_gemver *version)
+{
+    wow_ci_provider *prov = ctx;
+    struct wow_ci_pkg *pkg = find_cached(prov, package);
+    if (!pkg) return NULL;
+
+    const wow_gemver *versions = P_PTR(pkg->versions_offset,
+                                        const wow_gemver);
+    const struct wow_ci_ver_deps *ver_deps =
+        P_PTR(pkg->ver_deps_offset, const struct wow_ci_ver_deps);
+
+    for (int v = 0; v < pkg->n_versions; v++) {
+        if (wow_gemver_cmp(&versions[v], version) == 0) {
+            int k = ver_deps[v].platform;
+            /* platforms[] lives in the provider struct: stable */
+            return k > 0 ? prov->platforms[k - 1] : NULL;
+        }
+    }
+    return NULL;
+}
+
 /* ------------------------------------------------------------------ */
 /* Public API                                                          */
 /* ------------------------------------------------------------------ */
 
-void wow_ci_provider_init(wow_ci_provider *p, const char *source_url,
+int wow_ci_host_platforms(char out[][WOW_CI_PLATFORM_LEN], int max)
+{
+    wow_platform_t hp;
+    wow_detect_platform(&hp);
+
+    /* RubyGems spells 64-bit ARM "aarch64" on Linux, "arm64" on macOS */
+    const char *arch = hp.arch;
+    if (strcmp(hp.os, "linux") == 0 && strcmp(arch, "arm64") == 0)
+        arch = "aarch64";
+
+    int n = 0;
+    if (strcmp(hp.os, "linux") == 0) {
+        if (strcmp(hp.libc, "musl") == 0) {
+            if (n < max)
+                snprintf(out[n++], WOW_CI_PLATFORM_LEN, "%s-linux-musl", arch);
+        } else {
+            /* nokogiri and sqlite3 publish -linux-gnu, grpc bare -linux */
+            if (n < max)
+                snprintf(out[n++], WOW_CI_PLATFORM_LEN, "%s-linux-gnu", arch);
+            if (n < max)
+                snprintf(out[n++], WOW_CI_PLATFORM_LEN, "%s-linux", arch);
+        }
+    } else if (strcmp(hp.os, "darwin") == 0) {
+        if (n < max)
+            snprintf(out[n++], WOW_CI_PLATFORM_LEN, "%s-darwin", arch);
+    }
+    return n;
+}
+
+void wow_ci_provider_set_platforms(wow_ci_provider *p,
+                                   const char *const *platforms, int n)
+{
+    if (n > WOW_CI_MAX_PLATFORMS) n = WOW_CI_MAX_PLATFORMS;
+    for (int i = 0; i < n; i++)
+        snprintf(p->platforms[i], WOW_CI_PLATFORM_LEN, "%s", platforms[i]);
+    p->n_platforms = n;
+}
+
+/* Everything but the arena, which the caller has set up */
+static void provider_setup(wow_ci_provider *p, const char *source_url,
                            struct wow_http_pool *pool,
                            const char *ruby_version)
 {
-    memset(p, 0, sizeof(*p));
-    wow_arena_init(&p->arena);
+    p->arena.mem_sys = WOW_MEM_INDEX;
 
     /* Strip trailing slash from source URL */
     size_t slen = strlen(source_url);
@@ -627,6 +1139,46 @@ void wow_ci_provider_init(wow_ci_provider *p, const char *source_url,
     /* Parse target Ruby version for metadata filtering */
     if (ruby_version && wow_gemver_parse(ruby_version, &p->ruby_ver) == 0)
         p->has_ruby_ver = true;
+
+    p->n_platforms = wow_ci_host_platforms(p->platforms,
+                                           WOW_CI_MAX_PLATFORMS);
+}
+
+void wow_ci_provider_init(wow_ci_provider *p, const char *source_url,
+                           struct wow_http_pool *pool,
+                           const char *ruby_version)
+{
+    memset(p, 0, sizeof(*p));
+    wow_arena_init(&p->arena);
+    provider_setup(p, source_url, pool, ruby_version);
+}
+
+int wow_ci_provider_init_shared(wow_ci_provider *p, const char *source_url,
+                                int n_fetchers, const char *ruby_version)
+{
+    memset(p, 0, sizeof(*p));
+    if (n_fetchers < 1) n_fetchers = 1;
+
+    struct wow_ci_shared *sh = calloc(1, sizeof(*sh));
+    struct ci_fetch_slot *slots = calloc((size_t)n_fetchers,
+                                         sizeof(*slots));
+    if (!sh || !slots ||
+        wow_arena_init_fixed(&p->arena, WOW_CI_SHARED_RESERVE) != 0) {
+        fprintf(stderr, "wow: cannot set up shared index cache\n");
+        free(sh);
+        free(slots);
+        return -1;
+    }
+    pthread_mutex_init(&sh->mu, NULL);
+    pthread_cond_init(&sh->cv, NULL);
+    for (int i = 0; i < n_fetchers; i++)
+        wow_http_pool_init(&slots[i].pool, 4);
+    sh->slots = slots;
+    sh->n_slots = n_fetchers;
+    p->shared = sh;
+
+    provider_setup(p, source_url, NULL, ruby_version);
+    return 0;
 }
 
 wow_provider wow_ci_provider_as_provider(wow_ci_provider *p)
@@ -634,12 +1186,23 @@ wow_provider wow_ci_provider_as_provider(wow_ci_provider *p)
     wow_provider prov;
     prov.list_versions = ci_list_versions;
     prov.get_deps = ci_get_deps;
+    prov.get_platform = ci_get_platform;
+    prov.preferred_version = NULL;
     prov.ctx = p;
     return prov;
 }
 
 void wow_ci_provider_destroy(wow_ci_provider *p)
 {
+    struct wow_ci_shared *sh = p->shared;
+    if (sh) {
+        for (int i = 0; i < sh->n_slots; i++)
+            wow_http_pool_cleanup(&sh->slots[i].pool);
+        pthread_cond_destroy(&sh->cv);
+        pthread_mutex_destroy(&sh->mu);
+        free(sh->slots);
+        free(sh);
+    }
     wow_arena_destroy(&p->arena);
     memset(p, 0, sizeof(*p));
 }
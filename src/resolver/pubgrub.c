@@ -10,16 +10,24 @@
  */
 
 #include "wow/resolver/pubgrub.h"
+#include "wow/util/mem.h"
+#include "wow/util/time.h"
+#include "wow/util/trace.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-/* Debug output gated on WOW_DEBUG_RESOLVE=1 env var */
+/* Debug output gated on WOW_DEBUG_RESOLVE=1 env var (solvers may run
+ * on several threads at once, hence the atomics) */
 static int dbg_resolve = -1;
 #define DBG(...) do { \
-    if (dbg_resolve < 0) dbg_resolve = (getenv("WOW_DEBUG_RESOLVE") != NULL); \
-    if (dbg_resolve) fprintf(stderr, "[resolve] " __VA_ARGS__); \
+    int dbg_ = __atomic_load_n(&dbg_resolve, __ATOMIC_RELAXED); \
+    if (dbg_ < 0) { \
+        dbg_ = getenv("WOW_DEBUG_RESOLVE") != NULL; \
+        __atomic_store_n(&dbg_resolve, dbg_, __ATOMIC_RELAXED); \
+    } \
+    if (dbg_) fprintf(stderr, "[resolve] " __VA_ARGS__); \
 } while (0)
 
 /* ------------------------------------------------------------------ */
@@ -38,6 +46,78 @@ static bool streq(const char *a, const char *b)
     return strcmp(a, b) == 0;
 }
 
+/* FNV-1a, for the package name table */
+static uint32_t name_hash(const char *name)
+{
+    uint32_t h = 2166136261u;
+    for (; *name; name++)
+        h = (h ^ (uint8_t)*name) * 16777619u;
+    return h;
+}
+
+/*
+ * An interned package name, its latest assignment (-1 if none), the
+ * indices of the incompatibilities that mention it and the versions
+ * whose dependencies have been added as incompatibilities.
+ */
+struct wow_pkg_slot {
+    wow_aoff           name;
+    int                last;
+    int               *incomps;
+    int                n_incomps, incomps_cap;
+    wow_gemver        *deps_added;
+    int                n_deps_added, deps_added_cap;
+};
+
+static struct wow_pkg_slot *find_slot(const wow_solver *s, const char *name)
+{
+    uint32_t mask = (uint32_t)(s->names_cap - 1);
+    uint32_t j = name_hash(name) & mask;
+    for (; s->names[j].name != WOW_AOFF_NULL; j = (j + 1) & mask)
+        if (streq(A_STR(s->names[j].name), name)) return &s->names[j];
+    return &s->names[j];
+}
+
+/* The slot of an interned package (pkg is an offset intern returned) */
+static struct wow_pkg_slot *pkg_slot(const wow_solver *s, wow_aoff pkg)
+{
+    return find_slot(s, A_STR(pkg));
+}
+
+/*
+ * The arena offset of name, the same for every equal name, so the
+ * solver compares packages by offset.  WOW_AOFF_NULL on OOM.  name
+ * must not point into the solver arena (which this may grow).
+ */
+static wow_aoff intern(wow_solver *s, const char *name)
+{
+    if ((s->n_names + 1) * 2 > s->names_cap) {
+        int new_cap = s->names_cap ? s->names_cap * 2 : 256;
+        struct wow_pkg_slot *nt = malloc((size_t)new_cap * sizeof(*nt));
+        if (!nt) return WOW_AOFF_NULL;
+        for (int i = 0; i < new_cap; i++)
+            nt[i] = (struct wow_pkg_slot){ .name = WOW_AOFF_NULL, .last = -1 };
+        for (int i = 0; i < s->names_cap; i++) {
+            if (s->names[i].name == WOW_AOFF_NULL) continue;
+            uint32_t j = name_hash(A_STR(s->names[i].name));
+            while (nt[j & (uint32_t)(new_cap - 1)].name != WOW_AOFF_NULL) j++;
+            nt[j & (uint32_t)(new_cap - 1)] = s->names[i];
+        }
+        free(s->names);
+        s->names = nt;
+        s->names_cap = new_cap;
+    }
+
+    struct wow_pkg_slot *slot = find_slot(s, name);
+    if (slot->name != WOW_AOFF_NULL) return slot->name;
+
+    wow_aoff off = wow_arena_strdup_off(&s->arena, name);
+    if (off == WOW_AOFF_NULL) return WOW_AOFF_NULL;
+    slot->name = off;
+    s->n_names++;
+    return off;
+}
+
 /* ------------------------------------------------------------------ */
 /* Version range operations                                            */
 /* ------------------------------------------------------------------ */
@@ -72,46 +152,77 @@ static bool range_contains(const wow_ver_range *r, const wow_gemver *v)
     return true;
 }
 
-/* Intersect two ranges. Result may be empty. */
-static wow_ver_range range_intersect(const wow_ver_range *a,
-                                     const wow_ver_range *b)
+/* Narrow r to its intersection with b, in place */
+static void range_tighten(wow_ver_range *r, const wow_ver_range *b)
 {
-    wow_ver_range r = *a;
-
     /* Tighten lower bound */
     if (b->has_min) {
-        if (!r.has_min) {
-            r.has_min = true;
-            r.min = b->min;
-            r.min_inclusive = b->min_inclusive;
+        if (!r->has_min) {
+            r->has_min = true;
+            r->min = b->min;
+            r->min_inclusive = b->min_inclusive;
         } else {
-            int c = wow_gemver_cmp(&b->min, &r.min);
+            int c = wow_gemver_cmp(&b->min, &r->min);
             if (c > 0) {
-                r.min = b->min;
-                r.min_inclusive = b->min_inclusive;
+                r->min = b->min;
+                r->min_inclusive = b->min_inclusive;
             } else if (c == 0) {
-                r.min_inclusive = r.min_inclusive && b->min_inclusive;
+                r->min_inclusive = r->min_inclusive && b->min_inclusive;
             }
         }
     }
 
     /* Tighten upper bound */
     if (b->has_max) {
-        if (!r.has_max) {
-            r.has_max = true;
-            r.max = b->max;
-            r.max_inclusive = b->max_inclusive;
+        if (!r->has_max) {
+            r->has_max = true;
+            r->max = b->max;
+            r->max_inclusive = b->max_inclusive;
         } else {
-            int c = wow_gemver_cmp(&b->max, &r.max);
+            int c = wow_gemver_cmp(&b->max, &r->max);
             if (c < 0) {
-                r.max = b->max;
-                r.max_inclusive = b->max_inclusive;
+                r->max = b->max;
+                r->max_inclusive = b->max_inclusive;
             } else if (c == 0) {
-                r.max_inclusive = r.max_inclusive && b->max_inclusive;
+                r->max_inclusive = r->max_inclusive && b->max_inclusive;
             }
         }
     }
+}
+
+/*
+ * Is the intersection of a and b empty?  The same answer as
+ * range_is_empty(wow_ver_range_intersect(a, b)), without the copy.
+ */
+static bool ranges_disjoint(const wow_ver_range *a, const wow_ver_range *b)
+{
+    const wow_gemver *min = NULL, *max = NULL;
+    bool min_incl = true, max_incl = true;
 
+    if (a->has_min) { min = &a->min; min_incl = a->min_inclusive; }
+    if (b->has_min) {
+        int c = min ? wow_gemver_cmp(&b->min, min) : 1;
+        if (c > 0) { min = &b->min; min_incl = b->min_inclusive; }
+        else if (c == 0) min_incl = min_incl && b->min_inclusive;
+    }
+    if (a->has_max) { max = &a->max; max_incl = a->max_inclusive; }
+    if (b->has_max) {
+        int c = max ? wow_gemver_cmp(&b->max, max) : -1;
+        if (c < 0) { max = &b->max; max_incl = b->max_inclusive; }
+        else if (c == 0) max_incl = max_incl && b->max_inclusive;
+    }
+
+    if (!min || !max) return false;
+    int cmp = wow_gemver_cmp(min, max);
+    return cmp > 0 || (cmp == 0 && (!min_incl || !max_incl));
+}
+
+/* Intersect two ranges (declared in pubgrub.h). */
+wow_ver_range wow_ver_range_intersect(const wow_ver_range *a,
+                                      const wow_ver_range *b)
+{
+    wow_ver_range r = *a;
+    range_tighten(&r, b);
     return r;
 }
 
@@ -205,7 +316,7 @@ static wow_ver_range range_from_constraints(const wow_gem_constraints *cs)
         }
         }
 
-        r = range_intersect(&r, &cr);
+        range_tighten(&r, &cr);
     }
 
     return r;
@@ -254,52 +365,54 @@ enum term_relation {
 };
 
 /*
- * Determine the relation of a term to the current partial solution.
+ * What a prefix of the partial solution says about one package.
  *
  * Assignments can be positive ("version in range") or negative
- * ("version NOT in range"). For a package with assignments:
- *   - positive_range = intersection of all positive assignment ranges
- *   - negative_ranges = list of ranges that are excluded
- *
+ * ("version NOT in range"):
+ *   - pos = intersection of all positive assignment ranges
+ *   - neg = ranges that are excluded (up to 16)
  * When there's a decision, it overrides all derivations (exact version).
- *
- * We compute whether the effective constraint on a package
- * satisfies, contradicts, or is inconclusive w.r.t. the given term.
  */
-static enum term_relation term_relation(const wow_solver *s,
-                                         const wow_term *t)
+struct pkg_state {
+    wow_ver_range        pos;
+    bool                 has_pos;
+    const wow_gemver    *decided;      /* NULL = no decision */
+    const wow_ver_range *neg[16];
+    int                  n_neg;
+};
+
+static void pkg_state_init(struct pkg_state *st)
 {
-    const char *t_pkg = A_STR(t->package);
-
-    /* Collect positive range and negative exclusions for this package */
-    wow_ver_range pos_range = WOW_RANGE_ANY;
-    bool has_pos = false;
-    bool has_decision = false;
-    wow_gemver decided_ver;
-
-    /* Negative exclusions — track up to 16 */
-    wow_ver_range neg_ranges[16];
-    int n_neg = 0;
-
-    for (int i = 0; i < s->n_assign; i++) {
-        if (!streq(A_STR(s->assignments[i].package), t_pkg)) continue;
-
-        if (s->assignments[i].is_decision) {
-            has_decision = true;
-            decided_ver = s->assignments[i].version;
-            pos_range = range_exact(&s->assignments[i].version);
-            has_pos = true;
-        } else if (s->assignments[i].positive) {
-            pos_range = range_intersect(&pos_range, &s->assignments[i].range);
-            has_pos = true;
-        } else {
-            /* Negative assignment: version must NOT be in this range */
-            if (n_neg < 16)
-                neg_ranges[n_neg++] = s->assignments[i].range;
-        }
+    st->pos = WOW_RANGE_ANY;
+    st->has_pos = false;
+    st->decided = NULL;
+    st->n_neg = 0;
+}
+
+static void pkg_state_add(struct pkg_state *st, const wow_assignment *a)
+{
+    if (a->is_decision) {
+        st->decided = &a->version;
+    } else if (st->decided) {
+        /* A decision overrides the rest (and the relation ignores pos) */
+    } else if (a->positive) {
+        if (st->has_pos) range_tighten(&st->pos, &a->range);
+        else st->pos = a->range;
+        st->has_pos = true;
+    } else if (st->n_neg < 16) {
+        /* Negative assignment: version must NOT be in this range */
+        st->neg[st->n_neg++] = &a->range;
     }
+}
 
-    if (!has_pos && n_neg == 0) {
+/*
+ * Is the term satisfied, contradicted, or inconclusive given what is
+ * known about its package?
+ */
+static enum term_relation pkg_state_relation(const struct pkg_state *st,
+                                             const wow_term *t)
+{
+    if (!st->decided && !st->has_pos && st->n_neg == 0) {
         /* No assignments at all */
         if (t->positive) {
             return range_is_any(&t->range) ? TERM_SATISFIED : TERM_INCONCLUSIVE;
@@ -311,8 +424,8 @@ static enum term_relation term_relation(const wow_solver *s,
      * If there's a decision, the package is pinned to exactly that version.
      * This is the simple case — ignore negatives (decision overrides).
      */
-    if (has_decision) {
-        bool in_term_range = range_contains(&t->range, &decided_ver);
+    if (st->decided) {
+        bool in_term_range = range_contains(&t->range, st->decided);
         if (t->positive)
             return in_term_range ? TERM_SATISFIED : TERM_CONTRADICTED;
         else
@@ -320,31 +433,33 @@ static enum term_relation term_relation(const wow_solver *s,
     }
 
     /*
-     * No decision yet. We have positive constraints (pos_range) and
+     * No decision yet. We have positive constraints (pos) and
      * possibly negative exclusions.
      */
     if (t->positive) {
         /* Term says "version must be in R" */
 
-        /* If pos_range is entirely within R, and no negative range
+        /* If pos is entirely within R, and no negative range
          * could pull versions out, then SATISFIED */
-        if (range_allows_all(&t->range, &pos_range)) {
+        if (range_allows_all(&t->range, &st->pos)) {
             /* Check: are there negative ranges that exclude parts of
-             * pos_range that are inside R? For satisfaction, we need
+             * pos that are inside R? For satisfaction, we need
              * ALL possible versions to be in R, which they are since
-             * pos_range ⊆ R. Negatives only further restrict, which
+             * pos ⊆ R. Negatives only further restrict, which
              * is fine. */
             return TERM_SATISFIED;
         }
 
-        /* If pos_range doesn't overlap R at all → CONTRADICTED */
-        wow_ver_range inter = range_intersect(&t->range, &pos_range);
-        if (range_is_empty(&inter))
+        /* If pos doesn't overlap R at all → CONTRADICTED */
+        if (ranges_disjoint(&t->range, &st->pos))
             return TERM_CONTRADICTED;
+        if (st->n_neg == 0)
+            return TERM_INCONCLUSIVE;
 
-        /* Check if negative ranges exclude everything in pos_range ∩ R */
-        for (int i = 0; i < n_neg; i++) {
-            if (range_allows_all(&neg_ranges[i], &inter)) {
+        /* Check if negative ranges exclude everything in pos ∩ R */
+        wow_ver_range inter = wow_ver_range_intersect(&t->range, &st->pos);
+        for (int i = 0; i < st->n_neg; i++) {
+            if (range_allows_all(st->neg[i], &inter)) {
                 /* The negative range excludes all of the intersection */
                 return TERM_CONTRADICTED;
             }
@@ -354,27 +469,99 @@ static enum term_relation term_relation(const wow_solver *s,
     } else {
         /* Term says "version must NOT be in R" (negative) */
 
-        /* Satisfied if pos_range doesn't overlap R at all */
-        wow_ver_range inter = range_intersect(&t->range, &pos_range);
-        if (range_is_empty(&inter))
+        /* Satisfied if pos doesn't overlap R at all */
+        if (ranges_disjoint(&t->range, &st->pos))
             return TERM_SATISFIED;
 
         /* Satisfied if a negative range already excludes everything
-         * in pos_range ∩ R (those versions are already ruled out) */
-        for (int i = 0; i < n_neg; i++) {
-            if (range_allows_all(&neg_ranges[i], &inter))
-                return TERM_SATISFIED;
+         * in pos ∩ R (those versions are already ruled out) */
+        if (st->n_neg > 0) {
+            wow_ver_range inter = wow_ver_range_intersect(&t->range,
+                                                          &st->pos);
+            for (int i = 0; i < st->n_neg; i++) {
+                if (range_allows_all(st->neg[i], &inter))
+                    return TERM_SATISFIED;
+            }
         }
 
-        /* Contradicted if pos_range is entirely within R and no
+        /* Contradicted if pos is entirely within R and no
          * negative ranges help */
-        if (range_allows_all(&t->range, &pos_range))
+        if (range_allows_all(&t->range, &st->pos))
             return TERM_CONTRADICTED;
 
         return TERM_INCONCLUSIVE;
     }
 }
 
+#define PKG_CHAIN_MAX 256
+
+/*
+ * Indices of pkg's assignments in trail order, following the prev
+ * links back from its latest one.  -1 if there are more than
+ * PKG_CHAIN_MAX (callers then scan the whole trail).
+ */
+static int pkg_chain(const wow_solver *s, wow_aoff pkg, int *idx)
+{
+    int n = 0;
+    for (int i = pkg_slot(s, pkg)->last; i >= 0;
+         i = s->assignments[i].prev) {
+        if (n == PKG_CHAIN_MAX) return -1;
+        idx[n++] = i;
+    }
+    for (int a = 0, b = n - 1; a < b; a++, b--) {
+        int tmp = idx[a];
+        idx[a] = idx[b];
+        idx[b] = tmp;
+    }
+    return n;
+}
+
+/* Relation of a term to the whole partial solution */
+static enum term_relation term_relation(const wow_solver *s,
+                                         const wow_term *t)
+{
+    struct pkg_state st;
+    int idx[PKG_CHAIN_MAX];
+    int n = pkg_chain(s, t->package, idx);
+    pkg_state_init(&st);
+    if (n < 0) {
+        for (int i = 0; i < s->n_assign; i++)
+            if (s->assignments[i].package == t->package)
+                pkg_state_add(&st, &s->assignments[i]);
+    } else {
+        for (int k = 0; k < n; k++)
+            pkg_state_add(&st, &s->assignments[idx[k]]);
+    }
+    return pkg_state_relation(&st, t);
+}
+
+/*
+ * Index of the assignment after which the partial solution first
+ * satisfies t (its satisfier): -1 if t holds with no assignments at
+ * all, s->n_assign if it is not satisfied.
+ */
+static int term_satisfier(const wow_solver *s, const wow_term *t)
+{
+    struct pkg_state st;
+    int idx[PKG_CHAIN_MAX];
+    int n = pkg_chain(s, t->package, idx);
+    pkg_state_init(&st);
+    if (pkg_state_relation(&st, t) == TERM_SATISFIED) return -1;
+    if (n < 0) {
+        for (int i = 0; i < s->n_assign; i++) {
+            if (s->assignments[i].package != t->package) continue;
+            pkg_state_add(&st, &s->assignments[i]);
+            if (pkg_state_relation(&st, t) == TERM_SATISFIED) return i;
+        }
+    } else {
+        for (int k = 0; k < n; k++) {
+            pkg_state_add(&st, &s->assignments[idx[k]]);
+            if (pkg_state_relation(&st, t) == TERM_SATISFIED) return idx[k];
+        }
+    }
+    return s->n_assign;
+}
+
 /* ------------------------------------------------------------------ */
 /* Solver internals                                                    */
 /* ------------------------------------------------------------------ */
@@ -390,7 +577,26 @@ static int push_incomp(wow_solver *s, wow_aoff ic_off)
         s->incomps = nb;
         s->incomps_cap = new_cap;
     }
-    s->incomps[s->n_incomps++] = ic_off;
+    s->incomps[s->n_incomps] = ic_off;
+
+    /* Index it under each package it mentions, once */
+    const wow_incomp *ic = A_PTR(ic_off, wow_incomp);
+    const wow_term *terms = A_PTR(ic->terms, wow_term);
+    for (int t = 0; t < ic->n_terms; t++) {
+        struct wow_pkg_slot *slot = pkg_slot(s, terms[t].package);
+        if (slot->n_incomps > 0 &&
+            slot->incomps[slot->n_incomps - 1] == s->n_incomps)
+            continue;
+        if (slot->n_incomps >= slot->incomps_cap) {
+            int new_cap = slot->incomps_cap ? slot->incomps_cap * 2 : 8;
+            int *nb = realloc(slot->incomps, (size_t)new_cap * sizeof(*nb));
+            if (!nb) return -1;
+            slot->incomps = nb;
+            slot->incomps_cap = new_cap;
+        }
+        slot->incomps[slot->n_incomps++] = s->n_incomps;
+    }
+    s->n_incomps++;
     return 0;
 }
 
@@ -404,10 +610,62 @@ static int push_assignment(wow_solver *s, wow_assignment *a)
         s->assignments = nb;
         s->assign_cap = new_cap;
     }
+    struct wow_pkg_slot *slot = pkg_slot(s, a->package);
+    a->prev = slot->last;
+    slot->last = s->n_assign;
     s->assignments[s->n_assign++] = *a;
+    if (s->n_assign > s->stats.max_assignments)
+        s->stats.max_assignments = s->n_assign;
+    return 0;
+}
+
+/*
+ * 1 if the dependencies of pkg at version v have been added as
+ * incompatibilities already, else record that they are and return 0.
+ * -1 on OOM.
+ */
+static int deps_seen(wow_solver *s, wow_aoff pkg, const wow_gemver *v)
+{
+    struct wow_pkg_slot *slot = pkg_slot(s, pkg);
+    for (int i = 0; i < slot->n_deps_added; i++)
+        if (wow_gemver_cmp(&slot->deps_added[i], v) == 0) return 1;
+
+    if (slot->n_deps_added >= slot->deps_added_cap) {
+        int new_cap = slot->deps_added_cap ? slot->deps_added_cap * 2 : 4;
+        wow_gemver *nb = realloc(slot->deps_added,
+                                 (size_t)new_cap * sizeof(*nb));
+        if (!nb) return -1;
+        slot->deps_added = nb;
+        slot->deps_added_cap = new_cap;
+    }
+    slot->deps_added[slot->n_deps_added++] = *v;
     return 0;
 }
 
+/* Provider calls, counted and timed for wow_solver_stats */
+static int provider_list_versions(wow_solver *s, const char *pkg,
+                                  const wow_gemver **out, int *n_out)
+{
+    double t0 = wow_now_secs();
+    int rc = s->provider->list_versions(s->provider->ctx, pkg, out, n_out);
+    s->stats.list_versions_calls++;
+    s->stats.provider_secs += wow_now_secs() - t0;
+    return rc;
+}
+
+static int provider_get_deps(wow_solver *s, const char *pkg,
+                             const wow_gemver *version,
+                             const char ***names, wow_gem_constraints **cs,
+                             int *n)
+{
+    double t0 = wow_now_secs();
+    int rc = s->provider->get_deps(s->provider->ctx, pkg, version,
+                                   names, cs, n);
+    s->stats.get_deps_calls++;
+    s->stats.provider_secs += wow_now_secs() - t0;
+    return rc;
+}
+
 /* Create an incompatibility in the arena. Returns offset (WOW_AOFF_NULL on OOM). */
 static wow_aoff make_incomp(wow_solver *s, wow_term *terms, int n,
                               enum wow_incomp_cause cause)
@@ -438,93 +696,206 @@ static wow_aoff make_incomp(wow_solver *s, wow_term *terms, int n,
 /* ------------------------------------------------------------------ */
 
 /*
- * Scan all incompatibilities. For each:
+ * Check incompatibility i against the partial solution:
  *   - If ALL terms are satisfied → conflict (return the incompatibility)
  *   - If all-but-one term is satisfied and one is inconclusive →
  *     derive the negation of the remaining term (unit propagation)
+ *     and set *derived to its package
  *   - Otherwise → skip
  *
+ * Returns the offset of the incompatibility on conflict, else
+ * WOW_AOFF_NULL.
+ */
+static wow_aoff propagate_incomp(wow_solver *s, int i, wow_aoff *derived)
+{
+    wow_incomp *ic = A_PTR(s->incomps[i], wow_incomp);
+    wow_term *ic_terms = A_PTR(ic->terms, wow_term);
+
+    int n_satisfied = 0;
+    int n_inconclusive = 0;
+    int inconclusive_idx = -1;
+
+    for (int t = 0; t < ic->n_terms; t++) {
+        enum term_relation rel = term_relation(s, &ic_terms[t]);
+        if (rel == TERM_SATISFIED) {
+            n_satisfied++;
+        } else if (rel == TERM_INCONCLUSIVE) {
+            n_inconclusive++;
+            inconclusive_idx = t;
+        }
+        /* CONTRADICTED terms are neither satisfied nor inconclusive */
+    }
+
+    if (n_satisfied == ic->n_terms) {
+        /* Conflict! All terms are satisfied → impossible */
+        return s->incomps[i];
+    }
+
+    if (n_satisfied == ic->n_terms - 1 && n_inconclusive == 1) {
+        /* Unit propagation: derive negation of the inconclusive term.
+         * Flip the polarity: positive → negative, negative → positive.
+         * Keep the range as-is — the assignment's positive flag
+         * encodes the negation semantics. */
+        wow_term *ut = &ic_terms[inconclusive_idx];
+        wow_assignment deriv;
+        memset(&deriv, 0, sizeof(deriv));
+        deriv.package = ut->package;
+        deriv.is_decision = false;
+        deriv.decision_level = s->decision_level;
+        deriv.cause = s->incomps[i];
+        deriv.range = ut->range;
+        deriv.positive = !ut->positive;  /* flip polarity */
+
+        push_assignment(s, &deriv);
+        s->stats.propagations++;
+        *derived = ut->package;
+    }
+    return WOW_AOFF_NULL;
+}
+
+/* Append pkg to a growable array of packages */
+static int push_pkg(wow_aoff **v, int *n, int *cap, wow_aoff pkg)
+{
+    if (*n == *cap) {
+        int new_cap = *cap ? *cap * 2 : 16;
+        wow_aoff *nv = realloc(*v, (size_t)new_cap * sizeof(*nv));
+        if (!nv) return -1;
+        *v = nv;
+        *cap = new_cap;
+    }
+    (*v)[(*n)++] = pkg;
+    return 0;
+}
+
+/*
+ * Propagate until nothing new is derived.  decided is the package just
+ * decided on, or WOW_AOFF_NULL.
+ *
  * Returns WOW_AOFF_NULL when no more propagation is possible.
  * Returns the offset of the conflicting incompatibility on conflict.
  */
-static wow_aoff unit_propagate(wow_solver *s, wow_aoff changed_pkg)
+static wow_aoff unit_propagate(wow_solver *s, wow_aoff decided)
 {
     /*
-     * We iterate until no new derivations. To avoid O(n^2), we only
-     * check incompatibilities that mention the changed package.
-     * On first call (changed_pkg == WOW_AOFF_NULL), check all.
+     * Only an incompatibility that mentions a package whose assignments
+     * changed can change its relation, and the partial solution is a
+     * fixpoint of the first n_propagated.  So the first pass checks
+     * the newer ones plus those that mention decided, and each later
+     * pass those that mention a package derived in the pass before.
      */
-    bool changed = true;
-    while (changed) {
-        changed = false;
-
-        for (int i = 0; i < s->n_incomps; i++) {
-            wow_incomp *ic = A_PTR(s->incomps[i], wow_incomp);
-            wow_term *ic_terms = A_PTR(ic->terms, wow_term);
-
-            /* Quick filter: skip if changed_pkg isn't in this incompatibility */
-            if (changed_pkg != WOW_AOFF_NULL) {
-                bool relevant = false;
-                const char *cpkg = A_STR(changed_pkg);
-                for (int t = 0; t < ic->n_terms; t++) {
-                    if (streq(A_STR(ic_terms[t].package), cpkg)) {
-                        relevant = true;
-                        break;
-                    }
-                }
-                if (!relevant) continue;
-            }
-
-            int n_satisfied = 0;
-            int n_inconclusive = 0;
-            int inconclusive_idx = -1;
-
-            for (int t = 0; t < ic->n_terms; t++) {
-                enum term_relation rel = term_relation(s, &ic_terms[t]);
-                if (rel == TERM_SATISFIED) {
-                    n_satisfied++;
-                } else if (rel == TERM_INCONCLUSIVE) {
-                    n_inconclusive++;
-                    inconclusive_idx = t;
-                }
-                /* CONTRADICTED terms are neither satisfied nor inconclusive */
-            }
-
-            if (n_satisfied == ic->n_terms) {
-                /* Conflict! All terms are satisfied → impossible */
-                return s->incomps[i];
+    wow_aoff *changed = NULL, *next = NULL;
+    int n_changed = 0, n_next = 0, changed_cap = 0, next_cap = 0;
+    wow_aoff conflict = WOW_AOFF_NULL;
+    int first_new = s->n_propagated;
+
+    if (decided != WOW_AOFF_NULL &&
+        push_pkg(&changed, &n_changed, &changed_cap, decided) != 0)
+        return WOW_AOFF_NULL;
+
+    while (first_new < s->n_incomps || n_changed > 0) {
+        wow_aoff derived;
+
+        for (int c = 0; c < n_changed; c++) {
+            const struct wow_pkg_slot *slot = pkg_slot(s, changed[c]);
+            for (int k = 0; k < slot->n_incomps; k++) {
+                int i = slot->incomps[k];
+                if (i >= first_new) break;   /* checked below */
+
+                /* Once per pass, even if it mentions several */
+                const wow_incomp *ic = A_PTR(s->incomps[i], wow_incomp);
+                const wow_term *ic_terms = A_PTR(ic->terms, wow_term);
+                bool seen = false;
+                for (int d = 0; d < c && !seen; d++)
+                    for (int t = 0; t < ic->n_terms && !seen; t++)
+                        seen = ic_terms[t].package == changed[d];
+                if (seen) continue;
+
+                derived = WOW_AOFF_NULL;
+                conflict = propagate_incomp(s, i, &derived);
+                if (conflict != WOW_AOFF_NULL) goto out;
+                if (derived != WOW_AOFF_NULL &&
+                    push_pkg(&next, &n_next, &next_cap, derived) != 0)
+                    goto out;
             }
+        }
 
-            if (n_satisfied == ic->n_terms - 1 && n_inconclusive == 1) {
-                /* Unit propagation: derive negation of the inconclusive term.
-                 * Flip the polarity: positive → negative, negative → positive.
-                 * Keep the range as-is — the assignment's positive flag
-                 * encodes the negation semantics. */
-                wow_term *ut = &ic_terms[inconclusive_idx];
-                wow_assignment deriv;
-                memset(&deriv, 0, sizeof(deriv));
-                deriv.package = ut->package;
-                deriv.is_decision = false;
-                deriv.decision_level = s->decision_level;
-                deriv.cause = s->incomps[i];
-                deriv.range = ut->range;
-                deriv.positive = !ut->positive;  /* flip polarity */
-
-                push_assignment(s, &deriv);
-                changed = true;
-                changed_pkg = ut->package;
-                break;  /* restart scan */
-            }
+        for (int i = first_new; i < s->n_incomps; i++) {
+            derived = WOW_AOFF_NULL;
+            conflict = propagate_incomp(s, i, &derived);
+            if (conflict != WOW_AOFF_NULL) goto out;
+            if (derived != WOW_AOFF_NULL &&
+                push_pkg(&next, &n_next, &next_cap, derived) != 0)
+                goto out;
         }
+        first_new = s->n_incomps;
+
+        wow_aoff *tmp = changed;
+        int tmp_cap = changed_cap;
+        changed = next;
+        changed_cap = next_cap;
+        n_changed = n_next;
+        next = tmp;
+        next_cap = tmp_cap;
+        n_next = 0;
     }
+    s->n_propagated = s->n_incomps;
 
-    return WOW_AOFF_NULL;  /* no conflict */
+out:
+    free(changed);
+    free(next);
+    return conflict;  /* WOW_AOFF_NULL: no conflict */
 }
 
 /* ------------------------------------------------------------------ */
 /* Conflict resolution                                                 */
 /* ------------------------------------------------------------------ */
 
+static bool range_eq(const wow_ver_range *a, const wow_ver_range *b)
+{
+    if (a->has_min != b->has_min || a->has_max != b->has_max) return false;
+    if (a->has_min && (a->min_inclusive != b->min_inclusive ||
+                       wow_gemver_cmp(&a->min, &b->min) != 0))
+        return false;
+    if (a->has_max && (a->max_inclusive != b->max_inclusive ||
+                       wow_gemver_cmp(&a->max, &b->max) != 0))
+        return false;
+    return true;
+}
+
+/* Growable term list for building a derived incompatibility */
+struct term_buf {
+    wow_term *v;
+    int       n, cap;
+};
+
+/*
+ * Add t to the list.  Several terms for one package stand for their
+ * conjunction, which is exact; only positive pairs are folded into one
+ * (their intersection), since a negated pair may not be one range.
+ */
+static int term_buf_add(struct term_buf *b, const wow_term *t)
+{
+    for (int i = 0; i < b->n; i++) {
+        wow_term *u = &b->v[i];
+        if (u->positive != t->positive || u->package != t->package)
+            continue;
+        if (range_eq(&u->range, &t->range)) return 0;
+        if (t->positive) {
+            range_tighten(&u->range, &t->range);
+            return 0;
+        }
+    }
+    if (b->n == b->cap) {
+        int new_cap = b->cap ? b->cap * 2 : 16;
+        wow_term *nv = realloc(b->v, (size_t)new_cap * sizeof(*nv));
+        if (!nv) return -1;
+        b->v = nv;
+        b->cap = new_cap;
+    }
+    b->v[b->n++] = *t;
+    return 0;
+}
+
 /*
  * When unit propagation finds a conflict, we need to learn a new
  * incompatibility and backjump to the right decision level.
@@ -535,10 +906,12 @@ static wow_aoff unit_propagate(wow_solver *s, wow_aoff changed_pkg)
 static int conflict_resolution(wow_solver *s, wow_aoff conflict)
 {
     /*
-     * Algorithm:
-     * While the conflict incompatibility has more than one term at the
-     * current decision level, resolve it with the cause of the most
-     * recent assignment for one of those terms.
+     * Algorithm (solver.md, "Conflict Resolution"): find the satisfier,
+     * the assignment that completed the conflict.  If it is a decision,
+     * or every other term was already satisfied at an earlier decision
+     * level, the incompatibility is learned and we backjump to that
+     * level, where it propagates.  Otherwise resolve: replace the
+     * satisfier's package with what caused its assignments, and repeat.
      */
     wow_aoff ic_off = conflict;
 
@@ -546,151 +919,211 @@ static int conflict_resolution(wow_solver *s, wow_aoff conflict)
         wow_incomp *ic = A_PTR(ic_off, wow_incomp);
         wow_term *ic_terms = A_PTR(ic->terms, wow_term);
 
-        /* Count how many terms in ic are decided at the current level */
-        int n_at_level = 0;
-        int most_recent_idx = -1;
-        int most_recent_assign = -1;
-
+        int sat_idx = -1, sat_term = -1;
         for (int t = 0; t < ic->n_terms; t++) {
-            /* Find the most recent assignment for this term's package
-             * at the current decision level */
-            const char *tpkg = A_STR(ic_terms[t].package);
-            for (int a = s->n_assign - 1; a >= 0; a--) {
-                if (!streq(A_STR(s->assignments[a].package), tpkg))
-                    continue;
-                if (s->assignments[a].decision_level ==
-                    s->decision_level) {
-                    n_at_level++;
-                    if (a > most_recent_assign) {
-                        most_recent_assign = a;
-                        most_recent_idx = t;
-                    }
-                    break;
-                }
+            int k = term_satisfier(s, &ic_terms[t]);
+            if (k > sat_idx) {
+                sat_idx = k;
+                sat_term = t;
             }
         }
+        /* Holds with no assignments at all (or, defensively, does not
+         * hold): nothing to backtrack over */
+        if (sat_idx < 0 || sat_idx >= s->n_assign) return -1;
 
-        if (n_at_level <= 1) {
-            /* We've reduced to at most one term at current level.
-             * This is our learned incompatibility. */
-            break;
-        }
+        const wow_assignment *sat = &s->assignments[sat_idx];
+        wow_aoff sat_pkg = sat->package;
+        int level = sat->decision_level;
 
-        /* Resolve: combine ic with the cause of the most recent assignment */
-        if (most_recent_assign < 0 ||
-            s->assignments[most_recent_assign].cause == WOW_AOFF_NULL) {
-            /* Cannot resolve further — this shouldn't happen with
-             * a correct algorithm, but guard against it */
-            break;
+        /* The level by which every other term was satisfied.  A decision
+         * settles all of its package's terms, so only others count. */
+        int prev = 0;
+        for (int t = 0; t < ic->n_terms; t++) {
+            if (t == sat_term) continue;
+            if (sat->is_decision &&
+                ic_terms[t].package == sat_pkg)
+                continue;
+            int k = term_satisfier(s, &ic_terms[t]);
+            if (k >= 0 && s->assignments[k].decision_level > prev)
+                prev = s->assignments[k].decision_level;
         }
 
-        wow_aoff prior_cause_off = s->assignments[most_recent_assign].cause;
-
-        /* Build a new incompatibility from the union of terms in ic and
-         * prior_cause, minus the resolved term's package.
-         * This is the resolution rule: if ic says {A, B} are incompatible
-         * and prior_cause says {¬A, C} are incompatible, then {B, C} are
-         * incompatible. */
-        wow_term merged[64];
-        int n_merged = 0;
+        if (sat->is_decision || prev < level) {
+            if (level == 0) return -1;   /* conflict at the root */
+
+            if (sat->is_decision) {
+                /* Several terms on the decided package would leave the
+                 * learned incompatibility without a single term to
+                 * propagate; "pkg = v" implies them all, so it may
+                 * stand in for them (a narrower term is still sound) */
+                int n_pkg = 0;
+                for (int t = 0; t < ic->n_terms; t++)
+                    if (ic_terms[t].package == sat_pkg)
+                        n_pkg++;
+                if (n_pkg > 1) {
+                    struct term_buf b = { 0 };
+                    wow_term exact = { sat->package,
+                                       range_exact(&sat->version), true };
+                    int rc = term_buf_add(&b, &exact);
+                    for (int t = 0; t < ic->n_terms && rc == 0; t++)
+                        if (ic_terms[t].package != sat_pkg)
+                            rc = term_buf_add(&b, &ic_terms[t]);
+                    wow_aoff narrowed = rc == 0 ?
+                        make_incomp(s, b.v, b.n, CAUSE_CONFLICT) :
+                        WOW_AOFF_NULL;
+                    free(b.v);
+                    if (narrowed == WOW_AOFF_NULL) return -1;
+                    A_PTR(narrowed, wow_incomp)->cause_a = ic_off;
+                    ic_off = narrowed;
+                }
+            }
 
-        /* Re-fetch pointers (stable within this block — no arena allocs) */
-        ic = A_PTR(ic_off, wow_incomp);
-        ic_terms = A_PTR(ic->terms, wow_term);
-        wow_aoff resolved_pkg = ic_terms[most_recent_idx].package;
+            if (ic_off != conflict && push_incomp(s, ic_off) != 0)
+                return -1;
 
-        /* Add terms from ic (except the resolved one) */
-        for (int t = 0; t < ic->n_terms; t++) {
-            if (t == most_recent_idx) continue;
-            if (n_merged < 64) merged[n_merged++] = ic_terms[t];
+            /* Backjump: remove all assignments above prev (assignments
+             * are ordered by level, so the rest stay satisfied) */
+            s->n_propagated = 0;
+            while (s->n_assign > 0 &&
+                   s->assignments[s->n_assign - 1].decision_level > prev) {
+                const wow_assignment *a = &s->assignments[--s->n_assign];
+                pkg_slot(s, a->package)->last = a->prev;
+                /* What is left is the fixpoint this decision was made in */
+                if (a->is_decision) s->n_propagated = a->n_incomps;
+            }
+            s->stats.backjumps++;
+            s->stats.backjump_levels += s->decision_level - prev;
+            s->decision_level = prev;
+            return 0;
         }
 
-        /* Add terms from prior_cause (except the resolved package) */
-        wow_incomp *prior = A_PTR(prior_cause_off, wow_incomp);
-        wow_term *prior_terms = A_PTR(prior->terms, wow_term);
-        const char *resolved_str = A_STR(resolved_pkg);
-        for (int t = 0; t < prior->n_terms; t++) {
-            if (streq(A_STR(prior_terms[t].package), resolved_str))
+        /*
+         * Resolve.  Together, the satisfier's package's assignments up to
+         * and including the satisfier imply every term ic has on that
+         * package, and each derived one follows from its cause's other
+         * terms.  So ic's remaining terms plus those causes' remaining
+         * terms cannot all hold: that is the new incompatibility.  Each
+         * of its terms is satisfied before sat_idx, so this terminates.
+         */
+        struct term_buf b = { 0 };
+        int rc = 0;
+        for (int t = 0; t < ic->n_terms && rc == 0; t++)
+            if (ic_terms[t].package != sat_pkg)
+                rc = term_buf_add(&b, &ic_terms[t]);
+
+        for (int a = 0; a <= sat_idx && rc == 0; a++) {
+            const wow_assignment *asg = &s->assignments[a];
+            if (asg->package != sat_pkg) continue;
+            if (asg->is_decision || asg->cause == WOW_AOFF_NULL) {
+                wow_term exact = { asg->package, range_exact(&asg->version),
+                                   true };
+                rc = term_buf_add(&b, &exact);
                 continue;
-            /* Check for duplicate package — merge ranges */
-            bool found = false;
-            for (int m = 0; m < n_merged; m++) {
-                if (streq(A_STR(merged[m].package),
-                          A_STR(prior_terms[t].package))) {
-                    /* Both positive or both negative: intersect ranges */
-                    if (merged[m].positive ==
-                        prior_terms[t].positive) {
-                        merged[m].range = range_intersect(
-                            &merged[m].range,
-                            &prior_terms[t].range);
-                    }
-                    found = true;
-                    break;
+            }
+            /* The cause minus the term this assignment negates */
+            wow_incomp *cause = A_PTR(asg->cause, wow_incomp);
+            wow_term *cause_terms = A_PTR(cause->terms, wow_term);
+            bool skipped = false;
+            for (int t = 0; t < cause->n_terms && rc == 0; t++) {
+                const wow_term *ct = &cause_terms[t];
+                if (!skipped && ct->positive != asg->positive &&
+                    ct->package == sat_pkg &&
+                    range_eq(&ct->range, &asg->range)) {
+                    skipped = true;
+                    continue;
                 }
+                rc = term_buf_add(&b, ct);
             }
-            if (!found && n_merged < 64)
-                merged[n_merged++] = prior_terms[t];
         }
 
-        /* make_incomp may grow the arena — invalidates ic, prior, etc. */
-        wow_aoff derived_off = make_incomp(s, merged, n_merged,
-                                            CAUSE_CONFLICT);
+        /* make_incomp may grow the arena — invalidates ic, sat, etc. */
+        wow_aoff prior_cause_off = sat->cause;
+        wow_aoff derived_off = rc == 0 ?
+            make_incomp(s, b.v, b.n, CAUSE_CONFLICT) : WOW_AOFF_NULL;
+        free(b.v);
         if (derived_off == WOW_AOFF_NULL) return -1;
+        s->stats.learned++;
 
-        /* Re-fetch derived after arena may have moved */
         wow_incomp *derived = A_PTR(derived_off, wow_incomp);
         derived->cause_a = ic_off;
         derived->cause_b = prior_cause_off;
 
         ic_off = derived_off;
     }
+}
 
-    /* Add the learned incompatibility */
-    push_incomp(s, ic_off);
+/* ------------------------------------------------------------------ */
+/* Decision (version selection)                                        */
+/* ------------------------------------------------------------------ */
 
-    /* Find the decision level to backjump to:
-     * the second-highest decision level among ic's terms */
-    wow_incomp *ic = A_PTR(ic_off, wow_incomp);
-    wow_term *ic_terms = A_PTR(ic->terms, wow_term);
-    int target_level = 0;
-    for (int t = 0; t < ic->n_terms; t++) {
-        const char *tpkg = A_STR(ic_terms[t].package);
-        for (int a = s->n_assign - 1; a >= 0; a--) {
-            if (!streq(A_STR(s->assignments[a].package), tpkg))
-                continue;
-            int lvl = s->assignments[a].decision_level;
-            if (lvl < s->decision_level && lvl > target_level)
-                target_level = lvl;
-            break;
-        }
+/*
+ * Current constraints on pkg: the intersection of its positive
+ * assignments (or the exact decided version) and up to 16 negative
+ * ranges it must avoid.
+ */
+static void pkg_constraints(const wow_solver *s, wow_aoff pkg,
+                            wow_ver_range *pos, wow_ver_range neg[16],
+                            int *n_neg)
+{
+    struct pkg_state st;
+    int idx[PKG_CHAIN_MAX];
+    int n = pkg_chain(s, pkg, idx);
+    pkg_state_init(&st);
+    if (n < 0) {
+        for (int a = 0; a < s->n_assign; a++)
+            if (s->assignments[a].package == pkg)
+                pkg_state_add(&st, &s->assignments[a]);
+    } else {
+        for (int k = 0; k < n; k++)
+            pkg_state_add(&st, &s->assignments[idx[k]]);
     }
 
-    if (s->decision_level == 0) {
-        /* Unresolvable conflict at root level */
-        return -1;
-    }
+    *pos = st.decided ? range_exact(st.decided) : st.pos;
+    *n_neg = st.n_neg;
+    for (int i = 0; i < st.n_neg; i++)
+        neg[i] = *st.neg[i];
+}
 
-    /* Backjump: remove all assignments above target_level */
-    int new_n = 0;
-    for (int a = 0; a < s->n_assign; a++) {
-        if (s->assignments[a].decision_level <= target_level) {
-            s->assignments[new_n++] = s->assignments[a];
-        }
-    }
-    s->n_assign = new_n;
-    s->decision_level = target_level;
+/* Is v inside pos, outside every neg, and not a gated pre-release? */
+static bool version_allowed(const wow_ver_range *pos,
+                            const wow_ver_range *neg, int n_neg,
+                            const wow_gemver *v)
+{
+    if (!range_contains(pos, v)) return false;
 
-    return 0;
+    /* RubyGems pre-release semantics: skip pre-release versions unless
+     * the positive range references a pre-release */
+    if (v->prerelease && !range_allows_prerelease(pos)) return false;
+
+    for (int i = 0; i < n_neg; i++)
+        if (range_contains(&neg[i], v)) return false;
+    return true;
 }
 
-/* ------------------------------------------------------------------ */
-/* Decision (version selection)                                        */
-/* ------------------------------------------------------------------ */
+/*
+ * The provider's preferred version of pkg (e.g. from the previous
+ * lockfile) if it is still allowed by the partial solution, else NULL.
+ */
+static const wow_gemver *preferred_if_allowed(const wow_solver *s,
+                                              wow_aoff pkg)
+{
+    if (!s->provider->preferred_version) return NULL;
+    const wow_gemver *pref =
+        s->provider->preferred_version(s->provider->ctx, A_STR(pkg));
+    if (!pref) return NULL;
+
+    wow_ver_range pos, neg[16];
+    int n_neg;
+    pkg_constraints(s, pkg, &pos, neg, &n_neg);
+    return version_allowed(&pos, neg, n_neg, pref) ? pref : NULL;
+}
 
 /*
- * Find the next package to decide on: one that has assignments
- * (constraints) but no decision yet.
- * Heuristic: pick the package with the fewest available versions.
+ * Find the next package to decide on: one that has a positive
+ * assignment (something requires it) but no decision yet.
+ * A package whose preferred version is still allowed goes first — it
+ * is all but decided already.  Otherwise, heuristic: pick the package
+ * with the fewest available versions.
  * Returns WOW_AOFF_NULL if all packages are decided.
  */
 static wow_aoff pick_next_package(wow_solver *s)
@@ -701,16 +1134,18 @@ static wow_aoff pick_next_package(wow_solver *s)
 
     for (int a = 0; a < s->n_assign; a++) {
         wow_aoff pkg = s->assignments[a].package;
-        const char *pkg_str = A_STR(pkg);
 
         /* Skip root */
-        if (streq(pkg_str, ROOT_PKG)) continue;
+        if (pkg == s->assignments[0].package) continue;
+
+        /* Only a positive derivation means the package is needed */
+        if (!s->assignments[a].positive) continue;
 
         /* Check if this package already has a decision */
         bool has_decision = false;
-        for (int b = 0; b < s->n_assign; b++) {
-            if (streq(A_STR(s->assignments[b].package), pkg_str) &&
-                s->assignments[b].is_decision) {
+        for (int b = pkg_slot(s, pkg)->last; b >= 0;
+             b = s->assignments[b].prev) {
+            if (s->assignments[b].is_decision) {
                 has_decision = true;
                 break;
             }
@@ -720,7 +1155,7 @@ static wow_aoff pick_next_package(wow_solver *s)
         /* Check if already in candidates */
         bool dup = false;
         for (int c = 0; c < n_cand; c++) {
-            if (streq(A_STR(candidates[c]), pkg_str)) { dup = true; break; }
+            if (candidates[c] == pkg) { dup = true; break; }
         }
         if (!dup && n_cand < 256)
             candidates[n_cand++] = pkg;
@@ -728,6 +1163,10 @@ static wow_aoff pick_next_package(wow_solver *s)
 
     if (n_cand == 0) return WOW_AOFF_NULL;
 
+    for (int i = 0; i < n_cand; i++)
+        if (preferred_if_allowed(s, candidates[i]))
+            return candidates[i];
+
     /* Heuristic: fewest available versions matching current range */
     wow_aoff best = WOW_AOFF_NULL;
     int best_count = INT32_MAX;
@@ -736,41 +1175,20 @@ static wow_aoff pick_next_package(wow_solver *s)
         const char *cand_str = A_STR(candidates[i]);
         const wow_gemver *versions;
         int n_ver;
-        if (s->provider->list_versions(s->provider->ctx,
-                                        cand_str,
-                                        &versions, &n_ver) != 0)
-            continue;
+        /* Unlistable (fetch failed): pick it so choose_version fails
+         * it, rather than skipping it into an empty "solution" */
+        if (provider_list_versions(s, cand_str, &versions, &n_ver) != 0)
+            return candidates[i];
 
         /* Count versions matching current constraints */
-        wow_ver_range pkg_pos = WOW_RANGE_ANY;
-        wow_ver_range pkg_neg[16];
-        int pkg_n_neg = 0;
-        for (int a = 0; a < s->n_assign; a++) {
-            if (!streq(A_STR(s->assignments[a].package), cand_str))
-                continue;
-            if (s->assignments[a].is_decision) {
-                pkg_pos = range_exact(&s->assignments[a].version);
-            } else if (s->assignments[a].positive) {
-                pkg_pos = range_intersect(&pkg_pos,
-                                           &s->assignments[a].range);
-            } else if (pkg_n_neg < 16) {
-                pkg_neg[pkg_n_neg++] = s->assignments[a].range;
-            }
-        }
+        wow_ver_range pkg_pos, pkg_neg[16];
+        int pkg_n_neg;
+        pkg_constraints(s, candidates[i], &pkg_pos, pkg_neg, &pkg_n_neg);
 
-        bool pkg_pre_ok = range_allows_prerelease(&pkg_pos);
         int matching = 0;
-        for (int v = 0; v < n_ver; v++) {
-            if (!range_contains(&pkg_pos, &versions[v])) continue;
-            if (versions[v].prerelease && !pkg_pre_ok) continue;
-            bool excl = false;
-            for (int ne = 0; ne < pkg_n_neg; ne++) {
-                if (range_contains(&pkg_neg[ne], &versions[v])) {
-                    excl = true; break;
-                }
-            }
-            if (!excl) matching++;
-        }
+        for (int v = 0; v < n_ver; v++)
+            if (version_allowed(&pkg_pos, pkg_neg, pkg_n_neg, &versions[v]))
+                matching++;
 
         if (matching < best_count) {
             best_count = matching;
@@ -783,19 +1201,33 @@ static wow_aoff pick_next_package(wow_solver *s)
 
 /*
  * Choose a version for the given package that matches the current
- * assignment constraints. Picks the newest matching version.
+ * assignment constraints: the preferred version if still allowed and
+ * still in the index (a locked version may since have been yanked),
+ * otherwise the newest matching version.
  * Respects both positive ranges (must be in) and negative ranges
  * (must NOT be in). Returns NULL if no version matches.
  */
 static const wow_gemver *choose_version(wow_solver *s, wow_aoff pkg_off)
 {
     const char *pkg = A_STR(pkg_off);
+
     const wow_gemver *versions;
     int n_ver;
-    if (s->provider->list_versions(s->provider->ctx, pkg,
-                                    &versions, &n_ver) != 0)
+    if (provider_list_versions(s, pkg, &versions, &n_ver) != 0)
         return NULL;
 
+    const wow_gemver *pref = preferred_if_allowed(s, pkg_off);
+    for (int v = 0; pref && v < n_ver; v++) {
+        if (wow_gemver_cmp(&versions[v], pref) == 0) {
+            DBG("choose_version(%s): preferred %s\n", pkg, pref->raw);
+            s->stats.preferred++;
+            return &versions[v];
+        }
+    }
+    if (pref)
+        DBG("choose_version(%s): preferred %s is no longer listed\n",
+            pkg, pref->raw);
+
     DBG("choose_version(%s): %d versions available, top3:",
         pkg, n_ver);
     for (int _i = 0; _i < n_ver && _i < 3; _i++)
@@ -803,44 +1235,13 @@ static const wow_gemver *choose_version(wow_solver *s, wow_aoff pkg_off)
     DBG("\n");
 
     /* Compute positive range and collect negative exclusions */
-    wow_ver_range pos_range = WOW_RANGE_ANY;
-    wow_ver_range neg_ranges[16];
-    int n_neg = 0;
-
-    for (int a = 0; a < s->n_assign; a++) {
-        if (!streq(A_STR(s->assignments[a].package), pkg)) continue;
-        if (s->assignments[a].is_decision) {
-            pos_range = range_exact(&s->assignments[a].version);
-        } else if (s->assignments[a].positive) {
-            pos_range = range_intersect(&pos_range,
-                                         &s->assignments[a].range);
-        } else {
-            if (n_neg < 16)
-                neg_ranges[n_neg++] = s->assignments[a].range;
-        }
-    }
-
-    /* Pre-release gate: skip pre-release versions unless the positive
-     * range was derived from a constraint that references a pre-release */
-    bool prerelease_ok = range_allows_prerelease(&pos_range);
+    wow_ver_range pos_range, neg_ranges[16];
+    int n_neg;
+    pkg_constraints(s, pkg_off, &pos_range, neg_ranges, &n_neg);
 
     /* Pick newest matching: must be in pos_range and NOT in any neg_range */
     for (int v = 0; v < n_ver; v++) {
-        if (!range_contains(&pos_range, &versions[v]))
-            continue;
-
-        /* RubyGems pre-release semantics */
-        if (versions[v].prerelease && !prerelease_ok)
-            continue;
-
-        bool excluded = false;
-        for (int i = 0; i < n_neg; i++) {
-            if (range_contains(&neg_ranges[i], &versions[v])) {
-                excluded = true;
-                break;
-            }
-        }
-        if (!excluded) {
+        if (version_allowed(&pos_range, neg_ranges, n_neg, &versions[v])) {
             DBG("choose_version(%s): picked %s (idx %d)\n",
                 pkg, versions[v].raw, v);
             return &versions[v];
@@ -933,6 +1334,14 @@ static void explain_error(wow_solver *s, wow_aoff root_off)
                 }
             }
             sp--;
+        } else if (ic->cause_type == CAUSE_NO_VERSIONS) {
+            /* "no versions of rack match >= 9.0" */
+            char rbuf[128];
+            fmt_range(rbuf, sizeof(rbuf), &ic_terms[0].range);
+            off += (size_t)snprintf(msg + off, sz - off,
+                "no versions of %s match %s",
+                A_STR(ic_terms[0].package), rbuf);
+            sp--;
         } else if (ic->cause_type == CAUSE_ROOT) {
             for (int t = 0; t < ic->n_terms; t++) {
                 if (streq(A_STR(ic_terms[t].package), ROOT_PKG)) continue;
@@ -982,6 +1391,7 @@ void wow_solver_init(wow_solver *s, wow_provider *p)
 {
     memset(s, 0, sizeof(*s));
     wow_arena_init(&s->arena);
+    s->arena.mem_sys = WOW_MEM_SOLVER;
     s->provider = p;
 }
 
@@ -991,19 +1401,25 @@ void wow_solver_destroy(wow_solver *s)
     free(s->incomps);
     free(s->assignments);
     free(s->solution);
+    for (int i = 0; i < s->names_cap; i++) {
+        free(s->names[i].incomps);
+        free(s->names[i].deps_added);
+    }
+    free(s->names);
     memset(s, 0, sizeof(*s));
 }
 
-int wow_solve(wow_solver *s,
-              const char **root_names,
-              const wow_gem_constraints *root_constraints,
-              int n_roots)
+static int solve(wow_solver *s,
+                 const char **root_names,
+                 const wow_gem_constraints *root_constraints,
+                 int n_roots)
 {
     /* Step 1: add root package as a decision at level 0 */
     {
         wow_assignment root_assign;
         memset(&root_assign, 0, sizeof(root_assign));
-        root_assign.package = wow_arena_strdup_off(&s->arena, ROOT_PKG);
+        root_assign.package = intern(s, ROOT_PKG);
+        if (root_assign.package == WOW_AOFF_NULL) return -1;
         root_assign.cause = WOW_AOFF_NULL;
         root_assign.is_decision = true;
         root_assign.positive = true;
@@ -1020,7 +1436,8 @@ int wow_solve(wow_solver *s,
 
     /* Step 2: add incompatibilities for each root dependency */
     for (int i = 0; i < n_roots; i++) {
-        wow_aoff name_off = wow_arena_strdup_off(&s->arena, root_names[i]);
+        wow_aoff name_off = intern(s, root_names[i]);
+        if (name_off == WOW_AOFF_NULL) return -1;
         wow_ver_range dep_range =
             range_from_constraints(&root_constraints[i]);
 
@@ -1032,7 +1449,7 @@ int wow_solve(wow_solver *s,
         wow_term terms[2];
 
         /* Root positive term */
-        terms[0].package = wow_arena_strdup_off(&s->arena, ROOT_PKG);
+        terms[0].package = s->assignments[0].package;
         terms[0].range = range_exact(&s->assignments[0].version);
         terms[0].positive = true;
 
@@ -1047,12 +1464,22 @@ int wow_solve(wow_solver *s,
     }
 
     /* Step 3: main solving loop */
-    int max_iterations = 10000;
-    for (int iter = 0; iter < max_iterations; iter++) {
+    int max_iterations = 100000;
+    wow_aoff decided = WOW_AOFF_NULL;
+    for (int iter = 0; ; iter++) {
+        /* Out of iterations is a failure, never a partial solution */
+        if (iter == max_iterations) {
+            snprintf(s->error_msg, sizeof(s->error_msg),
+                     "gave up after %d iterations", max_iterations);
+            return -1;
+        }
+
         /* Unit propagation */
-        wow_aoff conflict = unit_propagate(s, WOW_AOFF_NULL);
+        wow_aoff conflict = unit_propagate(s, decided);
+        decided = WOW_AOFF_NULL;
 
         if (conflict != WOW_AOFF_NULL) {
+            s->stats.conflicts++;
             /* Conflict resolution: learn + backjump */
             if (conflict_resolution(s, conflict) != 0) {
                 explain_error(s, conflict);
@@ -1068,32 +1495,32 @@ int wow_solve(wow_solver *s,
             break;
         }
 
-        /* Choose a version */
+        /* Choose a version (the span covers the dependency fetch too) */
+        uint64_t t_decide = wow_trace_begin();
         const wow_gemver *chosen = choose_version(s, next_pkg);
 
         if (!chosen) {
             /* No version available in the current allowed range.
-             * Add incompatibility: "pkg in [current range] is impossible".
-             * Use the actual constrained range, not ANY — this lets
-             * conflict resolution learn which constraint caused the
-             * failure and backtrack appropriately. */
-            wow_ver_range eff_range = WOW_RANGE_ANY;
-            for (int a = 0; a < s->n_assign; a++) {
-                if (!streq(A_STR(s->assignments[a].package),
-                           A_STR(next_pkg)))
-                    continue;
-                if (s->assignments[a].positive) {
-                    eff_range = range_intersect(&eff_range,
-                                                &s->assignments[a].range);
-                }
+             * Add incompatibility: "pkg in [positive range] and outside
+             * every excluded range is impossible" — exactly what
+             * choose_version found, so conflict resolution can learn
+             * which constraint caused the failure and backtrack. */
+            wow_ver_range pos, neg[16];
+            int n_neg;
+            pkg_constraints(s, next_pkg, &pos, neg, &n_neg);
+
+            wow_term terms[17];
+            terms[0].package = next_pkg;
+            terms[0].range = pos;
+            terms[0].positive = true;
+            for (int i = 0; i < n_neg; i++) {
+                terms[1 + i].package = next_pkg;
+                terms[1 + i].range = neg[i];
+                terms[1 + i].positive = false;
             }
 
-            wow_term term;
-            term.package = next_pkg;
-            term.range = eff_range;
-            term.positive = true;
-
-            wow_aoff no_ver = make_incomp(s, &term, 1, CAUSE_ROOT);
+            wow_aoff no_ver = make_incomp(s, terms, 1 + n_neg,
+                                          CAUSE_NO_VERSIONS);
             if (no_ver == WOW_AOFF_NULL) return -1;
             push_incomp(s, no_ver);
             /* Re-propagate will catch the conflict */
@@ -1106,6 +1533,9 @@ int wow_solve(wow_solver *s,
 
         /* Make a decision */
         s->decision_level++;
+        s->stats.decisions++;
+        if (s->decision_level > s->stats.max_decision_level)
+            s->stats.max_decision_level = s->decision_level;
         wow_assignment decision;
         memset(&decision, 0, sizeof(decision));
         decision.package = next_pkg;
@@ -1115,15 +1545,19 @@ int wow_solve(wow_solver *s,
         decision.is_decision = true;
         decision.positive = true;
         decision.decision_level = s->decision_level;
+        decision.n_incomps = s->n_incomps;
         push_assignment(s, &decision);
-
-        /* Add incompatibilities from this version's dependencies */
-        const char **dep_names;
-        wow_gem_constraints *dep_cs;
-        int n_deps;
-        if (s->provider->get_deps(s->provider->ctx, A_STR(next_pkg),
-                                   chosen, &dep_names, &dep_cs,
-                                   &n_deps) != 0) {
+        decided = next_pkg;
+
+        /* Add incompatibilities from this version's dependencies, once:
+         * those from an earlier decision on it outlive the backjump */
+        const char **dep_names = NULL;
+        wow_gem_constraints *dep_cs = NULL;
+        int n_deps = 0;
+        int seen = deps_seen(s, next_pkg, chosen);
+        if (seen < 0) return -1;
+        if (!seen && provider_get_deps(s, A_STR(next_pkg), chosen,
+                                       &dep_names, &dep_cs, &n_deps) != 0) {
             snprintf(s->error_msg, sizeof(s->error_msg),
                      "failed to fetch dependencies for %s %s",
                      A_STR(next_pkg), chosen->raw);
@@ -1145,8 +1579,8 @@ int wow_solve(wow_solver *s,
             terms[0].positive = true;
 
             /* "...then dep must be in range" (negated: dep NOT in range) */
-            terms[1].package =
-                wow_arena_strdup_off(&s->arena, dep_names[d]);
+            terms[1].package = intern(s, dep_names[d]);
+            if (terms[1].package == WOW_AOFF_NULL) return -1;
             terms[1].range = dep_range;
             terms[1].positive = false;
 
@@ -1165,6 +1599,13 @@ int wow_solve(wow_solver *s,
 
             push_incomp(s, dep_ic_off);
         }
+
+        if (wow_trace_on) {
+            char what[160];
+            snprintf(what, sizeof(what), "%s %s",
+                     A_STR(next_pkg), chosen->raw);
+            wow_trace_end(t_decide, "solver", "decide", what);
+        }
     }
 
     /* Build solution from decisions (arena is stable — no more allocs) */
@@ -1185,6 +1626,10 @@ int wow_solve(wow_solver *s,
             !streq(A_STR(s->assignments[a].package), ROOT_PKG)) {
             s->solution[idx].name = A_STR(s->assignments[a].package);
             s->solution[idx].version = s->assignments[a].version;
+            if (s->provider->get_platform)
+                s->solution[idx].platform = s->provider->get_platform(
+                    s->provider->ctx, s->solution[idx].name,
+                    &s->solution[idx].version);
             DBG("SOLUTION[%d]: %s = %s\n", idx,
                 s->solution[idx].name,
                 s->solution[idx].version.raw);
@@ -1194,3 +1639,18 @@ int wow_solve(wow_solver *s,
 
     return 0;
 }
+
+int wow_solve(wow_solver *s,
+              const char **root_names,
+              const wow_gem_constraints *root_constraints,
+              int n_roots)
+{
+    uint64_t t0 = wow_trace_begin();
+    double start = wow_now_secs();
+    int rc = solve(s, root_names, root_constraints, n_roots);
+    s->stats.solve_secs = wow_now_secs() - start;
+    s->stats.n_incomps = s->n_incomps;
+    s->stats.arena_peak = s->arena.used;   /* the arena only grows */
+    wow_trace_end(t0, "solver", "solve", NULL);
+    return rc;
+}
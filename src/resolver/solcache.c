@@ -0,0 +1,397 @@
+/*
+ * solcache.c -- on-disk cache of solved resolutions
+ *
+ * Entry layout (all integers little-endian u32, strings length-prefixed,
+ * length 0xFFFFFFFF meaning NULL):
+ *
+ *   "WOWSOL1\n"
+ *   n_index, then per /info file read: name, digest
+ *   n_solved, then per package: name, version, platform
+ *
+ * Entries are never modified in place, only replaced, so a reader sees
+ * either the old file or the new one.  A hit refreshes the entry's
+ * mtime; stores trim entries unused for CACHE_MAX_AGE, and the least
+ * recently used beyond CACHE_MAX_ENTRIES.
+ */
+
+#include "wow/resolver/solcache.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "wow/common.h"
+#include "wow/util/path.h"
+#include "wow/util/sha256.h"
+#include "wow/util/trace.h"
+#include "wow/version.h"
+
+#define CACHE_MAGIC     "WOWSOL1\n"
+#define CACHE_MAGIC_LEN 8
+#define CACHE_MAX_SIZE  (4 * 1024 * 1024)
+#define CACHE_NULL      0xFFFFFFFFu
+
+/* One entry per root set and seed: bound the directory (wow_cache_trim) */
+#define CACHE_MAX_AGE     (30L * 24 * 60 * 60)
+#define CACHE_MAX_ENTRIES 512
+
+/* ------------------------------------------------------------------ */
+/* Location                                                            */
+/* ------------------------------------------------------------------ */
+
+static int cache_enabled(void)
+{
+    const char *off = getenv("WOW_NO_SOLUTION_CACHE");
+    return !(off && off[0] && strcmp(off, "0") != 0);
+}
+
+static int cache_dir(char *buf, size_t bufsz)
+{
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    int n;
+    if (xdg && xdg[0]) {
+        n = snprintf(buf, bufsz, "%s/wow/solution", xdg);
+    } else {
+        const char *home = getenv("HOME");
+        if (!home || !home[0]) return -1;
+        n = snprintf(buf, bufsz, "%s/.cache/wow/solution", home);
+    }
+    return (n < 0 || (size_t)n >= bufsz) ? -1 : 0;
+}
+
+static int entry_path(const char *key, char *buf, size_t bufsz)
+{
+    char dir[WOW_DIR_PATH_MAX];
+    if (cache_dir(dir, sizeof(dir)) != 0) return -1;
+    int n = snprintf(buf, bufsz, "%s/%s", dir, key);
+    return (n < 0 || (size_t)n >= bufsz) ? -1 : 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* Key                                                                 */
+/* ------------------------------------------------------------------ */
+
+static void hash_str(wow_sha256_ctx *h, const char *s)
+{
+    if (s) wow_sha256_update(h, s, strlen(s));
+    wow_sha256_update(h, "\n", 1);
+}
+
+static int cmp_str(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/*
+ * "name\tc1\tc2..." with the constraints in sorted order: the set is an
+ * AND, so ">= 1, < 2" and "< 2, >= 1" are the same root.
+ */
+static char *root_line(const char *name, const wow_gem_constraints *cs)
+{
+    char items[WOW_MAX_CONSTRAINTS][WOW_VER_RAW_SZ + 8];
+    char *sorted[WOW_MAX_CONSTRAINTS];
+    int n = cs->count < WOW_MAX_CONSTRAINTS ? cs->count : WOW_MAX_CONSTRAINTS;
+    size_t len = strlen(name) + 1;
+    for (int i = 0; i < n; i++) {
+        wow_gem_constraints one = { .count = 1 };
+        one.items[0] = cs->items[i];
+        wow_gem_constraints_fmt(&one, items[i], sizeof(items[i]));
+        sorted[i] = items[i];
+        len += strlen(items[i]) + 1;
+    }
+    if (n > 1) qsort(sorted, (size_t)n, sizeof(*sorted), cmp_str);
+
+    char *line = malloc(len);
+    if (!line) return NULL;
+    size_t off = (size_t)snprintf(line, len, "%s", name);
+    for (int i = 0; i < n; i++)
+        off += (size_t)snprintf(line + off, len - off, "\t%s", sorted[i]);
+    return line;
+}
+
+int wow_solcache_key(wow_ci_provider *ci, const char *const *names,
+                     const wow_gem_constraints *cs, int n,
+                     const char *seed, char *hex, size_t hexsz)
+{
+    if (!cache_enabled() || n <= 0) return -1;
+
+    char **lines = calloc((size_t)n, sizeof(*lines));
+    if (!lines) return -1;
+    int ok = 1;
+    for (int i = 0; i < n && ok; i++)
+        ok = (lines[i] = root_line(names[i], &cs[i])) != NULL;
+
+    wow_sha256_ctx *h = ok ? wow_sha256_new() : NULL;
+    int rc = -1;
+    if (h) {
+        qsort(lines, (size_t)n, sizeof(*lines), cmp_str);
+        hash_str(h, CACHE_MAGIC "wow " WOW_VERSION);
+        hash_str(h, WOW_ARENA_STR(&ci->arena, ci->source_url));
+        hash_str(h, ci->has_ruby_ver ? ci->ruby_ver.raw : NULL);
+        for (int i = 0; i < ci->n_platforms; i++)
+            hash_str(h, ci->platforms[i]);
+        hash_str(h, "roots");
+        for (int i = 0; i < n; i++)
+            hash_str(h, lines[i]);
+        hash_str(h, seed);
+        rc = wow_sha256_final(h, hex, hexsz);
+        wow_sha256_free(h);
+    }
+    for (int i = 0; i < n; i++) free(lines[i]);
+    free(lines);
+
+    if (rc == 0) ci->digest_bodies = true;
+    return rc;
+}
+
+/* ------------------------------------------------------------------ */
+/* Writing                                                             */
+/* ------------------------------------------------------------------ */
+
+static void put_u32(FILE *f, uint32_t v)
+{
+    unsigned char b[4] = { (unsigned char)v, (unsigned char)(v >> 8),
+                           (unsigned char)(v >> 16),
+                           (unsigned char)(v >> 24) };
+    fwrite(b, 1, 4, f);
+}
+
+static void put_str(FILE *f, const char *s)
+{
+    if (!s) {
+        put_u32(f, CACHE_NULL);
+        return;
+    }
+    size_t len = strlen(s);
+    put_u32(f, (uint32_t)len);
+    fwrite(s, 1, len, f);
+}
+
+int wow_solcache_store(const char *key, wow_ci_provider *ci,
+                       const wow_solver *s)
+{
+    /* Every /info the solve read must be pinned by a digest */
+    int n_pkgs = __atomic_load_n(&ci->n_pkgs, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < n_pkgs; i++)
+        if (ci->pkgs[i].digest == WOW_AOFF_NULL) return -1;
+
+    char path[WOW_OS_PATH_MAX], tmp[WOW_OS_PATH_MAX];
+    if (entry_path(key, path, sizeof(path)) != 0) return -1;
+    int n = snprintf(tmp, sizeof(tmp), "%s.tmp.%d", path, (int)getpid());
+    if (n < 0 || (size_t)n >= sizeof(tmp)) return -1;
+
+    FILE *f = fopen(tmp, "wb");
+    if (!f) {
+        char dir[WOW_DIR_PATH_MAX];
+        if (cache_dir(dir, sizeof(dir)) != 0 || wow_mkdirs(dir, 0755) != 0)
+            return -1;
+        if (!(f = fopen(tmp, "wb"))) return -1;
+    }
+
+    fwrite(CACHE_MAGIC, 1, CACHE_MAGIC_LEN, f);
+    put_u32(f, (uint32_t)n_pkgs);
+    for (int i = 0; i < n_pkgs; i++) {
+        put_str(f, WOW_ARENA_STR(&ci->arena, ci->pkgs[i].name));
+        put_str(f, WOW_ARENA_STR(&ci->arena, ci->pkgs[i].digest));
+    }
+    put_u32(f, (uint32_t)s->n_solved);
+    for (int i = 0; i < s->n_solved; i++) {
+        put_str(f, s->solution[i].name);
+        put_str(f, s->solution[i].version.raw);
+        put_str(f, s->solution[i].platform);
+    }
+
+    int werr = ferror(f);
+    if (fclose(f) != 0) werr = 1;
+    if (werr || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+
+    char dir[WOW_DIR_PATH_MAX];
+    if (cache_dir(dir, sizeof(dir)) == 0)
+        wow_cache_trim(dir, CACHE_MAX_AGE, CACHE_MAX_ENTRIES);
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* Reading                                                             */
+/* ------------------------------------------------------------------ */
+
+/* Bounds-checked cursor over an entry; any overrun sets bad */
+struct reader {
+    const unsigned char *p, *end;
+    int bad;
+};
+
+static uint32_t get_u32(struct reader *r)
+{
+    if (r->bad || r->end - r->p < 4) {
+        r->bad = 1;
+        return 0;
+    }
+    uint32_t v = (uint32_t)r->p[0] | (uint32_t)r->p[1] << 8 |
+                 (uint32_t)r->p[2] << 16 | (uint32_t)r->p[3] << 24;
+    r->p += 4;
+    return v;
+}
+
+/* Returns a malloc'd copy; NULL for a NULL string or on error (check bad) */
+static char *get_str(struct reader *r)
+{
+    uint32_t len = get_u32(r);
+    if (r->bad || len == CACHE_NULL) return NULL;
+    if ((size_t)(r->end - r->p) < len) {
+        r->bad = 1;
+        return NULL;
+    }
+    char *s = strndup((const char *)r->p, len);
+    if (!s) r->bad = 1;
+    r->p += len;
+    return s;
+}
+
+/* A count of entries that are each at least min_bytes long */
+static uint32_t get_count(struct reader *r, size_t min_bytes)
+{
+    uint32_t n = get_u32(r);
+    if (!r->bad && n > (size_t)(r->end - r->p) / min_bytes) r->bad = 1;
+    return r->bad ? 0 : n;
+}
+
+static int read_entry(const char *path, unsigned char **out, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    struct stat st;
+    if (fstat(fileno(f), &st) != 0 || st.st_size < CACHE_MAGIC_LEN ||
+        st.st_size > CACHE_MAX_SIZE) {
+        fclose(f);
+        return -1;
+    }
+    unsigned char *buf = malloc((size_t)st.st_size);
+    if (!buf) {
+        fclose(f);
+        return -1;
+    }
+    size_t got = fread(buf, 1, (size_t)st.st_size, f);
+    fclose(f);
+    if (got != (size_t)st.st_size) {
+        free(buf);
+        return -1;
+    }
+    *out = buf;
+    *len = got;
+    return 0;
+}
+
+static void strv_free(char **v, int n)
+{
+    if (!v) return;
+    for (int i = 0; i < n; i++) free(v[i]);
+    free(v);
+}
+
+/*
+ * Refetch the recorded /info files together and compare digests.
+ * Returns 1 if every one is unchanged.
+ */
+static int index_unchanged(struct reader *r, wow_ci_provider *ci)
+{
+    int n = (int)get_count(r, 8);
+    char **names = calloc(n > 0 ? (size_t)n : 1, sizeof(*names));
+    char **digests = calloc(n > 0 ? (size_t)n : 1, sizeof(*digests));
+    int same = names && digests && !r->bad;
+    for (int i = 0; i < n && same; i++) {
+        names[i] = get_str(r);
+        digests[i] = get_str(r);
+        same = !r->bad && names[i] && digests[i];
+    }
+
+    if (same && n > 0 &&
+        wow_ci_provider_prefetch(ci, (const char *const *)names, n, 0) < 0)
+        same = 0;
+    for (int i = 0; i < n && same; i++) {
+        const char *now = wow_ci_provider_digest(ci, names[i]);
+        same = now && strcmp(now, digests[i]) == 0;
+    }
+
+    strv_free(names, n);
+    strv_free(digests, n);
+    return same;
+}
+
+/* ci's copy of a platform name (stable for the provider's lifetime) */
+static const char *ci_platform(const wow_ci_provider *ci, const char *plat,
+                               int *ok)
+{
+    if (!plat) return NULL;
+    for (int i = 0; i < ci->n_platforms; i++)
+        if (strcmp(ci->platforms[i], plat) == 0)
+            return ci->platforms[i];
+    *ok = 0;
+    return NULL;
+}
+
+int wow_solcache_load(const char *key, wow_ci_provider *ci, wow_solver *s)
+{
+    char path[WOW_OS_PATH_MAX];
+    if (!cache_enabled() || entry_path(key, path, sizeof(path)) != 0)
+        return -1;
+
+    unsigned char *buf;
+    size_t len;
+    if (read_entry(path, &buf, &len) != 0) return -1;
+    if (memcmp(buf, CACHE_MAGIC, CACHE_MAGIC_LEN) != 0) {
+        free(buf);
+        return -1;
+    }
+    struct reader r = { buf + CACHE_MAGIC_LEN, buf + len, 0 };
+
+    uint64_t t0 = wow_trace_begin();
+    int ok = index_unchanged(&r, ci);
+
+    /* Names go into the solver arena, as wow_solve's would; pointers
+     * are taken only once it has stopped growing */
+    int n = ok ? (int)get_count(&r, 12) : 0;
+    wow_resolved_pkg *sol = ok ? calloc(n > 0 ? (size_t)n : 1,
+                                        sizeof(*sol)) : NULL;
+    wow_aoff *name_off = ok ? calloc(n > 0 ? (size_t)n : 1,
+                                     sizeof(*name_off)) : NULL;
+    ok = ok && sol && name_off && !r.bad;
+    for (int i = 0; i < n && ok; i++) {
+        char *name = get_str(&r);
+        char *ver = get_str(&r);
+        char *plat = get_str(&r);
+        ok = !r.bad && name && ver &&
+             wow_gemver_parse(ver, &sol[i].version) == 0;
+        if (ok) {
+            sol[i].platform = ci_platform(ci, plat, &ok);
+            name_off[i] = wow_arena_strdup_off(&s->arena, name);
+            ok = ok && name_off[i] != WOW_AOFF_NULL;
+        }
+        free(name);
+        free(ver);
+        free(plat);
+    }
+    ok = ok && r.p == r.end;
+    free(buf);
+
+    wow_trace_end(t0, "solcache", "load", ok ? "hit" : "miss");
+    if (!ok) {
+        free(sol);
+        free(name_off);
+        return -1;
+    }
+    for (int i = 0; i < n; i++)
+        sol[i].name = WOW_ARENA_STR(&s->arena, name_off[i]);
+    free(name_off);
+    free(s->solution);
+    s->solution = sol;
+    s->n_solved = n;
+    wow_cache_touch(path);
+    return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * stats.c -- Resolver statistics report (wow resolve/lock --stats)
+ *
+ * Solve time is split into time spent in the solver proper and time
+ * spent in provider callbacks; the latter is further split into HTTP
+ * and compact index parsing when a compact index provider was used.
+ * A lock-seeded solve shows up as a high "preferred" count with few
+ * index fetches.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "wow/resolver/stats.h"
+#include "wow/util/fmt.h"
+#include "wow/util/mem.h"
+
+int wow_stats_flag(const char *arg, enum wow_stats_mode *mode)
+{
+    if (strcmp(arg, "--stats") == 0) {
+        *mode = WOW_STATS_TEXT;
+        return 1;
+    }
+    if (strcmp(arg, "--stats=json") == 0) {
+        *mode = WOW_STATS_JSON;
+        return 1;
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* JSON                                                                */
+/* ------------------------------------------------------------------ */
+
+static void print_json(FILE *out, const wow_solver_stats *ss,
+                       const wow_ci_provider *ci)
+{
+    const char *sep = "";
+
+    fputc('{', out);
+    if (ss) {
+        fprintf(out,
+                "\"solver\":{"
+                "\"decisions\":%d,\"preferred\":%d,\"propagations\":%d,"
+                "\"conflicts\":%d,\"backjumps\":%d,\"backjump_levels\":%d,"
+                "\"learned\":%d,\"max_decision_level\":%d,"
+                "\"max_assignments\":%d,\"incompatibilities\":%d,"
+                "\"list_versions_calls\":%d,\"get_deps_calls\":%d,"
+                "\"arena_peak_bytes\":%zu,"
+                "\"solve_secs\":%.6f,\"provider_secs\":%.6f}",
+                ss->decisions, ss->preferred, ss->propagations,
+                ss->conflicts, ss->backjumps, ss->backjump_levels,
+                ss->learned, ss->max_decision_level,
+                ss->max_assignments, ss->n_incomps,
+                ss->list_versions_calls, ss->get_deps_calls,
+                ss->arena_peak,
+                ss->solve_secs, ss->provider_secs);
+        sep = ",";
+    }
+
+    if (ci) {
+        const wow_ci_stats *cs = &ci->stats;
+        fprintf(out,
+                "%s\"index\":{"
+                "\"cache_hits\":%d,\"cache_misses\":%d,\"prefetched\":%d,"
+                "\"not_found\":%d,\"via_daemon\":%d,"
+                "\"fetch_bytes\":%zu,\"fetch_secs\":%.6f,"
+                "\"parse_secs\":%.6f,\"packages\":%d,"
+                "\"arena_peak_bytes\":%zu}",
+                sep, cs->cache_hits, cs->cache_misses, cs->prefetched,
+                cs->not_found, cs->via_daemon,
+                cs->fetch_bytes, cs->fetch_secs,
+                cs->parse_secs, ci->n_pkgs,
+                ci->arena.used);
+        sep = ",";
+    }
+
+    if (wow_mem_on) {
+        fprintf(out, "%s\"memory\":", sep);
+        wow_mem_report(out, 1);
+    }
+    fprintf(out, "}\n");
+}
+
+/* ------------------------------------------------------------------ */
+/* Text                                                                */
+/* ------------------------------------------------------------------ */
+
+static void print_text_solver(FILE *out, const wow_solver_stats *ss)
+{
+    char arena[16];
+    wow_fmt_bytes(ss->arena_peak, arena, sizeof(arena));
+
+    double own = ss->solve_secs - ss->provider_secs;
+    if (own < 0) own = 0;
+
+    fprintf(out, "Resolver statistics:\n");
+    fprintf(out, "  decisions          %d (%d preferred)\n",
+            ss->decisions, ss->preferred);
+    fprintf(out, "  propagations       %d\n", ss->propagations);
+    fprintf(out, "  conflicts          %d\n", ss->conflicts);
+    fprintf(out, "  backjumps          %d (%d levels)\n",
+            ss->backjumps, ss->backjump_levels);
+    fprintf(out, "  learned            %d\n", ss->learned);
+    fprintf(out, "  incompatibilities  %d\n", ss->n_incomps);
+    fprintf(out, "  max level          %d\n", ss->max_decision_level);
+    fprintf(out, "  max assignments    %d\n", ss->max_assignments);
+    fprintf(out, "  provider calls     %d list_versions, %d get_deps\n",
+            ss->list_versions_calls, ss->get_deps_calls);
+    fprintf(out, "  solver arena       %s\n", arena);
+    fprintf(out, "  time               %.3fs (solver %.3fs, provider %.3fs)\n",
+            ss->solve_secs, own, ss->provider_secs);
+}
+
+static void print_text_index(FILE *out, const wow_ci_provider *ci)
+{
+    const wow_ci_stats *cs = &ci->stats;
+    char bytes[16], idx_arena[16];
+    wow_fmt_bytes(cs->fetch_bytes, bytes, sizeof(bytes));
+    wow_fmt_bytes(ci->arena.used, idx_arena, sizeof(idx_arena));
+
+    fprintf(out, "Index statistics:\n");
+    fprintf(out, "  fetched            %d (%d prefetched, %d not found, "
+            "%d via daemon), %s\n", cs->cache_misses, cs->prefetched,
+            cs->not_found, cs->via_daemon, bytes);
+    fprintf(out, "  cache hits         %d\n", cs->cache_hits);
+    fprintf(out, "  fetch time         %.3fs\n", cs->fetch_secs);
+    fprintf(out, "  parse time         %.3fs\n", cs->parse_secs);
+    fprintf(out, "  index arena        %s (%d packages)\n",
+            idx_arena, ci->n_pkgs);
+}
+
+static void print_text(FILE *out, const wow_solver_stats *ss,
+                       const wow_ci_provider *ci)
+{
+    if (ss) print_text_solver(out, ss);
+    if (ci) print_text_index(out, ci);
+    wow_mem_report(out, 0);
+}
+
+void wow_resolve_stats_print(FILE *out, enum wow_stats_mode mode,
+                             const wow_solver_stats *ss,
+                             const wow_ci_provider *ci)
+{
+    if (mode == WOW_STATS_JSON)
+        print_json(out, ss, ci);
+    else if (mode == WOW_STATS_TEXT)
+        print_text(out, ss, ci);
+}
@@ -4,12 +4,19 @@
  * Downloads, extracts, and installs one Ruby version using definition
  * files from vendor/ruby-binary/ for URL resolution and SHA-256
  * verification.
+ *
+ * Ruby tarballs are streamed: the HTTP body goes down a pipe straight
+ * into the tar extractor, which hashes the compressed bytes as it reads
+ * them.  No temporary tarball touches the disc; the staging directory
+ * is only renamed into place once the digest matches the definition.
  */
 
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -43,6 +50,109 @@ static int verify_sha256(const char *path, const char *expected_hex)
     return 0;
 }
 
+/* ── Streaming download → SHA-256 + extract ──────────────────────── */
+
+struct stream_dl {
+    const char          *url;
+    int                  wfd;       /* write end of the pipe */
+    wow_progress_state_t prog;
+    int                  rc;
+};
+
+static void *stream_dl_thread(void *arg)
+{
+    struct stream_dl *dl = arg;
+    dl->rc = wow_http_download_to_fd(dl->url, dl->wfd,
+                                     wow_progress_http_callback, &dl->prog);
+    /* EOF for the extractor, whatever happened */
+    close(dl->wfd);
+    return NULL;
+}
+
+static void stream_tee_sha256(const void *data, size_t len, void *ctx)
+{
+    wow_sha256_update(ctx, data, len);
+}
+
+/*
+ * Download url and extract it (strip 1) into staging in one pass.
+ * The compressed stream is hashed on the way through; returns 0 only
+ * if the download, the extraction and the digest all check out.  On
+ * failure the caller discards staging.
+ */
+static int stream_install(const char *url, const char *label,
+                          const char *staging, const char *expected_hex)
+{
+    wow_sha256_ctx *h = wow_sha256_new();
+    if (!h) {
+        fprintf(stderr, "wow: out of memory\n");
+        return -1;
+    }
+
+    int pfd[2];
+    if (pipe(pfd) != 0) {
+        fprintf(stderr, "wow: pipe: %s\n", strerror(errno));
+        wow_sha256_free(h);
+        return -1;
+    }
+
+    /* The extractor drains to EOF, but if it dies early a write into
+     * the pipe must fail with EPIPE rather than kill the process.
+     * Restored once the download thread is done, so children exec'd
+     * later don't inherit an ignored SIGPIPE. */
+    struct sigaction ign = { .sa_handler = SIG_IGN }, old_pipe;
+    sigemptyset(&ign.sa_mask);
+    sigaction(SIGPIPE, &ign, &old_pipe);
+
+    struct stream_dl dl = { .url = url, .wfd = pfd[1], .rc = -1 };
+    wow_progress_init(&dl.prog, label, 0, NULL);
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, stream_dl_thread, &dl) != 0) {
+        fprintf(stderr, "wow: cannot start download thread\n");
+        sigaction(SIGPIPE, &old_pipe, NULL);
+        close(pfd[0]);
+        close(pfd[1]);
+        wow_sha256_free(h);
+        return -1;
+    }
+
+    int xrc = wow_tar_extract_gz_fd(pfd[0], staging, 1,
+                                    stream_tee_sha256, h);
+    close(pfd[0]);
+    pthread_join(tid, NULL);
+    sigaction(SIGPIPE, &old_pipe, NULL);
+
+    if (dl.rc != 0) {
+        wow_progress_cancel(&dl.prog);
+        wow_sha256_free(h);
+        return -1;
+    }
+    wow_progress_finish(&dl.prog, "Downloaded");
+
+    char hex[65];
+    int hrc = wow_sha256_final(h, hex, sizeof(hex));
+    wow_sha256_free(h);
+    if (hrc != 0) return -1;
+
+    /* Digest first: a tampered archive that also fails to extract
+     * should be reported as tampered. */
+    if (strcmp(hex, expected_hex) != 0) {
+        fprintf(stderr, "wow: SHA-256 mismatch for %s\n"
+                "  expected: %s\n"
+                "  got:      %s\n", url, expected_hex, hex);
+        fprintf(stderr, "wow: checksum verification failed — aborting install\n");
+        return -1;
+    }
+
+    if (xrc != 0) {
+        fprintf(stderr, "wow: extraction failed\n");
+        return -1;
+    }
+
+    return 0;
+}
+
 /* ── Ruby-builder install (platform-specific tarballs) ───────────── */
 
 int wow_ruby_install(const char *version)
@@ -124,57 +234,22 @@ int wow_ruby_install(const char *version)
 
     double t0 = wow_now_secs();
 
-    /* Download to temp file */
-    char tmp_tarball[WOW_OS_PATH_MAX];
-    snprintf(tmp_tarball, sizeof(tmp_tarball), "%s/.temp-%s.tar.gz",
-             base, full_ver);
-
-    int fd = open(tmp_tarball, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-    if (fd == -1) {
-        fprintf(stderr, "wow: cannot create %s: %s\n",
-                tmp_tarball, strerror(errno));
-        wow_rubies_release_lock(lockfd);
-        return -1;
-    }
-
-    /* Download with progress tracking */
-    wow_progress_state_t prog;
-    wow_progress_init(&prog, asset_name, 0, NULL);
-    int rc = wow_http_download_to_fd(url, fd, wow_progress_http_callback, &prog);
-    close(fd);
-
-    if (rc != 0) {
-        wow_progress_cancel(&prog);
-        unlink(tmp_tarball);
-        wow_rubies_release_lock(lockfd);
-        return -1;
-    }
-
-    wow_progress_finish(&prog, "Downloaded");
-
-    /* Verify SHA-256 checksum */
-    if (verify_sha256(tmp_tarball, entry->sha256) != 0) {
-        fprintf(stderr, "wow: checksum verification failed — aborting install\n");
-        unlink(tmp_tarball);
-        wow_rubies_release_lock(lockfd);
-        return -1;
-    }
-
-    /* Extract to staging directory */
+    /* Extract to staging directory while downloading */
     char staging[WOW_OS_PATH_MAX];
     snprintf(staging, sizeof(staging), "%s/.temp-%s", base, full_ver);
 
+    /* Leftover from an interrupted install */
+    if (stat(staging, &st) == 0)
+        wow_rubies_rmdir_recursive(staging);
+
     if (wow_mkdirs(staging, 0755) != 0) {
-        unlink(tmp_tarball);
         wow_rubies_release_lock(lockfd);
         return -1;
     }
 
-    rc = wow_tar_extract_gz(tmp_tarball, staging, 1);
-    unlink(tmp_tarball);
-
+    int rc = stream_install(url, asset_name, staging, entry->sha256);
     if (rc != 0) {
-        fprintf(stderr, "wow: extraction failed\n");
+        wow_rubies_rmdir_recursive(staging);
         wow_rubies_release_lock(lockfd);
         return -1;
     }
@@ -183,6 +258,7 @@ int wow_ruby_install(const char *version)
     if (rename(staging, install_dir) != 0) {
         fprintf(stderr, "wow: cannot rename %s to %s: %s\n",
                 staging, install_dir, strerror(errno));
+        wow_rubies_rmdir_recursive(staging);
         wow_rubies_release_lock(lockfd);
         return -1;
     }
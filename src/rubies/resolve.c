@@ -17,6 +17,7 @@
 #include "wow/common.h"
 #include "wow/rubies/resolve.h"
 #include "wow/resolver/gemver.h"
+#include "wow/util/trace.h"
 #include "wow/version.h"
 
 /* ── String helper ───────────────────────────────────────────────── */
@@ -178,13 +179,10 @@ int wow_resolve_ruby_version(const char *input, char *full_ver, size_t bufsz)
 
 /* ── Find .ruby-version ──────────────────────────────────────────── */
 
-int wow_find_ruby_version(char *buf, size_t bufsz)
+static int find_ruby_version(const char *start, char *buf, size_t bufsz)
 {
-    char cwd[WOW_DIR_PATH_MAX];
-    if (!getcwd(cwd, sizeof(cwd))) return -1;
-
     char dir[WOW_DIR_PATH_MAX];
-    snprintf(dir, sizeof(dir), "%s", cwd);
+    snprintf(dir, sizeof(dir), "%s", start);
 
     for (;;) {
         char path[WOW_OS_PATH_MAX];
@@ -199,9 +197,10 @@ int wow_find_ruby_version(char *buf, size_t bufsz)
                        buf[len - 1] == '\r' || buf[len - 1] == ' '))
                     buf[--len] = '\0';
                 fclose(f);
-                return 0;
+                if (len > 0) return 0;  /* blank: keep walking */
+            } else {
+                fclose(f);
             }
-            fclose(f);
         }
 
         /* Walk up */
@@ -219,14 +218,30 @@ int wow_find_ruby_version(char *buf, size_t bufsz)
                    buf[len - 1] == '\r' || buf[len - 1] == ' '))
                 buf[--len] = '\0';
             fclose(f);
-            return 0;
+            if (len > 0) return 0;
+        } else {
+            fclose(f);
         }
-        fclose(f);
     }
 
     return -1;
 }
 
+int wow_find_ruby_version_in(const char *dir, char *buf, size_t bufsz)
+{
+    uint64_t t0 = wow_trace_begin();
+    int rc = find_ruby_version(dir, buf, bufsz);
+    wow_trace_end(t0, "rubies", "ruby-version", rc == 0 ? buf : NULL);
+    return rc;
+}
+
+int wow_find_ruby_version(char *buf, size_t bufsz)
+{
+    char cwd[WOW_DIR_PATH_MAX];
+    if (!getcwd(cwd, sizeof(cwd))) return -1;
+    return wow_find_ruby_version_in(cwd, buf, bufsz);
+}
+
 /* ── Path resolution ─────────────────────────────────────────────── */
 
 int wow_ruby_bin_path(const char *version, char *buf, size_t bufsz)
@@ -1,11 +1,16 @@
 /*
- * rubies/shims.c — Shim creation for argv[0] dispatch
+ * rubies/shims.c — Shim creation and argv[0] dispatch
  *
- * Creates hardlinks/copies of wow binary for ruby, irb, gem, etc.
+ * Creates hardlinks/copies of wow binary for ruby, irb, gem, etc., and
+ * implements the dispatch side: when invoked under one of those names,
+ * find .ruby-version and execve the managed binary with as few syscalls
+ * as possible.
  * Part of wow's Ruby version manager.
  */
 
 #include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,6 +30,13 @@ static const char *shim_names[] = {
     NULL
 };
 
+int wow_is_shim_name(const char *name)
+{
+    for (const char **n = shim_names; *n; n++)
+        if (strcmp(name, *n) == 0) return 1;
+    return 0;
+}
+
 /* ── Directory helper (also in install.c) ─────────────────────────── */
 
 int wow_create_shims(const char *wow_binary_path)
@@ -71,3 +83,236 @@ int wow_create_shims(const char *wow_binary_path)
 
     return 0;
 }
+
+/* ── Dispatch fast path ───────────────────────────────────────────── */
+
+#define SHIM_CACHE_ENV    "WOW_SHIM_CACHE"
+#define SHIM_CACHE_DEPTH  16     /* deeper finds are simply not cached */
+
+/*
+ * Cache entry layout (one line, ';'-separated):
+ *
+ *   1;<version>;<k>;<cwd dev>:<cwd ino>;<dir>...;<rv>
+ *
+ * <k> is how many levels above cwd .ruby-version was found.  Each <dir>
+ * (levels 0..k-1) and <rv> is "dev:ino:sec:nsec" for that path.  The
+ * directory holding .ruby-version itself is deliberately not recorded:
+ * $HOME's mtime changes constantly and would defeat the cache.
+ */
+
+struct shim_id {
+    uint64_t dev, ino;
+    int64_t  sec, nsec;
+};
+
+static void shim_id_from(struct shim_id *id, const struct stat *st)
+{
+    id->dev  = (uint64_t)st->st_dev;
+    id->ino  = (uint64_t)st->st_ino;
+    id->sec  = (int64_t)st->st_mtim.tv_sec;
+    id->nsec = (int64_t)st->st_mtim.tv_nsec;
+}
+
+static int shim_id_eq(const struct shim_id *a, const struct stat *st)
+{
+    return a->dev  == (uint64_t)st->st_dev &&
+           a->ino  == (uint64_t)st->st_ino &&
+           a->sec  == (int64_t)st->st_mtim.tv_sec &&
+           a->nsec == (int64_t)st->st_mtim.tv_nsec;
+}
+
+static const char *parse_shim_id(const char *p, struct shim_id *id,
+                                 int with_mtime)
+{
+    char *end;
+    id->dev = strtoull(p, &end, 10);
+    if (*end != ':') return NULL;
+    id->ino = strtoull(end + 1, &end, 10);
+    if (with_mtime) {
+        if (*end != ':') return NULL;
+        id->sec = strtoll(end + 1, &end, 10);
+        if (*end != ':') return NULL;
+        id->nsec = strtoll(end + 1, &end, 10);
+    }
+    if (*end != ';' && *end != '\0') return NULL;
+    return *end ? end + 1 : end;
+}
+
+/* "../../" for level 2, "" for level 0; then append tail */
+static void rel_path(char *buf, size_t bufsz, int level, const char *tail)
+{
+    size_t n = 0;
+    for (int i = 0; i < level && n + 3 < bufsz; i++) {
+        memcpy(buf + n, "../", 3);
+        n += 3;
+    }
+    snprintf(buf + n, bufsz - n, "%s", tail);
+}
+
+/*
+ * Validate the inherited cache entry against the filesystem.
+ * Costs k+2 stat()s and no opens.  Returns 0 and fills version on hit.
+ */
+static int shim_cache_lookup(char *version, size_t vsz)
+{
+    const char *p = getenv(SHIM_CACHE_ENV);
+    if (!p || strncmp(p, "1;", 2) != 0) return -1;
+    p += 2;
+
+    const char *semi = strchr(p, ';');
+    if (!semi || semi == p || (size_t)(semi - p) >= vsz) return -1;
+    memcpy(version, p, (size_t)(semi - p));
+    version[semi - p] = '\0';
+    p = semi + 1;
+
+    char *end;
+    long k = strtol(p, &end, 10);
+    if (*end != ';' || k < 0 || k > SHIM_CACHE_DEPTH) return -1;
+    p = end + 1;
+
+    struct shim_id key;
+    if (!(p = parse_shim_id(p, &key, 0))) return -1;
+
+    struct stat st;
+    if (stat(".", &st) != 0) return -1;
+    if (key.dev != (uint64_t)st.st_dev || key.ino != (uint64_t)st.st_ino)
+        return -1;
+
+    char path[SHIM_CACHE_DEPTH * 3 + 32];
+    for (int lvl = 0; lvl < k; lvl++) {
+        struct shim_id dir;
+        if (!(p = parse_shim_id(p, &dir, 1))) return -1;
+        rel_path(path, sizeof(path), lvl, ".");
+        if (lvl > 0 && stat(path, &st) != 0) return -1;
+        /* level 0 was stat'd above */
+        if (!shim_id_eq(&dir, &st)) return -1;
+    }
+
+    struct shim_id rv;
+    if (!(p = parse_shim_id(p, &rv, 1)) || *p) return -1;
+    rel_path(path, sizeof(path), (int)k, ".ruby-version");
+    if (stat(path, &st) != 0 || !shim_id_eq(&rv, &st)) return -1;
+
+    return 0;
+}
+
+/* Read and trim the first line of an open .ruby-version */
+static int read_version_fd(int fd, char *buf, size_t bufsz)
+{
+    ssize_t n = read(fd, buf, bufsz - 1);
+    if (n <= 0) return -1;
+    buf[n] = '\0';
+    char *nl = strpbrk(buf, "\r\n");
+    if (nl) *nl = '\0';
+    size_t len = strlen(buf);
+    while (len > 0 && buf[len - 1] == ' ')
+        buf[--len] = '\0';
+    return len > 0 ? 0 : -1;
+}
+
+/*
+ * Slow path: walk cwd → / with one open() per level (same search order
+ * as wow_find_ruby_version), then record a cache entry for children.
+ */
+static int shim_resolve(char *version, size_t vsz)
+{
+    char dir[WOW_DIR_PATH_MAX];
+    if (!getcwd(dir, sizeof(dir))) return -1;
+
+    int level = 0;
+    int skipped = 0;
+    struct stat rvst;
+    for (;;) {
+        char path[WOW_OS_PATH_MAX];
+        snprintf(path, sizeof(path), "%s/.ruby-version",
+                 strcmp(dir, "/") == 0 ? "" : dir);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            int ok = read_version_fd(fd, version, vsz) == 0 &&
+                     fstat(fd, &rvst) == 0;
+            close(fd);
+            if (ok) break;
+            /* Blank, unreadable or a directory: keep walking, as
+             * wow_find_ruby_version does */
+            skipped = 1;
+        }
+
+        if (strcmp(dir, "/") == 0) return -1;
+        char *slash = strrchr(dir, '/');
+        if (!slash) return -1;
+        if (slash == dir) slash[1] = '\0';
+        else *slash = '\0';
+        level++;
+    }
+
+    /* Filling a skipped file in place leaves every recorded mtime
+     * unchanged, so such a chain can't be validated cheaply */
+    if (skipped || level > SHIM_CACHE_DEPTH) return 0;
+
+    /* Record the chain; any stat failure just skips caching */
+    char entry[64 + (SHIM_CACHE_DEPTH + 2) * 96];
+    size_t n = (size_t)snprintf(entry, sizeof(entry), "1;%s;%d;",
+                                version, level);
+    struct stat st;
+    if (stat(".", &st) != 0) return 0;
+    n += (size_t)snprintf(entry + n, sizeof(entry) - n,
+                          "%" PRIu64 ":%" PRIu64,
+                          (uint64_t)st.st_dev, (uint64_t)st.st_ino);
+
+    char path[SHIM_CACHE_DEPTH * 3 + 32];
+    for (int lvl = 0; lvl <= level; lvl++) {
+        if (lvl == level) {
+            st = rvst;
+        } else if (lvl > 0) {
+            rel_path(path, sizeof(path), lvl, ".");
+            if (stat(path, &st) != 0) return 0;
+        }
+        struct shim_id id;
+        shim_id_from(&id, &st);
+        n += (size_t)snprintf(entry + n, sizeof(entry) - n,
+                              ";%" PRIu64 ":%" PRIu64 ":%" PRId64 ":%" PRId64,
+                              id.dev, id.ino, id.sec, id.nsec);
+        if (n >= sizeof(entry)) return 0;
+    }
+
+    setenv(SHIM_CACHE_ENV, entry, 1);
+    return 0;
+}
+
+int wow_shim_exec(const char *progname, char *argv[])
+{
+    char base[WOW_DIR_PATH_MAX];
+    if (wow_ruby_base_dir(base, sizeof(base)) != 0) return 1;
+
+    char version[32];
+    char bin_path[WOW_OS_PATH_MAX];
+
+    /* Fast path: trust the inherited entry, let execve do the existence
+     * check.  Any failure falls through to the full walk. */
+    if (shim_cache_lookup(version, sizeof(version)) == 0) {
+        snprintf(bin_path, sizeof(bin_path), "%s/%s/bin/%s",
+                 base, version, progname);
+        execv(bin_path, argv);
+        unsetenv(SHIM_CACHE_ENV);
+    }
+
+    if (shim_resolve(version, sizeof(version)) != 0) {
+        unsetenv(SHIM_CACHE_ENV);
+        fprintf(stderr,
+                "wow: no .ruby-version found (looked from cwd to /)\n");
+        return 1;
+    }
+
+    snprintf(bin_path, sizeof(bin_path), "%s/%s/bin/%s",
+             base, version, progname);
+    execv(bin_path, argv);
+
+    if (errno == ENOENT) {
+        fprintf(stderr, "wow: Ruby %s not installed "
+                "(run: wow rubies install %s)\n", version, version);
+    } else {
+        fprintf(stderr, "wow: exec %s failed: %s\n",
+                bin_path, strerror(errno));
+    }
+    return 1;
+}
@@ -4,12 +4,35 @@
  * Pipeline:
  *   1. Parse Gemfile
  *   2. Read .ruby-version → derive Ruby API version
- *   3. Resolve deps (PubGrub via compact index)
+ *   3. If Gemfile.lock still satisfies the Gemfile, take its versions
+ *      as-is — no index fetches, no solver.  Otherwise resolve deps
+ *      (PubGrub via compact index), preferring the locked versions so
+ *      only the packages whose constraints changed are fetched, and
  *   4. Write Gemfile.lock
- *   5. Diff installed vs solved — find missing gems
+ *   5. Diff the install manifest (.wow-installed) against the solution:
+ *      gems to add, gems to repair (left half-installed by an interrupted
+ *      sync), and gems to remove, which are pruned in parallel
  *   6. Download missing .gem files (parallel)
  *   7. Unpack missing gems to vendor/bundle/ruby/<api>/gems/<name>-<ver>/
- *   8. Print uv-style summary
+ *      and build native extensions (restored from the ext cache if
+ *      possible), recording each gem in the manifest once it is complete
+ *   8. Write the run environment manifest (.wow-env) for `wow run`
+ *   9. Print uv-style summary
+ *
+ * A no-op sync (lock current, everything installed) therefore makes no
+ * HTTP requests at all, and reads one manifest instead of probing every
+ * gem directory.
+ *
+ * Options:
+ *   --locked   fail instead of re-resolving if Gemfile.lock is stale
+ *   --frozen   install Gemfile.lock as-is, without checking it against
+ *              the Gemfile
+ *   --stats[=json]
+ *              print resolver statistics (when a solve ran) plus
+ *              per-subsystem memory and per-phase RSS to stderr
+ *
+ * `wow add` / `wow remove` edit the Gemfile and then sync; if the sync
+ * fails, Gemfile and Gemfile.lock are put back as they were.
  */
 
 #include <errno.h>
@@ -17,9 +40,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 #include "wow/common.h"
 #include "wow/download.h"
+#include "wow/exec.h"
 #include "wow/gemfile.h"
 #include "wow/gems.h"
 #include "wow/http.h"
@@ -49,13 +74,129 @@ static int resolved_cmp(const void *a, const void *b)
     return strcmp(pa->name, pb->name);
 }
 
+/*
+ * .gem file name as served under /downloads/ and kept in the cache:
+ * "name-ver.gem", or "name-ver-platform.gem" for a precompiled gem.
+ */
+static void gem_file_name(const wow_resolved_pkg *pkg, char *buf,
+                          size_t bufsz)
+{
+    if (pkg->platform)
+        snprintf(buf, bufsz, "%s-%s-%s.gem",
+                 pkg->name, pkg->version.raw, pkg->platform);
+    else
+        snprintf(buf, bufsz, "%s-%s.gem", pkg->name, pkg->version.raw);
+}
+
+static int gem_dir_exists(const char *env_dir, const char *entry)
+{
+    char dir[WOW_OS_PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s/gems/%s", env_dir, entry);
+    struct stat st;
+    return stat(dir, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+/* Note a finished install.  Best effort: an unrecorded gem is simply
+ * reinstalled by the next sync. */
+static void record_install(struct wow_installed *inst,
+                           const wow_resolved_pkg *pkg, const char *entry,
+                           const char *gem_path, const char *mode)
+{
+    char sha[65];
+    if (wow_sha256_file(gem_path, sha, sizeof(sha)) != 0) sha[0] = '\0';
+    wow_installed_add(inst, entry, pkg->name, pkg->version.raw,
+                      pkg->platform, sha, mode);
+}
+
+static void print_uninstalled(int n, double secs, int colour)
+{
+    if (n == 0) return;
+    char buf[32];
+    fmt_elapsed(secs, buf, sizeof(buf));
+    if (colour)
+        fprintf(stderr,
+                WOW_ANSI_GREEN WOW_ANSI_BOLD "Uninstalled "
+                WOW_ANSI_RESET "%d packages in "
+                WOW_ANSI_DIM "%s" WOW_ANSI_RESET "\n", n, buf);
+    else
+        fprintf(stderr, "Uninstalled %d packages in %s\n", n, buf);
+}
+
+/* " - name (version)" per removed entry ("name-version") */
+static void list_removed(char **stale, int n, int colour)
+{
+    for (int i = 0; i < n; i++) {
+        const char *dash = strrchr(stale[i], '-');
+        int nl = dash ? (int)(dash - stale[i]) : (int)strlen(stale[i]);
+        const char *ver = dash ? dash + 1 : "";
+        if (colour)
+            fprintf(stderr,
+                    " " WOW_ANSI_RED "-" WOW_ANSI_RESET
+                    " " WOW_ANSI_BOLD "%.*s" WOW_ANSI_RESET " (%s)\n",
+                    nl, stale[i], ver);
+        else
+            fprintf(stderr, " - %.*s (%s)\n", nl, stale[i], ver);
+    }
+}
+
+/*
+ * Mark the environment complete and precompute what `wow run` needs
+ * (load path, executable map) so launches skip the gems/ scan.
+ * Best effort: without an installed Ruby there is nothing to record,
+ * and a missing manifest only costs `wow run` its fast path.
+ * changed == 0 (a no-op sync) keeps a manifest that is still current,
+ * sparing the require index its walk over every load-path directory.
+ */
+static void write_run_env(const char *ruby_full, const char *ruby_api,
+                          int changed)
+{
+    char env_dir[64];
+    snprintf(env_dir, sizeof(env_dir), "vendor/bundle/ruby/%s", ruby_api);
+
+    char marker[128];
+    snprintf(marker, sizeof(marker), "%s/.installed", env_dir);
+    FILE *mf = fopen(marker, "w");
+    if (mf) fclose(mf);
+
+    char ruby_bin[WOW_OS_PATH_MAX];
+    if (wow_ruby_bin_path(ruby_full, ruby_bin, sizeof(ruby_bin)) != 0)
+        return;
+    if (!changed && wow_env_manifest_current(ruby_bin, ruby_full, env_dir,
+                                             "Gemfile.lock")) {
+        /* The launcher skips these; a newer wow may ship new ones */
+        char prefix[WOW_DIR_PATH_MAX];
+        wow_exec_ruby_prefix(ruby_bin, prefix, sizeof(prefix));
+        wow_ensure_bundler_shim(prefix);
+        wow_ensure_gem_preload(prefix);
+        return;
+    }
+    wow_env_manifest_write(ruby_bin, ruby_full, ruby_api, env_dir,
+                           "Gemfile.lock");
+}
+
 /* ------------------------------------------------------------------ */
 /* cmd_sync                                                            */
 /* ------------------------------------------------------------------ */
 
+enum sync_mode { SYNC_AUTO, SYNC_LOCKED, SYNC_FROZEN };
+
 int cmd_sync(int argc, char *argv[])
 {
-    (void)argc; (void)argv;
+    enum sync_mode mode = SYNC_AUTO;
+    enum wow_stats_mode stats = WOW_STATS_OFF;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--locked") == 0) {
+            mode = SYNC_LOCKED;
+        } else if (strcmp(argv[i], "--frozen") == 0) {
+            mode = SYNC_FROZEN;
+        } else if (!wow_stats_flag(argv[i], &stats)) {
+            fprintf(stderr, "wow: unknown option for sync: %s\n"
+                    "usage: wow sync [--locked | --frozen] "
+                    "[--stats[=json]]\n", argv[i]);
+            return 1;
+        }
+    }
+    if (stats != WOW_STATS_OFF) wow_mem_enable();
 
     int ret = 1;
     int colour = wow_use_colour();
@@ -76,6 +217,8 @@ int cmd_sync(int argc, char *argv[])
         return 1;
     }
 
+    wow_mem_phase("parse");
+
     const char *source = gf.source ? gf.source : "https://rubygems.org";
 
     /* ---- 2. Read .ruby-version ---- */
@@ -122,59 +265,183 @@ int cmd_sync(int argc, char *argv[])
         }
     }
 
-    /* ---- 4. Resolve ---- */
+    /* ---- 4. Take Gemfile.lock, or resolve ---- */
     struct wow_http_pool pool;
-    wow_http_pool_init(&pool, 4);
-
     wow_ci_provider ci;
-    wow_ci_provider_init(&ci, source, &pool, NULL);
-
-    wow_provider prov = wow_ci_provider_as_provider(&ci);
+    wow_provider ci_prov;
+    wow_lock_provider lock_prov;
+    wow_provider prov;
     wow_solver solver;
-    wow_solver_init(&solver, &prov);
+    int resolving = 0;
+
+    struct wow_ext_plan ext_plan = { 0 };
+
+    /* Install state, and per-sync arrays released at cleanup */
+    struct wow_installed inst = { .fd = -1 };
+    char (*entries)[256] = NULL;    /* gems/ entry per solved package */
+    char **stale = NULL;            /* gems/ entries to remove */
+    int n_stale = 0;
+    int *ext_pkg = NULL;            /* solved index per ext plan job */
+
+    /* The packages to install: the lock's, or the solver's solution */
+    struct wow_lockfile lock;
+    int have_lock = 0;
+    wow_resolved_pkg *locked = NULL;
+    wow_resolved_pkg *pkgs = NULL;
+    int n_solved = 0;
 
     double t_resolve_start = wow_now_secs();
 
-    int rc = wow_solve(&solver, root_names, root_cs, n_roots);
-    if (rc != 0) {
-        fprintf(stderr, "Resolution failed:\n%s\n", solver.error_msg);
+    if (wow_lockfile_parse("Gemfile.lock", &lock) == 0) {
+        have_lock = 1;
+    } else if (mode != SYNC_AUTO) {
+        fprintf(stderr, "wow: %s needs a readable Gemfile.lock "
+                "(run 'wow lock' first)\n",
+                mode == SYNC_LOCKED ? "--locked" : "--frozen");
         goto cleanup;
     }
 
-    double t_resolve_end = wow_now_secs();
+    int n_locked = 0;
+    if (have_lock) {
+        char why[256];
+        int usable = wow_lockfile_select_host(&lock, &locked, &n_locked,
+                                              why, sizeof(why)) == 0;
+        if (usable && mode != SYNC_FROZEN)
+            usable = wow_lockfile_satisfies(&lock, &gf, source,
+                                            locked, n_locked,
+                                            why, sizeof(why));
+        if (usable) {
+            pkgs = locked;
+            n_solved = n_locked;
+            if (lock.remote) source = lock.remote;
+        } else if (mode != SYNC_AUTO) {
+            fprintf(stderr, "wow: cannot install from Gemfile.lock: %s\n",
+                    why);
+            goto cleanup;
+        }
+    }
 
-    /* Sort solution alphabetically */
-    qsort(solver.solution, (size_t)solver.n_solved,
-          sizeof(wow_resolved_pkg), resolved_cmp);
+    if (!pkgs) {
+        wow_http_pool_init(&pool, 4);
+        wow_ci_provider_init(&ci, source, &pool, ruby_full);
+        ci_prov = wow_ci_provider_as_provider(&ci);
+        if (wow_lock_provider_init(&lock_prov, have_lock ? &lock : NULL,
+                                   locked, n_locked, source,
+                                   &ci_prov) != 0) {
+            fprintf(stderr, "wow: out of memory\n");
+            wow_ci_provider_destroy(&ci);
+            wow_http_pool_cleanup(&pool);
+            goto cleanup;
+        }
+        prov = wow_lock_provider_as_provider(&lock_prov);
+        wow_solver_init(&solver, &prov);
+        resolving = 1;
+
+        /* Same solution cache as `wow lock` (see cmd_lock) */
+        char seed[65], skey[65];
+        int cached = (lock_prov.n_pkgs == 0 ||
+                      wow_sha256_file("Gemfile.lock", seed,
+                                      sizeof(seed)) == 0) &&
+                     wow_solcache_key(&ci, root_names, root_cs, n_roots,
+                                      lock_prov.n_pkgs ? seed : NULL,
+                                      skey, sizeof(skey)) == 0;
+        if (have_lock)
+            wow_lockfile_prefetch(&lock, &ci);
+
+        int rc = 0;
+        if (!cached || wow_solcache_load(skey, &ci, &solver) != 0) {
+            rc = wow_solve(&solver, root_names, root_cs, n_roots);
+            if (rc == 0 && cached)
+                wow_solcache_store(skey, &ci, &solver);
+        }
+        if (rc != 0) {
+            fprintf(stderr, "Resolution failed:\n%s\n", solver.error_msg);
+            goto cleanup;
+        }
 
-    /* ---- 5. Write Gemfile.lock ---- */
-    if (wow_write_lockfile("Gemfile.lock", &solver, &prov, &gf, source) != 0)
+        /* Sort solution alphabetically */
+        qsort(solver.solution, (size_t)solver.n_solved,
+              sizeof(wow_resolved_pkg), resolved_cmp);
+
+        /* ---- 5. Write Gemfile.lock ---- */
+        if (wow_write_lockfile("Gemfile.lock", &solver, &prov, &gf,
+                               source) != 0)
+            goto cleanup;
+
+        pkgs = solver.solution;
+        n_solved = solver.n_solved;
+    }
+
+    double t_resolve_end = wow_now_secs();
+    wow_mem_phase("resolve");
+
+    /* ---- 6. Diff installed vs solved: add, repair, remove ---- */
+    char env_dir[64];
+    snprintf(env_dir, sizeof(env_dir), "vendor/bundle/ruby/%s", ruby_api);
+    if (wow_installed_load(&inst, env_dir) != 0)
         goto cleanup;
 
-    /* ---- 6. Diff installed — find missing gems ---- */
-    int n_solved = solver.n_solved;
-    int *missing = calloc((size_t)n_solved, sizeof(int));
-    if (!missing) {
+    int *missing = wow_mem_calloc(WOW_MEM_SYNC, (size_t)n_solved,
+                                  sizeof(int));
+    entries = wow_mem_calloc(WOW_MEM_SYNC, (size_t)n_solved + 1, 256);
+    if (!missing || !entries) {
         fprintf(stderr, "wow: out of memory\n");
+        wow_mem_free(missing);
         goto cleanup;
     }
 
     int n_missing = 0;
     for (int i = 0; i < n_solved; i++) {
-        char gem_dir[WOW_OS_PATH_MAX];
-        snprintf(gem_dir, sizeof(gem_dir),
-                 "vendor/bundle/ruby/%s/gems/%s-%s",
-                 ruby_api, solver.solution[i].name,
-                 solver.solution[i].version.raw);
+        snprintf(entries[i], 256, "%s-%s", pkgs[i].name,
+                 pkgs[i].version.raw);
+        if (inst.exists) {
+            /* Recorded (for this platform, extensions built) means
+             * completely installed.  The directory is only checked if
+             * gems/ changed since the last sync. */
+            if (wow_installed_find_complete(&inst, entries[i],
+                                            pkgs[i].platform) &&
+                (inst.fresh || gem_dir_exists(env_dir, entries[i])))
+                continue;
+        } else if (gem_dir_exists(env_dir, entries[i])) {
+            /* Installed before there was a manifest: take it as-is */
+            wow_installed_add(&inst, entries[i], pkgs[i].name,
+                              pkgs[i].version.raw, pkgs[i].platform, NULL,
+                              "adopted");
+            continue;
+        }
+        missing[n_missing++] = i;
+    }
 
-        struct stat st;
-        if (stat(gem_dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
-            missing[n_missing++] = i;
+    /* Gems that dropped out of the lock (and stray directories) go;
+     * each is forgotten before its directory is deleted */
+    {
+        const char **solved = malloc(((size_t)n_solved + 1) *
+                                     sizeof(char *));
+        int rc = solved ? 0 : -1;
+        for (int i = 0; solved && i < n_solved; i++) solved[i] = entries[i];
+        if (solved)
+            rc = wow_installed_stale(&inst, solved, n_solved,
+                                     &stale, &n_stale);
+        free(solved);
+        if (rc != 0) {
+            if (!solved) fprintf(stderr, "wow: out of memory\n");
+            wow_mem_free(missing);
+            goto cleanup;
         }
     }
+    double t_prune = wow_now_secs();
+    for (int i = 0; i < n_stale; i++)
+        wow_installed_remove(&inst, stale[i]);
+    if (wow_installed_prune(env_dir, stale, n_stale) != 0)
+        fprintf(stderr, "wow: warning: could not remove every stale gem "
+                "from %s/gems\n", env_dir);
+    t_prune = wow_now_secs() - t_prune;
 
     if (n_missing == 0) {
-        /* Nothing to do — audit output */
+        /* Nothing to install — audit output */
+        print_uninstalled(n_stale, t_prune, colour);
+        list_removed(stale, n_stale, colour);
+        if (!inst.fresh) wow_installed_commit(&inst);
         char elapsed_buf[32];
         fmt_elapsed(wow_now_secs() - t_start, elapsed_buf,
                     sizeof(elapsed_buf));
@@ -187,8 +454,9 @@ int cmd_sync(int argc, char *argv[])
         else
             fprintf(stderr, "Audited %d packages in %s\n",
                     n_solved, elapsed_buf);
+        write_run_env(ruby_full, ruby_api, n_stale > 0);
         ret = 0;
-        free(missing);
+        wow_mem_free(missing);
         goto cleanup;
     }
 
@@ -197,7 +465,7 @@ int cmd_sync(int argc, char *argv[])
     /* Ensure cache directory exists */
     char cache_dir[WOW_DIR_PATH_MAX];
     if (wow_gem_cache_dir(cache_dir, sizeof(cache_dir)) != 0) {
-        free(missing);
+        wow_mem_free(missing);
         goto cleanup;
     }
     {
@@ -207,20 +475,23 @@ int cmd_sync(int argc, char *argv[])
     }
 
     /* Build download specs — only for gems not already cached */
-    wow_download_spec_t *specs = calloc((size_t)n_missing,
-                                         sizeof(wow_download_spec_t));
-    wow_download_result_t *results = calloc((size_t)n_missing,
-                                             sizeof(wow_download_result_t));
+    wow_download_spec_t *specs =
+        wow_mem_calloc(WOW_MEM_SYNC, (size_t)n_missing,
+                       sizeof(wow_download_spec_t));
+    wow_download_result_t *results =
+        wow_mem_calloc(WOW_MEM_SYNC, (size_t)n_missing,
+                       sizeof(wow_download_result_t));
     /* Flat URL/path/label buffers */
-    char (*urls)[512] = calloc((size_t)n_missing, 512);
-    char (*paths)[WOW_OS_PATH_MAX] = calloc((size_t)n_missing,
-                                             WOW_OS_PATH_MAX);
-    char (*labels)[256] = calloc((size_t)n_missing, 256);
+    char (*urls)[512] = wow_mem_calloc(WOW_MEM_SYNC, (size_t)n_missing, 512);
+    char (*paths)[WOW_OS_PATH_MAX] =
+        wow_mem_calloc(WOW_MEM_SYNC, (size_t)n_missing, WOW_OS_PATH_MAX);
+    char (*labels)[256] = wow_mem_calloc(WOW_MEM_SYNC, (size_t)n_missing,
+                                         256);
 
     if (!specs || !results || !urls || !paths || !labels) {
         fprintf(stderr, "wow: out of memory\n");
-        free(specs); free(results); free(urls); free(paths); free(labels);
-        free(missing);
+        wow_mem_free(specs); wow_mem_free(results); wow_mem_free(urls);
+        wow_mem_free(paths); wow_mem_free(labels); wow_mem_free(missing);
         goto cleanup;
     }
 
@@ -232,23 +503,24 @@ int cmd_sync(int argc, char *argv[])
         src_base[slen - 1] = '\0';
 
     int n_to_download = 0;
-    int *download_map = calloc((size_t)n_missing, sizeof(int));
+    int *download_map = wow_mem_calloc(WOW_MEM_SYNC, (size_t)n_missing,
+                                       sizeof(int));
     if (!download_map) {
         fprintf(stderr, "wow: out of memory\n");
-        free(specs); free(results); free(urls); free(paths); free(labels);
-        free(missing);
+        wow_mem_free(specs); wow_mem_free(results); wow_mem_free(urls);
+        wow_mem_free(paths); wow_mem_free(labels); wow_mem_free(missing);
         goto cleanup;
     }
 
     for (int m = 0; m < n_missing; m++) {
         int si = missing[m];
-        const char *name = solver.solution[si].name;
-        const char *ver = solver.solution[si].version.raw;
+        char file[256];
+        gem_file_name(&pkgs[si], file, sizeof(file));
 
         /* Check cache first */
         char cached_path[WOW_OS_PATH_MAX];
-        snprintf(cached_path, sizeof(cached_path), "%s/%s-%s.gem",
-                 cache_dir, name, ver);
+        snprintf(cached_path, sizeof(cached_path), "%s/%s",
+                 cache_dir, file);
 
         struct stat st;
         if (stat(cached_path, &st) == 0 && st.st_size > 0) {
@@ -257,11 +529,9 @@ int cmd_sync(int argc, char *argv[])
         }
 
         int d = n_to_download;
-        snprintf(urls[d], 512, "%s/downloads/%s-%s.gem",
-                 src_base, name, ver);
-        snprintf(paths[d], WOW_OS_PATH_MAX, "%s/%s-%s.gem",
-                 cache_dir, name, ver);
-        snprintf(labels[d], 256, "%s-%s.gem", name, ver);
+        snprintf(urls[d], 512, "%s/downloads/%s", src_base, file);
+        snprintf(paths[d], WOW_OS_PATH_MAX, "%s/%s", cache_dir, file);
+        snprintf(labels[d], 256, "%s", file);
 
         specs[d].url = urls[d];
         specs[d].dest_path = paths[d];
@@ -286,15 +556,24 @@ int cmd_sync(int argc, char *argv[])
                     break;
                 }
             }
-            free(specs); free(results); free(urls); free(paths);
-            free(labels); free(download_map); free(missing);
+            wow_mem_free(specs); wow_mem_free(results); wow_mem_free(urls);
+            wow_mem_free(paths); wow_mem_free(labels);
+            wow_mem_free(download_map); wow_mem_free(missing);
             goto cleanup;
         }
     }
 
+    wow_mem_phase("download");
+
     /* ---- 8. Unpack missing gems ---- */
     double t_install_start = wow_now_secs();
 
+    /* Ruby to build native extensions with (empty if not installed) */
+    char ruby_bin[WOW_OS_PATH_MAX] = "";
+    if (wow_ruby_bin_path(ruby_full, ruby_bin, sizeof(ruby_bin)) != 0 ||
+        access(ruby_bin, X_OK) != 0)
+        ruby_bin[0] = '\0';
+
     /* Ensure vendor bundle base directory exists */
     {
         char vendor_base[WOW_OS_PATH_MAX];
@@ -303,14 +582,41 @@ int cmd_sync(int argc, char *argv[])
         wow_mkdirs(vendor_base, 0755);
     }
 
+    /* Repair: anything already at a missing gem's path is left over
+     * from an interrupted install and cannot be trusted */
+    ext_pkg = wow_mem_calloc(WOW_MEM_SYNC, (size_t)n_missing, sizeof(int));
+    char **repair = wow_mem_calloc(WOW_MEM_SYNC, (size_t)n_missing,
+                                   sizeof(char *));
+    if (!ext_pkg || !repair) {
+        fprintf(stderr, "wow: out of memory\n");
+        wow_mem_free(repair);
+        wow_mem_free(specs); wow_mem_free(results); wow_mem_free(urls);
+        wow_mem_free(paths); wow_mem_free(labels);
+        wow_mem_free(download_map); wow_mem_free(missing);
+        goto cleanup;
+    }
+    for (int m = 0; m < n_missing; m++)
+        repair[m] = entries[missing[m]];
+    int n_unremoved = wow_installed_prune(env_dir, repair, n_missing);
+    wow_mem_free(repair);
+    if (n_unremoved != 0) {
+        fprintf(stderr, "wow: cannot clear partly installed gems "
+                "in %s/gems\n", env_dir);
+        wow_mem_free(specs); wow_mem_free(results); wow_mem_free(urls);
+        wow_mem_free(paths); wow_mem_free(labels);
+        wow_mem_free(download_map); wow_mem_free(missing);
+        goto cleanup;
+    }
+
     for (int m = 0; m < n_missing; m++) {
         int si = missing[m];
-        const char *name = solver.solution[si].name;
-        const char *ver = solver.solution[si].version.raw;
+        const char *name = pkgs[si].name;
+        const char *ver = pkgs[si].version.raw;
 
+        char file[256];
+        gem_file_name(&pkgs[si], file, sizeof(file));
         char gem_path[WOW_OS_PATH_MAX];
-        snprintf(gem_path, sizeof(gem_path), "%s/%s-%s.gem",
-                 cache_dir, name, ver);
+        snprintf(gem_path, sizeof(gem_path), "%s/%s", cache_dir, file);
 
         char dest_dir[WOW_OS_PATH_MAX];
         snprintf(dest_dir, sizeof(dest_dir),
@@ -319,16 +625,74 @@ int cmd_sync(int argc, char *argv[])
 
         if (wow_gem_unpack_q(gem_path, dest_dir, 1) != 0) {
             fprintf(stderr, "wow: failed to unpack %s-%s\n", name, ver);
-            free(specs); free(results); free(urls); free(paths);
-            free(labels); free(download_map); free(missing);
+            wow_mem_free(specs); wow_mem_free(results); wow_mem_free(urls);
+            wow_mem_free(paths); wow_mem_free(labels);
+            wow_mem_free(download_map); wow_mem_free(missing);
             goto cleanup;
         }
+
+        /* .require_paths / .executables for the exec layer */
+        struct wow_gemspec gspec;
+        int queued = 0;
+        const char *mode = "gem";
+        if (wow_gemspec_parse(gem_path, &gspec) == 0) {
+            wow_gemspec_write_markers(&gspec, dest_dir);
+
+            /* Native extensions: queued for the parallel build below.
+             * Without an installed Ruby there is nothing to build
+             * against; `wow run` will report the missing Ruby, and the
+             * gem is recorded as pending so the next sync builds it. */
+            int needs_build = gspec.n_extensions > 0 &&
+                              !wow_gem_has_native_lib(dest_dir);
+            if (needs_build && !ruby_bin[0]) mode = "ext-pending";
+            if (needs_build && ruby_bin[0]) {
+                if (wow_ext_plan_add(&ext_plan, gem_path, dest_dir,
+                                     &gspec) != 0) {
+                    wow_mem_free(specs); wow_mem_free(results);
+                    wow_mem_free(urls); wow_mem_free(paths);
+                    wow_mem_free(labels); wow_mem_free(download_map);
+                    wow_mem_free(missing);
+                    goto cleanup;
+                }
+                ext_pkg[ext_plan.n - 1] = si;
+                queued = 1;
+            } else {
+                wow_gemspec_free(&gspec);
+            }
+        }
+
+        /* Done unless extensions still have to be built */
+        if (!queued)
+            record_install(&inst, &pkgs[si], entries[si], gem_path, mode);
     }
 
+    /* Build native extensions concurrently (cache hits are linked).
+     * Gems whose build succeeded are recorded even if another failed. */
+    int ext_rc = wow_ext_plan_run(&ext_plan, ruby_bin, ruby_api);
+    for (size_t j = 0; j < ext_plan.n; j++) {
+        const struct wow_ext_job *job = &ext_plan.jobs[j];
+        if (job->rc == 0)
+            record_install(&inst, &pkgs[ext_pkg[j]], entries[ext_pkg[j]],
+                           job->gem_path,
+                           job->cached ? "ext-cached" : "ext");
+    }
+    if (ext_rc != 0) {
+        wow_mem_free(specs); wow_mem_free(results); wow_mem_free(urls);
+        wow_mem_free(paths); wow_mem_free(labels); wow_mem_free(download_map);
+        wow_mem_free(missing);
+        goto cleanup;
+    }
+
+    /* ---- 9. Write install and run environment manifests ---- */
+    wow_installed_commit(&inst);
+    write_run_env(ruby_full, ruby_api, 1);
+
     double t_install_end = wow_now_secs();
+    wow_mem_phase("install");
 
-    /* ---- 9. Print uv-style summary ---- */
-    /* IMPORTANT: print before solver_destroy (arena owns name strings) */
+    /* ---- 10. Print uv-style summary ---- */
+    /* IMPORTANT: print before solver_destroy / wow_lockfile_free
+     * (they own the name strings) */
     {
         char resolve_buf[32], download_buf[32], install_buf[32];
         fmt_elapsed(t_resolve_end - t_resolve_start, resolve_buf,
@@ -360,6 +724,8 @@ int cmd_sync(int argc, char *argv[])
             }
         }
 
+        print_uninstalled(n_stale, t_prune, colour);
+
         fmt_elapsed(t_install_end - t_install_start, install_buf,
                     sizeof(install_buf));
         if (colour) {
@@ -373,7 +739,8 @@ int cmd_sync(int argc, char *argv[])
                     n_missing, install_buf);
         }
 
-        /* List each newly installed gem */
+        /* List each removed, then each newly installed gem */
+        list_removed(stale, n_stale, colour);
         for (int m = 0; m < n_missing; m++) {
             int si = missing[m];
             if (colour)
@@ -381,26 +748,187 @@ int cmd_sync(int argc, char *argv[])
                         " " WOW_ANSI_GREEN "+" WOW_ANSI_RESET
                         " " WOW_ANSI_BOLD "%s" WOW_ANSI_RESET
                         " (%s)\n",
-                        solver.solution[si].name,
-                        solver.solution[si].version.raw);
+                        pkgs[si].name,
+                        pkgs[si].version.raw);
             else
                 fprintf(stderr, " + %s (%s)\n",
-                        solver.solution[si].name,
-                        solver.solution[si].version.raw);
+                        pkgs[si].name,
+                        pkgs[si].version.raw);
         }
+
+        wow_ext_plan_report(&ext_plan);
     }
 
     ret = 0;
 
-    free(specs); free(results); free(urls); free(paths);
-    free(labels); free(download_map); free(missing);
+    wow_mem_free(specs); wow_mem_free(results); wow_mem_free(urls);
+    wow_mem_free(paths); wow_mem_free(labels); wow_mem_free(download_map);
+    wow_mem_free(missing);
 
 cleanup:
-    wow_solver_destroy(&solver);
-    wow_ci_provider_destroy(&ci);
-    wow_http_pool_cleanup(&pool);
+    wow_resolve_stats_print(stderr, stats, resolving ? &solver.stats : NULL,
+                            resolving ? &ci : NULL);
+    wow_ext_plan_free(&ext_plan);
+    wow_installed_free(&inst);
+    for (int i = 0; i < n_stale; i++) free(stale[i]);
+    free(stale);
+    wow_mem_free(entries);
+    wow_mem_free(ext_pkg);
+    if (resolving) {
+        wow_solver_destroy(&solver);
+        wow_lock_provider_destroy(&lock_prov);
+        wow_ci_provider_destroy(&ci);
+        wow_http_pool_cleanup(&pool);
+    }
+    free(locked);
+    if (have_lock) wow_lockfile_free(&lock);
     free(root_names);
     free(root_cs);
     wow_gemfile_free(&gf);
     return ret;
 }
+
+/* ------------------------------------------------------------------ */
+/* wow add / wow remove                                                */
+/* ------------------------------------------------------------------ */
+
+/* A file's contents before an edit, to put back if the sync fails */
+struct file_backup {
+    const char *path;
+    char       *buf;      /* NULL if the file did not exist */
+    size_t      len;
+};
+
+static int backup_take(struct file_backup *b, const char *path)
+{
+    b->path = path;
+    b->buf = NULL;
+    b->len = 0;
+
+    FILE *f = fopen(path, "rb");
+    if (!f) return errno == ENOENT ? 0 : -1;
+    fseek(f, 0, SEEK_END);
+    long sz = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    b->buf = sz >= 0 ? malloc((size_t)sz + 1) : NULL;
+    if (!b->buf || fread(b->buf, 1, (size_t)sz, f) != (size_t)sz) {
+        fclose(f);
+        free(b->buf);
+        b->buf = NULL;
+        return -1;
+    }
+    fclose(f);
+    b->len = (size_t)sz;
+    return 0;
+}
+
+static void backup_restore(const struct file_backup *b)
+{
+    if (!b->buf) {
+        unlink(b->path);
+        return;
+    }
+    FILE *f = fopen(b->path, "wb");
+    if (!f || fwrite(b->buf, 1, b->len, f) != b->len)
+        fprintf(stderr, "wow: cannot restore %s\n", b->path);
+    if (f) fclose(f);
+}
+
+/* Run `wow sync`; on failure put Gemfile and Gemfile.lock back */
+static int sync_or_restore(struct file_backup *gemfile,
+                           struct file_backup *lockfile)
+{
+    char *sync_argv[] = { "sync", NULL };
+    int rc = cmd_sync(1, sync_argv);
+    if (rc != 0) {
+        backup_restore(gemfile);
+        backup_restore(lockfile);
+        fprintf(stderr, "wow: Gemfile and Gemfile.lock left unchanged\n");
+    }
+    free(gemfile->buf);
+    free(lockfile->buf);
+    return rc;
+}
+
+int cmd_add(int argc, char *argv[])
+{
+    if (argc < 2 || argv[1][0] == '-') {
+        fprintf(stderr, "usage: wow add <gem> [<constraint>...]\n"
+                "  e.g. wow add rack \"~> 3.0\"\n");
+        return 1;
+    }
+    const char *name = argv[1];
+    char **cs = argv + 2;
+    int n_cs = argc - 2;
+
+    if (n_cs > 0) {
+        char joined[512];
+        wow_gem_constraints parsed;
+        wow_join_constraints(cs, n_cs, joined, sizeof(joined));
+        if (wow_gem_constraints_parse(joined, &parsed) != 0) {
+            fprintf(stderr, "wow: invalid constraint for %s: %s\n",
+                    name, joined);
+            return 1;
+        }
+    }
+
+    struct wow_gemfile gf;
+    wow_gemfile_init(&gf);
+    if (wow_gemfile_parse_file("Gemfile", &gf) != 0) {
+        fprintf(stderr, "wow: failed to parse Gemfile\n");
+        wow_gemfile_free(&gf);
+        return 1;
+    }
+    for (size_t i = 0; i < gf.n_deps; i++) {
+        if (strcmp(gf.deps[i].name, name) == 0) {
+            fprintf(stderr, "wow: %s is already in Gemfile\n", name);
+            wow_gemfile_free(&gf);
+            return 1;
+        }
+    }
+    wow_gemfile_free(&gf);
+
+    struct file_backup gemfile, lockfile;
+    if (backup_take(&gemfile, "Gemfile") != 0 ||
+        backup_take(&lockfile, "Gemfile.lock") != 0) {
+        fprintf(stderr, "wow: cannot read Gemfile or Gemfile.lock\n");
+        free(gemfile.buf);
+        return 1;
+    }
+
+    if (wow_gemfile_edit_add("Gemfile", name, cs, n_cs) != 0) {
+        free(gemfile.buf);
+        free(lockfile.buf);
+        return 1;
+    }
+    return sync_or_restore(&gemfile, &lockfile);
+}
+
+int cmd_remove(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: wow remove <gem> [<gem>...]\n");
+        return 1;
+    }
+
+    struct file_backup gemfile, lockfile;
+    if (backup_take(&gemfile, "Gemfile") != 0 || !gemfile.buf ||
+        backup_take(&lockfile, "Gemfile.lock") != 0) {
+        fprintf(stderr, "wow: cannot read Gemfile or Gemfile.lock\n");
+        free(gemfile.buf);
+        return 1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        int n = wow_gemfile_edit_remove("Gemfile", argv[i]);
+        if (n <= 0) {
+            if (n == 0)
+                fprintf(stderr, "wow: %s is not in Gemfile\n", argv[i]);
+            backup_restore(&gemfile);
+            free(gemfile.buf);
+            free(lockfile.buf);
+            return 1;
+        }
+    }
+    return sync_or_restore(&gemfile, &lockfile);
+}
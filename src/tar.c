@@ -10,6 +10,7 @@
  */
 
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -63,6 +64,8 @@ struct tar_reader {
     size_t     tlen;                /* valid bytes in tbuf */
     int        zeof;                /* zlib hit Z_STREAM_END */
     int        compressed;          /* 1 = gzip, 0 = plain tar */
+    wow_tar_tee_fn tee;             /* sees every compressed byte read */
+    void      *tee_ctx;
 };
 
 /* ── Helpers ─────────────────────────────────────────────────────── */
@@ -235,6 +238,35 @@ static int tar_reader_init_gz(struct tar_reader *r, const char *gz_path)
     return 0;
 }
 
+/*
+ * Gzip reader over a caller-owned fd (pipe, socket, …).  The fd is
+ * dup'd so tar_reader_close() leaves the caller's descriptor alone.
+ */
+static int tar_reader_init_gz_fd(struct tar_reader *r, int fd,
+                                 wow_tar_tee_fn tee, void *tee_ctx)
+{
+    memset(r, 0, sizeof(*r));
+    r->compressed = 1;
+    r->tee = tee;
+    r->tee_ctx = tee_ctx;
+
+    int dfd = dup(fd);
+    if (dfd == -1 || !(r->input = fdopen(dfd, "rb"))) {
+        fprintf(stderr, "wow: cannot open tar stream: %s\n",
+                strerror(errno));
+        if (dfd != -1) close(dfd);
+        return -1;
+    }
+
+    if (inflateInit2(&r->zstrm, 16 + MAX_WBITS) != Z_OK) {
+        fprintf(stderr, "wow: zlib inflateInit2 failed\n");
+        fclose(r->input);
+        return -1;
+    }
+
+    return 0;
+}
+
 static int tar_reader_init_plain(struct tar_reader *r, const char *path)
 {
     memset(r, 0, sizeof(*r));
@@ -306,6 +338,7 @@ static int tar_reader_read(struct tar_reader *r, void *buf, size_t n)
                 if (remaining > 0) return -1;
                 return 0;
             }
+            if (r->tee) r->tee(r->zbuf, got, r->tee_ctx);
             r->zstrm.next_in = r->zbuf;
             r->zstrm.avail_in = (uInt)got;
         }
@@ -361,6 +394,20 @@ static int tar_reader_skip(struct tar_reader *r, size_t n)
     return 0;
 }
 
+/*
+ * Read the input to EOF, feeding the tee but discarding the bytes.
+ * Used after streaming extraction so the hash covers the whole body
+ * (including anything past the tar end-of-archive blocks) and the
+ * writer on the other end of a pipe never blocks or sees EPIPE.
+ */
+static int tar_reader_drain(struct tar_reader *r)
+{
+    size_t got;
+    while ((got = fread(r->zbuf, 1, ZBUF_SIZE, r->input)) > 0)
+        if (r->tee) r->tee(r->zbuf, got, r->tee_ctx);
+    return ferror(r->input) ? -1 : 0;
+}
+
 /* ── Build entry name from tar header ────────────────────────────── */
 
 static void tar_build_entry_name(char *out, size_t outsz,
@@ -592,28 +639,47 @@ int wow_tar_extract_gz(const char *gz_path, const char *dest_dir,
     return ret;
 }
 
-/* ── Public API: plain (uncompressed) tar extraction ─────────────── */
+/* ── Public API: streaming gzip extraction from an fd ─────────────── */
 
-int wow_tar_extract(const char *tar_path, const char *dest_dir,
-                    int strip_components)
+int wow_tar_extract_gz_fd(int fd, const char *dest_dir, int strip_components,
+                          wow_tar_tee_fn tee, void *tee_ctx)
 {
     struct tar_reader reader;
-    if (tar_reader_init_plain(&reader, tar_path) != 0)
+    if (tar_reader_init_gz_fd(&reader, fd, tee, tee_ctx) != 0)
         return -1;
 
     int ret = tar_extract_loop(&reader, dest_dir, strip_components);
+
+    /* Always drain, even on failure: the producer must be able to
+     * finish its write()s, and the digest must see every byte. */
+    if (tar_reader_drain(&reader) != 0 && ret == 0) {
+        fprintf(stderr, "wow: read error on tar stream\n");
+        ret = -1;
+    }
+
     tar_reader_close(&reader);
     return ret;
 }
 
-/* ── Public API: list entries in an uncompressed tar ─────────────── */
+/* ── Public API: plain (uncompressed) tar extraction ─────────────── */
 
-int wow_tar_list(const char *tar_path, wow_tar_list_fn fn, void *ctx)
+int wow_tar_extract(const char *tar_path, const char *dest_dir,
+                    int strip_components)
 {
     struct tar_reader reader;
     if (tar_reader_init_plain(&reader, tar_path) != 0)
         return -1;
 
+    int ret = tar_extract_loop(&reader, dest_dir, strip_components);
+    tar_reader_close(&reader);
+    return ret;
+}
+
+/* ── Public API: list entries (plain or gzipped tar) ─────────────── */
+
+static int tar_list_loop(struct tar_reader *reader, wow_tar_list_fn fn,
+                         void *ctx)
+{
     int ret = -1;
     int zero_blocks = 0;
     char long_name[PATH_MAX];
@@ -621,7 +687,7 @@ int wow_tar_list(const char *tar_path, wow_tar_list_fn fn, void *ctx)
 
     for (;;) {
         tar_header_t hdr;
-        if (tar_reader_read(&reader, &hdr, 512) != 0) {
+        if (tar_reader_read(reader, &hdr, 512) != 0) {
             if (zero_blocks > 0) {
                 ret = 0;
                 break;
@@ -653,10 +719,10 @@ int wow_tar_list(const char *tar_path, wow_tar_list_fn fn, void *ctx)
         /* GNU @LongLink */
         if (typeflag == 'L') {
             if (size >= PATH_MAX) break;
-            if (tar_reader_read(&reader, long_name, size) != 0) break;
+            if (tar_reader_read(reader, long_name, size) != 0) break;
             long_name[size] = '\0';
             size_t pad = blocks * 512 - size;
-            if (pad > 0 && tar_reader_skip(&reader, pad) != 0) break;
+            if (pad > 0 && tar_reader_skip(reader, pad) != 0) break;
             have_long_name = 1;
             continue;
         }
@@ -670,15 +736,34 @@ int wow_tar_list(const char *tar_path, wow_tar_list_fn fn, void *ctx)
         if (fn && fn(entry_name, size, typeflag, ctx) != 0) {
             /* User requested stop — not an error */
             ret = 0;
-            if (blocks > 0) tar_reader_skip(&reader, blocks * 512);
+            if (blocks > 0) tar_reader_skip(reader, blocks * 512);
             break;
         }
 
         /* Skip data blocks */
-        if (blocks > 0 && tar_reader_skip(&reader, blocks * 512) != 0)
+        if (blocks > 0 && tar_reader_skip(reader, blocks * 512) != 0)
             break;
     }
 
+    return ret;
+}
+
+int wow_tar_list(const char *tar_path, wow_tar_list_fn fn, void *ctx)
+{
+    struct tar_reader reader;
+    if (tar_reader_init_plain(&reader, tar_path) != 0)
+        return -1;
+    int ret = tar_list_loop(&reader, fn, ctx);
+    tar_reader_close(&reader);
+    return ret;
+}
+
+int wow_tar_list_gz(const char *gz_path, wow_tar_list_fn fn, void *ctx)
+{
+    struct tar_reader reader;
+    if (tar_reader_init_gz(&reader, gz_path) != 0)
+        return -1;
+    int ret = tar_list_loop(&reader, fn, ctx);
     tar_reader_close(&reader);
     return ret;
 }
@@ -859,3 +944,70 @@ done:
     tar_reader_close(&reader);
     return ret;
 }
+
+/* ── Member index ────────────────────────────────────────────────── */
+
+int wow_tar_index(const char *tar_path, struct wow_tar_member *out, int max)
+{
+    int fd = open(tar_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    int count = -1;
+    int found = 0;
+    int zero_blocks = 0;
+    char long_name[PATH_MAX];
+    int have_long_name = 0;
+    uint64_t off = 0;
+
+    for (;;) {
+        tar_header_t hdr;
+        ssize_t n = pread(fd, &hdr, 512, (off_t)off);
+        if (n != 512) {
+            /* Some writers stop after a single zero block */
+            if (n == 0 && zero_blocks > 0) count = found;
+            break;
+        }
+        off += 512;
+
+        if (is_zero_block(&hdr)) {
+            if (++zero_blocks >= 2) {
+                count = found;
+                break;
+            }
+            continue;
+        }
+        zero_blocks = 0;
+
+        if (memcmp(hdr.magic, "ustar", 5) != 0) break;
+
+        size_t size = parse_octal(hdr.size, 12);
+        size_t blocks = (size + 511) / 512;
+        char typeflag = hdr.typeflag ? hdr.typeflag : '0';
+
+        /* GNU @LongLink */
+        if (typeflag == 'L') {
+            if (size >= PATH_MAX) break;
+            if (pread(fd, long_name, size, (off_t)off) != (ssize_t)size)
+                break;
+            long_name[size] = '\0';
+            off += blocks * 512;
+            have_long_name = 1;
+            continue;
+        }
+
+        if (found < max) {
+            struct wow_tar_member *m = &out[found];
+            tar_build_entry_name(m->name, sizeof(m->name), &hdr,
+                                 long_name, have_long_name);
+            m->offset = off;
+            m->size = size;
+            m->typeflag = typeflag;
+        }
+        have_long_name = 0;
+        found++;
+        off += blocks * 512;
+    }
+
+    close(fd);
+    return count;
+}
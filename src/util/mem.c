@@ -0,0 +1,250 @@
+/*
+ * util/mem.c — Allocation accounting and per-phase RSS samples
+ *
+ * Each subsystem has four atomic counters: bytes currently held, the
+ * high-water mark of that, the number of charges and the total bytes
+ * ever charged.  Peak is maintained with a CAS loop so concurrent
+ * download workers never lose an update.
+ *
+ * RSS comes from /proc/self/statm (current) and getrusage (peak);
+ * where /proc is missing the current column reads 0.
+ */
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "wow/util/fmt.h"
+#include "wow/util/mem.h"
+#include "wow/util/time.h"
+
+#define MEM_MAX_PHASES 16
+#define MEM_HDR_SIZE   16   /* keeps wrapper blocks 16-byte aligned */
+
+struct mem_counter {
+    _Atomic size_t cur, peak, allocs, total;
+};
+
+/* Prefix of every wow_mem_* block */
+struct mem_hdr {
+    size_t size;
+    int    sys;
+    int    charged;     /* accounting was on when it was allocated */
+};
+_Static_assert(sizeof(struct mem_hdr) <= MEM_HDR_SIZE, "mem header");
+
+struct mem_phase {
+    const char *name;
+    double      secs;
+    size_t      rss, peak_rss, tracked;
+};
+
+int wow_mem_on;
+
+static struct mem_counter counters[WOW_MEM_NSYS];
+static struct mem_phase   phases[MEM_MAX_PHASES];
+static int                n_phases;
+static double             mem_t0;
+
+static const char *const sys_names[WOW_MEM_NSYS] = {
+    [WOW_MEM_OTHER]    = "other",
+    [WOW_MEM_SOLVER]   = "solver",
+    [WOW_MEM_INDEX]    = "index",
+    [WOW_MEM_SYNC]     = "sync",
+    [WOW_MEM_DOWNLOAD] = "download",
+};
+
+/* ── Counters ────────────────────────────────────────────────────── */
+
+void wow_mem_enable(void)
+{
+    if (wow_mem_on) return;
+    wow_mem_on = 1;
+    mem_t0 = wow_now_secs();
+    wow_mem_phase("start");
+}
+
+static void charge(enum wow_mem_sys sys, ptrdiff_t delta)
+{
+    struct mem_counter *c = &counters[sys];
+    if (delta < 0) {
+        atomic_fetch_sub_explicit(&c->cur, (size_t)-delta,
+                                  memory_order_relaxed);
+        return;
+    }
+    size_t now = atomic_fetch_add_explicit(&c->cur, (size_t)delta,
+                                           memory_order_relaxed) +
+                 (size_t)delta;
+    atomic_fetch_add_explicit(&c->allocs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&c->total, (size_t)delta, memory_order_relaxed);
+
+    size_t peak = atomic_load_explicit(&c->peak, memory_order_relaxed);
+    while (now > peak &&
+           !atomic_compare_exchange_weak_explicit(&c->peak, &peak, now,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        ;
+}
+
+void wow_mem_charge(enum wow_mem_sys sys, ptrdiff_t delta)
+{
+    if (wow_mem_on && delta != 0)
+        charge(sys, delta);
+}
+
+/* ── Wrappers ────────────────────────────────────────────────────── */
+
+static void *hdr_init(void *raw, enum wow_mem_sys sys, size_t size)
+{
+    if (!raw) return NULL;
+    struct mem_hdr *h = raw;
+    h->size = size;
+    h->sys = (int)sys;
+    h->charged = wow_mem_on;
+    if (h->charged) charge(sys, (ptrdiff_t)size);
+    return (char *)raw + MEM_HDR_SIZE;
+}
+
+void *wow_mem_malloc(enum wow_mem_sys sys, size_t size)
+{
+    if (size > SIZE_MAX - MEM_HDR_SIZE) return NULL;
+    return hdr_init(malloc(MEM_HDR_SIZE + size), sys, size);
+}
+
+void *wow_mem_calloc(enum wow_mem_sys sys, size_t n, size_t size)
+{
+    if (size && n > (SIZE_MAX - MEM_HDR_SIZE) / size) return NULL;
+    return hdr_init(calloc(1, MEM_HDR_SIZE + n * size), sys, n * size);
+}
+
+void *wow_mem_realloc(void *p, size_t size)
+{
+    if (!p) return wow_mem_malloc(WOW_MEM_OTHER, size);
+    if (size > SIZE_MAX - MEM_HDR_SIZE) return NULL;
+
+    struct mem_hdr *h = (struct mem_hdr *)((char *)p - MEM_HDR_SIZE);
+    size_t old = h->size;
+    h = realloc(h, MEM_HDR_SIZE + size);
+    if (!h) return NULL;
+    h->size = size;
+    if (h->charged)
+        charge((enum wow_mem_sys)h->sys, (ptrdiff_t)size - (ptrdiff_t)old);
+    return (char *)h + MEM_HDR_SIZE;
+}
+
+void wow_mem_free(void *p)
+{
+    if (!p) return;
+    struct mem_hdr *h = (struct mem_hdr *)((char *)p - MEM_HDR_SIZE);
+    if (h->charged)
+        charge((enum wow_mem_sys)h->sys, -(ptrdiff_t)h->size);
+    free(h);
+}
+
+/* ── Phases ──────────────────────────────────────────────────────── */
+
+static size_t rss_now(void)
+{
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    unsigned long size, resident = 0;
+    if (fscanf(f, "%lu %lu", &size, &resident) != 2) resident = 0;
+    fclose(f);
+    long page = sysconf(_SC_PAGESIZE);
+    return (size_t)resident * (size_t)(page > 0 ? page : 4096);
+}
+
+static size_t rss_peak(void)
+{
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+    return (size_t)ru.ru_maxrss * 1024;     /* KiB */
+}
+
+void wow_mem_phase(const char *name)
+{
+    if (!wow_mem_on || n_phases == MEM_MAX_PHASES) return;
+
+    struct mem_phase *ph = &phases[n_phases++];
+    ph->name = name;
+    ph->secs = wow_now_secs() - mem_t0;
+    ph->rss = rss_now();
+    ph->peak_rss = rss_peak();
+    ph->tracked = 0;
+    for (int s = 0; s < WOW_MEM_NSYS; s++)
+        ph->tracked += atomic_load_explicit(&counters[s].cur,
+                                            memory_order_relaxed);
+}
+
+/* ── Report ──────────────────────────────────────────────────────── */
+
+static void report_json(FILE *out)
+{
+    fprintf(out, "{\"subsystems\":{");
+    int first = 1;
+    for (int s = 0; s < WOW_MEM_NSYS; s++) {
+        const struct mem_counter *c = &counters[s];
+        size_t allocs = atomic_load(&c->allocs);
+        if (!allocs) continue;
+        fprintf(out,
+                "%s\"%s\":{\"current_bytes\":%zu,\"peak_bytes\":%zu,"
+                "\"allocs\":%zu,\"total_bytes\":%zu}",
+                first ? "" : ",", sys_names[s], atomic_load(&c->cur),
+                atomic_load(&c->peak), allocs, atomic_load(&c->total));
+        first = 0;
+    }
+    fprintf(out, "},\"phases\":[");
+    for (int i = 0; i < n_phases; i++) {
+        const struct mem_phase *ph = &phases[i];
+        fprintf(out,
+                "%s{\"name\":\"%s\",\"secs\":%.6f,\"rss_bytes\":%zu,"
+                "\"peak_rss_bytes\":%zu,\"tracked_bytes\":%zu}",
+                i ? "," : "", ph->name, ph->secs, ph->rss, ph->peak_rss,
+                ph->tracked);
+    }
+    fprintf(out, "]}");
+}
+
+static void report_text(FILE *out)
+{
+    char a[16], b[16], c[16];
+
+    fprintf(out, "Memory:\n");
+    fprintf(out, "  %-10s %10s %10s %8s %10s\n",
+            "subsystem", "current", "peak", "allocs", "total");
+    for (int s = 0; s < WOW_MEM_NSYS; s++) {
+        const struct mem_counter *mc = &counters[s];
+        size_t allocs = atomic_load(&mc->allocs);
+        if (!allocs) continue;
+        wow_fmt_bytes(atomic_load(&mc->cur), a, sizeof(a));
+        wow_fmt_bytes(atomic_load(&mc->peak), b, sizeof(b));
+        wow_fmt_bytes(atomic_load(&mc->total), c, sizeof(c));
+        fprintf(out, "  %-10s %10s %10s %8zu %10s\n",
+                sys_names[s], a, b, allocs, c);
+    }
+
+    fprintf(out, "  %-10s %10s %10s %10s %10s\n",
+            "phase", "at", "rss", "peak rss", "tracked");
+    for (int i = 0; i < n_phases; i++) {
+        const struct mem_phase *ph = &phases[i];
+        char t[16];
+        snprintf(t, sizeof(t), "%.3fs", ph->secs);
+        wow_fmt_bytes(ph->rss, a, sizeof(a));
+        wow_fmt_bytes(ph->peak_rss, b, sizeof(b));
+        wow_fmt_bytes(ph->tracked, c, sizeof(c));
+        fprintf(out, "  %-10s %10s %10s %10s %10s\n",
+                ph->name, t, ph->rss ? a : "-", b, c);
+    }
+}
+
+void wow_mem_report(FILE *out, int json)
+{
+    if (!wow_mem_on) return;
+    if (json)
+        report_json(out);
+    else
+        report_text(out);
+}
@@ -2,10 +2,16 @@
  * util/path.c — Path and filesystem utilities
  */
 
+#include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "wow/util/path.h"
 
@@ -29,3 +35,93 @@ int wow_mkdirs(char *path, mode_t mode)
     }
     return 0;
 }
+
+/* ── Cache directories ───────────────────────────────────────────── */
+
+#define CACHE_TRIM_STAMP     ".trim"
+#define CACHE_TRIM_INTERVAL  (24 * 60 * 60)
+
+struct trim_ent {
+    struct timespec mtime;
+    char *name;
+};
+
+static int trim_cmp(const void *a, const void *b)
+{
+    const struct timespec *x = &((const struct trim_ent *)a)->mtime;
+    const struct timespec *y = &((const struct trim_ent *)b)->mtime;
+    if (x->tv_sec != y->tv_sec) return x->tv_sec < y->tv_sec ? -1 : 1;
+    return (x->tv_nsec > y->tv_nsec) - (x->tv_nsec < y->tv_nsec);
+}
+
+/* Remove dir/name; too-long paths are skipped */
+static void trim_unlink(const char *dir, const char *name)
+{
+    char path[PATH_MAX];
+    int n = snprintf(path, sizeof(path), "%s/%s", dir, name);
+    if (n > 0 && (size_t)n < sizeof(path)) unlink(path);
+}
+
+void wow_cache_trim(const char *dir, long max_age, int max_entries)
+{
+    char stamp[PATH_MAX];
+    int n = snprintf(stamp, sizeof(stamp), "%s/" CACHE_TRIM_STAMP, dir);
+    if (n < 0 || (size_t)n >= sizeof(stamp)) return;
+
+    /* Claim this round first so concurrent stores don't all scan */
+    time_t now = time(NULL);
+    struct stat st;
+    if (stat(stamp, &st) == 0 && now - st.st_mtime < CACHE_TRIM_INTERVAL)
+        return;
+    int fd = open(stamp, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return;
+    int touched = futimens(fd, NULL) == 0;
+    close(fd);
+    if (!touched) return;
+
+    DIR *d = opendir(dir);
+    if (!d) return;
+
+    struct trim_ent *ents = NULL;
+    size_t n_ents = 0, cap = 0;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != NULL) {
+        if (ent->d_name[0] == '.') continue;
+        char path[PATH_MAX];
+        n = snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        if (n < 0 || (size_t)n >= sizeof(path)) continue;
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+
+        /* Expired (stale temp files from crashed writers included) */
+        if (now - st.st_mtime > max_age) {
+            unlink(path);
+            continue;
+        }
+
+        if (n_ents == cap) {
+            size_t nc = cap ? cap * 2 : 256;
+            struct trim_ent *ne = realloc(ents, nc * sizeof(*ents));
+            if (!ne) break;
+            ents = ne;
+            cap = nc;
+        }
+        ents[n_ents].mtime = st.st_mtim;
+        if (!(ents[n_ents].name = strdup(ent->d_name))) break;
+        n_ents++;
+    }
+    closedir(d);
+
+    if (max_entries >= 0 && n_ents > (size_t)max_entries) {
+        qsort(ents, n_ents, sizeof(*ents), trim_cmp);
+        for (size_t i = 0; i < n_ents - (size_t)max_entries; i++)
+            trim_unlink(dir, ents[i].name);
+    }
+
+    for (size_t i = 0; i < n_ents; i++) free(ents[i].name);
+    free(ents);
+}
+
+void wow_cache_touch(const char *path)
+{
+    utimensat(AT_FDCWD, path, NULL, 0);
+}
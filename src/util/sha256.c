@@ -1,16 +1,403 @@
 /*
  * util/sha256.c — SHA-256 hashing utilities
  *
- * Uses mbedTLS for SHA-256 computation.
+ * Self-contained SHA-256 with the block function picked at runtime:
+ *
+ *   sha-ni   x86-64 SHA extensions (cpuid leaf 7, EBX bit 29)
+ *   armv8    ARMv8 Cryptography Extensions (HWCAP_SHA2)
+ *   portable plain C, always available
+ *
+ * A single fat binary runs on all of these, so the choice is made once,
+ * on first use, from what the CPU reports.  WOW_SHA256=portable forces
+ * the C path (for benchmarking or to rule out a backend bug).
+ *
+ * With the hardware rounds a core hashes at well over 1 GB/s, so file
+ * hashing is built around large read() calls rather than stdio.
  */
 
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-#include <third_party/mbedtls/sha256.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#endif
 
 #include "wow/util/sha256.h"
+#include "wow/util/trace.h"
+
+#define READ_CHUNK     (256 * 1024)
+#define FILES_MAX_JOBS 32
+
+static const uint32_t K[64] __attribute__((aligned(16))) = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t H0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+/* Process nblocks consecutive 64-byte blocks into st */
+typedef void (*compress_fn)(uint32_t st[8], const uint8_t *p, size_t nblocks);
+
+/* ── Portable block function ─────────────────────────────────────── */
+
+#define ROR(x, n)  (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void compress_portable(uint32_t st[8], const uint8_t *p,
+                              size_t nblocks)
+{
+    uint32_t w[64];
+    while (nblocks--) {
+        for (int i = 0; i < 16; i++, p += 4)
+            w[i] = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 |
+                   (uint32_t)p[2] << 8  | (uint32_t)p[3];
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = ROR(w[i-15], 7) ^ ROR(w[i-15], 18) ^ (w[i-15] >> 3);
+            uint32_t s1 = ROR(w[i-2], 17) ^ ROR(w[i-2], 19) ^ (w[i-2] >> 10);
+            w[i] = w[i-16] + s0 + w[i-7] + s1;
+        }
+
+        uint32_t a = st[0], b = st[1], c = st[2], d = st[3];
+        uint32_t e = st[4], f = st[5], g = st[6], h = st[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t t1 = h + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) +
+                          ((e & f) ^ (~e & g)) + K[i] + w[i];
+            uint32_t t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) +
+                          ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        st[0] += a; st[1] += b; st[2] += c; st[3] += d;
+        st[4] += e; st[5] += f; st[6] += g; st[7] += h;
+    }
+}
+
+/* ── x86-64 SHA extensions ───────────────────────────────────────── */
+
+#if defined(__x86_64__)
+
+/*
+ * sha256rnds2 does two rounds on state split as ABEF / CDGH; the
+ * message schedule runs four words ahead using sha256msg1/msg2.  The
+ * loop is written over the 16 four-round groups and fully unrolled.
+ */
+__attribute__((target("sha,sse4.1,ssse3")))
+static void compress_shani(uint32_t st[8], const uint8_t *p, size_t nblocks)
+{
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+                                         0x0405060700010203ULL);
+    __m128i tmp = _mm_loadu_si128((const __m128i *)&st[0]);
+    __m128i s1  = _mm_loadu_si128((const __m128i *)&st[4]);
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);            /* CDAB */
+    s1  = _mm_shuffle_epi32(s1, 0x1B);             /* EFGH */
+    __m128i s0 = _mm_alignr_epi8(tmp, s1, 8);      /* ABEF */
+    s1 = _mm_blend_epi16(s1, tmp, 0xF0);           /* CDGH */
+
+    while (nblocks--) {
+        __m128i abef = s0, cdgh = s1, m[4];
+
+#pragma GCC unroll 16
+        for (int i = 0; i < 16; i++) {
+            if (i < 4)
+                m[i] = _mm_shuffle_epi8(
+                    _mm_loadu_si128((const __m128i *)(p + 16 * i)), bswap);
+            __m128i cur = m[i & 3];
+            __m128i msg = _mm_add_epi32(
+                cur, _mm_load_si128((const __m128i *)&K[4 * i]));
+            s1 = _mm_sha256rnds2_epu32(s1, s0, msg);
+            if (i >= 3 && i < 15) {
+                __m128i t = _mm_alignr_epi8(cur, m[(i + 3) & 3], 4);
+                m[(i + 1) & 3] = _mm_sha256msg2_epu32(
+                    _mm_add_epi32(m[(i + 1) & 3], t), cur);
+            }
+            msg = _mm_shuffle_epi32(msg, 0x0E);
+            s0 = _mm_sha256rnds2_epu32(s0, s1, msg);
+            if (i >= 1 && i < 13)
+                m[(i + 3) & 3] = _mm_sha256msg1_epu32(m[(i + 3) & 3], cur);
+        }
+
+        s0 = _mm_add_epi32(s0, abef);
+        s1 = _mm_add_epi32(s1, cdgh);
+        p += 64;
+    }
+
+    tmp = _mm_shuffle_epi32(s0, 0x1B);             /* FEBA */
+    s1  = _mm_shuffle_epi32(s1, 0xB1);             /* DCHG */
+    s0  = _mm_blend_epi16(tmp, s1, 0xF0);          /* DCBA */
+    s1  = _mm_alignr_epi8(s1, tmp, 8);             /* HGFE */
+    _mm_storeu_si128((__m128i *)&st[0], s0);
+    _mm_storeu_si128((__m128i *)&st[4], s1);
+}
+
+static int have_shani(void)
+{
+    uint32_t a, b, c, d;
+    __asm__ volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d)
+                             : "a"(0), "c"(0));
+    if (a < 7) return 0;
+    __asm__ volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d)
+                             : "a"(1), "c"(0));
+    if (!(c & (1u << 9)) || !(c & (1u << 19)))     /* SSSE3, SSE4.1 */
+        return 0;
+    __asm__ volatile("cpuid" : "=a"(a), "=b"(b), "=c"(c), "=d"(d)
+                             : "a"(7), "c"(0));
+    return (b >> 29) & 1;                          /* SHA */
+}
+
+#endif /* __x86_64__ */
+
+/* ── ARMv8 Cryptography Extensions ───────────────────────────────── */
+
+#if defined(__aarch64__)
+
+#ifndef HWCAP_SHA2
+#define HWCAP_SHA2 (1 << 6)
+#endif
+
+/* vsha256h/h2 do four rounds; su0/su1 extend the schedule in place */
+__attribute__((target("+crypto")))
+static void compress_armv8(uint32_t st[8], const uint8_t *p, size_t nblocks)
+{
+    uint32x4_t s0 = vld1q_u32(&st[0]);
+    uint32x4_t s1 = vld1q_u32(&st[4]);
+
+    while (nblocks--) {
+        uint32x4_t abcd = s0, efgh = s1, m[4];
+        for (int i = 0; i < 4; i++)
+            m[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(p + 16 * i)));
+
+#pragma GCC unroll 16
+        for (int i = 0; i < 16; i++) {
+            uint32x4_t wk = vaddq_u32(m[i & 3], vld1q_u32(&K[4 * i]));
+            if (i < 12)
+                m[i & 3] = vsha256su0q_u32(m[i & 3], m[(i + 1) & 3]);
+            uint32x4_t t = s0;
+            s0 = vsha256hq_u32(s0, s1, wk);
+            s1 = vsha256h2q_u32(s1, t, wk);
+            if (i < 12)
+                m[i & 3] = vsha256su1q_u32(m[i & 3], m[(i + 2) & 3],
+                                           m[(i + 3) & 3]);
+        }
+
+        s0 = vaddq_u32(s0, abcd);
+        s1 = vaddq_u32(s1, efgh);
+        p += 64;
+    }
+
+    vst1q_u32(&st[0], s0);
+    vst1q_u32(&st[4], s1);
+}
+
+static int have_armv8_sha2(void)
+{
+    return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0;
+}
+
+#endif /* __aarch64__ */
+
+/* ── Backend selection ───────────────────────────────────────────── */
+
+static const struct backend {
+    const char  *name;
+    compress_fn  fn;
+    int        (*available)(void);
+} backends[] = {
+#if defined(__x86_64__)
+    { "sha-ni",   compress_shani,    have_shani },
+#elif defined(__aarch64__)
+    { "armv8",    compress_armv8,    have_armv8_sha2 },
+#endif
+    { "portable", compress_portable, NULL },
+};
+
+#define N_BACKENDS (sizeof(backends) / sizeof(backends[0]))
+
+static const struct backend *chosen;
+
+static const struct backend *find_backend(const char *name)
+{
+    for (size_t i = 0; i < N_BACKENDS; i++) {
+        const struct backend *b = &backends[i];
+        if (name && strcmp(name, b->name) != 0) continue;
+        if (!b->available || b->available()) return b;
+    }
+    return NULL;
+}
+
+/* Racing first calls all compute the same answer, so no lock is needed */
+static const struct backend *backend(void)
+{
+    const struct backend *b = __atomic_load_n(&chosen, __ATOMIC_ACQUIRE);
+    if (b) return b;
+    const char *env = getenv("WOW_SHA256");
+    b = (env && env[0]) ? find_backend(env) : NULL;
+    if (!b) b = find_backend(NULL);
+    __atomic_store_n(&chosen, b, __ATOMIC_RELEASE);
+    return b;
+}
+
+const char *wow_sha256_backend(void)
+{
+    return backend()->name;
+}
+
+int wow_sha256_set_backend(const char *name)
+{
+    const struct backend *b = find_backend(name);
+    if (!b) return -1;
+    __atomic_store_n(&chosen, b, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* ── Core ────────────────────────────────────────────────────────── */
+
+struct wow_sha256_ctx {
+    uint32_t    st[8];
+    uint64_t    total;          /* bytes fed so far */
+    uint8_t     buf[64];
+    size_t      nbuf;
+    compress_fn fn;
+};
+
+static void ctx_init(wow_sha256_ctx *h)
+{
+    memcpy(h->st, H0, sizeof(H0));
+    h->total = 0;
+    h->nbuf = 0;
+    h->fn = backend()->fn;
+}
+
+static void ctx_update(wow_sha256_ctx *h, const uint8_t *p, size_t len)
+{
+    h->total += len;
+    if (h->nbuf > 0) {
+        size_t take = 64 - h->nbuf;
+        if (take > len) take = len;
+        memcpy(h->buf + h->nbuf, p, take);
+        h->nbuf += take;
+        p += take;
+        len -= take;
+        if (h->nbuf < 64) return;
+        h->fn(h->st, h->buf, 1);
+        h->nbuf = 0;
+    }
+    if (len >= 64) {
+        h->fn(h->st, p, len / 64);
+        p += len & ~(size_t)63;
+        len &= 63;
+    }
+    memcpy(h->buf, p, len);
+    h->nbuf = len;
+}
+
+static void ctx_final(wow_sha256_ctx *h, uint8_t digest[32])
+{
+    uint64_t bits = h->total * 8;
+    uint8_t pad[72] = { 0x80 };
+    size_t padlen = (h->nbuf < 56 ? 56 : 120) - h->nbuf;
+    for (int i = 0; i < 8; i++)
+        pad[padlen + i] = (uint8_t)(bits >> (56 - 8 * i));
+    ctx_update(h, pad, padlen + 8);
+
+    for (int i = 0; i < 8; i++) {
+        digest[4 * i]     = (uint8_t)(h->st[i] >> 24);
+        digest[4 * i + 1] = (uint8_t)(h->st[i] >> 16);
+        digest[4 * i + 2] = (uint8_t)(h->st[i] >> 8);
+        digest[4 * i + 3] = (uint8_t)h->st[i];
+    }
+}
+
+static void digest_to_hex(const uint8_t digest[32], char *out_hex)
+{
+    static const char hexdig[] = "0123456789abcdef";
+    for (int i = 0; i < 32; i++) {
+        out_hex[i * 2]     = hexdig[digest[i] >> 4];
+        out_hex[i * 2 + 1] = hexdig[digest[i] & 0xf];
+    }
+    out_hex[64] = '\0';
+}
+
+/*
+ * Hash length bytes of fd starting at offset (length < 0: to EOF) into
+ * out_hex.  Returns 0, or an errno value (EIO for a short range).
+ */
+static int hash_fd(int fd, uint64_t offset, int64_t length, char *out_hex)
+{
+    uint8_t *buf = malloc(READ_CHUNK);
+    if (!buf) return ENOMEM;
+
+    wow_sha256_ctx h;
+    ctx_init(&h);
+
+    int err = 0;
+    uint64_t off = offset;
+    for (;;) {
+        size_t want = READ_CHUNK;
+        if (length >= 0) {
+            uint64_t left = (uint64_t)length - (off - offset);
+            if (left == 0) break;
+            if (left < want) want = (size_t)left;
+        }
+        ssize_t n = pread(fd, buf, want, (off_t)off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            err = errno;
+            break;
+        }
+        if (n == 0) {
+            if (length >= 0) err = EIO;   /* range runs past EOF */
+            break;
+        }
+        ctx_update(&h, buf, (size_t)n);
+        off += (uint64_t)n;
+    }
+    free(buf);
+    if (err) return err;
+
+    uint8_t digest[32];
+    ctx_final(&h, digest);
+    digest_to_hex(digest, out_hex);
+    return 0;
+}
+
+static int hash_path(const char *path, uint64_t offset, int64_t length,
+                     char *out_hex)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return errno;
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, (off_t)offset, length < 0 ? 0 : (off_t)length,
+                  POSIX_FADV_SEQUENTIAL);
+#endif
+    int err = hash_fd(fd, offset, length, out_hex);
+    close(fd);
+    return err;
+}
 
 int wow_sha256_file(const char *path, char *out_hex, size_t hex_sz)
 {
@@ -19,38 +406,103 @@ int wow_sha256_file(const char *path, char *out_hex, size_t hex_sz)
         return -1;
     }
 
-    FILE *f = fopen(path, "rb");
-    if (!f) {
-        fprintf(stderr, "wow: cannot open %s for hashing: %s\n",
-                path, strerror(errno));
+    uint64_t t0 = wow_trace_begin();
+    int err = hash_path(path, 0, -1, out_hex);
+    wow_trace_end(t0, "sha256", "file", path);
+
+    if (err) {
+        fprintf(stderr, "wow: cannot hash %s: %s\n", path, strerror(err));
         return -1;
     }
+    return 0;
+}
 
-    mbedtls_sha256_context ctx;
-    mbedtls_sha256_init(&ctx);
-    mbedtls_sha256_starts_ret(&ctx, 0);  /* 0 = SHA-256, not SHA-224 */
+/* ── Batch API ───────────────────────────────────────────────────── */
 
-    uint8_t buf[8192];
-    size_t n;
-    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
-        mbedtls_sha256_update_ret(&ctx, buf, n);
+static int cpu_count(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
 
-    int read_err = ferror(f);
-    fclose(f);
+struct files_queue {
+    struct wow_sha256_job *jobs;
+    int                    n;
+    int                    next;
+    int                    failed;
+};
 
-    if (read_err) {
-        fprintf(stderr, "wow: read error hashing %s\n", path);
-        mbedtls_sha256_free(&ctx);
-        return -1;
+static void *files_worker(void *arg)
+{
+    struct files_queue *q = arg;
+    int i;
+    while ((i = __atomic_fetch_add(&q->next, 1, __ATOMIC_RELAXED)) < q->n) {
+        struct wow_sha256_job *j = &q->jobs[i];
+        j->hex[0] = '\0';
+        j->err = hash_path(j->path, j->offset, j->length, j->hex);
+        if (j->err)
+            __atomic_fetch_add(&q->failed, 1, __ATOMIC_RELAXED);
     }
+    return NULL;
+}
 
-    uint8_t digest[32];
-    mbedtls_sha256_finish_ret(&ctx, digest);
-    mbedtls_sha256_free(&ctx);
+int wow_sha256_files(struct wow_sha256_job *jobs, int n, int threads)
+{
+    if (n <= 0) return 0;
+    struct files_queue q = { jobs, n, 0, 0 };
 
-    for (int i = 0; i < 32; i++)
-        snprintf(out_hex + i * 2, 3, "%02x", digest[i]);
-    out_hex[64] = '\0';
+    uint64_t t0 = wow_trace_begin();
+    if (threads <= 0) threads = cpu_count();
+    if (threads > FILES_MAX_JOBS) threads = FILES_MAX_JOBS;
+    if (threads > n) threads = n;
+
+    /* A failed pthread_create just means fewer workers; the calling
+     * thread drains whatever is left. */
+    pthread_t tids[FILES_MAX_JOBS];
+    int started = 0;
+    for (int i = 1; i < threads; i++) {
+        if (pthread_create(&tids[started], NULL, files_worker, &q) == 0)
+            started++;
+    }
+    files_worker(&q);
+    for (int i = 0; i < started; i++)
+        pthread_join(tids[i], NULL);
+
+    char detail[32];
+    snprintf(detail, sizeof(detail), "%d jobs", n);
+    wow_trace_end(t0, "sha256", "files", detail);
+    return q.failed;
+}
 
+/* ── Incremental API ─────────────────────────────────────────────── */
+
+wow_sha256_ctx *wow_sha256_new(void)
+{
+    wow_sha256_ctx *h = malloc(sizeof(*h));
+    if (!h) return NULL;
+    ctx_init(h);
+    return h;
+}
+
+void wow_sha256_update(wow_sha256_ctx *h, const void *data, size_t len)
+{
+    if (len > 0)
+        ctx_update(h, data, len);
+}
+
+int wow_sha256_final(wow_sha256_ctx *h, char *out_hex, size_t hex_sz)
+{
+    if (hex_sz < 65) {
+        fprintf(stderr, "wow: output buffer too small for SHA-256 hex\n");
+        return -1;
+    }
+    uint8_t digest[32];
+    ctx_final(h, digest);
+    digest_to_hex(digest, out_hex);
     return 0;
 }
+
+void wow_sha256_free(wow_sha256_ctx *h)
+{
+    free(h);
+}
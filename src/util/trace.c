@@ -0,0 +1,217 @@
+/*
+ * trace.c — Chrome trace-event span recorder
+ *
+ * Every thread appends to a private, growable event array, so
+ * recording never takes a lock.  The first event a thread records
+ * registers its buffer on a global list (one mutex acquisition per
+ * thread, ever).  Buffers are never freed, so a worker that exits
+ * before the flush still shows up in the trace.
+ *
+ * Output:
+ *   {"traceEvents":[
+ *     {"name":"thread_name","ph":"M","pid":P,"tid":T,"args":{"name":"..."}},
+ *     {"name":"fetch","cat":"provider","ph":"X","ts":µs,"dur":µs,
+ *      "pid":P,"tid":T,"args":{"detail":"rack"}},
+ *     ...
+ *   ],"displayTimeUnit":"ms"}
+ *
+ * Timestamps are microseconds since wow_trace_init().
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "wow/util/trace.h"
+
+#define TRACE_DETAIL_LEN 96
+
+struct trace_event {
+    uint64_t    ts, dur;
+    const char *cat;
+    const char *name;
+    char        detail[TRACE_DETAIL_LEN];
+};
+
+struct trace_buf {
+    struct trace_event *ev;
+    size_t              n, cap;
+    int                 tid;
+    char                thread_name[32];
+    struct trace_buf   *next;
+};
+
+int wow_trace_on;
+
+static char             trace_path[4096];
+static uint64_t         trace_epoch;
+static pthread_mutex_t  trace_mu = PTHREAD_MUTEX_INITIALIZER;
+static struct trace_buf *trace_bufs;
+static int              trace_next_tid = 1;
+static int              trace_flushed;
+
+static _Thread_local struct trace_buf *tl_buf;
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+static struct trace_buf *thread_buf(void)
+{
+    if (tl_buf) return tl_buf;
+
+    struct trace_buf *b = calloc(1, sizeof(*b));
+    if (!b) return NULL;
+
+    pthread_mutex_lock(&trace_mu);
+    b->tid = trace_next_tid++;
+    b->next = trace_bufs;
+    trace_bufs = b;
+    pthread_mutex_unlock(&trace_mu);
+
+    tl_buf = b;
+    return b;
+}
+
+void wow_trace_init(void)
+{
+    const char *path = getenv("WOW_TRACE");
+    if (!path || !path[0] || wow_trace_on) return;
+
+    int n = snprintf(trace_path, sizeof(trace_path), "%s", path);
+    if (n < 0 || (size_t)n >= sizeof(trace_path)) {
+        fprintf(stderr, "wow: WOW_TRACE path too long\n");
+        return;
+    }
+
+    trace_epoch = now_us();
+    wow_trace_on = 1;
+    wow_trace_thread_name("main");
+    atexit(wow_trace_flush);
+}
+
+uint64_t wow_trace_begin(void)
+{
+    if (!wow_trace_on) return 0;
+    uint64_t t = now_us();
+    return t > trace_epoch ? t : trace_epoch + 1;
+}
+
+void wow_trace_end(uint64_t t0, const char *cat, const char *name,
+                   const char *detail)
+{
+    if (!t0 || !wow_trace_on) return;
+    uint64_t t1 = now_us();
+
+    struct trace_buf *b = thread_buf();
+    if (!b) return;
+
+    if (b->n == b->cap) {
+        size_t nc = b->cap ? b->cap * 2 : 256;
+        struct trace_event *ev = realloc(b->ev, nc * sizeof(*ev));
+        if (!ev) return;
+        b->ev = ev;
+        b->cap = nc;
+    }
+
+    struct trace_event *e = &b->ev[b->n];
+    e->ts = t0 - trace_epoch;
+    e->dur = t1 > t0 ? t1 - t0 : 0;
+    e->cat = cat;
+    e->name = name;
+    snprintf(e->detail, sizeof(e->detail), "%s", detail ? detail : "");
+
+    /* Publish after the event is complete: the flusher may run on
+     * another thread at exit */
+    __atomic_store_n(&b->n, b->n + 1, __ATOMIC_RELEASE);
+}
+
+void wow_trace_thread_name(const char *name)
+{
+    if (!wow_trace_on) return;
+    struct trace_buf *b = thread_buf();
+    if (b) snprintf(b->thread_name, sizeof(b->thread_name), "%s", name);
+}
+
+static void put_json_str(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            fprintf(f, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(f, "\\u%04x", c);
+        else
+            fputc(c, f);
+    }
+    fputc('"', f);
+}
+
+void wow_trace_flush(void)
+{
+    if (!wow_trace_on) return;
+
+    pthread_mutex_lock(&trace_mu);
+    if (trace_flushed) {
+        pthread_mutex_unlock(&trace_mu);
+        return;
+    }
+    trace_flushed = 1;
+
+    FILE *f = fopen(trace_path, "w");
+    if (!f) {
+        fprintf(stderr, "wow: cannot write trace %s: %s\n",
+                trace_path, strerror(errno));
+        pthread_mutex_unlock(&trace_mu);
+        return;
+    }
+
+    int pid = (int)getpid();
+    int first = 1;
+    fputs("{\"traceEvents\":[\n", f);
+
+    for (struct trace_buf *b = trace_bufs; b; b = b->next) {
+        if (b->thread_name[0]) {
+            fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\","
+                    "\"pid\":%d,\"tid\":%d,\"args\":{\"name\":",
+                    first ? "" : ",\n", pid, b->tid);
+            put_json_str(f, b->thread_name);
+            fputs("}}", f);
+            first = 0;
+        }
+
+        size_t n = __atomic_load_n(&b->n, __ATOMIC_ACQUIRE);
+        for (size_t i = 0; i < n; i++) {
+            const struct trace_event *e = &b->ev[i];
+            fprintf(f, "%s{\"name\":", first ? "" : ",\n");
+            put_json_str(f, e->name);
+            fputs(",\"cat\":", f);
+            put_json_str(f, e->cat);
+            fprintf(f, ",\"ph\":\"X\",\"ts\":%llu,\"dur\":%llu,"
+                    "\"pid\":%d,\"tid\":%d",
+                    (unsigned long long)e->ts, (unsigned long long)e->dur,
+                    pid, b->tid);
+            if (e->detail[0]) {
+                fputs(",\"args\":{\"detail\":", f);
+                put_json_str(f, e->detail);
+                fputc('}', f);
+            }
+            fputc('}', f);
+            first = 0;
+        }
+    }
+
+    fputs("\n],\"displayTimeUnit\":\"ms\"}\n", f);
+    if (fclose(f) != 0)
+        fprintf(stderr, "wow: cannot write trace %s: %s\n",
+                trace_path, strerror(errno));
+    pthread_mutex_unlock(&trace_mu);
+}
@@ -0,0 +1,709 @@
+/*
+ * workspace.c -- `wow workspace`: lock many Gemfiles in one process
+ *
+ * Usage:
+ *   wow workspace list [DIR...]
+ *   wow workspace lock [--update] [--unified] [-j N] [--stats[=json]]
+ *                      [DIR...]
+ *
+ * Members are the given DIRs, or every directory under the working
+ * directory that holds a Gemfile (hidden directories, vendor/,
+ * node_modules/ and tmp/ are not searched).
+ *
+ * `lock` runs in three steps:
+ *   1. Parse every member's Gemfile, .ruby-version and Gemfile.lock on
+ *      a pool of N threads.
+ *   2. Group members by (source, Ruby version) and give each group one
+ *      shared compact index provider (wow_ci_provider_init_shared).
+ *   3. Resolve the members on the same threads, each with its own
+ *      solver, and write <member>/Gemfile.lock.
+ * Every /info file is therefore fetched and parsed once per group, and
+ * later members mostly hit a warm cache.  As with `wow lock`, an
+ * existing Gemfile.lock seeds its member's solve; --update ignores it.
+ *
+ * --unified first resolves the union of all members' dependencies into
+ * Gemfile.workspace.lock in the working directory (seeded from the
+ * previous one unless --update), then locks each member seeded from it,
+ * so every service ends up on the same version of every shared gem.
+ * It needs all members to agree on source and Ruby version.
+ */
+
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "wow/common.h"
+#include "wow/gemfile.h"
+#include "wow/resolver.h"
+#include "wow/rubies/resolve.h"
+#include "wow/util/mem.h"
+#include "wow/util/path.h"
+#include "wow/util/time.h"
+#include "wow/workspace.h"
+
+#define WS_MAX_MEMBERS  512
+#define WS_MAX_DEPTH    8
+#define WS_MAX_JOBS     32
+#define WS_LOCK_NAME    "Gemfile.workspace.lock"
+
+/* ------------------------------------------------------------------ */
+/* Members                                                             */
+/* ------------------------------------------------------------------ */
+
+struct ws_member {
+    char                 dir[WOW_DIR_PATH_MAX];   /* absolute */
+    const char          *label;                   /* dir, relative */
+
+    /* Step 1 */
+    struct wow_gemfile   gf;
+    int                  parsed;
+    const char          *source;
+    char                 ruby_full[32];
+    int                  has_ruby;
+    const char         **root_names;
+    wow_gem_constraints *root_cs;
+    int                  n_roots;
+    struct wow_lockfile  lock;
+    int                  have_lock;
+    wow_resolved_pkg    *locked;
+    int                  n_locked;
+    int                  group;
+
+    /* Step 3 */
+    int                  ok;
+    int                  n_solved;
+    double               secs;
+    char                *error;                  /* malloc'd, or NULL */
+};
+
+/* Members sharing one provider */
+struct ws_group {
+    const char      *source;
+    const char      *ruby;       /* NULL: no .ruby-version */
+    wow_ci_provider *ci;
+};
+
+struct ws {
+    char              root[WOW_DIR_PATH_MAX];
+    struct ws_member *m;
+    int               n;
+    struct ws_group  *groups;
+    int               n_groups;
+    int               update;
+
+    /* --unified: the workspace lock every member is seeded from */
+    struct wow_lockfile  ulock;
+    int                  have_ulock;
+    wow_resolved_pkg    *upkgs;
+    int                  n_upkgs;
+};
+
+static int member_cmp(const void *a, const void *b)
+{
+    return strcmp(((const struct ws_member *)a)->dir,
+                  ((const struct ws_member *)b)->dir);
+}
+
+static int resolved_cmp(const void *a, const void *b)
+{
+    return strcmp(((const wow_resolved_pkg *)a)->name,
+                  ((const wow_resolved_pkg *)b)->name);
+}
+
+static int has_gemfile(const char *dir)
+{
+    char path[WOW_OS_PATH_MAX];
+    int n = snprintf(path, sizeof(path), "%s/Gemfile", dir);
+    if (n < 0 || (size_t)n >= sizeof(path)) return 0;
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+static int add_member(struct ws *w, const char *dir)
+{
+    if (w->n == WS_MAX_MEMBERS) {
+        fprintf(stderr, "wow: more than %d workspace members\n",
+                WS_MAX_MEMBERS);
+        return -1;
+    }
+    if (strlen(dir) >= sizeof(w->m[0].dir)) {
+        fprintf(stderr, "wow: %s: path too long\n", dir);
+        return -1;
+    }
+    struct ws_member *m = &w->m[w->n++];
+    memset(m, 0, sizeof(*m));
+    snprintf(m->dir, sizeof(m->dir), "%s", dir);
+    return 0;
+}
+
+static int skip_dir(const char *name)
+{
+    return name[0] == '.' || strcmp(name, "vendor") == 0 ||
+           strcmp(name, "node_modules") == 0 || strcmp(name, "tmp") == 0;
+}
+
+static int discover(struct ws *w, const char *dir, int depth)
+{
+    if (has_gemfile(dir) && add_member(w, dir) != 0) return -1;
+    if (depth == WS_MAX_DEPTH) return 0;
+
+    DIR *d = opendir(dir);
+    if (!d) return 0;
+    struct dirent *de;
+    int rc = 0;
+    while (rc == 0 && (de = readdir(d)) != NULL) {
+        if (skip_dir(de->d_name)) continue;
+        char sub[WOW_DIR_PATH_MAX];
+        int n = snprintf(sub, sizeof(sub), "%s/%s", dir, de->d_name);
+        if (n < 0 || (size_t)n >= sizeof(sub)) continue;
+        struct stat st;
+        if (lstat(sub, &st) != 0 || !S_ISDIR(st.st_mode)) continue;
+        rc = discover(w, sub, depth + 1);
+    }
+    closedir(d);
+    return rc;
+}
+
+/* Fill w->m from argv (explicit DIRs) or by searching w->root */
+static int find_members(struct ws *w, int argc, char *argv[])
+{
+    w->m = calloc(WS_MAX_MEMBERS, sizeof(*w->m));
+    if (!w->m) {
+        fprintf(stderr, "wow: out of memory\n");
+        return -1;
+    }
+
+    if (argc == 0) {
+        if (discover(w, w->root, 0) != 0) return -1;
+    }
+    for (int i = 0; i < argc; i++) {
+        char abs[PATH_MAX];
+        if (!realpath(argv[i], abs) || !has_gemfile(abs)) {
+            fprintf(stderr, "wow: %s: no Gemfile\n", argv[i]);
+            return -1;
+        }
+        if (add_member(w, abs) != 0) return -1;
+    }
+    if (w->n == 0) {
+        fprintf(stderr, "wow: no Gemfiles found under %s\n", w->root);
+        return -1;
+    }
+
+    qsort(w->m, (size_t)w->n, sizeof(*w->m), member_cmp);
+    size_t rlen = strlen(w->root);
+    for (int i = 0; i < w->n; i++) {
+        struct ws_member *m = &w->m[i];
+        if (strcmp(m->dir, w->root) == 0)
+            m->label = ".";
+        else if (strncmp(m->dir, w->root, rlen) == 0 &&
+                 m->dir[rlen] == '/')
+            m->label = m->dir + rlen + 1;
+        else
+            m->label = m->dir;
+    }
+    return 0;
+}
+
+static void member_free(struct ws_member *m)
+{
+    free(m->error);
+    free(m->locked);
+    if (m->have_lock) wow_lockfile_free(&m->lock);
+    free(m->root_names);
+    free(m->root_cs);
+    if (m->parsed) wow_gemfile_free(&m->gf);
+}
+
+static void member_fail(struct ws_member *m, const char *msg)
+{
+    free(m->error);
+    m->error = strdup(msg);
+}
+
+/* ------------------------------------------------------------------ */
+/* Thread pool                                                         */
+/* ------------------------------------------------------------------ */
+
+struct ws_pool {
+    struct ws *w;
+    void     (*fn)(struct ws *w, int i);
+    int        next;
+};
+
+static void *ws_worker(void *arg)
+{
+    struct ws_pool *p = arg;
+    int i;
+    while ((i = __atomic_fetch_add(&p->next, 1, __ATOMIC_RELAXED)) <
+           p->w->n)
+        p->fn(p->w, i);
+    return NULL;
+}
+
+/* Run fn(w, i) for every member on up to jobs threads */
+static void ws_run(struct ws *w, int jobs, void (*fn)(struct ws *, int))
+{
+    struct ws_pool p = { .w = w, .fn = fn, .next = 0 };
+    pthread_t threads[WS_MAX_JOBS];
+    if (jobs > w->n) jobs = w->n;
+
+    /* A failed pthread_create just means fewer workers; the calling
+     * thread drains whatever is left. */
+    int started = 0;
+    for (int i = 0; i < jobs; i++) {
+        if (pthread_create(&threads[started], NULL, ws_worker, &p) == 0)
+            started++;
+    }
+    ws_worker(&p);
+    for (int i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+}
+
+/* ------------------------------------------------------------------ */
+/* Step 1: parse                                                       */
+/* ------------------------------------------------------------------ */
+
+/* Root names/constraints from a parsed Gemfile (names borrowed from gf) */
+static int gemfile_roots(const struct wow_gemfile *gf, const char ***names,
+                         wow_gem_constraints **cs, char *err, size_t errsz)
+{
+    int n = (int)gf->n_deps;
+    *names = calloc((size_t)n, sizeof(char *));
+    *cs = calloc((size_t)n, sizeof(wow_gem_constraints));
+    if (!*names || !*cs) {
+        snprintf(err, errsz, "out of memory");
+        return -1;
+    }
+    for (int i = 0; i < n; i++) {
+        (*names)[i] = gf->deps[i].name;
+        char joined[512] = ">= 0";
+        if (gf->deps[i].n_constraints > 0)
+            wow_join_constraints(gf->deps[i].constraints,
+                                 gf->deps[i].n_constraints,
+                                 joined, sizeof(joined));
+        if (wow_gem_constraints_parse(joined, &(*cs)[i]) != 0) {
+            snprintf(err, errsz, "invalid constraint for %.63s: %.255s",
+                     gf->deps[i].name, joined);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void parse_member(struct ws *w, int i)
+{
+    struct ws_member *m = &w->m[i];
+    char path[WOW_OS_PATH_MAX], err[512];
+
+    snprintf(path, sizeof(path), "%s/Gemfile", m->dir);
+    if (wow_gemfile_parse_file(path, &m->gf) != 0) {
+        member_fail(m, "failed to parse Gemfile");
+        return;
+    }
+    m->parsed = 1;
+    if (m->gf.n_deps == 0) {
+        member_fail(m, "no gems in Gemfile");
+        return;
+    }
+    m->source = m->gf.source ? m->gf.source : "https://rubygems.org";
+    m->has_ruby = wow_find_ruby_version_in(m->dir, m->ruby_full,
+                                           sizeof(m->ruby_full)) == 0;
+
+    m->n_roots = (int)m->gf.n_deps;
+    if (gemfile_roots(&m->gf, &m->root_names, &m->root_cs,
+                      err, sizeof(err)) != 0) {
+        member_fail(m, err);
+        return;
+    }
+
+    if (!w->update) {
+        snprintf(path, sizeof(path), "%s/Gemfile.lock", m->dir);
+        if (wow_lockfile_parse(path, &m->lock) == 0) {
+            m->have_lock = 1;
+            wow_lockfile_select_host(&m->lock, &m->locked, &m->n_locked,
+                                     err, sizeof(err));
+        }
+    }
+}
+
+/* ------------------------------------------------------------------ */
+/* Step 2: groups                                                      */
+/* ------------------------------------------------------------------ */
+
+static int same_str(const char *a, const char *b)
+{
+    return (!a && !b) || (a && b && strcmp(a, b) == 0);
+}
+
+static int make_groups(struct ws *w, int jobs)
+{
+    w->groups = calloc((size_t)w->n, sizeof(*w->groups));
+    if (!w->groups) return -1;
+
+    for (int i = 0; i < w->n; i++) {
+        struct ws_member *m = &w->m[i];
+        if (m->error) continue;
+        const char *ruby = m->has_ruby ? m->ruby_full : NULL;
+        int g = 0;
+        while (g < w->n_groups &&
+               !(same_str(w->groups[g].source, m->source) &&
+                 same_str(w->groups[g].ruby, ruby)))
+            g++;
+        if (g == w->n_groups) {
+            struct ws_group *gr = &w->groups[w->n_groups++];
+            gr->source = m->source;
+            gr->ruby = ruby;
+            gr->ci = malloc(sizeof(*gr->ci));
+            if (!gr->ci ||
+                wow_ci_provider_init_shared(gr->ci, m->source, jobs,
+                                            ruby) != 0) {
+                free(gr->ci);
+                gr->ci = NULL;
+                w->n_groups--;
+                return -1;
+            }
+        }
+        m->group = g;
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* Step 3: resolve                                                     */
+/* ------------------------------------------------------------------ */
+
+static void resolve_member(struct ws *w, int i)
+{
+    struct ws_member *m = &w->m[i];
+    if (m->error) return;
+
+    double t0 = wow_now_secs();
+    struct ws_group *g = &w->groups[m->group];
+    wow_provider ci_prov = wow_ci_provider_as_provider(g->ci);
+
+    /* Seed from the workspace lock (--unified) or the member's own */
+    const struct wow_lockfile *lf = m->have_lock ? &m->lock : NULL;
+    const wow_resolved_pkg *seed = m->locked;
+    int n_seed = m->n_locked;
+    if (w->have_ulock) {
+        lf = &w->ulock;
+        seed = w->upkgs;
+        n_seed = w->n_upkgs;
+    }
+
+    wow_lock_provider lp;
+    wow_solver *solver = malloc(sizeof(*solver));
+    if (!solver ||
+        wow_lock_provider_init(&lp, lf, seed, n_seed, m->source,
+                               &ci_prov) != 0) {
+        free(solver);
+        member_fail(m, "out of memory");
+        return;
+    }
+    wow_provider prov = wow_lock_provider_as_provider(&lp);
+    wow_solver_init(solver, &prov);
+
+    if (wow_solve(solver, m->root_names, m->root_cs, m->n_roots) != 0) {
+        member_fail(m, solver->error_msg);
+    } else {
+        qsort(solver->solution, (size_t)solver->n_solved,
+              sizeof(wow_resolved_pkg), resolved_cmp);
+        char path[WOW_OS_PATH_MAX];
+        snprintf(path, sizeof(path), "%s/Gemfile.lock", m->dir);
+        if (wow_write_lockfile(path, solver, &prov, &m->gf,
+                               m->source) != 0) {
+            member_fail(m, "cannot write Gemfile.lock");
+        } else {
+            m->ok = 1;
+            m->n_solved = solver->n_solved;
+        }
+    }
+
+    wow_solver_destroy(solver);
+    free(solver);
+    wow_lock_provider_destroy(&lp);
+    m->secs = wow_now_secs() - t0;
+}
+
+/* ------------------------------------------------------------------ */
+/* --unified                                                           */
+/* ------------------------------------------------------------------ */
+
+/* Append c to dep's constraints unless it is already there */
+static int merge_constraint(struct wow_gemfile_dep *dep, const char *c)
+{
+    for (int k = 0; k < dep->n_constraints; k++)
+        if (strcmp(dep->constraints[k], c) == 0) return 0;
+    char **nc = realloc(dep->constraints,
+                        (size_t)(dep->n_constraints + 1) * sizeof(char *));
+    if (!nc) return -1;
+    dep->constraints = nc;
+    if (!(nc[dep->n_constraints] = strdup(c))) return -1;
+    dep->n_constraints++;
+    return 0;
+}
+
+/* A Gemfile whose dependencies are the union of all members' */
+static int merged_gemfile(const struct ws *w, struct wow_gemfile *out)
+{
+    wow_gemfile_init(out);
+    out->source = strdup(w->groups[0].source);
+    if (!out->source) return -1;
+
+    for (int i = 0; i < w->n; i++) {
+        const struct ws_member *m = &w->m[i];
+        if (m->error) continue;
+        for (size_t d = 0; d < m->gf.n_deps; d++) {
+            const struct wow_gemfile_dep *src = &m->gf.deps[d];
+            size_t j = 0;
+            while (j < out->n_deps && strcmp(out->deps[j].name, src->name))
+                j++;
+            if (j == out->n_deps) {
+                struct wow_gemfile_dep dep = { 0 };
+                if (!(dep.name = strdup(src->name)) ||
+                    wow_gemfile_add_dep(out, &dep) != 0) {
+                    free(dep.name);
+                    return -1;
+                }
+            }
+            for (int k = 0; k < src->n_constraints; k++)
+                if (merge_constraint(&out->deps[j],
+                                     src->constraints[k]) != 0)
+                    return -1;
+        }
+    }
+    return 0;
+}
+
+static int resolve_unified(struct ws *w)
+{
+    if (w->n_groups != 1) {
+        fprintf(stderr, "wow: --unified needs every member on the same "
+                "source and Ruby version (found %d combinations)\n",
+                w->n_groups);
+        return -1;
+    }
+
+    char path[WOW_OS_PATH_MAX], why[256];
+    snprintf(path, sizeof(path), "%s/" WS_LOCK_NAME, w->root);
+
+    struct wow_gemfile gf;
+    const char **names = NULL;
+    wow_gem_constraints *cs = NULL;
+    struct wow_lockfile prev;
+    int have_prev = 0;
+    wow_resolved_pkg *prev_pkgs = NULL;
+    int n_prev = 0;
+    int rc = -1;
+
+    if (merged_gemfile(w, &gf) != 0 ||
+        gemfile_roots(&gf, &names, &cs, why, sizeof(why)) != 0) {
+        fprintf(stderr, "wow: workspace: %s\n",
+                names ? why : "out of memory");
+        goto out;
+    }
+
+    if (!w->update && wow_lockfile_parse(path, &prev) == 0) {
+        have_prev = 1;
+        wow_lockfile_select_host(&prev, &prev_pkgs, &n_prev,
+                                 why, sizeof(why));
+    }
+
+    wow_provider ci_prov = wow_ci_provider_as_provider(w->groups[0].ci);
+    wow_lock_provider lp;
+    if (wow_lock_provider_init(&lp, have_prev ? &prev : NULL, prev_pkgs,
+                               n_prev, gf.source, &ci_prov) != 0) {
+        fprintf(stderr, "wow: out of memory\n");
+        goto out;
+    }
+    wow_provider prov = wow_lock_provider_as_provider(&lp);
+    wow_solver *solver = malloc(sizeof(*solver));
+    if (!solver) {
+        wow_lock_provider_destroy(&lp);
+        goto out;
+    }
+    wow_solver_init(solver, &prov);
+
+    printf("Resolving workspace (%zu gems across %d members)...\n",
+           gf.n_deps, w->n);
+    fflush(stdout);
+    if (wow_solve(solver, names, cs, (int)gf.n_deps) != 0) {
+        fprintf(stderr, "\nWorkspace resolution failed:\n%s\n",
+                solver->error_msg);
+    } else {
+        qsort(solver->solution, (size_t)solver->n_solved,
+              sizeof(wow_resolved_pkg), resolved_cmp);
+        if (wow_write_lockfile(path, solver, &prov, &gf, gf.source) == 0) {
+            printf("Wrote " WS_LOCK_NAME " (%d packages)\n",
+                   solver->n_solved);
+            rc = 0;
+        }
+    }
+    wow_solver_destroy(solver);
+    free(solver);
+    wow_lock_provider_destroy(&lp);
+
+    /* Members are seeded from what was just written */
+    if (rc == 0) {
+        if (wow_lockfile_parse(path, &w->ulock) != 0 ||
+            wow_lockfile_select_host(&w->ulock, &w->upkgs, &w->n_upkgs,
+                                     why, sizeof(why)) != 0) {
+            fprintf(stderr, "wow: cannot read back " WS_LOCK_NAME "\n");
+            rc = -1;
+        } else {
+            w->have_ulock = 1;
+        }
+    }
+
+out:
+    free(prev_pkgs);
+    if (have_prev) wow_lockfile_free(&prev);
+    free(names);
+    free(cs);
+    wow_gemfile_free(&gf);
+    return rc;
+}
+
+/* ------------------------------------------------------------------ */
+/* wow workspace                                                       */
+/* ------------------------------------------------------------------ */
+
+static int cpu_count(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+static void ws_usage(void)
+{
+    fprintf(stderr,
+            "usage: wow workspace list [DIR...]\n"
+            "       wow workspace lock [--update] [--unified] [-j N] "
+            "[--stats[=json]] [DIR...]\n");
+}
+
+static void ws_free(struct ws *w)
+{
+    for (int g = 0; g < w->n_groups; g++) {
+        wow_ci_provider_destroy(w->groups[g].ci);
+        free(w->groups[g].ci);
+    }
+    free(w->groups);
+    free(w->upkgs);
+    if (w->have_ulock) wow_lockfile_free(&w->ulock);
+    for (int i = 0; i < w->n; i++) member_free(&w->m[i]);
+    free(w->m);
+}
+
+static int ws_lock(struct ws *w, int jobs, int unified,
+                   enum wow_stats_mode stats)
+{
+    double t0 = wow_now_secs();
+
+    ws_run(w, jobs, parse_member);
+    wow_mem_phase("parse");
+    if (make_groups(w, jobs) != 0) return 1;
+    if (unified && resolve_unified(w) != 0) return 1;
+
+    int nt = jobs < w->n ? jobs : w->n;
+    printf("Resolving %d members on %d thread%s...\n", w->n, nt,
+           nt == 1 ? "" : "s");
+    fflush(stdout);
+    ws_run(w, jobs, resolve_member);
+    wow_mem_phase("resolve");
+
+    int n_ok = 0;
+    for (int i = 0; i < w->n; i++) {
+        const struct ws_member *m = &w->m[i];
+        if (m->ok) {
+            n_ok++;
+            printf("  %-24s %4d packages  %.2fs\n", m->label,
+                   m->n_solved, m->secs);
+        } else {
+            printf("  %-24s failed\n", m->label);
+        }
+    }
+    fflush(stdout);
+    for (int i = 0; i < w->n; i++) {
+        const struct ws_member *m = &w->m[i];
+        if (!m->ok)
+            fprintf(stderr, "\nwow: %s: %s\n", m->label,
+                    m->error ? m->error : "failed");
+    }
+
+    int fetched = 0;
+    for (int g = 0; g < w->n_groups; g++)
+        fetched += w->groups[g].ci->stats.cache_misses;
+    printf("Wrote %d of %d lockfiles in %.2fs (%d index files fetched)\n",
+           n_ok, w->n, wow_now_secs() - t0, fetched);
+    fflush(stdout);
+
+    for (int g = 0; g < w->n_groups; g++)
+        wow_resolve_stats_print(stderr, stats, NULL, w->groups[g].ci);
+    return n_ok == w->n ? 0 : 1;
+}
+
+int cmd_workspace(int argc, char *argv[])
+{
+    if (argc < 2) {
+        ws_usage();
+        return 1;
+    }
+    const char *sub = argv[1];
+    int list = strcmp(sub, "list") == 0;
+    if (!list && strcmp(sub, "lock") != 0) {
+        ws_usage();
+        return 1;
+    }
+
+    struct ws w = { 0 };
+    int unified = 0;
+    int jobs = cpu_count();
+    enum wow_stats_mode stats = WOW_STATS_OFF;
+
+    /* Options are compacted out of argv, leaving the member DIRs */
+    int n_dirs = 0;
+    for (int i = 2; i < argc; i++) {
+        if (!list && strcmp(argv[i], "--update") == 0) {
+            w.update = 1;
+        } else if (!list && strcmp(argv[i], "--unified") == 0) {
+            unified = 1;
+        } else if (!list && strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            jobs = atoi(argv[++i]);
+        } else if (!list && wow_stats_flag(argv[i], &stats)) {
+            continue;
+        } else if (argv[i][0] == '-') {
+            ws_usage();
+            return 1;
+        } else {
+            argv[2 + n_dirs++] = argv[i];
+        }
+    }
+    if (jobs < 1) jobs = 1;
+    if (jobs > WS_MAX_JOBS) jobs = WS_MAX_JOBS;
+    if (stats != WOW_STATS_OFF) wow_mem_enable();
+
+    if (!getcwd(w.root, sizeof(w.root))) {
+        perror("wow: getcwd");
+        return 1;
+    }
+    if (find_members(&w, n_dirs, argv + 2) != 0) {
+        ws_free(&w);
+        return 1;
+    }
+
+    int rc = 0;
+    if (list) {
+        for (int i = 0; i < w.n; i++)
+            printf("%s\n", w.m[i].label);
+    } else {
+        rc = ws_lock(&w, jobs, unified, stats);
+    }
+    ws_free(&w);
+    return rc;
+}
@@ -8,6 +8,11 @@
  *   2. wowx cache           (~/.cache/wowx/<gem>-<ver>/...)
  *   3. Auto-install          PubGrub resolve → download → unpack → exec
  *
+ * An unpinned tool served from the cache is stale-while-revalidate: once
+ * its freshness record is older than WOWX_TTL, the launch starts a
+ * detached background install of the newest release and execs the
+ * cached env without waiting.  The next launch picks up the new env.
+ *
  * Uses RUBYLIB (not GEM_HOME) for load-path resolution — same as
  * Bundler's --standalone mode.
  */
@@ -15,13 +20,15 @@
 #include <cosmo.h>
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/file.h>
 #include <sys/stat.h>
-#include <sys/utsname.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "wow/common.h"
@@ -78,6 +85,10 @@ static void print_usage(void)
     fprintf(stderr, "Usage: wowx [--ruby <ver>] <gem>[@<version>] [args...]\n\n");
     fprintf(stderr, "Options:\n");
     fprintf(stderr, "  --ruby, -r <ver>  Ruby version to use (e.g. 3.3, 4.0)\n\n");
+    fprintf(stderr, "Environment:\n");
+    fprintf(stderr, "  WOWX_TTL=<secs>   Check for newer unpinned tools this often,\n");
+    fprintf(stderr, "                    in the background (default 86400; 0 = every\n");
+    fprintf(stderr, "                    run, negative = never)\n\n");
     fprintf(stderr, "Examples:\n");
     fprintf(stderr, "  wowx rubocop               # latest gem, latest Ruby\n");
     fprintf(stderr, "  wowx rubocop@1.60.0        # pinned gem version\n");
@@ -86,63 +97,15 @@ static void print_usage(void)
     fprintf(stderr, "  wowx rubocop -- --only Style\n");
 }
 
-/*
- * Detect the RubyGems platform string for native gem downloads.
- * Returns a static string like "x86_64-linux", "aarch64-linux",
- * "x86_64-darwin", "arm64-darwin", or NULL on failure.
- */
-/*
- * Detect RubyGems platform strings for native gem downloads.
- * Returns a NULL-terminated array of platforms to try in order.
- *
- * On Linux, gems use inconsistent conventions:
- *   - nokogiri: x86_64-linux-gnu / x86_64-linux-musl
- *   - grpc:     x86_64-linux
- * We try the more specific variant first, then the bare one.
- */
-#define MAX_GEM_PLATFORMS 3
-
-static const char **detect_gem_platforms(void)
-{
-    static const char *platforms[MAX_GEM_PLATFORMS + 1];
-    static char buf[MAX_GEM_PLATFORMS][256];
-    static int detected;
-
-    if (detected) return platforms[0] ? platforms : NULL;
-    detected = 1;
-
-    struct utsname u;
-    if (uname(&u) != 0) return NULL;
-
-    const char *arch = u.machine;  /* x86_64, aarch64, arm64 */
-    int n = 0;
-
-    if (strstr(u.sysname, "Linux")) {
-        /* Try gnu-suffixed first (nokogiri, etc.), then bare */
-        snprintf(buf[n], sizeof(buf[n]), "%s-linux-gnu", arch);
-        platforms[n] = buf[n]; n++;
-        snprintf(buf[n], sizeof(buf[n]), "%s-linux", arch);
-        platforms[n] = buf[n]; n++;
-    } else if (strstr(u.sysname, "Darwin")) {
-        snprintf(buf[n], sizeof(buf[n]), "%s-darwin", arch);
-        platforms[n] = buf[n]; n++;
-    } else {
-        return NULL;
-    }
-
-    platforms[n] = NULL;
-    return platforms;
-}
-
-
 /*
  * Check wowx cache for a specific version.
- * Returns 0 if found (env_dir + exe_path filled), -1 otherwise.
+ * Returns 0 if the env dir is completely installed (env_dir filled),
+ * -1 otherwise.
+ * Binary lookup is left to the caller (manifest first, then a scan).
  */
 static int check_cache_pinned(const char *wowx_cache, const char *gem_name,
-                              const char *version, const char *binary_name,
-                              char *env_dir, size_t env_dir_sz,
-                              char *exe_path, size_t exe_path_sz)
+                              const char *version,
+                              char *env_dir, size_t env_dir_sz)
 {
     /* Bounded copies so GCC can prove env_dir composition fits */
     char cache[WOW_DIR_PATH_MAX];
@@ -153,18 +116,22 @@ static int check_cache_pinned(const char *wowx_cache, const char *gem_name,
     SCOPY(ver, version);
 
     snprintf(env_dir, env_dir_sz, "%s/%s-%s", cache, name, ver);
-    return wow_find_gem_binary(env_dir, gem_name, binary_name,
-                              exe_path, exe_path_sz);
+    struct stat st;
+    if (stat(env_dir, &st) != 0 || !S_ISDIR(st.st_mode)) return -1;
+
+    /* A background refresh may be filling this env right now */
+    char marker[WOW_OS_PATH_MAX];
+    snprintf(marker, sizeof(marker), "%s/%s-%s/.installed",
+             cache, name, ver);
+    return access(marker, F_OK) == 0 ? 0 : -1;
 }
 
 /*
- * Scan wowx cache for the latest cached version of a gem.
- * Returns 0 if found (env_dir + exe_path filled), -1 otherwise.
+ * Scan wowx cache for the latest completely installed version of a gem.
+ * Returns 0 if found (env_dir filled), -1 otherwise.
  */
 static int check_cache_latest(const char *wowx_cache, const char *gem_name,
-                              const char *binary_name,
-                              char *env_dir, size_t env_dir_sz,
-                              char *exe_path, size_t exe_path_sz)
+                              char *env_dir, size_t env_dir_sz)
 {
     /* Bounded copy so GCC can track size through compositions */
     char cache[WOW_DIR_PATH_MAX];
@@ -191,6 +158,12 @@ static int check_cache_latest(const char *wowx_cache, const char *gem_name,
         char entry[128];
         SCOPY(entry, ent->d_name);
 
+        /* Skip envs still being installed (e.g. by a background
+         * refresh) -- they lack the completion marker */
+        char marker[WOW_OS_PATH_MAX];
+        snprintf(marker, sizeof(marker), "%s/%s/.installed", cache, entry);
+        if (access(marker, F_OK) != 0) continue;
+
         if (!found || wow_gemver_cmp(&v, &best_ver) > 0) {
             best_ver = v;
             snprintf(best_env, sizeof(best_env), "%s/%s",
@@ -203,37 +176,7 @@ static int check_cache_latest(const char *wowx_cache, const char *gem_name,
     if (!found) return -1;
 
     snprintf(env_dir, env_dir_sz, "%s", best_env);
-    return wow_find_gem_binary(env_dir, gem_name, binary_name,
-                              exe_path, exe_path_sz);
-}
-
-/* ── Process helper ──────────────────────────────────────────────── */
-
-/*
- * Run a command in a given working directory, wait for completion.
- * Child stdout is redirected to stderr so build noise (extconf checks,
- * compiler output) doesn't pollute the gem's actual stdout output.
- * Returns the exit code, or -1 on fork/exec failure.
- */
-static int run_cmd(const char *cwd, const char *const argv[])
-{
-    pid_t pid = fork();
-    if (pid < 0) {
-        fprintf(stderr, "wowx: fork failed: %s\n", strerror(errno));
-        return -1;
-    }
-    if (pid == 0) {
-        /* Redirect stdout → stderr so build output doesn't mix
-         * with the gem binary's actual output on stdout. */
-        dup2(STDERR_FILENO, STDOUT_FILENO);
-        if (cwd && chdir(cwd) != 0)
-            _exit(127);
-        execv(argv[0], (char *const *)argv);
-        _exit(127);
-    }
-    int status;
-    if (waitpid(pid, &status, 0) < 0) return -1;
-    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    return 0;
 }
 
 /* ── Default gem detection ───────────────────────────────────────── */
@@ -275,225 +218,15 @@ static int is_default_gem_matching(const char *ruby_bin, const char *ruby_api,
     return access(spec_path, F_OK) == 0;
 }
 
-/* ── Native extension compilation ────────────────────────────────── */
-
-/*
- * Check if a gem already has compiled native code (e.g. from a
- * platform-specific .gem download).  Looks for .so or .bundle files
- * under the gem's lib/ tree.
- */
-static int has_native_lib(const char *gem_dir)
-{
-    /* Bounded copy so GCC can track sizes through compositions */
-    char dir[WOW_DIR_PATH_MAX];
-    snprintf(dir, sizeof(dir), "%s", gem_dir);
-
-    char lib_dir[WOW_OS_PATH_MAX];
-    snprintf(lib_dir, sizeof(lib_dir), "%s/lib", dir);
-
-    /* Quick scan: look for any .so or .bundle file recursively.
-     * We only go one level deep under lib/ — that covers the common
-     * case (lib/prism/prism.so, lib/x86_64-linux/foo.so). */
-    DIR *d1 = opendir(lib_dir);
-    if (!d1) return 0;
-
-    struct dirent *e1;
-    while ((e1 = readdir(d1)) != NULL) {
-        if (e1->d_name[0] == '.') continue;
-        size_t len = strlen(e1->d_name);
-        if ((len > 3 && strcmp(e1->d_name + len - 3, ".so") == 0) ||
-            (len > 7 && strcmp(e1->d_name + len - 7, ".bundle") == 0)) {
-            closedir(d1);
-            return 1;
-        }
-        /* Check one level deeper */
-        char entry[128];
-        SCOPY(entry, e1->d_name);
-
-        char sub[WOW_OS_PATH_MAX];
-        snprintf(sub, sizeof(sub), "%s/lib/%s", dir, entry);
-        struct stat st;
-        if (stat(sub, &st) != 0 || !S_ISDIR(st.st_mode)) continue;
-
-        DIR *d2 = opendir(sub);
-        if (!d2) continue;
-        struct dirent *e2;
-        while ((e2 = readdir(d2)) != NULL) {
-            size_t l2 = strlen(e2->d_name);
-            if ((l2 > 3 && strcmp(e2->d_name + l2 - 3, ".so") == 0) ||
-                (l2 > 7 && strcmp(e2->d_name + l2 - 7, ".bundle") == 0)) {
-                closedir(d2);
-                closedir(d1);
-                return 1;
-            }
-        }
-        closedir(d2);
-    }
-    closedir(d1);
-    return 0;
-}
+/* ── Auto-install: resolve + download + unpack ───────────────────── */
 
 /*
- * Build a native extension from source.
- *
- * Three-tier strategy:
- *   1. Platform binary already present (checked before calling this)
- *   2. Cosmo binary (stub — future)
- *   3. Build from source: ruby extconf.rb && make
- *
- * ext_path is relative to gem_dir, e.g. "ext/prism/extconf.rb".
- * ruby_bin is the absolute path to the Ruby binary.
+ * refresh: a background check for a newer release -- if the newest
+ * version is already installed, stop after resolving.
  */
-static int build_native_extension(const char *gem_dir, const char *ext_path,
-                                   const char *ruby_bin,
-                                   const char *ruby_api)
-{
-    /* Bounded copies so GCC can track sizes through compositions */
-    char gdir[WOW_DIR_PATH_MAX];
-    snprintf(gdir, sizeof(gdir), "%s", gem_dir);
-    char ext[128];
-    snprintf(ext, sizeof(ext), "%s", ext_path);
-
-    /* Extract the directory containing extconf.rb */
-    char ext_dir[WOW_OS_PATH_MAX];
-    snprintf(ext_dir, sizeof(ext_dir), "%s/%s", gdir, ext);
-    char *slash = strrchr(ext_dir, '/');
-    if (slash) *slash = '\0';
-
-    /* Verify extconf.rb exists */
-    char extconf[WOW_OS_PATH_MAX];
-    snprintf(extconf, sizeof(extconf), "%s/%s", gdir, ext);
-    if (access(extconf, R_OK) != 0) {
-        fprintf(stderr, "wowx: extension not found: %s\n", ext_path);
-        return -1;
-    }
-
-    /* Set up environment for the forked Ruby process.
-     * Pre-built rubies have hardcoded load paths from the build machine,
-     * so we need LD_LIBRARY_PATH (for libruby.so) and RUBYLIB (for
-     * stdlib: mkmf, rubygems, etc.) — same fix as wow_exec_gem_binary(). */
-    {
-        char prefix[WOW_DIR_PATH_MAX];
-        snprintf(prefix, sizeof(prefix), "%s", ruby_bin);
-        char *sl = strrchr(prefix, '/');
-        if (sl) { *sl = '\0'; sl = strrchr(prefix, '/'); if (sl) *sl = '\0'; }
-
-        char api[16];
-        snprintf(api, sizeof(api), "%s", ruby_api);
-
-        /* LD_LIBRARY_PATH */
-        char lib_dir[WOW_OS_PATH_MAX];
-        snprintf(lib_dir, sizeof(lib_dir), "%s/lib", prefix);
-        const char *existing_ld = getenv("LD_LIBRARY_PATH");
-        if (existing_ld && existing_ld[0]) {
-            char combined[PATH_MAX * 2];
-            snprintf(combined, sizeof(combined), "%s:%s", lib_dir, existing_ld);
-            setenv("LD_LIBRARY_PATH", combined, 1);
-        } else {
-            setenv("LD_LIBRARY_PATH", lib_dir, 1);
-        }
-
-        /* RUBYLIB — stdlib + arch-specific dir (for mkmf, rbconfig, etc.) */
-        char stdlib_dir[WOW_OS_PATH_MAX];
-        snprintf(stdlib_dir, sizeof(stdlib_dir), "%s/lib/ruby/%s",
-                 prefix, api);
-
-        /* Find arch subdir containing rbconfig.rb */
-        char rubylib[PATH_MAX * 2];
-        snprintf(rubylib, sizeof(rubylib), "%s", stdlib_dir);
-
-        DIR *sd = opendir(stdlib_dir);
-        if (sd) {
-            struct dirent *se;
-            while ((se = readdir(sd)) != NULL) {
-                if (se->d_name[0] == '.') continue;
-
-                char arch[128];
-                SCOPY(arch, se->d_name);
-
-                char candidate[WOW_OS_PATH_MAX];
-                snprintf(candidate, sizeof(candidate),
-                         "%s/lib/ruby/%s/%s/rbconfig.rb",
-                         prefix, api, arch);
-                if (access(candidate, R_OK) == 0) {
-                    size_t pos = strlen(rubylib);
-                    snprintf(rubylib + pos, sizeof(rubylib) - pos,
-                             ":%s/lib/ruby/%s/%s", prefix, api, arch);
-                    break;
-                }
-            }
-            closedir(sd);
-        }
-        setenv("RUBYLIB", rubylib, 1);
-    }
-
-    /* Tier 2: Cosmo binary (stub)
-     * TODO: check for Cosmopolitan fat binary variant of this extension.
-     * Would be fetched from a wow-specific binary cache. */
-
-    /* Tier 3: Build from source */
-    int colour = wow_use_colour();
-    if (colour)
-        fprintf(stderr, WOW_ANSI_DIM "Building native extension: %s..."
-                WOW_ANSI_RESET "\n", ext_path);
-    else
-        fprintf(stderr, "Building native extension: %s...\n", ext_path);
-
-    /* Step 1: ruby extconf.rb */
-    {
-        const char *argv[] = { ruby_bin, "extconf.rb", NULL };
-        int rc = run_cmd(ext_dir, argv);
-        if (rc != 0) {
-            fprintf(stderr, "wowx: extconf.rb failed (exit %d) in %s\n",
-                    rc, ext_dir);
-            return -1;
-        }
-    }
-
-    /* Step 2: make */
-    {
-        const char *argv[] = { "/usr/bin/make", "-j4", NULL };
-        int rc = run_cmd(ext_dir, argv);
-        if (rc != 0) {
-            fprintf(stderr, "wowx: make failed (exit %d) in %s\n",
-                    rc, ext_dir);
-            return -1;
-        }
-    }
-
-    /* Step 3: make install into the gem's own lib/ directory.
-     * extconf.rb-generated Makefiles support sitearchdir/sitelibdir
-     * overrides to control where .so and .rb files land.
-     *
-     * NB: this duplicates .so files — the build artefact stays in ext/
-     * and the installed copy goes to lib/.  We can't skip the install
-     * step because the build layout doesn't match the require layout
-     * (e.g. ext/racc/cparse/cparse.so vs lib/racc/cparse.so).
-     * TODO: clean ext/ build artefacts after install to reclaim space. */
-    {
-        char sitearch[WOW_OS_PATH_MAX];
-        char sitelib[WOW_OS_PATH_MAX];
-        snprintf(sitearch, sizeof(sitearch), "sitearchdir=%s/lib", gdir);
-        snprintf(sitelib, sizeof(sitelib), "sitelibdir=%s/lib", gdir);
-        const char *argv[] = {
-            "/usr/bin/make", "install", sitearch, sitelib, NULL
-        };
-        int rc = run_cmd(ext_dir, argv);
-        if (rc != 0) {
-            fprintf(stderr, "wowx: make install failed (exit %d) in %s\n",
-                    rc, ext_dir);
-            return -1;
-        }
-    }
-
-    return 0;
-}
-
-/* ── Auto-install: resolve + download + unpack ───────────────────── */
-
 static int auto_install(const char *gem_name, const char *constraint_str,
                         const char *ruby_api, const char *ruby_bin,
-                        const char *ruby_version,
+                        const char *ruby_version, int refresh,
                         char *env_dir, size_t env_dir_sz)
 {
     int ret = -1;
@@ -524,7 +257,16 @@ static int auto_install(const char *gem_name, const char *constraint_str,
     else
         fprintf(stderr, "Resolving dependencies...\n");
 
-    int rc = wow_solve(&solver, root_names, root_cs, 1);
+    /* A tool env re-created for the same gem and Ruby usually lands on
+     * the solution from last time; the cache checks the index first */
+    char skey[65];
+    int cached = wow_solcache_key(&ci, root_names, root_cs, 1, NULL,
+                                  skey, sizeof(skey)) == 0;
+    int rc = 0;
+    if (!cached || wow_solcache_load(skey, &ci, &solver) != 0) {
+        rc = wow_solve(&solver, root_names, root_cs, 1);
+        if (rc == 0 && cached) wow_solcache_store(skey, &ci, &solver);
+    }
     if (rc != 0) {
         fprintf(stderr, "wowx: failed to resolve dependencies for %s:\n%s\n",
                 gem_name, solver.error_msg);
@@ -554,19 +296,40 @@ static int auto_install(const char *gem_name, const char *constraint_str,
     snprintf(env_dir, env_dir_sz, "%s/%s-%s",
              wowx_cache, gem_name, resolved_ver);
 
+    if (refresh) {
+        char marker[WOW_OS_PATH_MAX];
+        snprintf(marker, sizeof(marker), "%s/.installed", env_dir);
+        if (access(marker, F_OK) == 0) {
+            fprintf(stderr, "%s %s is current\n", gem_name, resolved_ver);
+            ret = 0;
+            goto cleanup;
+        }
+    }
+
     /* Copy solution names/versions out of solver arena before destroy.
      * Bounded sizes (64/32) give GCC proof that downstream path
      * compositions (cache_dir + name + version + suffix) fit. */
     char (*names)[64] = calloc((size_t)n_solved, 64);
     char (*versions)[32] = calloc((size_t)n_solved, 32);
-    if (!names || !versions) {
+    /* .gem file per package: the solver already picked the host's
+     * precompiled variant where one exists ("name-ver-plat.gem") */
+    char (*files)[160] = calloc((size_t)n_solved, 160);
+    if (!names || !versions || !files) {
         fprintf(stderr, "wowx: out of memory\n");
-        free(names); free(versions);
+        free(names); free(versions); free(files);
         goto cleanup;
     }
     for (int i = 0; i < n_solved; i++) {
         SCOPY(names[i], solver.solution[i].name);
         SCOPY(versions[i], solver.solution[i].version.raw);
+        char plat[WOW_CI_PLATFORM_LEN];
+        if (solver.solution[i].platform) {
+            SCOPY(plat, solver.solution[i].platform);
+            snprintf(files[i], 160, "%s-%s-%s.gem",
+                     names[i], versions[i], plat);
+        } else {
+            snprintf(files[i], 160, "%s-%s.gem", names[i], versions[i]);
+        }
     }
 
     /* Done with solver + provider (arena freed here) */
@@ -576,7 +339,7 @@ static int auto_install(const char *gem_name, const char *constraint_str,
     /* 2. Download missing .gem files */
     char cache_dir[WOW_DIR_PATH_MAX];
     if (wow_gem_cache_dir(cache_dir, sizeof(cache_dir)) != 0) {
-        free(names); free(versions);
+        free(names); free(versions); free(files);
         wow_http_pool_cleanup(&pool);
         return -1;
     }
@@ -598,65 +361,23 @@ static int auto_install(const char *gem_name, const char *constraint_str,
     if (!specs || !results || !urls || !paths || !labels) {
         fprintf(stderr, "wowx: out of memory\n");
         free(specs); free(results); free(urls); free(paths); free(labels);
-        free(names); free(versions);
+        free(names); free(versions); free(files);
         wow_http_pool_cleanup(&pool);
         return -1;
     }
 
-    const char **platforms = detect_gem_platforms();
-    int n_plat = 0;
-    if (platforms) while (platforms[n_plat]) n_plat++;
-
-    /* Map download slot → solution index (for retry) */
-    int *dl_map = calloc((size_t)n_solved, sizeof(int));
-    if (!dl_map) {
-        free(specs); free(results); free(urls); free(paths);
-        free(labels); free(names); free(versions);
-        wow_http_pool_cleanup(&pool);
-        return -1;
-    }
-
-    /* Check cache: platform gem is preferred over generic.
-     * Only use a cached generic gem if no platform variants exist
-     * (e.g. macOS with only one platform string, or no platforms at all).
-     * A stale generic gem must not prevent us from trying to download
-     * a platform gem with pre-compiled native extensions. */
     int n_to_download = 0;
     for (int i = 0; i < n_solved; i++) {
         struct stat st;
-        int cached = 0;
-        for (int p = 0; p < n_plat && !cached; p++) {
-            char path[WOW_OS_PATH_MAX];
-            snprintf(path, sizeof(path), "%s/%s-%s-%s.gem",
-                     cache_dir, names[i], versions[i], platforms[p]);
-            if (stat(path, &st) == 0 && st.st_size > 0) cached = 1;
-        }
-        if (!cached && n_plat == 0) {
-            char path[WOW_OS_PATH_MAX];
-            snprintf(path, sizeof(path), "%s/%s-%s.gem",
-                     cache_dir, names[i], versions[i]);
-            if (stat(path, &st) == 0 && st.st_size > 0) cached = 1;
-        }
-        if (cached) continue;
+        char path[WOW_OS_PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", cache_dir, files[i]);
+        if (stat(path, &st) == 0 && st.st_size > 0) continue;
 
         int d = n_to_download;
-        dl_map[d] = i;
-
-        /* Start with first platform variant (or generic if no platforms) */
-        if (n_plat > 0) {
-            snprintf(urls[d], 512,
-                     "https://rubygems.org/downloads/%s-%s-%s.gem",
-                     names[i], versions[i], platforms[0]);
-            snprintf(paths[d], WOW_OS_PATH_MAX, "%s/%s-%s-%s.gem",
-                     cache_dir, names[i], versions[i], platforms[0]);
-        } else {
-            snprintf(urls[d], 512,
-                     "https://rubygems.org/downloads/%s-%s.gem",
-                     names[i], versions[i]);
-            snprintf(paths[d], WOW_OS_PATH_MAX, "%s/%s-%s.gem",
-                     cache_dir, names[i], versions[i]);
-        }
-        snprintf(labels[d], 256, "%s-%s.gem", names[i], versions[i]);
+        snprintf(urls[d], 512, "https://rubygems.org/downloads/%s",
+                 files[i]);
+        snprintf(paths[d], WOW_OS_PATH_MAX, "%s", path);
+        snprintf(labels[d], 256, "%s", files[i]);
 
         specs[d].url = urls[d];
         specs[d].dest_path = paths[d];
@@ -666,52 +387,6 @@ static int auto_install(const char *gem_name, const char *constraint_str,
 
     if (n_to_download > 0) {
         int ok = wow_parallel_download(specs, results, n_to_download, 0, 0);
-
-        /* Retry failures with remaining platform variants, then generic.
-         * E.g. on Linux: round 0 tried x86_64-linux-gnu, round 1 tries
-         * x86_64-linux, round 2 tries generic (no platform suffix).
-         * Pure-Ruby gems 404 on all platform variants and succeed on generic. */
-        for (int round = 1; round <= n_plat && ok < n_to_download; round++) {
-            const char *try_plat = (round < n_plat) ? platforms[round] : NULL;
-            int n_retry = 0;
-
-            for (int d = 0; d < n_to_download; d++) {
-                if (results[d].ok) continue;
-                unlink(paths[d]);
-
-                int i = dl_map[d];
-                if (try_plat) {
-                    snprintf(urls[n_retry], 512,
-                             "https://rubygems.org/downloads/%s-%s-%s.gem",
-                             names[i], versions[i], try_plat);
-                    snprintf(paths[n_retry], WOW_OS_PATH_MAX,
-                             "%s/%s-%s-%s.gem",
-                             cache_dir, names[i], versions[i], try_plat);
-                } else {
-                    snprintf(urls[n_retry], 512,
-                             "https://rubygems.org/downloads/%s-%s.gem",
-                             names[i], versions[i]);
-                    snprintf(paths[n_retry], WOW_OS_PATH_MAX,
-                             "%s/%s-%s.gem",
-                             cache_dir, names[i], versions[i]);
-                }
-                snprintf(labels[n_retry], 256, "%s-%s.gem",
-                         names[i], versions[i]);
-                specs[n_retry].url = urls[n_retry];
-                specs[n_retry].dest_path = paths[n_retry];
-                specs[n_retry].label = labels[n_retry];
-                dl_map[n_retry] = i;
-                n_retry++;
-            }
-            if (n_retry > 0) {
-                memset(results, 0,
-                       (size_t)n_retry * sizeof(wow_download_result_t));
-                ok = wow_parallel_download(specs, results, n_retry, 0, 0);
-                n_to_download = n_retry;
-            }
-        }
-
-        /* After all rounds, check for remaining failures */
         if (ok < n_to_download) {
             for (int d = 0; d < n_to_download; d++) {
                 if (!results[d].ok) {
@@ -720,15 +395,13 @@ static int auto_install(const char *gem_name, const char *constraint_str,
                     break;
                 }
             }
-            free(dl_map);
             free(specs); free(results); free(urls); free(paths);
-            free(labels); free(names); free(versions);
+            free(labels); free(names); free(versions); free(files);
             wow_http_pool_cleanup(&pool);
             return -1;
         }
     }
 
-    free(dl_map);
     free(specs); free(results); free(urls); free(paths); free(labels);
     wow_http_pool_cleanup(&pool);
 
@@ -744,6 +417,8 @@ static int auto_install(const char *gem_name, const char *constraint_str,
     snprintf(gems_base, sizeof(gems_base), "%s/gems", env);
     wow_mkdirs(gems_base, 0755);
 
+    struct wow_ext_plan ext_plan = { 0 };
+
     for (int i = 0; i < n_solved; i++) {
         /* Skip default gems when the bundled version matches the
          * resolved version — Ruby already has it, no need to unpack.
@@ -753,19 +428,8 @@ static int auto_install(const char *gem_name, const char *constraint_str,
                                     names[i], versions[i]))
             continue;
 
-        /* Find the .gem file: try each platform variant, then generic */
         char gem_path[WOW_OS_PATH_MAX];
-        struct stat gst;
-        int gem_found = 0;
-        for (int p = 0; p < n_plat && !gem_found; p++) {
-            snprintf(gem_path, sizeof(gem_path), "%s/%s-%s-%s.gem",
-                     cache_dir, names[i], versions[i], platforms[p]);
-            if (stat(gem_path, &gst) == 0 && gst.st_size > 0)
-                gem_found = 1;
-        }
-        if (!gem_found)
-            snprintf(gem_path, sizeof(gem_path), "%s/%s-%s.gem",
-                     cache_dir, names[i], versions[i]);
+        snprintf(gem_path, sizeof(gem_path), "%s/%s", cache_dir, files[i]);
 
         /* Build dest_dir from env (not gems_base) to avoid chain */
         char dest_dir[WOW_OS_PATH_MAX];
@@ -779,7 +443,8 @@ static int auto_install(const char *gem_name, const char *constraint_str,
         if (wow_gem_unpack_q(gem_path, dest_dir, 1) != 0) {
             fprintf(stderr, "wowx: failed to unpack %s-%s\n",
                     names[i], versions[i]);
-            free(names); free(versions);
+            wow_ext_plan_free(&ext_plan);
+            free(names); free(versions); free(files);
             return -1;
         }
 
@@ -788,54 +453,32 @@ static int auto_install(const char *gem_name, const char *constraint_str,
          * .executables   — binary names (wow_find_gem_binary uses these) */
         struct wow_gemspec gspec;
         if (wow_gemspec_parse(gem_path, &gspec) == 0) {
-            if (gspec.n_require_paths > 0) {
-                char rp_path[WOW_OS_PATH_MAX];
-                snprintf(rp_path, sizeof(rp_path),
-                         "%s/gems/%s-%s/.require_paths",
-                         env, names[i], versions[i]);
-                FILE *rpf = fopen(rp_path, "w");
-                if (rpf) {
-                    for (size_t r = 0; r < gspec.n_require_paths; r++)
-                        fprintf(rpf, "%s\n", gspec.require_paths[r]);
-                    fclose(rpf);
-                }
-            }
-            if (gspec.n_executables > 0) {
-                char ex_path[WOW_OS_PATH_MAX];
-                snprintf(ex_path, sizeof(ex_path),
-                         "%s/gems/%s-%s/.executables",
-                         env, names[i], versions[i]);
-                FILE *exf = fopen(ex_path, "w");
-                if (exf) {
-                    for (size_t e = 0; e < gspec.n_executables; e++)
-                        fprintf(exf, "%s\n", gspec.executables[e]);
-                    fclose(exf);
-                }
-            }
-
-            /* Native extensions: three-tier strategy.
-             * 1. Platform binary already present → skip
-             * 2. Cosmo binary (stub — future)
-             * 3. Build from source: ruby extconf.rb && make */
-            if (gspec.n_extensions > 0 && !has_native_lib(dest_dir)) {
-                for (size_t e = 0; e < gspec.n_extensions; e++) {
-                    if (build_native_extension(dest_dir, gspec.extensions[e],
-                                               ruby_bin, ruby_api) != 0) {
-                        fprintf(stderr,
-                                "wowx: native extension build failed for "
-                                "%s-%s (%s)\n",
-                                names[i], versions[i], gspec.extensions[e]);
-                        wow_gemspec_free(&gspec);
-                        free(names); free(versions);
-                        return -1;
-                    }
+            wow_gemspec_write_markers(&gspec, dest_dir);
+
+            /* Native extensions: platform binary already present,
+             * else queue for the parallel build below (which restores
+             * cached builds before compiling anything) */
+            if (gspec.n_extensions > 0 && !wow_gem_has_native_lib(dest_dir)) {
+                if (wow_ext_plan_add(&ext_plan, gem_path, dest_dir,
+                                     &gspec) != 0) {
+                    wow_ext_plan_free(&ext_plan);
+                    free(names); free(versions); free(files);
+                    return -1;
                 }
+                continue;
             }
 
             wow_gemspec_free(&gspec);
         }
     }
 
+    /* Build all queued extensions concurrently */
+    if (wow_ext_plan_run(&ext_plan, ruby_bin, ruby_api) != 0) {
+        wow_ext_plan_free(&ext_plan);
+        free(names); free(versions); free(files);
+        return -1;
+    }
+
     /* Write completion marker — without this, a partial env (from a
      * timed-out or crashed install) would be treated as a cache hit,
      * causing LoadError for missing transitive dependencies. */
@@ -846,14 +489,19 @@ static int auto_install(const char *gem_name, const char *constraint_str,
         if (mf) fclose(mf);
     }
 
+    /* Precompute load path + executable map for later launches */
+    wow_env_manifest_write(ruby_bin, ruby_version, ruby_api, env, NULL);
+
     if (colour) {
         fprintf(stderr, WOW_ANSI_GREEN WOW_ANSI_BOLD "Installed "
                 WOW_ANSI_RESET "%d packages" WOW_ANSI_RESET "\n", n_solved);
     } else {
         fprintf(stderr, "Installed %d packages\n", n_solved);
     }
+    wow_ext_plan_report(&ext_plan);
+    wow_ext_plan_free(&ext_plan);
 
-    free(names); free(versions);
+    free(names); free(versions); free(files);
     return 0;
 
 cleanup:
@@ -863,11 +511,146 @@ cleanup:
     return ret;
 }
 
+/* ── Background refresh ──────────────────────────────────────────── */
+
+#define WOWX_DEFAULT_TTL (24 * 60 * 60)
+
+/* WOWX_TTL: seconds between checks for a newer release of an unpinned
+ * tool.  0 checks on every launch; a negative value never checks. */
+static long refresh_ttl(void)
+{
+    const char *s = getenv("WOWX_TTL");
+    if (!s || !s[0]) return WOWX_DEFAULT_TTL;
+    char *end;
+    long v = strtol(s, &end, 10);
+    return *end ? WOWX_DEFAULT_TTL : v;
+}
+
+/*
+ * Freshness record: <wowx_cache>/.fresh/<gem><suffix>.  The record's
+ * mtime is the time of the last check; suffix ".log" names the log of
+ * the last background run.  Creates .fresh.  Returns 0 or -1.
+ */
+static int fresh_path(const char *wowx_cache, const char *gem_name,
+                      const char *suffix, char *buf, size_t bufsz)
+{
+    /* Bounded copies so GCC can prove the composition fits */
+    char cache[WOW_DIR_PATH_MAX];
+    snprintf(cache, sizeof(cache), "%s", wowx_cache);
+    char name[128];
+    SCOPY(name, gem_name);
+
+    char dir[WOW_OS_PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s/.fresh", cache);
+    if (wow_mkdirs(dir, 0755) != 0) return -1;
+
+    snprintf(buf, bufsz, "%s/.fresh/%s%s", cache, name, suffix);
+    return 0;
+}
+
+/* Create the record if needed and set its mtime to now */
+static int fresh_touch(const char *record)
+{
+    int fd = open(record, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    int rc = futimens(fd, NULL);
+    close(fd);
+    return rc;
+}
+
+/* Mark gem_name as just checked (after a foreground install) */
+static void refresh_mark(const char *wowx_cache, const char *gem_name)
+{
+    char record[WOW_OS_PATH_MAX];
+    if (fresh_path(wowx_cache, gem_name, "", record, sizeof(record)) == 0)
+        fresh_touch(record);
+}
+
+/*
+ * Is a check for a newer gem_name due?  If so, claim it by touching the
+ * record, so concurrent launches don't all start one and a failing
+ * check is retried after the next TTL rather than on every launch.
+ */
+static int refresh_due(const char *wowx_cache, const char *gem_name)
+{
+    long ttl = refresh_ttl();
+    if (ttl < 0) return 0;
+
+    char record[WOW_OS_PATH_MAX];
+    if (fresh_path(wowx_cache, gem_name, "", record, sizeof(record)) != 0)
+        return 0;
+
+    struct stat st;
+    if (stat(record, &st) == 0 && time(NULL) - st.st_mtime < ttl)
+        return 0;
+    return fresh_touch(record) == 0;
+}
+
+/*
+ * Resolve the newest gem_name and install it if it isn't cached yet,
+ * in a detached process: the launch that triggered it execs the cached
+ * env without waiting, and the next launch finds the new env through
+ * check_cache_latest (which ignores it until .installed is written).
+ * Output goes to <wowx_cache>/.fresh/<gem>.log.
+ */
+static void refresh_in_background(const char *wowx_cache,
+                                  const char *gem_name,
+                                  const char *ruby_api, const char *ruby_bin,
+                                  const char *ruby_version)
+{
+    char record[WOW_OS_PATH_MAX], log_path[WOW_OS_PATH_MAX];
+    if (fresh_path(wowx_cache, gem_name, "", record, sizeof(record)) != 0 ||
+        fresh_path(wowx_cache, gem_name, ".log",
+                   log_path, sizeof(log_path)) != 0)
+        return;
+
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+    if (pid < 0) return;
+    if (pid > 0) {
+        /* Reap the intermediate child; the worker is not ours */
+        while (waitpid(pid, NULL, 0) < 0 && errno == EINTR)
+            ;
+        return;
+    }
+
+    /* Intermediate child: new session, then fork the worker and exit
+     * so it is reparented and outlives the tool we are about to exec */
+    setsid();
+    pid = fork();
+    if (pid != 0) _exit(0);
+
+    /* One refresh per gem at a time: a slow install still running from
+     * an earlier launch keeps the lock */
+    int rfd = open(record, O_RDONLY | O_CLOEXEC);
+    if (rfd < 0 || flock(rfd, LOCK_EX | LOCK_NB) != 0) _exit(0);
+
+    int null_fd = open("/dev/null", O_RDWR);
+    if (null_fd >= 0) {
+        dup2(null_fd, STDIN_FILENO);
+        dup2(null_fd, STDOUT_FILENO);
+        if (null_fd > STDERR_FILENO) close(null_fd);
+    }
+    int log_fd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (log_fd >= 0) {
+        dup2(log_fd, STDERR_FILENO);
+        if (log_fd != STDERR_FILENO) close(log_fd);
+    }
+
+    char env_dir[WOW_OS_PATH_MAX];
+    int rc = auto_install(gem_name, ">= 0", ruby_api, ruby_bin,
+                          ruby_version, 1, env_dir, sizeof(env_dir));
+    _exit(rc == 0 ? 0 : 1);
+}
+
 /* ── Main ────────────────────────────────────────────────────────── */
 
 int main(int argc, char *argv[])
 {
     ShowCrashReports();
+    wow_trace_init();
 
     if (argc < 2 || strcmp(argv[1], "--help") == 0 ||
         strcmp(argv[1], "-h") == 0) {
@@ -1029,17 +812,29 @@ int main(int argc, char *argv[])
             int found;
             if (pin_version[0])
                 found = check_cache_pinned(wowx_cache, gem_name, pin_version,
-                                           binary_name, env_dir,
-                                           sizeof(env_dir), exe_path,
-                                           sizeof(exe_path));
+                                           env_dir, sizeof(env_dir));
             else
-                found = check_cache_latest(wowx_cache, gem_name, binary_name,
-                                           env_dir, sizeof(env_dir),
-                                           exe_path, sizeof(exe_path));
-
-            if (found == 0)
-                return wow_exec_gem_binary(ruby_bin, ruby_api, env_dir, exe_path,
-                               user_argc, user_argv);
+                found = check_cache_latest(wowx_cache, gem_name,
+                                           env_dir, sizeof(env_dir));
+
+            if (found == 0) {
+                /* Unpinned: serve the cached env now, look for a newer
+                 * release behind it once the record is stale */
+                if (!pin_version[0] && refresh_due(wowx_cache, gem_name))
+                    refresh_in_background(wowx_cache, gem_name, ruby_api,
+                                          ruby_bin, ruby_ver);
+
+                /* Precomputed environment: straight to execve */
+                int mrc = wow_env_manifest_exec(ruby_bin, ruby_ver, env_dir,
+                                                NULL, gem_name, binary_name,
+                                                user_argc, user_argv);
+                if (mrc != -1) return mrc;
+
+                if (wow_find_gem_binary(env_dir, gem_name, binary_name,
+                                        exe_path, sizeof(exe_path)) == 0)
+                    return wow_exec_gem_binary(ruby_bin, ruby_api, env_dir,
+                                   exe_path, user_argc, user_argv);
+            }
         }
     }
 
@@ -1053,9 +848,17 @@ int main(int argc, char *argv[])
 
         char env_dir[WOW_OS_PATH_MAX];
         if (auto_install(gem_name, cs_str, ruby_api, ruby_bin,
-                         ruby_ver, env_dir, sizeof(env_dir)) != 0)
+                         ruby_ver, 0, env_dir, sizeof(env_dir)) != 0)
             return 1;
 
+        /* A fresh unpinned install is as new as a background check */
+        if (!pin_version[0]) {
+            char wowx_cache[WOW_DIR_PATH_MAX];
+            if (wow_wowx_cache_dir(ruby_api, wowx_cache,
+                                   sizeof(wowx_cache)) == 0)
+                refresh_mark(wowx_cache, gem_name);
+        }
+
         /* Resolve binary name from gemspec (handles gems where
          * the executable name differs from the gem name, e.g.
          * haml_lint gem → haml-lint binary). */
@@ -0,0 +1,44 @@
+#!/bin/bash
+# record.sh — capture compact index data for the resolver bench corpus
+#
+# Runs `wow lock --update` on every non-synthetic case with
+# WOW_CI_RECORD pointing at index/, so each /info response the
+# resolver fetches is saved as index/info/<gem>.  Afterwards
+# `make bench-resolve` replays the corpus without network access.
+#
+# Usage:
+#   ./tests/bench/resolve/record.sh [CASE...]
+#
+# Requires: build/wow.com and network access to rubygems.org.
+
+set -euo pipefail
+
+CORPUS="$(cd "$(dirname "$0")" && pwd)"
+ROOT="$(cd "$CORPUS/../../.." && pwd)"
+WOW="${WOW:-$ROOT/build/wow.com}"
+
+if [ $# -eq 0 ]; then
+    set -- $(ls "$CORPUS/cases")
+fi
+
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+for name in "$@"; do
+    gemfile="$CORPUS/cases/$name/Gemfile"
+    [ -f "$gemfile" ] || { echo "no such case: $name" >&2; exit 2; }
+
+    # Synthetic cases use made-up gems that only exist in index/
+    if head -1 "$gemfile" | grep -q '^# Synthetic'; then
+        echo "── $name: synthetic, skipped"
+        continue
+    fi
+
+    echo "── $name"
+    mkdir -p "$WORK/$name"
+    cp "$gemfile" "$WORK/$name/Gemfile"
+    (cd "$WORK/$name" && WOW_CI_RECORD="$CORPUS/index" "$WOW" lock --update)
+done
+
+echo
+echo "Recorded $(ls "$CORPUS/index/info" | wc -l) packages in $CORPUS/index"
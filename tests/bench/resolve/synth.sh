@@ -0,0 +1,75 @@
+#!/bin/bash
+# synth.sh — generate the synthetic-wide case of the resolver bench corpus
+#
+# Stands in for the GitLab-scale case until real index data is recorded:
+# 400 made-up sw-* gems with 6 releases each, laid out as a DAG (a gem
+# only depends on higher-numbered ones).  Newer releases raise their
+# dependency floors and about one dependency in ten carries an upper
+# cap, so the solver has to reject and revisit releases; every 1.0.0
+# release satisfies every constraint, so the case always resolves.
+#
+# The output is deterministic (a fixed LCG, not awk's rand()), so the
+# decision count stays comparable across machines and re-runs.
+#
+# Usage:
+#   ./tests/bench/resolve/synth.sh
+#
+# Writes index/info/sw-* and cases/synthetic-wide/Gemfile.
+
+set -euo pipefail
+
+CORPUS="$(cd "$(dirname "$0")" && pwd)"
+N_GEMS=400
+N_ROOTS=12
+
+rm -f "$CORPUS"/index/info/sw-*
+mkdir -p "$CORPUS/index/info" "$CORPUS/cases/synthetic-wide"
+
+awk -v n="$N_GEMS" -v roots="$N_ROOTS" -v info="$CORPUS/index/info" \
+    -v gemfile="$CORPUS/cases/synthetic-wide/Gemfile" '
+function rnd(m) { seed = (seed * 1103515245 + 12345) % 2147483648
+                  return int(seed / 65536) % m }
+function gem(i) { return sprintf("sw-%03d", i) }
+BEGIN {
+    seed = 42
+    for (i = 0; i < n; i++) {
+        # One dependency set per gem, as real gems rarely change theirs
+        nd = (i + 1 < n) ? 1 + rnd(4) : 0
+        if (nd > n - 1 - i) nd = n - 1 - i
+        for (d = 0; d < nd; d++) {
+            do {
+                j = i + 1 + rnd(n - 1 - i < 40 ? n - 1 - i : 40)
+                dup = 0
+                for (e = 0; e < d; e++) if (dep[e] == j) dup = 1
+            } while (dup)
+            dep[d] = j
+            cap[d] = rnd(10) == 0 ? 1 + rnd(5) : 0
+        }
+
+        out = info "/" gem(i)
+        print "---" > out
+        for (k = 0; k <= 5; k++) {
+            line = "1." k ".0 "
+            for (d = 0; d < nd; d++) {
+                floor = rnd(k + 1)
+                c = gem(dep[d]) ":"
+                if (cap[d] && floor < cap[d])
+                    c = c "< 1." cap[d] "&>= 1." floor
+                else
+                    c = c ">= 1." floor
+                line = line (d ? "," : "") c
+            }
+            print line "|" > out
+        }
+        close(out)
+    }
+
+    print "# Synthetic: 400 generated gems with capped dependencies, a" > gemfile
+    print "# stand-in for the GitLab-scale case (regenerate with synth.sh)." > gemfile
+    print "source \"https://rubygems.org\"" > gemfile
+    print "" > gemfile
+    for (r = 0; r < roots; r++)
+        print "gem \"" gem(r * 3) "\"" > gemfile
+}'
+
+echo "Generated $N_GEMS gems in $CORPUS/index/info"
@@ -0,0 +1,99 @@
+#!/bin/bash
+# shim_overhead.sh — cost of the ruby shim vs. invoking Ruby directly
+#
+# Runs `ruby -e ''` N times three ways and reports mean wall time per
+# invocation:
+#
+#   direct   — the managed Ruby binary itself
+#   shim     — the wow shim, cold (.ruby-version walk every time)
+#   cached   — the wow shim with WOW_SHIM_CACHE inherited, as a Ruby
+#              process spawning ruby would see it
+#
+# Usage:
+#   ./tests/bench/shim_overhead.sh [-n ITERATIONS] [--ruby VERSION]
+#
+# Requires: build/wow.com, at least one Ruby installed via
+# `wow rubies install`.
+
+set -euo pipefail
+
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+ROOT="$(cd "$SCRIPT_DIR/../.." && pwd)"
+WOW="${WOW:-$ROOT/build/wow.com}"
+
+# ── Options ───────────────────────────────────────────────────────────
+
+ITERATIONS=200
+RUBY_VERSION=""
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        -n)      ITERATIONS="$2"; shift 2 ;;
+        --ruby)  RUBY_VERSION="$2"; shift 2 ;;
+        *)       echo "usage: $0 [-n ITERATIONS] [--ruby VERSION]" >&2; exit 2 ;;
+    esac
+done
+
+# ── Setup ─────────────────────────────────────────────────────────────
+
+RUBIES="${XDG_DATA_HOME:-$HOME/.local/share}/wow/rubies"
+
+if [ -z "$RUBY_VERSION" ]; then
+    RUBY_VERSION="$(ls "$RUBIES" 2>/dev/null | grep -E '^[0-9]' | sort -V | tail -1 || true)"
+fi
+RUBY_BIN="$RUBIES/$RUBY_VERSION/bin/ruby"
+if [ -z "$RUBY_VERSION" ] || [ ! -x "$RUBY_BIN" ]; then
+    echo "error: no installed Ruby found (run: wow rubies install 3.3)" >&2
+    exit 1
+fi
+[ -x "$WOW" ] || { echo "error: $WOW not built (run: make)" >&2; exit 1; }
+
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+# Shim lives in a bin dir; .ruby-version a few levels above the cwd
+# so the cold path has a realistic walk.
+mkdir -p "$WORK/bin" "$WORK/project/app/models/concerns"
+ln "$WOW" "$WORK/bin/ruby" 2>/dev/null || cp "$WOW" "$WORK/bin/ruby"
+echo "$RUBY_VERSION" > "$WORK/project/.ruby-version"
+cd "$WORK/project/app/models/concerns"
+
+# Warm the APE loader / page cache once
+"$WORK/bin/ruby" -e '' >/dev/null
+
+# ── Timing ────────────────────────────────────────────────────────────
+
+now_ns() { date +%s%N; }
+
+bench() {
+    local t0 t1
+    t0=$(now_ns)
+    for ((i = 0; i < ITERATIONS; i++)); do
+        "$@" -e '' >/dev/null
+    done
+    t1=$(now_ns)
+    echo $(( (t1 - t0) / ITERATIONS ))
+}
+
+unset WOW_SHIM_CACHE
+direct_ns=$(bench "$RUBY_BIN")
+shim_ns=$(bench "$WORK/bin/ruby")
+
+# Capture the entry the shim exports to its child, then reuse it
+export WOW_SHIM_CACHE="$("$WORK/bin/ruby" -e 'print ENV["WOW_SHIM_CACHE"]')"
+cached_ns=$(bench "$WORK/bin/ruby")
+
+# ── Report ────────────────────────────────────────────────────────────
+
+ms() { awk -v ns="$1" 'BEGIN { printf "%.3f", ns / 1e6 }'; }
+
+echo "Ruby $RUBY_VERSION, $ITERATIONS iterations, cwd 3 levels below .ruby-version"
+printf "  %-8s %9s ms/op\n" "direct" "$(ms "$direct_ns")"
+printf "  %-8s %9s ms/op  (+%s ms)\n" "shim" "$(ms "$shim_ns")" \
+       "$(ms $((shim_ns - direct_ns)))"
+if [ -n "$WOW_SHIM_CACHE" ]; then
+    printf "  %-8s %9s ms/op  (+%s ms)\n" "cached" "$(ms "$cached_ns")" \
+           "$(ms $((cached_ns - direct_ns)))"
+else
+    echo "  cached   (no WOW_SHIM_CACHE exported — cache not populated)"
+fi
@@ -0,0 +1,412 @@
+#!/usr/bin/env python3
+"""
+bench_sync.py — end-to-end `wow sync` benchmark against a local registry
+
+Serves a mirror built by mirror.sh (info/<gem>, gems/<file>.gem,
+versions) over plain HTTP on 127.0.0.1 and runs each case's Gemfile
+through three scenarios:
+
+  cold   empty gem cache, nothing installed
+  warm   gem cache populated, nothing installed
+  noop   everything installed; sync should do nothing
+
+Every scenario starts from a Gemfile.lock made against the mirror
+(untimed), so resolution is the same for every run. With --bundler the
+same scenarios are run with `bundle install` for comparison.
+
+Per run it records wall time, user/system CPU and peak RSS (wait4
+rusage of the child and everything it waited for), plus requests and
+bytes the registry served. With strace on PATH, one extra run per
+scenario counts syscalls (-f, so download and build threads and
+children are included); that run is not timed.
+
+Results are appended to a JSON Lines file (default
+build/bench-sync.jsonl), one object per invocation, for trend tracking.
+
+Usage:
+  python3 tests/bench/sync/bench_sync.py [-n N] [--bundler] [CASE...]
+"""
+
+import argparse
+import datetime
+import http.server
+import json
+import os
+import platform
+import re
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.abspath(os.path.join(BENCH_DIR, "..", "..", ".."))
+SCENARIOS = ("cold", "warm", "noop")
+PROXY_VARS = ("http_proxy", "https_proxy", "all_proxy",
+              "HTTP_PROXY", "HTTPS_PROXY", "ALL_PROXY")
+
+
+# ── Local registry ───────────────────────────────────────────────────
+
+class CountingWriter:
+    """Wraps a handler's wfile and counts every byte sent."""
+
+    def __init__(self, inner, server):
+        self.inner = inner
+        self.server = server
+
+    def write(self, data):
+        self.server.count(len(data))
+        return self.inner.write(data)
+
+    def __getattr__(self, name):
+        return getattr(self.inner, name)
+
+
+class RegistryHandler(http.server.BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"   # keep-alive, as rubygems.org does
+
+    def setup(self):
+        super().setup()
+        self.wfile = CountingWriter(self.wfile, self.server)
+
+    def resolve(self, path):
+        path = path.split("?", 1)[0]
+        if path == "/versions":
+            return os.path.join(self.server.mirror, "versions")
+        for prefix, sub in (("/info/", "info"), ("/gems/", "gems"),
+                            ("/downloads/", "gems")):
+            if path.startswith(prefix):
+                name = path[len(prefix):]
+                if not name or "/" in name or name.startswith("."):
+                    return None
+                return os.path.join(self.server.mirror, sub, name)
+        return None
+
+    def do_GET(self):
+        self.server.request()
+        path = self.resolve(self.path)
+        try:
+            with open(path, "rb") as f:
+                body = f.read()
+        except (TypeError, OSError):
+            self.send_error(404)
+            return
+        self.send_response(200)
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_message(self, fmt, *args):
+        pass
+
+
+class Registry(http.server.ThreadingHTTPServer):
+    daemon_threads = True
+
+    def __init__(self, mirror):
+        super().__init__(("127.0.0.1", 0), RegistryHandler)
+        self.mirror = mirror
+        self.lock = threading.Lock()
+        self.requests = 0
+        self.bytes = 0
+
+    @property
+    def url(self):
+        return "http://127.0.0.1:%d" % self.server_address[1]
+
+    def request(self):
+        with self.lock:
+            self.requests += 1
+
+    def count(self, n):
+        with self.lock:
+            self.bytes += n
+
+    def snapshot(self):
+        with self.lock:
+            return self.requests, self.bytes
+
+
+# ── Measurement ──────────────────────────────────────────────────────
+
+def run(cmd, cwd, env, log):
+    """Run cmd; return (ok, wall, user, sys, max_rss_kb)."""
+    with open(log, "ab") as out:
+        t0 = time.monotonic()
+        p = subprocess.Popen(cmd, cwd=cwd, env=env, stdin=subprocess.DEVNULL,
+                             stdout=out, stderr=out)
+        _, status, ru = os.wait4(p.pid, 0)
+        wall = time.monotonic() - t0
+    p.returncode = os.waitstatus_to_exitcode(status)
+    rss = ru.ru_maxrss
+    if sys.platform == "darwin":
+        rss //= 1024                    # bytes there, KiB on Linux
+    return p.returncode == 0, wall, ru.ru_utime, ru.ru_stime, rss
+
+
+def count_syscalls(cmd, cwd, env, log):
+    """Total syscalls made by cmd and its threads/children, or None."""
+    strace = shutil.which("strace")
+    if not strace:
+        return None
+    summary = log + ".strace"
+    with open(log, "ab") as out:
+        rc = subprocess.call([strace, "-f", "-c", "-o", summary] + cmd,
+                             cwd=cwd, env=env, stdin=subprocess.DEVNULL,
+                             stdout=out, stderr=out)
+    if rc != 0 or not os.path.exists(summary):
+        return None
+    total = 0
+    with open(summary) as f:
+        for line in f:
+            fields = line.split()
+            # "% time  seconds  usecs/call  calls  [errors]  syscall"
+            if len(fields) >= 5 and fields[-1] != "total" and \
+                    fields[3].isdigit():
+                total += int(fields[3])
+    return total
+
+
+# ── Tools ────────────────────────────────────────────────────────────
+
+class Tool:
+    """How one installer is set up, reset and run in a work directory."""
+
+    def __init__(self, name, argv, lock_argv, cache_env):
+        self.name = name
+        self.argv = argv
+        self.lock_argv = lock_argv
+        self.cache_env = cache_env      # env var -> subdir of cache
+
+    def env(self, base_env, cache):
+        env = dict(base_env)
+        for var, sub in self.cache_env.items():
+            env[var] = os.path.join(cache, sub)
+        if self.name == "bundler":
+            env["BUNDLE_PATH"] = "vendor/bundle"
+            env["BUNDLE_GLOBAL_GEM_CACHE"] = "true"
+        return env
+
+
+def wow_tool(wow):
+    return Tool("wow", [wow, "sync"], [wow, "lock"],
+                {"XDG_CACHE_HOME": "xdg"})
+
+
+def bundler_tool(bundle):
+    return Tool("bundler", [bundle, "install"], [bundle, "lock"],
+                {"BUNDLE_USER_HOME": "home", "BUNDLE_USER_CACHE": "cache"})
+
+
+def latest_ruby():
+    data = os.environ.get("XDG_DATA_HOME",
+                          os.path.expanduser("~/.local/share"))
+    rubies = os.path.join(data, "wow", "rubies")
+    try:
+        vers = [v for v in os.listdir(rubies) if v[:1].isdigit()]
+    except OSError:
+        return None, None
+    if not vers:
+        return None, None
+    vers.sort(key=lambda v: [int(x) if x.isdigit() else -1
+                             for x in re.split(r"[.-]", v)])
+    return vers[-1], os.path.join(rubies, vers[-1])
+
+
+# ── Scenarios ────────────────────────────────────────────────────────
+
+def prepare_case(case, tool, registry, ruby, work, base_env):
+    """Fresh project directory with a lockfile made against the mirror."""
+    proj = os.path.join(work, "%s-%s" % (tool.name, case))
+    cache = os.path.join(work, "%s-%s-cache" % (tool.name, case))
+    shutil.rmtree(proj, ignore_errors=True)
+    shutil.rmtree(cache, ignore_errors=True)
+    os.makedirs(proj)
+
+    with open(os.path.join(BENCH_DIR, "cases", case, "Gemfile")) as f:
+        gemfile = f.read()
+    gemfile = re.sub(r"""^source\s+["'][^"']*["']""",
+                     'source "%s"' % registry.url, gemfile, flags=re.M)
+    with open(os.path.join(proj, "Gemfile"), "w") as f:
+        f.write(gemfile)
+    with open(os.path.join(proj, ".ruby-version"), "w") as f:
+        f.write(ruby + "\n")
+
+    env = tool.env(base_env, cache)
+    log = os.path.join(work, "%s-%s.log" % (tool.name, case))
+    ok = run(tool.lock_argv, proj, env, log)[0]
+    return proj, cache, env, log, ok
+
+
+def reset(scenario, tool, proj, cache, env, log):
+    """Put proj/cache into the state the scenario starts from."""
+    vendor = os.path.join(proj, "vendor")
+    if scenario == "cold":
+        shutil.rmtree(vendor, ignore_errors=True)
+        shutil.rmtree(cache, ignore_errors=True)
+        return True
+    have_cache = os.path.isdir(cache) and any(os.scandir(cache))
+    if scenario == "warm":
+        if not have_cache:
+            run(tool.argv, proj, env, log)
+        shutil.rmtree(vendor, ignore_errors=True)
+        return True
+    if not os.path.isdir(vendor):
+        return run(tool.argv, proj, env, log)[0]
+    return True
+
+
+def bench_scenario(case, scenario, tool, proj, cache, env, log, registry, n):
+    runs = []
+    for _ in range(n):
+        reset(scenario, tool, proj, cache, env, log)
+        r0, b0 = registry.snapshot()
+        ok, wall, user, sys_, rss = run(tool.argv, proj, env, log)
+        r1, b1 = registry.snapshot()
+        runs.append(dict(ok=ok, wall=wall, user=user, sys=sys_, rss=rss,
+                         requests=r1 - r0, bytes=b1 - b0))
+        if not ok:
+            break
+
+    syscalls = None
+    if all(r["ok"] for r in runs):
+        reset(scenario, tool, proj, cache, env, log)
+        syscalls = count_syscalls(tool.argv, proj, env, log)
+
+    med = lambda k: statistics.median(r[k] for r in runs)
+    return {
+        "case": case,
+        "tool": tool.name,
+        "scenario": scenario,
+        "ok": all(r["ok"] for r in runs),
+        "runs": len(runs),
+        "wall_secs": round(med("wall"), 4),
+        "user_secs": round(med("user"), 4),
+        "sys_secs": round(med("sys"), 4),
+        "cpu_secs": round(med("user") + med("sys"), 4),
+        "max_rss_kb": max(r["rss"] for r in runs),
+        "requests": int(med("requests")),
+        "bytes": int(med("bytes")),
+        "syscalls": syscalls,
+    }
+
+
+def tail(path, n=20):
+    try:
+        with open(path, errors="replace") as f:
+            return "".join(f.readlines()[-n:])
+    except OSError:
+        return ""
+
+
+# ── Main ─────────────────────────────────────────────────────────────
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    ap.add_argument("cases", nargs="*", help="cases (default: all)")
+    ap.add_argument("-n", type=int, default=3,
+                    help="timed runs per scenario (default 3)")
+    ap.add_argument("--wow", default=os.path.join(ROOT, "build", "wow.com"))
+    ap.add_argument("--mirror",
+                    default=os.path.join(ROOT, "build", "bench-sync-mirror"))
+    ap.add_argument("--results",
+                    default=os.path.join(ROOT, "build", "bench-sync.jsonl"))
+    ap.add_argument("--ruby", help="Ruby version (default: latest installed)")
+    ap.add_argument("--bundler", action="store_true",
+                    help="also run the scenarios with bundle install")
+    ap.add_argument("--scenario", action="append", choices=SCENARIOS,
+                    help="run only this scenario (repeatable)")
+    args = ap.parse_args()
+
+    if not os.access(args.wow, os.X_OK):
+        sys.exit("error: %s not built (run: make)" % args.wow)
+    if not os.path.exists(os.path.join(args.mirror, "versions")):
+        sys.exit("error: no mirror at %s (run: make bench-sync-mirror)"
+                 % args.mirror)
+
+    ruby, ruby_prefix = latest_ruby()
+    if args.ruby:
+        ruby = args.ruby
+        ruby_prefix = ruby_prefix and os.path.join(
+            os.path.dirname(ruby_prefix), ruby)
+    if not ruby:
+        sys.exit("error: no installed Ruby found (run: wow rubies install 3.3)")
+
+    tools = [wow_tool(os.path.abspath(args.wow))]
+    if args.bundler:
+        bundle = ruby_prefix and os.path.join(ruby_prefix, "bin", "bundle")
+        if not bundle or not os.access(bundle, os.X_OK):
+            bundle = shutil.which("bundle")
+        if not bundle:
+            sys.exit("error: --bundler needs bundle (in the Ruby or on PATH)")
+        tools.append(bundler_tool(bundle))
+
+    cases = args.cases or sorted(os.listdir(os.path.join(BENCH_DIR, "cases")))
+    scenarios = args.scenario or SCENARIOS
+
+    base_env = {k: v for k, v in os.environ.items() if k not in PROXY_VARS}
+    base_env["NO_COLOR"] = "1"
+    if ruby_prefix:
+        base_env["PATH"] = os.path.join(ruby_prefix, "bin") + os.pathsep + \
+            base_env.get("PATH", "")
+
+    wow_version = subprocess.run([args.wow, "--version"], capture_output=True,
+                                 text=True).stdout.strip()
+
+    registry = Registry(os.path.abspath(args.mirror))
+    threading.Thread(target=registry.serve_forever, daemon=True).start()
+
+    results = []
+    failed = False
+    print("%-14s %-8s %-5s %9s %9s %10s %6s %10s %9s" %
+          ("case", "tool", "scen", "wall s", "cpu s", "rss KiB", "reqs",
+           "bytes", "syscalls"))
+    with tempfile.TemporaryDirectory(prefix="wow-bench-sync-") as work:
+        for case in cases:
+            for tool in tools:
+                proj, cache, env, log, ok = prepare_case(
+                    case, tool, registry, ruby, work, base_env)
+                if not ok:
+                    print("%-14s %-8s lock failed:\n%s" %
+                          (case, tool.name, tail(log)))
+                    failed = True
+                    continue
+                for scenario in scenarios:
+                    r = bench_scenario(case, scenario, tool, proj, cache,
+                                       env, log, registry, args.n)
+                    results.append(r)
+                    print("%-14s %-8s %-5s %9.3f %9.3f %10d %6d %10d %9s%s" %
+                          (case, tool.name, scenario, r["wall_secs"],
+                           r["cpu_secs"], r["max_rss_kb"], r["requests"],
+                           r["bytes"],
+                           "-" if r["syscalls"] is None else r["syscalls"],
+                           "" if r["ok"] else "  FAILED"))
+                    if not r["ok"]:
+                        print(tail(log))
+                        failed = True
+    registry.shutdown()
+
+    record = {
+        "timestamp": datetime.datetime.now(datetime.timezone.utc)
+                     .isoformat(timespec="seconds"),
+        "host": platform.node(),
+        "machine": platform.machine(),
+        "system": platform.system(),
+        "wow": wow_version,
+        "ruby": ruby,
+        "runs_per_scenario": args.n,
+        "results": results,
+    }
+    os.makedirs(os.path.dirname(os.path.abspath(args.results)), exist_ok=True)
+    with open(args.results, "a") as f:
+        f.write(json.dumps(record) + "\n")
+    print("\nresults appended to %s" % args.results)
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,86 @@
+#!/bin/bash
+# mirror.sh — build the local registry used by the sync benchmark
+#
+# For every case, locks the Gemfile against rubygems.org with
+# WOW_CI_RECORD pointing at the mirror (so each /info body the resolver
+# fetches is saved as <mirror>/info/<gem>), then downloads every locked
+# .gem into <mirror>/gems/.  Finally writes <mirror>/versions so Bundler's
+# compact index client can use the mirror too.
+#
+# Afterwards bench_sync.py serves the mirror over local HTTP and no
+# network is needed.
+#
+# Usage:
+#   ./tests/bench/sync/mirror.sh [--mirror DIR] [CASE...]
+#
+# Requires: build/wow.com, curl, an installed Ruby (for .ruby-version),
+# and network access to rubygems.org.
+
+set -euo pipefail
+
+BENCH="$(cd "$(dirname "$0")" && pwd)"
+ROOT="$(cd "$BENCH/../../.." && pwd)"
+WOW="${WOW:-$ROOT/build/wow.com}"
+MIRROR="$ROOT/build/bench-sync-mirror"
+UPSTREAM="https://rubygems.org"
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --mirror) MIRROR="$2"; shift 2 ;;
+        -*)       echo "usage: $0 [--mirror DIR] [CASE...]" >&2; exit 2 ;;
+        *)        break ;;
+    esac
+done
+
+if [ $# -eq 0 ]; then
+    set -- $(ls "$BENCH/cases")
+fi
+
+[ -x "$WOW" ] || { echo "error: $WOW not built (run: make)" >&2; exit 1; }
+
+RUBIES="${XDG_DATA_HOME:-$HOME/.local/share}/wow/rubies"
+RUBY_VERSION="$(ls "$RUBIES" 2>/dev/null | grep -E '^[0-9]' | sort -V | tail -1 || true)"
+if [ -z "$RUBY_VERSION" ]; then
+    echo "error: no installed Ruby found (run: wow rubies install 3.3)" >&2
+    exit 1
+fi
+
+mkdir -p "$MIRROR/info" "$MIRROR/gems"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+
+for name in "$@"; do
+    gemfile="$BENCH/cases/$name/Gemfile"
+    [ -f "$gemfile" ] || { echo "no such case: $name" >&2; exit 2; }
+
+    echo "── $name"
+    mkdir -p "$WORK/$name"
+    cp "$gemfile" "$WORK/$name/Gemfile"
+    echo "$RUBY_VERSION" > "$WORK/$name/.ruby-version"
+    (cd "$WORK/$name" && WOW_CI_RECORD="$MIRROR" "$WOW" lock --update)
+
+    # Locked specs sit at four spaces: "    name (version[-platform])"
+    sed -n 's/^    \([^ ]*\) (\([^)]*\))$/\1-\2.gem/p' \
+        "$WORK/$name/Gemfile.lock" | sort -u |
+    while read -r file; do
+        [ -s "$MIRROR/gems/$file" ] && continue
+        echo "   $file"
+        curl -fsSL -o "$MIRROR/gems/$file.tmp" "$UPSTREAM/gems/$file"
+        mv "$MIRROR/gems/$file.tmp" "$MIRROR/gems/$file"
+    done
+done
+
+# /versions: "name v1,v2,... md5(info)" for each mirrored gem
+{
+    echo "created_at: $(date -u +%Y-%m-%dT%H:%M:%SZ)"
+    echo "---"
+    for info in "$MIRROR"/info/*; do
+        gem="$(basename "$info")"
+        vers="$(sed -n '/^---$/,$p' "$info" | sed '1d' | cut -d' ' -f1 |
+                paste -sd, -)"
+        echo "$gem $vers $(md5sum "$info" | cut -d' ' -f1)"
+    done
+} > "$MIRROR/versions"
+
+echo "mirror: $MIRROR ($(ls "$MIRROR/info" | wc -l) gems indexed," \
+     "$(ls "$MIRROR/gems" | wc -l) .gem files)"
@@ -2,8 +2,11 @@
  * tests/gem_test.c — Gem infrastructure tests
  *
  * Offline tests: plain tar read/extract, tar_read_entry, tar_list,
- * tar_extract_entry_to_fd, SHA-256 verification, gunzip round-trip,
- * and gemspec YAML parsing.
+ * tar_extract_entry_to_fd, SHA-256 verification (every backend the CPU
+ * supports, plus batch hashing), gunzip round-trip, gemspec YAML parsing,
+ * gem cache verification, the install manifest (.wow-installed), and
+ * the require index against a live $LOAD_PATH (skipped without a Ruby
+ * on PATH).
  *
  * All fixtures are embedded — no network access or curl required.
  *
@@ -22,8 +25,13 @@
 #include <third_party/zlib/zlib.h>
 #include <third_party/mbedtls/sha256.h>
 
+#include "wow/exec.h"
 #include "wow/tar.h"
+#include "wow/gems/installed.h"
 #include "wow/gems/meta.h"
+#include "wow/gems/verify.h"
+#include "wow/util/path.h"
+#include "wow/util/sha256.h"
 
 /* Composite path buffer */
 #define TPATH (PATH_MAX + 256)
@@ -425,6 +433,90 @@ static void test_sha256(void) {
     rm_rf(tmpdir);
 }
 
+static void test_sha256_backends(void) {
+    printf("\n[Test] SHA-256 backends...\n");
+
+    static uint8_t data[100000];
+    for (size_t i = 0; i < sizeof(data); i++)
+        data[i] = (uint8_t)(i * 2654435761u >> 13);
+
+    static const size_t lens[] = { 0, 1, 55, 56, 63, 64, 65, 119, 120,
+                                   128, 1000, 4097, sizeof(data) };
+    static const char *names[] = { "sha-ni", "armv8", "portable" };
+    const char *orig = wow_sha256_backend();
+
+    for (size_t b = 0; b < sizeof(names) / sizeof(names[0]); b++) {
+        if (wow_sha256_set_backend(names[b]) != 0) continue;
+        int ok = 1;
+        for (size_t i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+            size_t len = lens[i];
+            uint8_t d[32];
+            char want[65], got[65];
+            mbedtls_sha256_ret(data, len, d, 0);
+            for (int k = 0; k < 32; k++)
+                snprintf(want + k * 2, 3, "%02x", d[k]);
+
+            /* Odd-sized updates cross the 64-byte block buffer */
+            wow_sha256_ctx *h = wow_sha256_new();
+            for (size_t off = 0; off < len; off += 37)
+                wow_sha256_update(h, data + off, len - off < 37 ? len - off : 37);
+            wow_sha256_final(h, got, sizeof(got));
+            wow_sha256_free(h);
+            if (strcmp(want, got) != 0) ok = 0;
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "%s matches mbedTLS", names[b]);
+        check(name, ok);
+    }
+    wow_sha256_set_backend(orig);
+}
+
+static void test_sha256_files(void) {
+    printf("\n[Test] SHA-256 batch hashing...\n");
+
+    char tmpdir[] = "/tmp/wow-test-shab-XXXXXX";
+    if (!mkdtemp(tmpdir)) { check("mkdtemp", 0); return; }
+
+    char path[TPATH];
+    snprintf(path, sizeof(path), "%s/data.bin", tmpdir);
+    const char *content = "0123456789abcdef";
+    FILE *f = fopen(path, "wb");
+    if (f) {
+        for (int i = 0; i < 1000; i++) fputs(content, f);
+        fclose(f);
+    }
+
+    struct wow_sha256_job jobs[4];
+    memset(jobs, 0, sizeof(jobs));
+    for (int i = 0; i < 4; i++) jobs[i].path = path;
+    jobs[0].length = -1;                        /* whole file        */
+    jobs[1].offset = 16; jobs[1].length = 16;   /* one copy          */
+    jobs[2].length = 0;                         /* empty range       */
+    jobs[3].offset = 15990; jobs[3].length = 20; /* past EOF         */
+
+    int failed = wow_sha256_files(jobs, 4, 3);
+    check("one job failed", failed == 1);
+
+    char whole[65];
+    check("whole-file job matches wow_sha256_file",
+          wow_sha256_file(path, whole, sizeof(whole)) == 0 &&
+          strcmp(jobs[0].hex, whole) == 0);
+
+    wow_sha256_ctx *h = wow_sha256_new();
+    wow_sha256_update(h, content, 16);
+    char part[65];
+    wow_sha256_final(h, part, sizeof(part));
+    wow_sha256_free(h);
+    check("range job hashes only its bytes", strcmp(jobs[1].hex, part) == 0);
+    check("empty range is the empty digest",
+          strcmp(jobs[2].hex, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b93"
+                              "4ca495991b7852b855") == 0);
+    check("range past EOF reports EIO", jobs[3].err == EIO &&
+          jobs[3].hex[0] == '\0');
+
+    rm_rf(tmpdir);
+}
+
 /* ── Gunzip round-trip tests ─────────────────────────────────── */
 
 static void test_gunzip_roundtrip(void) {
@@ -622,6 +714,318 @@ static void test_gem_cache_dir(void) {
     }
 }
 
+/* ── Gem cache verification ──────────────────────────────────── */
+
+static void sha256_hex(const void *data, size_t len, char out[65]) {
+    wow_sha256_ctx *h = wow_sha256_new();
+    wow_sha256_update(h, data, len);
+    wow_sha256_final(h, out, 65);
+    wow_sha256_free(h);
+}
+
+/* Write a gzip file holding text; return its bytes (malloc'd) */
+static uint8_t *gzip_text(const char *path, const char *text, size_t *len) {
+    gzFile gz = gzopen(path, "wb");
+    if (!gz) return NULL;
+    gzwrite(gz, text, (unsigned)strlen(text));
+    gzclose(gz);
+
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    uint8_t *buf = malloc(4096);
+    *len = buf ? fread(buf, 1, 4096, f) : 0;
+    fclose(f);
+    return buf;
+}
+
+static void test_gem_verify(void) {
+    printf("\n[Test] Gem cache verification...\n");
+
+    char tmpdir[] = "/tmp/wow-test-verify-XXXXXX";
+    if (!mkdtemp(tmpdir)) { check("mkdtemp", 0); return; }
+
+    const char *meta = "--- !ruby/object:Gem::Specification\nname: demo\n";
+    const char *data = "pretend this is data.tar.gz";
+    char meta_hex[65], data_hex[65];
+    sha256_hex(meta, strlen(meta), meta_hex);
+    sha256_hex(data, strlen(data), data_hex);
+
+    char yaml[512];
+    snprintf(yaml, sizeof(yaml),
+             "---\nSHA256:\n  metadata.gz: %s\n  data.tar.gz: %s\n"
+             "SHA512:\n  metadata.gz: 00\n", meta_hex, data_hex);
+
+    char gz_path[TPATH];
+    snprintf(gz_path, sizeof(gz_path), "%s/checksums.tmp", tmpdir);
+    size_t sums_len = 0;
+    uint8_t *sums = gzip_text(gz_path, yaml, &sums_len);
+    unlink(gz_path);
+    check("built checksums.yaml.gz", sums && sums_len > 0);
+    if (!sums) { rm_rf(tmpdir); return; }
+
+    struct tar_entry good[] = {
+        { "metadata.gz", meta, strlen(meta) },
+        { "data.tar.gz", data, strlen(data) },
+        { "checksums.yaml.gz", sums, sums_len },
+    };
+    struct tar_entry bad[] = {
+        { "metadata.gz", meta, strlen(meta) },
+        { "data.tar.gz", "pretend this is data.tar.gZ", strlen(data) },
+        { "checksums.yaml.gz", sums, sums_len },
+    };
+
+    char path[TPATH];
+    snprintf(path, sizeof(path), "%s/good-1.0.gem", tmpdir);
+    make_plain_tar(path, good, 3);
+
+    struct wow_tar_member mem[4];
+    check("tar index finds 3 members", wow_tar_index(path, mem, 4) == 3);
+    check("tar index offset is after the header",
+          mem[0].offset == 512 && mem[0].size == strlen(meta) &&
+          strcmp(mem[1].name, "data.tar.gz") == 0);
+
+    snprintf(path, sizeof(path), "%s/old-1.0.gem", tmpdir);
+    make_plain_tar(path, good, 2);
+    snprintf(path, sizeof(path), "%s/flipped-1.0.gem", tmpdir);
+    make_plain_tar(path, bad, 3);
+    snprintf(path, sizeof(path), "%s/short-1.0.gem", tmpdir);
+    make_plain_tar(path, good, 3);
+    check("truncate", truncate(path, 1024 + 10) == 0);  /* into data.tar.gz */
+    free(sums);
+
+    struct wow_gem_verify_opts o = { 2, 0, 0 };
+    struct wow_gem_verify_stats st;
+    check("verify runs", wow_gem_verify_dir(tmpdir, &o, &st) == 0);
+    check("4 gems seen", st.total == 4);
+    check("1 ok", st.ok == 1);
+    check("1 unchecked (no checksums)", st.unchecked == 1);
+    check("2 corrupt (mismatch, truncated)", st.corrupt == 2);
+
+    o.remove = 1;
+    wow_gem_verify_dir(tmpdir, &o, &st);
+    check("--remove deletes corrupt gems", st.removed == 2 &&
+          access(path, F_OK) != 0);
+    wow_gem_verify_dir(tmpdir, &o, &st);
+    check("cache is clean afterwards", st.total == 2 && st.corrupt == 0);
+
+    rm_rf(tmpdir);
+}
+
+/* ── Require index ───────────────────────────────────────────── */
+
+static int write_text(const char *path, const char *text) {
+    FILE *f = fopen(path, "w");
+    if (!f) return -1;
+    fputs(text, f);
+    return fclose(f);
+}
+
+/* Run cmd and keep its stdout in out; returns 0 if it exited 0 */
+static int run_capture(const char *cmd, char *out, size_t outsz) {
+    FILE *p = popen(cmd, "r");
+    if (!p) return -1;
+    size_t n = fread(out, 1, outsz - 1, p);
+    out[n] = '\0';
+    return pclose(p) == 0 ? 0 : -1;
+}
+
+static void test_require_index(void) {
+    printf("\n[Test] Require index vs $LOAD_PATH...\n");
+
+    /* Needs a real Ruby to run the preload hook */
+    char ruby[PATH_MAX];
+    if (run_capture("ruby -e 'print RbConfig.ruby' 2>/dev/null",
+                    ruby, sizeof(ruby)) != 0 || !ruby[0]) {
+        printf("  SKIP: no ruby on PATH\n");
+        return;
+    }
+
+    char tmpdir[] = "/tmp/wow-test-reqidx-XXXXXX";
+    if (!mkdtemp(tmpdir)) { check("mkdtemp", 0); return; }
+
+    /* <tmp>/ruby: preload prefix; <tmp>/gem/lib: the indexed load
+     * path; <tmp>/app/lib: a directory the script puts in front */
+    char prefix[TPATH], gem_lib[TPATH], app_lib[TPATH], env[TPATH];
+    char path[TPATH + 32];
+    snprintf(prefix, sizeof(prefix), "%s/ruby", tmpdir);
+    snprintf(gem_lib, sizeof(gem_lib), "%s/gem/lib", tmpdir);
+    snprintf(app_lib, sizeof(app_lib), "%s/app/lib", tmpdir);
+    snprintf(env, sizeof(env), "%s/env", tmpdir);
+    check("preload written", wow_ensure_gem_preload(prefix) == 0);
+    check("dirs created", wow_mkdirs(gem_lib, 0755) == 0 &&
+          wow_mkdirs(app_lib, 0755) == 0 && wow_mkdirs(env, 0755) == 0);
+
+    snprintf(path, sizeof(path), "%s/wow_idx_feat.rb", gem_lib);
+    write_text(path, "$wow_hit = :gem\n");
+    snprintf(path, sizeof(path), "%s/wow_idx_feat.rb", app_lib);
+    write_text(path, "$wow_hit = :app\n");
+
+    char index[TPATH];
+    check("index written", wow_require_index_write(env, gem_lib, index,
+                                                   sizeof(index)) == 0);
+
+    /* Prints whether the index is in use, then which file loaded */
+    const char *script =
+        "$LOAD_PATH.unshift(ARGV[0]) if ARGV[0]; "
+        "require %q(wow_idx_feat); "
+        "print WowRequireIndex.current?, %q( ), $wow_hit";
+
+    /* Without and then with app_lib unshifted in front */
+    const char *shadow[] = { "", app_lib };
+    const char *want[] = { "true gem", "false app" };
+    const char *what[] = { "indexed require loads the gem's file",
+                           "unshifted dir shadows the index" };
+    for (int i = 0; i < 2; i++) {
+        char cmd[5 * TPATH], out[256];
+        snprintf(cmd, sizeof(cmd),
+                 "env -u RUBYOPT RUBYLIB='%s' WOW_REQUIRE_INDEX='%s' '%s' "
+                 "--disable-gems -r'%s/lib/wow_preload.rb' -e '%s' %s 2>&1",
+                 gem_lib, index, ruby, prefix, script, shadow[i]);
+        int rc = run_capture(cmd, out, sizeof(out));
+        check(what[i], rc == 0 && strcmp(out, want[i]) == 0);
+        if (rc != 0 || strcmp(out, want[i]) != 0)
+            printf("    got: %s\n", out);
+    }
+
+    rm_rf(tmpdir);
+}
+
+/* ── Install manifest (.wow-installed) ───────────────────────── */
+
+static int count_lines(const char *path, const char *prefix) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    char line[1024];
+    int n = 0;
+    while (fgets(line, sizeof(line), f))
+        if (strncmp(line, prefix, strlen(prefix)) == 0) n++;
+    fclose(f);
+    return n;
+}
+
+static int has_entry(char **list, int n, const char *entry) {
+    for (int i = 0; i < n; i++)
+        if (strcmp(list[i], entry) == 0) return 1;
+    return 0;
+}
+
+static void free_list(char **list, int n) {
+    for (int i = 0; i < n; i++) free(list[i]);
+    free(list);
+}
+
+static void test_installed_manifest(void) {
+    printf("\n[Test] Install manifest...\n");
+
+    char tmpdir[] = "/tmp/wow-test-inst-XXXXXX";
+    if (!mkdtemp(tmpdir)) { check("mkdtemp", 0); return; }
+
+    char dir[TPATH], manifest[TPATH];
+    const char *dirs[] = { "rack-3.1.7", "nokogiri-1.16.0", "pending-1.0",
+                           "stray-1.0" };
+    for (int i = 0; i < 4; i++) {
+        snprintf(dir, sizeof(dir), "%s/gems/%s", tmpdir, dirs[i]);
+        wow_mkdirs(dir, 0755);
+    }
+    snprintf(manifest, sizeof(manifest), "%s/.wow-installed", tmpdir);
+
+    struct wow_installed m;
+    check("missing manifest loads empty",
+          wow_installed_load(&m, tmpdir) == 0 && !m.exists && m.n == 0);
+    check("add generic gem",
+          wow_installed_add(&m, "rack-3.1.7", "rack", "3.1.7",
+                            NULL, NULL, "gem") == 0);
+    check("add platform gem",
+          wow_installed_add(&m, "nokogiri-1.16.0", "nokogiri", "1.16.0",
+                            "x86_64-linux", "abc123", "ext") == 0);
+    check("add pending gem",
+          wow_installed_add(&m, "pending-1.0", "pending", "1.0",
+                            NULL, NULL, "ext-pending") == 0);
+    check("add then remove",
+          wow_installed_add(&m, "old-0.1", "old", "0.1",
+                            NULL, NULL, "gem") == 0 &&
+          wow_installed_remove(&m, "old-0.1") == 0);
+    wow_installed_free(&m);
+
+    /* The uncompacted log replays to the same state */
+    check("log replays", wow_installed_load(&m, tmpdir) == 0 &&
+          m.exists && !m.fresh && m.n == 3);
+    const struct wow_installed_gem *g = wow_installed_find(&m, "rack-3.1.7");
+    check("generic gem recorded as ruby, unknown sha",
+          g && strcmp(g->platform, "ruby") == 0 &&
+          strcmp(g->sha256, "-") == 0 && strcmp(g->mode, "gem") == 0);
+    check("removed gem forgotten", !wow_installed_find(&m, "old-0.1"));
+    check("complete for its own platform",
+          wow_installed_find_complete(&m, "nokogiri-1.16.0",
+                                      "x86_64-linux") != NULL);
+    check("not complete for another platform",
+          !wow_installed_find_complete(&m, "nokogiri-1.16.0", NULL));
+    check("ext-pending is never complete",
+          wow_installed_find(&m, "pending-1.0") &&
+          !wow_installed_find_complete(&m, "pending-1.0", NULL));
+
+    check("commit", wow_installed_commit(&m) == 0 && m.fresh);
+    wow_installed_free(&m);
+
+    /* Compaction: magic, one line per live gem, the gems/ stamp */
+    check("compacted: no removals left", count_lines(manifest, "-\t") == 0);
+    check("compacted: one record per gem",
+          count_lines(manifest, "+\t") == 3);
+    check("compacted: stamped", count_lines(manifest, "gems-mtime\t") == 1);
+
+    /* A torn final line is ignored */
+    FILE *f = fopen(manifest, "a");
+    if (f) { fputs("+\ttorn-1.0\ttorn", f); fclose(f); }
+    check("fresh after commit", wow_installed_load(&m, tmpdir) == 0 &&
+          m.fresh && m.n == 3 && !wow_installed_find(&m, "torn-1.0"));
+
+    /* Fresh: gems/ is not listed, so the stray directory goes unseen */
+    const char *solved[] = { "rack-3.1.7", "pending-1.0" };
+    char **stale = NULL;
+    int n_stale = 0;
+    check("stale set (fresh)",
+          wow_installed_stale(&m, solved, 2, &stale, &n_stale) == 0 &&
+          n_stale == 1 && has_entry(stale, n_stale, "nokogiri-1.16.0"));
+    free_list(stale, n_stale);
+    wow_installed_free(&m);
+
+    /* Touching gems/ makes the manifest stale: unrecorded directories
+     * are listed, recorded-and-solved ones are kept */
+    snprintf(dir, sizeof(dir), "%s/gems/new-2.0", tmpdir);
+    wow_mkdirs(dir, 0755);
+    check("gems/ changed: not fresh",
+          wow_installed_load(&m, tmpdir) == 0 && m.exists && !m.fresh);
+    const char *solved_all[] = { "rack-3.1.7", "pending-1.0",
+                                 "nokogiri-1.16.0" };
+    stale = NULL;
+    n_stale = 0;
+    check("stale set (gems/ changed)",
+          wow_installed_stale(&m, solved_all, 3, &stale, &n_stale) == 0 &&
+          n_stale == 2 && has_entry(stale, n_stale, "stray-1.0") &&
+          has_entry(stale, n_stale, "new-2.0"));
+
+    check("prune", wow_installed_prune(tmpdir, stale, n_stale) == 0);
+    struct stat st;
+    snprintf(dir, sizeof(dir), "%s/gems/stray-1.0", tmpdir);
+    check("pruned directory gone", stat(dir, &st) != 0);
+    snprintf(dir, sizeof(dir), "%s/gems/rack-3.1.7", tmpdir);
+    check("solved directory kept", stat(dir, &st) == 0);
+    free_list(stale, n_stale);
+    wow_installed_free(&m);
+
+    /* A version 1 manifest (no platform column) is not trusted */
+    f = fopen(manifest, "w");
+    if (f) {
+        fputs("wow-installed\t1\n+\track-3.1.7\track\t3.1.7\t-\tgem\n", f);
+        fclose(f);
+    }
+    check("old format ignored",
+          wow_installed_load(&m, tmpdir) == 0 && !m.exists && m.n == 0);
+    wow_installed_free(&m);
+
+    rm_rf(tmpdir);
+}
+
 /* ── main ────────────────────────────────────────────────────── */
 
 int main(void) {
@@ -635,6 +1039,8 @@ int main(void) {
 
     /* SHA-256 */
     test_sha256();
+    test_sha256_backends();
+    test_sha256_files();
 
     /* Gzip round-trip */
     test_gunzip_roundtrip();
@@ -644,6 +1050,13 @@ int main(void) {
 
     /* Cache directory */
     test_gem_cache_dir();
+    test_gem_verify();
+
+    /* Install manifest */
+    test_installed_manifest();
+
+    /* Require index (runs Ruby if one is on PATH) */
+    test_require_index();
 
     printf("\n=== Results: %d passed, %d failed ===\n", n_pass, n_fail);
     return n_fail > 0 ? 1 : 0;
@@ -1,16 +1,25 @@
 /*
  * tests/gemfile_test.c -- Gemfile lexer + parser tests
  *
- * All fixtures are embedded string constants -- no file I/O needed.
+ * All fixtures are embedded string constants; only the parse cache,
+ * Gemfile edit and `wow add` / `wow remove` rollback tests touch the
+ * filesystem (temporary directories).
  *
  * Run via: make test-gemfile
  */
 
+#include <dirent.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "wow/gemfile.h"
+#include "wow/sync.h"
+#include "wow/util/path.h"
 #include "parser.h"  /* token IDs for lex tests */
 
 static int n_pass, n_fail;
@@ -1731,6 +1740,302 @@ static void test_ruby_const(void)
     wow_gemfile_free(&gf);
 }
 
+/* ── Test: parse cache ──────────────────────────────────────────── */
+
+static void write_text(const char *path, const char *text)
+{
+    FILE *f = fopen(path, "w");
+    if (f) {
+        fputs(text, f);
+        fclose(f);
+    }
+}
+
+static int count_entries(const char *dir)
+{
+    int n = 0;
+    DIR *d = opendir(dir);
+    if (!d) return 0;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL)
+        if (de->d_name[0] != '.') n++;
+    closedir(d);
+    return n;
+}
+
+static void test_parse_cache(void)
+{
+    printf("test_parse_cache:\n");
+    char root[] = "/tmp/wow-gfcache-XXXXXX";
+    if (!mkdtemp(root)) {
+        check("mkdtemp", 0);
+        return;
+    }
+    char gemfile[256], local[256], cache[256];
+    snprintf(gemfile, sizeof(gemfile), "%s/Gemfile", root);
+    snprintf(local, sizeof(local), "%s/Gemfile.local", root);
+    snprintf(cache, sizeof(cache), "%s/wow/gemfile", root);
+    setenv("XDG_CACHE_HOME", root, 1);
+    unsetenv("WOW_NO_GEMFILE_CACHE");
+    unsetenv("WOW_TEST_CACHE_PG");
+
+    write_text(gemfile,
+        "source \"https://rubygems.org\"\n"
+        "gem \"rack\"\n"
+        "gem \"pg\" if ENV[\"WOW_TEST_CACHE_PG\"]\n"
+        "eval_gemfile \"Gemfile.local\"\n");
+    write_text(local, "gem \"puma\"\n");
+
+    struct wow_gemfile gf;
+    int rc = wow_gemfile_parse_file(gemfile, &gf);
+    check("first parse OK", rc == 0 && gf.n_deps == 2);
+    check("entry stored", count_entries(cache) == 1);
+    wow_gemfile_free(&gf);
+
+    rc = wow_gemfile_parse_file(gemfile, &gf);
+    check("cached parse OK", rc == 0 && gf.n_deps == 2);
+    check("cached source", gf.source &&
+          strcmp(gf.source, "https://rubygems.org") == 0);
+    check("cached deps", gf.n_deps == 2 &&
+          strcmp(gf.deps[0].name, "rack") == 0 &&
+          strcmp(gf.deps[1].name, "puma") == 0);
+    check("cached groups", gf.n_deps > 0 && gf.deps[0].n_groups == 1 &&
+          strcmp(gf.deps[0].groups[0], "default") == 0);
+    wow_gemfile_free(&gf);
+
+    /* A changed ENV input invalidates the entry */
+    setenv("WOW_TEST_CACHE_PG", "1", 1);
+    rc = wow_gemfile_parse_file(gemfile, &gf);
+    check("ENV change re-evaluates", rc == 0 && gf.n_deps == 3);
+    wow_gemfile_free(&gf);
+    unsetenv("WOW_TEST_CACHE_PG");
+
+    /* So does a changed eval_gemfile include */
+    write_text(local, "gem \"puma\"\ngem \"nio4r\"\n");
+    rc = wow_gemfile_parse_file(gemfile, &gf);
+    check("include change re-evaluates", rc == 0 && gf.n_deps == 3);
+    wow_gemfile_free(&gf);
+
+    /* A truncated entry is a miss, not an error */
+    DIR *d = opendir(cache);
+    struct dirent *de;
+    int truncated = 0;
+    while (d && (de = readdir(d)) != NULL) {
+        if (de->d_name[0] == '.') continue;
+        char entry[512];
+        snprintf(entry, sizeof(entry), "%s/%s", cache, de->d_name);
+        if (truncate(entry, 12) == 0) truncated++;
+    }
+    if (d) closedir(d);
+    check("entry truncated", truncated == 1);
+    rc = wow_gemfile_parse_file(gemfile, &gf);
+    check("truncated entry ignored", rc == 0 && gf.n_deps == 3);
+    wow_gemfile_free(&gf);
+
+    /* Stores trim entries unused for a month (at most once a day) */
+    char stamp[512], stale[512];
+    snprintf(stamp, sizeof(stamp), "%s/.trim", cache);
+    snprintf(stale, sizeof(stale), "%s/stale-entry", cache);
+    write_text(stale, "WOWGFC1\n");
+    struct timespec old[2] = { { time(NULL) - 60L * 24 * 60 * 60, 0 },
+                               { time(NULL) - 60L * 24 * 60 * 60, 0 } };
+    utimensat(AT_FDCWD, stale, old, 0);
+    unlink(stamp);
+    write_text(local, "gem \"puma\"\n");
+    rc = wow_gemfile_parse_file(gemfile, &gf);
+    check("store after include change", rc == 0 && gf.n_deps == 2);
+    wow_gemfile_free(&gf);
+    check("month-old entry trimmed", access(stale, F_OK) != 0);
+    check("trim stamp written", access(stamp, F_OK) == 0);
+
+    /* Beyond the entry cap the least recently used go first */
+    write_text(stale, "WOWGFC1\n");
+    old[0].tv_sec = old[1].tv_sec = time(NULL) - 60 * 60;
+    utimensat(AT_FDCWD, stale, old, 0);
+    int before = count_entries(cache);
+    unlink(stamp);
+    wow_cache_trim(cache, 30L * 24 * 60 * 60, 1);
+    check("entry cap enforced", before == 2 && count_entries(cache) == 1);
+    check("least recently used went", access(stale, F_OK) != 0);
+
+    char cmd[512];
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", root);
+    check("cache dir removed", system(cmd) == 0);
+    unsetenv("XDG_CACHE_HOME");
+}
+
+/* ── Test: Gemfile edits (wow add / wow remove) ─────────────────── */
+
+static char *read_all(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    char *buf = malloc(8192);
+    size_t n = buf ? fread(buf, 1, 8191, f) : 0;
+    fclose(f);
+    if (buf) buf[n] = '\0';
+    return buf;
+}
+
+static int file_is(const char *path, const char *want)
+{
+    char *got = read_all(path);
+    int ok = got && strcmp(got, want) == 0;
+    if (got && !ok) printf("    got:\n%s", got);
+    free(got);
+    return ok;
+}
+
+static void test_edit(void)
+{
+    printf("test_edit:\n");
+    char root[] = "/tmp/wow-gfedit-XXXXXX";
+    if (!mkdtemp(root)) {
+        check("mkdtemp", 0);
+        return;
+    }
+    char gemfile[256];
+    snprintf(gemfile, sizeof(gemfile), "%s/Gemfile", root);
+
+    const char *base =
+        "source \"https://rubygems.org\"\n"
+        "gem \"rack\", \"~> 3.0\",\n"
+        "    require: false\n"
+        "\n"
+        "group :test do\n"
+        "  gem \"rspec\"\n"
+        "end\n";
+    write_text(gemfile, base);
+
+    char *cs[] = { "~> 4.0", ">= 4.0.1" };
+    check("add OK", wow_gemfile_edit_add(gemfile, "sinatra", cs, 2) == 0);
+    check("added after the last top-level gem and its continuation",
+          file_is(gemfile,
+                  "source \"https://rubygems.org\"\n"
+                  "gem \"rack\", \"~> 3.0\",\n"
+                  "    require: false\n"
+                  "gem \"sinatra\", \"~> 4.0\", \">= 4.0.1\"\n"
+                  "\n"
+                  "group :test do\n"
+                  "  gem \"rspec\"\n"
+                  "end\n"));
+
+    check("remove multi-line declaration",
+          wow_gemfile_edit_remove(gemfile, "rack") == 1);
+    check("remove nested declaration",
+          wow_gemfile_edit_remove(gemfile, "rspec") == 1);
+    check("remove absent gem is 0",
+          wow_gemfile_edit_remove(gemfile, "rails") == 0);
+    check("only the declarations went",
+          file_is(gemfile,
+                  "source \"https://rubygems.org\"\n"
+                  "gem \"sinatra\", \"~> 4.0\", \">= 4.0.1\"\n"
+                  "\n"
+                  "group :test do\n"
+                  "end\n"));
+
+    /* No gem line and no trailing newline: appended on a new line */
+    write_text(gemfile, "source \"https://rubygems.org\"");
+    check("add to gemless file",
+          wow_gemfile_edit_add(gemfile, "rack", NULL, 0) == 0 &&
+          file_is(gemfile, "source \"https://rubygems.org\"\n"
+                           "gem \"rack\"\n"));
+
+    /* Anything that could escape the quotes is refused, file untouched */
+    const char *bad_names[] = { "", "ra ck", "rack\"", "a/b", "x;y" };
+    int refused = 0;
+    for (int i = 0; i < 5; i++)
+        refused += wow_gemfile_edit_add(gemfile, bad_names[i], NULL, 0) != 0;
+    check("invalid names refused", refused == 5);
+    char *bad_cs[][1] = { { "~> 1\", system(\"id\")" }, { "1.0 # x" },
+                          { "1.0\\" }, { "1.0\n" } };
+    refused = 0;
+    for (int i = 0; i < 4; i++)
+        refused += wow_gemfile_edit_add(gemfile, "pg", bad_cs[i], 1) != 0;
+    check("invalid constraints refused", refused == 4);
+    check("refused edits leave the file alone",
+          file_is(gemfile, "source \"https://rubygems.org\"\n"
+                           "gem \"rack\"\n"));
+    check("dotted, dashed, underscored name accepted",
+          wow_gemfile_edit_add(gemfile, "net-http_persistent.x", NULL,
+                               0) == 0);
+
+    char cmd[512];
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", root);
+    check("edit dir removed", system(cmd) == 0);
+}
+
+/*
+ * A failing sync puts Gemfile and Gemfile.lock back byte for byte.  The
+ * source is a closed local port, so the index fetch fails fast and
+ * offline.
+ */
+static void test_add_remove_rollback(void)
+{
+    printf("test_add_remove_rollback:\n");
+    char root[] = "/tmp/wow-gfrollback-XXXXXX";
+    char cwd[1024];
+    if (!mkdtemp(root) || !getcwd(cwd, sizeof(cwd)) || chdir(root) != 0) {
+        check("temp project", 0);
+        return;
+    }
+    setenv("XDG_CACHE_HOME", root, 1);
+    setenv("WOW_NO_DAEMON", "1", 1);
+
+    const char *gemfile =
+        "source \"http://127.0.0.1:1\"\n"
+        "gem \"rack\"\n"
+        "gem \"rake\"\n";
+    const char *lock =
+        "GEM\n"
+        "  remote: http://127.0.0.1:1/\n"
+        "  specs:\n"
+        "    rack (3.1.7)\n"
+        "    rake (13.2.1)\n"
+        "\n"
+        "PLATFORMS\n"
+        "  ruby\n"
+        "\n"
+        "DEPENDENCIES\n"
+        "  rack\n"
+        "  rake\n";
+    write_text("Gemfile", gemfile);
+    write_text("Gemfile.lock", lock);
+    write_text(".ruby-version", "3.3.0\n");
+
+    char *add[] = { "add", "sinatra", "~> 4.0", NULL };
+    check("add fails without an index", cmd_add(3, add) != 0);
+    check("add: Gemfile restored", file_is("Gemfile", gemfile));
+    check("add: Gemfile.lock restored", file_is("Gemfile.lock", lock));
+
+    char *rm[] = { "remove", "rake", NULL };
+    check("remove fails without an index", cmd_remove(2, rm) != 0);
+    check("remove: Gemfile restored", file_is("Gemfile", gemfile));
+    check("remove: Gemfile.lock restored", file_is("Gemfile.lock", lock));
+
+    /* One unknown name undoes the edits made for the names before it */
+    char *rm2[] = { "remove", "rake", "rails", NULL };
+    check("remove of an absent gem fails", cmd_remove(3, rm2) != 0);
+    check("partial remove undone", file_is("Gemfile", gemfile));
+
+    /* Without a lock to begin with, none is left behind */
+    unlink("Gemfile.lock");
+    check("add fails without a lock", cmd_add(3, add) != 0);
+    check("no lock left behind", access("Gemfile.lock", F_OK) != 0);
+    check("Gemfile restored", file_is("Gemfile", gemfile));
+
+    char *bad[] = { "add", "x\"; system(\"id\") #", NULL };
+    check("unsafe name refused", cmd_add(2, bad) != 0 &&
+          file_is("Gemfile", gemfile));
+
+    unsetenv("WOW_NO_DAEMON");
+    unsetenv("XDG_CACHE_HOME");
+    char cmd[1200];
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", root);
+    check("back to cwd", chdir(cwd) == 0);
+    check("project dir removed", system(cmd) == 0);
+}
+
 /* ── Main ───────────────────────────────────────────────────────── */
 
 int main(void)
@@ -1818,6 +2123,13 @@ int main(void)
     test_var_version();
     test_ruby_const();
 
+    /* Parse cache (uses a temporary directory) */
+    test_parse_cache();
+
+    /* wow add / wow remove (temporary project directories) */
+    test_edit();
+    test_add_remove_rollback();
+
     printf("\n=== Results: %d passed, %d failed ===\n", n_pass, n_fail);
     return n_fail > 0 ? 1 : 0;
 }
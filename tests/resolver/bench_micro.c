@@ -0,0 +1,649 @@
+/*
+ * resolver/test/bench_micro.c — Microbenchmarks for core primitives
+ *
+ *   wow debug bench [options] [<primitive>...]
+ *
+ *   -r N              timed repetitions per primitive (default 7)
+ *   --min-time SECS   wall time of one repetition (default 0.05)
+ *   --fixtures DIR    fixture root (default: tests)
+ *   --input FILE      archive for sha256/gunzip/tar-read
+ *                     (default: <fixtures>/fixtures/valid.tar.gz)
+ *   --json            one JSON object per primitive instead of a table
+ *
+ * Primitives (all when none are named):
+ *
+ *   gemver-parse       wow_gemver_parse over every indexed version
+ *   gemver-cmp         wow_gemver_cmp over pairs of those versions
+ *   constraints-parse  wow_gem_constraints_parse over index requirements
+ *   gemver-match       wow_gemver_match, requirement × version
+ *   ci-line            wow_ci_parse_line over compact index lines
+ *   ci-tokenize        wow_ci_tokenize over whole /info bodies
+ *   range-intersect    wow_ver_range_intersect over version ranges
+ *   sha256             wow_sha256_file on the input archive
+ *   gunzip             wow_gunzip of the input archive, in memory
+ *   tar-read           wow_tar_list_gz (streaming inflate + tar reader)
+ *   gemfile-lex        wow_lexer_scan over the bench corpus Gemfiles
+ *
+ * Inputs come from the resolver bench corpus (tests/bench/resolve):
+ * index/info/<gem> for versions, requirements and index lines, and
+ * cases/<name>/Gemfile for the lexer.  Point --input at a real .gem's
+ * data.tar.gz for throughput numbers that mean something; the default
+ * fixture is tiny and mostly measures open() and setup.
+ *
+ * Each primitive is warmed up while calibrating a batch size, then timed
+ * over -r repetitions of that batch.  An "op" is one call on one input;
+ * ns/op is reported as the minimum and median over repetitions, cyc/op
+ * from the time-stamp counter (x86-64 only; "-" elsewhere), and MB/s
+ * from the input bytes the batch consumed.
+ */
+
+#include <dirent.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wow/common.h"
+#include "wow/gemfile.h"
+#include "wow/resolver.h"
+#include "wow/resolver/citok.h"
+#include "wow/tar.h"
+#include "wow/util/gunzip.h"
+#include "wow/util/sha256.h"
+#include "wow/util/time.h"
+
+#define BENCH_MAX_REPS      101
+#define BENCH_WARMUP_SECS   0.02
+#define BENCH_MAX_BATCH     (1u << 28)
+#define BENCH_GUNZIP_MAX    ((size_t)512 << 20)
+
+static volatile uint64_t bench_sink;  /* keeps results observable */
+
+static inline uint64_t bench_cycles(void)
+{
+#if defined(__x86_64__)
+    return __builtin_ia32_rdtsc();
+#else
+    return 0;
+#endif
+}
+
+/* ------------------------------------------------------------------ */
+/* Inputs                                                              */
+/* ------------------------------------------------------------------ */
+
+struct bench_buf {
+    char  *data;
+    size_t len;
+};
+
+struct bench_inputs {
+    char          **lines;      /* compact index version lines */
+    size_t          n_lines;
+    struct bench_buf *infos;    /* whole /info bodies */
+    size_t          n_infos;
+    wow_ci_toks     toks;       /* ci-tokenize output, reused */
+    wow_gemver     *vers;
+    size_t          n_vers;
+    char          **reqs;       /* "~> 1.0, >= 1.0.2" */
+    size_t          n_reqs;
+    wow_gem_constraints *cons;  /* reqs, parsed */
+    wow_ver_range  *ranges;
+    size_t          n_ranges;
+    struct bench_buf *gemfiles;
+    size_t          n_gemfiles;
+    const char     *archive;    /* path for sha256 / tar-read */
+    struct bench_buf gz;        /* archive contents for gunzip */
+    wow_arena       arena;      /* ci-line dependency storage */
+    size_t          pos;        /* rotating input index */
+};
+
+static int read_all(const char *path, struct bench_buf *b)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    size_t cap = 4096, len = 0;
+    char *data = malloc(cap + 1);
+    size_t got;
+    while (data && (got = fread(data + len, 1, cap - len, f)) > 0) {
+        len += got;
+        if (len == cap) {
+            char *nd = realloc(data, cap * 2 + 1);
+            if (!nd) { free(data); data = NULL; break; }
+            data = nd;
+            cap *= 2;
+        }
+    }
+    fclose(f);
+    if (!data) return -1;
+    data[len] = '\0';
+    b->data = data;
+    b->len = len;
+    return 0;
+}
+
+static int push(void **arr, size_t *n, size_t *cap, size_t elem)
+{
+    if (*n < *cap) return 0;
+    size_t nc = *cap ? *cap * 2 : 64;
+    void *na = realloc(*arr, nc * elem);
+    if (!na) return -1;
+    *arr = na;
+    *cap = nc;
+    return 0;
+}
+
+/* "name:~> 1.0&>= 1.0.2" → "~> 1.0, >= 1.0.2" */
+static char *dep_req(const char *dep, size_t len)
+{
+    const char *colon = memchr(dep, ':', len);
+    if (!colon) return NULL;
+    const char *r = colon + 1;
+    size_t rlen = len - (size_t)(r - dep);
+    char *out = malloc(rlen * 2 + 1);
+    if (!out) return NULL;
+    char *w = out;
+    for (size_t i = 0; i < rlen; i++) {
+        if (r[i] == '&') { *w++ = ','; *w++ = ' '; }
+        else *w++ = r[i];
+    }
+    *w = '\0';
+    return out;
+}
+
+static void add_index_line(struct bench_inputs *in, const char *line,
+                           size_t *lcap, size_t *vcap, size_t *rcap)
+{
+    if (push((void **)&in->lines, &in->n_lines, lcap, sizeof(char *)) != 0)
+        return;
+    in->lines[in->n_lines++] = strdup(line);
+
+    const char *sp = strchr(line, ' ');
+    const char *pipe = sp ? strchr(sp + 1, '|') : NULL;
+    if (!sp || !pipe) return;
+
+    /* Version, minus any platform suffix */
+    char vbuf[WOW_VER_RAW_SZ];
+    size_t vlen = (size_t)(sp - line);
+    if (vlen >= sizeof(vbuf)) return;
+    memcpy(vbuf, line, vlen);
+    vbuf[vlen] = '\0';
+    for (size_t i = 0; i + 1 < vlen; i++) {
+        if (vbuf[i] == '-' && ((vbuf[i + 1] >= 'a' && vbuf[i + 1] <= 'z') ||
+                               (vbuf[i + 1] >= 'A' && vbuf[i + 1] <= 'Z'))) {
+            vbuf[i] = '\0';
+            break;
+        }
+    }
+    if (push((void **)&in->vers, &in->n_vers, vcap, sizeof(wow_gemver)) == 0 &&
+        wow_gemver_parse(vbuf, &in->vers[in->n_vers]) == 0)
+        in->n_vers++;
+
+    /* Requirements: "dep:req,dep:req" between the space and the pipe */
+    const char *p = sp + 1;
+    while (p < pipe) {
+        const char *comma = memchr(p, ',', (size_t)(pipe - p));
+        const char *end = comma ? comma : pipe;
+        char *req = dep_req(p, (size_t)(end - p));
+        if (req &&
+            push((void **)&in->reqs, &in->n_reqs, rcap, sizeof(char *)) == 0)
+            in->reqs[in->n_reqs++] = req;
+        else
+            free(req);
+        p = end + 1;
+    }
+}
+
+static int load_index(struct bench_inputs *in, const char *fixtures)
+{
+    char dir[WOW_DIR_PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s/bench/resolve/index/info", fixtures);
+    DIR *d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "wow: cannot open %s\n", dir);
+        return -1;
+    }
+
+    size_t lcap = 0, vcap = 0, rcap = 0, icap = 0;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (de->d_name[0] == '.') continue;
+        char path[WOW_OS_PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%.*s", dir, NAME_MAX, de->d_name);
+        struct bench_buf b;
+        if (read_all(path, &b) != 0) continue;
+
+        /* Keep an untouched copy; strtok below writes into b */
+        char *copy = malloc(b.len + 1);
+        if (copy &&
+            push((void **)&in->infos, &in->n_infos, &icap,
+                 sizeof(*in->infos)) == 0) {
+            memcpy(copy, b.data, b.len + 1);
+            in->infos[in->n_infos].data = copy;
+            in->infos[in->n_infos++].len = b.len;
+        } else {
+            free(copy);
+        }
+
+        int past_header = 0;
+        for (char *line = strtok(b.data, "\n"); line;
+             line = strtok(NULL, "\n")) {
+            size_t ll = strlen(line);
+            if (ll && line[ll - 1] == '\r') line[--ll] = '\0';
+            if (!past_header) {
+                past_header = strcmp(line, "---") == 0;
+                continue;
+            }
+            if (ll) add_index_line(in, line, &lcap, &vcap, &rcap);
+        }
+        free(b.data);
+    }
+    closedir(d);
+
+    if (in->n_lines == 0 || in->n_vers < 2 || in->n_reqs == 0) {
+        fprintf(stderr, "wow: %s: no usable index data\n", dir);
+        return -1;
+    }
+
+    in->cons = calloc(in->n_reqs, sizeof(*in->cons));
+    if (!in->cons) return -1;
+    size_t nc = 0;
+    for (size_t i = 0; i < in->n_reqs; i++) {
+        if (wow_gem_constraints_parse(in->reqs[i], &in->cons[nc]) == 0)
+            in->reqs[nc++] = in->reqs[i];
+        else
+            free(in->reqs[i]);
+    }
+    in->n_reqs = nc;
+
+    /* Ranges of varying shape: bounded, half-open, inclusive or not */
+    in->n_ranges = in->n_vers;
+    in->ranges = calloc(in->n_ranges, sizeof(*in->ranges));
+    if (!in->ranges) return -1;
+    for (size_t k = 0; k < in->n_ranges; k++) {
+        const wow_gemver *a = &in->vers[k];
+        const wow_gemver *b = &in->vers[(k * 7 + 3) % in->n_vers];
+        if (wow_gemver_cmp(a, b) > 0) {
+            const wow_gemver *t = a; a = b; b = t;
+        }
+        wow_ver_range *r = &in->ranges[k];
+        r->has_min = k % 5 != 1;
+        r->has_max = k % 5 != 2;
+        r->min = *a;
+        r->max = *b;
+        r->min_inclusive = (k & 1) == 0;
+        r->max_inclusive = (k & 2) != 0;
+    }
+    return 0;
+}
+
+static int load_gemfiles(struct bench_inputs *in, const char *fixtures)
+{
+    char dir[WOW_DIR_PATH_MAX - NAME_MAX - 16];
+    snprintf(dir, sizeof(dir), "%s/bench/resolve/cases", fixtures);
+    DIR *d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "wow: cannot open %s\n", dir);
+        return -1;
+    }
+    size_t cap = 0;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (de->d_name[0] == '.') continue;
+        char path[WOW_OS_PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%.*s/Gemfile", dir, NAME_MAX,
+                 de->d_name);
+        struct bench_buf b;
+        if (read_all(path, &b) != 0) continue;
+        if (push((void **)&in->gemfiles, &in->n_gemfiles, &cap,
+                 sizeof(*in->gemfiles)) != 0) {
+            free(b.data);
+            break;
+        }
+        in->gemfiles[in->n_gemfiles++] = b;
+    }
+    closedir(d);
+    if (in->n_gemfiles == 0) {
+        fprintf(stderr, "wow: %s: no Gemfiles\n", dir);
+        return -1;
+    }
+    return 0;
+}
+
+static void free_inputs(struct bench_inputs *in)
+{
+    for (size_t i = 0; i < in->n_lines; i++) free(in->lines[i]);
+    for (size_t i = 0; i < in->n_infos; i++) free(in->infos[i].data);
+    free(in->infos);
+    wow_ci_toks_free(&in->toks);
+    for (size_t i = 0; i < in->n_reqs; i++) free(in->reqs[i]);
+    for (size_t i = 0; i < in->n_gemfiles; i++) free(in->gemfiles[i].data);
+    free(in->lines);
+    free(in->vers);
+    free(in->reqs);
+    free(in->cons);
+    free(in->ranges);
+    free(in->gemfiles);
+    free(in->gz.data);
+    wow_arena_destroy(&in->arena);
+}
+
+/* ------------------------------------------------------------------ */
+/* Operations — each returns the input bytes it consumed               */
+/* ------------------------------------------------------------------ */
+
+static size_t op_gemver_parse(struct bench_inputs *in)
+{
+    const wow_gemver *src = &in->vers[in->pos++ % in->n_vers];
+    wow_gemver v;
+    bench_sink += (uint64_t)wow_gemver_parse(src->raw, &v) + (uint64_t)v.n_segs;
+    return strlen(src->raw);
+}
+
+static size_t op_gemver_cmp(struct bench_inputs *in)
+{
+    size_t i = in->pos++;
+    const wow_gemver *a = &in->vers[i % in->n_vers];
+    const wow_gemver *b = &in->vers[(i * 7 + 1) % in->n_vers];
+    bench_sink += (uint64_t)(wow_gemver_cmp(a, b) + 1);
+    return 0;
+}
+
+static size_t op_constraints_parse(struct bench_inputs *in)
+{
+    const char *s = in->reqs[in->pos++ % in->n_reqs];
+    wow_gem_constraints cs;
+    bench_sink += (uint64_t)wow_gem_constraints_parse(s, &cs) +
+                  (uint64_t)cs.count;
+    return strlen(s);
+}
+
+static size_t op_gemver_match(struct bench_inputs *in)
+{
+    size_t i = in->pos++;
+    bench_sink += wow_gemver_match(&in->cons[i % in->n_reqs],
+                                   &in->vers[(i / in->n_reqs + i) %
+                                             in->n_vers]);
+    return 0;
+}
+
+static size_t op_ci_line(struct bench_inputs *in)
+{
+    size_t i = in->pos++ % in->n_lines;
+    if (i == 0) wow_arena_reset(&in->arena);
+    const char *line = in->lines[i];
+    wow_gemver v;
+    wow_aoff deps;
+    int plat, n_deps;
+    bench_sink += (uint64_t)wow_ci_parse_line(&in->arena, line, NULL, NULL, 0,
+                                              &v, &plat, &deps, &n_deps) +
+                  (uint64_t)n_deps;
+    return strlen(line);
+}
+
+static size_t op_ci_tokenize(struct bench_inputs *in)
+{
+    const struct bench_buf *b = &in->infos[in->pos++ % in->n_infos];
+    if (wow_ci_tokenize(b->data, b->len, &in->toks) != 0) return 0;
+    bench_sink += in->toks.n;
+    return b->len;
+}
+
+static size_t op_range_intersect(struct bench_inputs *in)
+{
+    size_t i = in->pos++;
+    wow_ver_range r = wow_ver_range_intersect(
+        &in->ranges[i % in->n_ranges],
+        &in->ranges[(i * 5 + 2) % in->n_ranges]);
+    bench_sink += (uint64_t)r.has_min + (uint64_t)r.max.n_segs;
+    return 0;
+}
+
+static size_t op_sha256(struct bench_inputs *in)
+{
+    char hex[65];
+    if (wow_sha256_file(in->archive, hex, sizeof(hex)) != 0) return 0;
+    bench_sink += (uint64_t)(unsigned char)hex[0];
+    return in->gz.len;
+}
+
+static size_t op_gunzip(struct bench_inputs *in)
+{
+    uint8_t *out;
+    size_t out_len;
+    if (wow_gunzip((const uint8_t *)in->gz.data, in->gz.len, &out, &out_len,
+                   BENCH_GUNZIP_MAX) != 0)
+        return 0;
+    bench_sink += out_len;
+    free(out);
+    return in->gz.len;
+}
+
+static int count_entry(const char *name, size_t size, char typeflag,
+                       void *ctx)
+{
+    (void)name; (void)typeflag;
+    *(size_t *)ctx += size;
+    return 0;
+}
+
+static size_t op_tar_read(struct bench_inputs *in)
+{
+    size_t total = 0;
+    if (wow_tar_list_gz(in->archive, count_entry, &total) != 0) return 0;
+    bench_sink += total;
+    return in->gz.len;
+}
+
+static size_t op_gemfile_lex(struct bench_inputs *in)
+{
+    const struct bench_buf *b = &in->gemfiles[in->pos++ % in->n_gemfiles];
+    struct wow_lexer lex;
+    struct wow_token tok;
+    wow_lexer_init(&lex, b->data, (int)b->len);
+    int id;
+    while ((id = wow_lexer_scan(&lex, &tok)) != 0)
+        bench_sink += (uint64_t)id;
+    return b->len;
+}
+
+struct bench_prim {
+    const char *name;
+    size_t    (*op)(struct bench_inputs *in);
+};
+
+static const struct bench_prim prims[] = {
+    { "gemver-parse",      op_gemver_parse },
+    { "gemver-cmp",        op_gemver_cmp },
+    { "constraints-parse", op_constraints_parse },
+    { "gemver-match",      op_gemver_match },
+    { "ci-line",           op_ci_line },
+    { "ci-tokenize",       op_ci_tokenize },
+    { "range-intersect",   op_range_intersect },
+    { "sha256",            op_sha256 },
+    { "gunzip",            op_gunzip },
+    { "tar-read",          op_tar_read },
+    { "gemfile-lex",       op_gemfile_lex },
+};
+#define N_PRIMS (sizeof(prims) / sizeof(prims[0]))
+
+/* ------------------------------------------------------------------ */
+/* Measurement                                                         */
+/* ------------------------------------------------------------------ */
+
+struct bench_result {
+    double   ns_min, ns_median;
+    double   cyc_median;        /* 0 without a cycle counter */
+    double   bytes_per_sec;
+    uint64_t ops;               /* per repetition */
+};
+
+static int dbl_cmp(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double run_batch(const struct bench_prim *p, struct bench_inputs *in,
+                        uint64_t n, uint64_t *cycles, size_t *bytes)
+{
+    size_t b = 0;
+    uint64_t c0 = bench_cycles();
+    double t0 = wow_now_secs();
+    for (uint64_t i = 0; i < n; i++)
+        b += p->op(in);
+    double t = wow_now_secs() - t0;
+    *cycles = bench_cycles() - c0;
+    *bytes = b;
+    return t;
+}
+
+static void measure(const struct bench_prim *p, struct bench_inputs *in,
+                    int reps, double min_time, struct bench_result *r)
+{
+    uint64_t cyc;
+    size_t bytes;
+    in->pos = 0;
+
+    /* Warm up caches and branch predictors while finding a batch size
+     * that takes a measurable slice of min_time. */
+    uint64_t n = 1;
+    double t, warm = 0;
+    for (;;) {
+        t = run_batch(p, in, n, &cyc, &bytes);
+        warm += t;
+        if ((t >= min_time / 8 && warm >= BENCH_WARMUP_SECS) ||
+            n >= BENCH_MAX_BATCH)
+            break;
+        if (t < min_time / 8) n *= 2;
+    }
+    double scaled = t > 0 ? (double)n * min_time / t : (double)n;
+    n = scaled < 1 ? 1 : scaled > BENCH_MAX_BATCH ? BENCH_MAX_BATCH
+                                                  : (uint64_t)scaled;
+
+    double ns[BENCH_MAX_REPS], cy[BENCH_MAX_REPS];
+    size_t total_bytes = 0;
+    double total_secs = 0;
+    for (int i = 0; i < reps; i++) {
+        t = run_batch(p, in, n, &cyc, &bytes);
+        ns[i] = t * 1e9 / (double)n;
+        cy[i] = (double)cyc / (double)n;
+        total_bytes += bytes;
+        total_secs += t;
+    }
+    qsort(ns, (size_t)reps, sizeof(double), dbl_cmp);
+    qsort(cy, (size_t)reps, sizeof(double), dbl_cmp);
+
+    r->ns_min = ns[0];
+    r->ns_median = ns[reps / 2];
+    r->cyc_median = cy[reps / 2];
+    r->bytes_per_sec = total_secs > 0 ? (double)total_bytes / total_secs : 0;
+    r->ops = n;
+}
+
+/* ------------------------------------------------------------------ */
+/* Command                                                             */
+/* ------------------------------------------------------------------ */
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: wow debug bench [-r N] [--min-time SECS] "
+            "[--fixtures DIR] [--input FILE] [--json] [<primitive>...]\n"
+            "primitives:");
+    for (size_t i = 0; i < N_PRIMS; i++)
+        fprintf(stderr, " %s", prims[i].name);
+    fprintf(stderr, "\n");
+}
+
+int cmd_debug_bench(int argc, char *argv[])
+{
+    const char *fixtures = "tests", *input = NULL;
+    int reps = 7, json = 0;
+    double min_time = 0.05;
+    int selected[N_PRIMS] = {0};
+    int any = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            reps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+            min_time = atof(argv[++i]);
+        else if (strcmp(argv[i], "--fixtures") == 0 && i + 1 < argc)
+            fixtures = argv[++i];
+        else if (strcmp(argv[i], "--input") == 0 && i + 1 < argc)
+            input = argv[++i];
+        else if (strcmp(argv[i], "--json") == 0)
+            json = 1;
+        else if (argv[i][0] == '-') {
+            usage();
+            return 2;
+        } else {
+            size_t k = 0;
+            while (k < N_PRIMS && strcmp(argv[i], prims[k].name) != 0) k++;
+            if (k == N_PRIMS) {
+                fprintf(stderr, "wow: unknown primitive: %s\n", argv[i]);
+                usage();
+                return 2;
+            }
+            selected[k] = any = 1;
+        }
+    }
+    if (reps < 1) reps = 1;
+    if (reps > BENCH_MAX_REPS) reps = BENCH_MAX_REPS;
+    if (min_time <= 0) min_time = 0.05;
+
+    struct bench_inputs in;
+    memset(&in, 0, sizeof(in));
+    wow_arena_init(&in.arena);
+
+    char default_archive[WOW_OS_PATH_MAX];
+    snprintf(default_archive, sizeof(default_archive),
+             "%s/fixtures/valid.tar.gz", fixtures);
+    in.archive = input ? input : default_archive;
+
+    if (load_index(&in, fixtures) != 0 || load_gemfiles(&in, fixtures) != 0 ||
+        read_all(in.archive, &in.gz) != 0) {
+        if (!in.gz.data)
+            fprintf(stderr, "wow: cannot read %s\n", in.archive);
+        free_inputs(&in);
+        return 1;
+    }
+
+    if (!json) {
+        printf("%zu index lines, %zu versions, %zu requirements, "
+               "%zu Gemfiles, %s (%zu bytes)\n\n",
+               in.n_lines, in.n_vers, in.n_reqs, in.n_gemfiles,
+               in.archive, in.gz.len);
+        printf("%-18s %10s %10s %9s %10s %10s\n", "primitive", "ns/op min",
+               "ns/op med", "cyc/op", "MB/s", "ops/rep");
+    }
+
+    for (size_t k = 0; k < N_PRIMS; k++) {
+        if (any && !selected[k]) continue;
+        struct bench_result r;
+        measure(&prims[k], &in, reps, min_time, &r);
+
+        if (json) {
+            printf("{\"primitive\":\"%s\",\"ns_per_op_min\":%.2f,"
+                   "\"ns_per_op_median\":%.2f,\"cycles_per_op\":%.1f,"
+                   "\"bytes_per_sec\":%.0f,\"ops_per_rep\":%llu,"
+                   "\"reps\":%d}\n",
+                   prims[k].name, r.ns_min, r.ns_median, r.cyc_median,
+                   r.bytes_per_sec, (unsigned long long)r.ops, reps);
+            continue;
+        }
+
+        char cyc[16] = "-", mbs[16] = "-";
+        if (r.cyc_median > 0)
+            snprintf(cyc, sizeof(cyc), "%.1f", r.cyc_median);
+        if (r.bytes_per_sec > 0)
+            snprintf(mbs, sizeof(mbs), "%.1f", r.bytes_per_sec / 1e6);
+        printf("%-18s %10.1f %10.1f %9s %10s %10llu\n", prims[k].name,
+               r.ns_min, r.ns_median, cyc, mbs, (unsigned long long)r.ops);
+    }
+
+    free_inputs(&in);
+    return 0;
+}
@@ -0,0 +1,431 @@
+/*
+ * resolver/test/bench_resolve.c — Offline resolver benchmark
+ *
+ *   wow debug bench-resolve [options] <corpus-dir>
+ *
+ *   -n N             iterations per case (default: adaptive, >= 3)
+ *   --save FILE      write results as a baseline (TSV)
+ *   --baseline FILE  compare against a saved baseline
+ *   --threshold PCT  allowed median slowdown vs baseline (default 10)
+ *
+ * Corpus layout (see tests/bench/resolve/README.md):
+ *
+ *   <corpus>/index/info/<gem>      recorded compact index responses
+ *   <corpus>/cases/<name>/Gemfile  one case per directory
+ *   <corpus>/cases/<name>/expect   optional: "conflict" if the case
+ *                                  must fail to resolve
+ *
+ * Every iteration resolves with a fresh compact index provider over a
+ * file:// source, so index parsing is part of the measurement exactly
+ * as it is in `wow lock`; no network is touched.  Platform and Ruby
+ * metadata filtering are off so results do not depend on the host.
+ *
+ * A case fails when its outcome differs from expect, when its median
+ * wall time exceeds the baseline by more than the threshold (and by
+ * more than BENCH_NOISE_SECS, so tiny cases don't flap), or when it
+ * needs more solver decisions than the baseline recorded (the decision
+ * count is deterministic, so any increase is a real change).
+ * Cases whose root gems were never recorded are skipped.
+ */
+
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "wow/common.h"
+#include "wow/gemfile.h"
+#include "wow/resolver.h"
+#include "wow/util/fmt.h"
+#include "wow/util/time.h"
+
+#define BENCH_MAX_CASES   64
+#define BENCH_MAX_ITERS   1000
+#define BENCH_MIN_ITERS   3
+#define BENCH_TARGET_SECS 0.5
+#define BENCH_NOISE_SECS  0.0005   /* slowdowns below this are jitter */
+
+struct bench_case {
+    char   name[64];
+    int    expect_conflict;
+    int    skipped;
+    int    ok;              /* resolved (or conflicted) as expected */
+    int    resolved;
+    int    n_solved;
+    int    iters;
+    double median, min;     /* seconds */
+    wow_solver_stats stats; /* from the last iteration */
+    size_t mem;             /* solver + index memory, bytes */
+};
+
+struct bench_baseline {
+    char   name[64];
+    double median;
+    int    decisions;
+};
+
+/* ------------------------------------------------------------------ */
+/* Gemfile → root requirements                                         */
+/* ------------------------------------------------------------------ */
+
+static int load_roots(const char *gemfile_path, struct wow_gemfile *gf,
+                      const char ***names_out, wow_gem_constraints **cs_out)
+{
+    if (wow_gemfile_parse_file(gemfile_path, gf) != 0)
+        return -1;
+
+    size_t n = gf->n_deps;
+    const char **names = calloc(n ? n : 1, sizeof(*names));
+    wow_gem_constraints *cs = calloc(n ? n : 1, sizeof(*cs));
+    if (!names || !cs) {
+        free(names);
+        free(cs);
+        wow_gemfile_free(gf);
+        return -1;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        const struct wow_gemfile_dep *d = &gf->deps[i];
+        char joined[256] = ">= 0";
+        size_t pos = 0;
+        int fits = 1;
+        for (int j = 0; j < d->n_constraints && fits; j++) {
+            int w = snprintf(joined + pos, sizeof(joined) - pos,
+                             "%s%s", j ? ", " : "", d->constraints[j]);
+            if (w < 0 || pos + (size_t)w >= sizeof(joined))
+                fits = 0;
+            else
+                pos += (size_t)w;
+        }
+        names[i] = d->name;
+        if (!fits) {
+            fprintf(stderr, "wow: %s: constraints for %s too long\n",
+                    gemfile_path, d->name);
+            free(names);
+            free(cs);
+            wow_gemfile_free(gf);
+            return -1;
+        }
+        if (wow_gem_constraints_parse(joined, &cs[i]) != 0) {
+            fprintf(stderr, "wow: %s: invalid constraint for %s: %s\n",
+                    gemfile_path, d->name, joined);
+            free(names);
+            free(cs);
+            wow_gemfile_free(gf);
+            return -1;
+        }
+    }
+
+    *names_out = names;
+    *cs_out = cs;
+    return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* One case                                                            */
+/* ------------------------------------------------------------------ */
+
+static int dbl_cmp(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void run_case(struct bench_case *bc, const char *corpus,
+                     const char *source, int fixed_iters)
+{
+    char path[WOW_OS_PATH_MAX];
+    snprintf(path, sizeof(path), "%s/cases/%.63s/expect", corpus, bc->name);
+    FILE *ef = fopen(path, "r");
+    if (ef) {
+        char word[32] = "";
+        if (fscanf(ef, "%31s", word) == 1)
+            bc->expect_conflict = strcmp(word, "conflict") == 0;
+        fclose(ef);
+    }
+
+    snprintf(path, sizeof(path), "%s/cases/%.63s/Gemfile", corpus,
+             bc->name);
+    struct wow_gemfile gf;
+    const char **names;
+    wow_gem_constraints *cs;
+    if (load_roots(path, &gf, &names, &cs) != 0) {
+        fprintf(stderr, "wow: %s: cannot load %s\n", bc->name, path);
+        return;
+    }
+    int n_roots = (int)gf.n_deps;
+
+    /* Cases are only as good as their recording */
+    for (int i = 0; i < n_roots; i++) {
+        snprintf(path, sizeof(path), "%s/index/info/%.*s", corpus,
+                 NAME_MAX, names[i]);
+        if (access(path, R_OK) != 0) {
+            bc->skipped = 1;
+            goto out;
+        }
+    }
+
+    double times[BENCH_MAX_ITERS];
+    double total = 0;
+    int iters = 0;
+    int want = fixed_iters > 0 ? fixed_iters : BENCH_MAX_ITERS;
+    if (want > BENCH_MAX_ITERS) want = BENCH_MAX_ITERS;
+
+    while (iters < want) {
+        wow_ci_provider *ci = malloc(sizeof(*ci));
+        if (!ci) break;
+        wow_ci_provider_init(ci, source, NULL, NULL);
+        wow_ci_provider_set_platforms(ci, NULL, 0);
+        wow_provider prov = wow_ci_provider_as_provider(ci);
+        wow_solver s;
+        wow_solver_init(&s, &prov);
+
+        double t0 = wow_now_secs();
+        int rc = wow_solve(&s, names, cs, n_roots);
+        double dt = wow_now_secs() - t0;
+
+        times[iters++] = dt;
+        total += dt;
+        bc->resolved = rc == 0;
+        bc->n_solved = s.n_solved;
+        bc->stats = s.stats;
+        bc->mem = s.arena.used + ci->arena.used +
+                  (size_t)s.assign_cap * sizeof(wow_assignment) +
+                  (size_t)s.incomps_cap * sizeof(wow_aoff);
+
+        wow_solver_destroy(&s);
+        wow_ci_provider_destroy(ci);
+        free(ci);
+
+        if (fixed_iters <= 0 && iters >= BENCH_MIN_ITERS &&
+            total >= BENCH_TARGET_SECS)
+            break;
+    }
+
+    bc->iters = iters;
+    if (iters > 0) {
+        qsort(times, (size_t)iters, sizeof(double), dbl_cmp);
+        bc->min = times[0];
+        bc->median = times[iters / 2];
+    }
+    bc->ok = iters > 0 && bc->resolved != bc->expect_conflict;
+
+out:
+    free(names);
+    free(cs);
+    wow_gemfile_free(&gf);
+}
+
+/* ------------------------------------------------------------------ */
+/* Baselines                                                           */
+/* ------------------------------------------------------------------ */
+
+static int load_baseline(const char *path, struct bench_baseline *bl, int max)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "wow: cannot read baseline %s\n", path);
+        return -1;
+    }
+    int n = 0;
+    char line[256];
+    while (n < max && fgets(line, sizeof(line), f)) {
+        if (line[0] == '#') continue;
+        double us;
+        if (sscanf(line, "%63s %lf %d", bl[n].name, &us,
+                   &bl[n].decisions) == 3) {
+            bl[n].median = us / 1e6;
+            n++;
+        }
+    }
+    fclose(f);
+    return n;
+}
+
+static int save_baseline(const char *path, const struct bench_case *cases,
+                         int n)
+{
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        fprintf(stderr, "wow: cannot write baseline %s\n", path);
+        return -1;
+    }
+    fprintf(f, "# case\tmedian_us\tdecisions\tconflicts\tmem_bytes\n");
+    for (int i = 0; i < n; i++) {
+        const struct bench_case *bc = &cases[i];
+        if (bc->skipped || bc->iters == 0) continue;
+        fprintf(f, "%s\t%.1f\t%d\t%d\t%zu\n", bc->name, bc->median * 1e6,
+                bc->stats.decisions, bc->stats.conflicts, bc->mem);
+    }
+    fclose(f);
+    return 0;
+}
+
+static const struct bench_baseline *find_baseline(
+    const struct bench_baseline *bl, int n, const char *name)
+{
+    for (int i = 0; i < n; i++)
+        if (strcmp(bl[i].name, name) == 0)
+            return &bl[i];
+    return NULL;
+}
+
+/* ------------------------------------------------------------------ */
+/* Driver                                                              */
+/* ------------------------------------------------------------------ */
+
+static int name_cmp(const void *a, const void *b)
+{
+    return strcmp(((const struct bench_case *)a)->name,
+                  ((const struct bench_case *)b)->name);
+}
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: wow debug bench-resolve [-n N] [--save FILE] "
+            "[--baseline FILE] [--threshold PCT] <corpus-dir>\n");
+}
+
+int cmd_debug_bench_resolve(int argc, char *argv[])
+{
+    const char *corpus_arg = NULL, *save = NULL, *baseline = NULL;
+    int fixed_iters = 0;
+    double threshold = 10.0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            fixed_iters = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc)
+            save = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+            baseline = argv[++i];
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+            threshold = atof(argv[++i]);
+        else if (argv[i][0] == '-') {
+            usage();
+            return 2;
+        } else
+            corpus_arg = argv[i];
+    }
+    if (!corpus_arg) {
+        usage();
+        return 2;
+    }
+
+    /* Room below the corpus for cases/<name>/Gemfile and index/info/<gem> */
+    char real[PATH_MAX];
+    char corpus[WOW_DIR_PATH_MAX - 128];
+    if (!realpath(corpus_arg, real)) {
+        fprintf(stderr, "wow: cannot find corpus %s\n", corpus_arg);
+        return 2;
+    }
+    if (strlen(real) >= sizeof(corpus)) {
+        fprintf(stderr, "wow: corpus path too long: %s\n", real);
+        return 2;
+    }
+    memcpy(corpus, real, strlen(real) + 1);
+    char source[sizeof(corpus) + 16];
+    snprintf(source, sizeof(source), "file://%s/index", corpus);
+
+    /* Collect cases */
+    static struct bench_case cases[BENCH_MAX_CASES];
+    int n_cases = 0;
+    char dir[sizeof(corpus) + 8];
+    snprintf(dir, sizeof(dir), "%s/cases", corpus);
+    DIR *d = opendir(dir);
+    if (!d) {
+        fprintf(stderr, "wow: no cases in %s\n", dir);
+        return 2;
+    }
+    struct dirent *ent;
+    while ((ent = readdir(d)) && n_cases < BENCH_MAX_CASES) {
+        size_t len = strlen(ent->d_name);
+        if (ent->d_name[0] == '.' || len >= sizeof(cases[0].name))
+            continue;
+        memset(&cases[n_cases], 0, sizeof(cases[n_cases]));
+        memcpy(cases[n_cases].name, ent->d_name, len + 1);
+        n_cases++;
+    }
+    closedir(d);
+    qsort(cases, (size_t)n_cases, sizeof(cases[0]), name_cmp);
+
+    static struct bench_baseline bl[BENCH_MAX_CASES];
+    int n_bl = 0;
+    if (baseline) {
+        n_bl = load_baseline(baseline, bl, BENCH_MAX_CASES);
+        if (n_bl < 0) return 2;
+    }
+
+    printf("%-24s %-12s %6s %10s %10s %9s %9s %10s\n",
+           "case", "result", "iters", "median", "min",
+           "decisions", "conflicts", "memory");
+
+    int failed = 0;
+    for (int i = 0; i < n_cases; i++) {
+        struct bench_case *bc = &cases[i];
+        run_case(bc, corpus, source, fixed_iters);
+
+        if (bc->skipped) {
+            printf("%-24s %-12s (index not recorded)\n", bc->name, "skip");
+            continue;
+        }
+        if (bc->iters == 0) {
+            printf("%-24s %-12s\n", bc->name, "error");
+            failed++;
+            continue;
+        }
+
+        char result[32], mem[16];
+        if (bc->resolved)
+            snprintf(result, sizeof(result), "ok (%d)", bc->n_solved);
+        else
+            snprintf(result, sizeof(result), "conflict");
+        wow_fmt_bytes(bc->mem, mem, sizeof(mem));
+
+        printf("%-24s %-12s %6d %8.2fms %8.2fms %9d %9d %10s",
+               bc->name, result, bc->iters, bc->median * 1e3,
+               bc->min * 1e3, bc->stats.decisions, bc->stats.conflicts,
+               mem);
+
+        if (!bc->ok) {
+            printf("  FAIL: expected %s",
+                   bc->expect_conflict ? "conflict" : "a resolution");
+            failed++;
+        }
+
+        const struct bench_baseline *b = find_baseline(bl, n_bl, bc->name);
+        if (b) {
+            double pct = b->median > 0
+                       ? (bc->median / b->median - 1.0) * 100.0 : 0.0;
+            printf("  %+.1f%%", pct);
+            if (pct > threshold &&
+                bc->median - b->median > BENCH_NOISE_SECS) {
+                printf("  FAIL: slower than baseline (> %.0f%%)", threshold);
+                failed++;
+            }
+            if (bc->stats.decisions > b->decisions) {
+                printf("  FAIL: %d decisions, baseline %d",
+                       bc->stats.decisions, b->decisions);
+                failed++;
+            }
+        }
+        printf("\n");
+    }
+
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0)
+        printf("\npeak RSS %ld KiB\n", ru.ru_maxrss);
+
+    if (save && save_baseline(save, cases, n_cases) != 0)
+        return 2;
+
+    if (failed) {
+        printf("%d check(s) failed\n", failed);
+        return 1;
+    }
+    return 0;
+}
@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include "wow/resolver.h"
 #include "internal.h"
@@ -37,7 +38,34 @@ extern int fail_count;
  *   Q 1.0.0 depends on R >= 1.0
  *   R 1.5.0 (no deps)
  *   R 2.0.0 not available
- *   Expected: P=1.0.0, Q=1.0.0, R=1.5.0 (backtracks from Q 2.0.0)
+ *   Expected: P=1.0.0, Q=1.0.0, R=1.5.0 (backtracks from Q 2.0.0);
+ *   the solver stats record the conflict and the backjump
+ *
+ * Test 5 (preferred versions, as seeded from a lockfile):
+ *   L 2.0.0 / 1.0.0, both depend on M >= 1.0
+ *   M 2.0.0 / 1.0.0
+ *   Prefer L=1.0.0, M=1.0.0
+ *   Expected: L=1.0.0, M=1.0.0, each listed once only to confirm the
+ *   preferred version is still there; with root M >= 2.0 only M moves:
+ *   L=1.0.0, M=2.0.0; with M 1.0.0 yanked, M=2.0.0
+ *
+ * Test 7 (lock-seeded provider over the same kind of universe):
+ *   Gemfile.lock: L 1.0.0 -> M >= 1.0, N >= 1.0; M 1.0.0; N 1.0.0 in
+ *   generic and x86_64-linux variants
+ *   Expected: locked versions, L's deps (and so N) taken from the lock,
+ *   N's platform from the selected variant; a yanked M moves to the
+ *   newest; a lock for another source passes everything through
+ *
+ * Test 8 (lock still satisfies the Gemfile):
+ *   DEPENDENCIES "L (< 3, >= 1.0)" vs Gemfile "L", ">= 1.0", "< 3";
+ *   an arm64-darwin-only variant of N depends on an unlocked gem
+ *   Expected: satisfied on x86_64-linux; a changed constraint is not
+ *
+ * Test 9 (prefetch over a file:// index):
+ *   pa cached beforehand; prefetch pa, pb, pb, broken (a directory, so
+ *   reading it fails)
+ *   Expected: only pb added, fetched once; broken left uncached, so
+ *   the solver's own lookup retries it
  */
 
 #define MAX_HARDCODED_PKGS 8
@@ -75,10 +103,13 @@ static struct hc_pkg *hc_find(struct hc_universe *u, const char *name)
     return NULL;
 }
 
+static int hc_list_calls;
+
 static int hc_list_versions(void *ctx, const char *package,
                              const wow_gemver **out, int *n_out)
 {
     struct hc_universe *u = ctx;
+    hc_list_calls++;
     struct hc_pkg *pkg = hc_find(u, package);
     if (!pkg) {
         *out = NULL;
@@ -125,6 +156,17 @@ static int hc_get_deps(void *ctx, const char *package,
     return 0;
 }
 
+/* Preferred versions for test 5 */
+static wow_gemver hc_pref_l, hc_pref_m;
+
+static const wow_gemver *hc_preferred(void *ctx, const char *package)
+{
+    (void)ctx;
+    if (strcmp(package, "L") == 0) return &hc_pref_l;
+    if (strcmp(package, "M") == 0) return &hc_pref_m;
+    return NULL;
+}
+
 static void hc_add_pkg(struct hc_universe *u, const char *name)
 {
     struct hc_pkg *p = &u->pkgs[u->n_pkgs++];
@@ -176,6 +218,39 @@ static void check_solved(wow_solver *s, const char *name,
     fprintf(stderr, "  FAIL: %s not in solution\n", name);
 }
 
+static void write_file(const char *dir, const char *name, const char *mode,
+                       const char *text)
+{
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE *f = fopen(path, mode);
+    if (!f) return;
+    fputs(text, f);
+    fclose(f);
+}
+
+/* Lock sb for the solution cache test; returns 1 on a cache hit */
+static int solve_cached(const char *source, wow_solver *s,
+                        wow_ci_provider *ci)
+{
+    const char *roots[] = { "sa" };
+    wow_gem_constraints rcs[1];
+    wow_gem_constraints_parse(">= 0", &rcs[0]);
+
+    wow_ci_provider_init(ci, source, NULL, NULL);
+    static wow_provider prov;
+    prov = wow_ci_provider_as_provider(ci);
+    wow_solver_init(s, &prov);
+
+    char key[65];
+    if (wow_solcache_key(ci, roots, rcs, 1, NULL, key, sizeof(key)) != 0)
+        return -1;
+    if (wow_solcache_load(key, ci, s) == 0) return 1;
+    if (wow_solve(s, roots, rcs, 1) != 0) return -1;
+    wow_solcache_store(key, ci, s);
+    return 0;
+}
+
 int cmd_debug_pubgrub_test(int argc, char *argv[])
 {
     (void)argc; (void)argv;
@@ -327,6 +402,17 @@ int cmd_debug_pubgrub_test(int argc, char *argv[])
         check_solved(&s, "Q", "1.0.0");
         check_solved(&s, "R", "1.5.0");
 
+        test_count++;
+        if (s.stats.conflicts >= 1 && s.stats.backjumps >= 1 &&
+            s.stats.decisions > s.n_solved) {
+            pass_count++;
+        } else {
+            fail_count++;
+            fprintf(stderr, "  FAIL: stats: %d conflicts, %d backjumps, "
+                    "%d decisions\n", s.stats.conflicts,
+                    s.stats.backjumps, s.stats.decisions);
+        }
+
         wow_solver_destroy(&s);
     }
 
@@ -376,6 +462,442 @@ int cmd_debug_pubgrub_test(int argc, char *argv[])
         wow_solver_destroy(&s);
     }
 
+    /* --- Test 5: Preferred (locked) versions --- */
+    printf("\nTest 5: Preferred versions (lockfile seed)\n");
+    {
+        static struct hc_universe u;
+        memset(&u, 0, sizeof(u));
+
+        hc_add_pkg(&u, "L");
+        hc_add_ver(&u, "L", "2.0.0");
+        hc_add_ver(&u, "L", "1.0.0");
+        hc_add_dep(&u, "L", "2.0.0", "M", ">= 1.0");
+        hc_add_dep(&u, "L", "1.0.0", "M", ">= 1.0");
+
+        hc_add_pkg(&u, "M");
+        hc_add_ver(&u, "M", "2.0.0");
+        hc_add_ver(&u, "M", "1.0.0");
+
+        wow_gemver_parse("1.0.0", &hc_pref_l);
+        wow_gemver_parse("1.0.0", &hc_pref_m);
+
+        wow_provider prov = {
+            .list_versions = hc_list_versions,
+            .get_deps = hc_get_deps,
+            .preferred_version = hc_preferred,
+            .ctx = &u,
+        };
+
+        /* Unchanged roots: the seed is taken as-is */
+        wow_solver s;
+        wow_solver_init(&s, &prov);
+        const char *roots[] = { "L", "M" };
+        wow_gem_constraints rcs[2];
+        wow_gem_constraints_parse(">= 0", &rcs[0]);
+        wow_gem_constraints_parse(">= 0", &rcs[1]);
+
+        hc_list_calls = 0;
+        int rc = wow_solve(&s, roots, rcs, 2);
+        test_count++;
+        if (rc == 0 && hc_list_calls == 2 && s.stats.preferred == 2) {
+            pass_count++;
+        } else {
+            fail_count++;
+            fprintf(stderr, "  FAIL: rc=%d, %d version listings\n",
+                    rc, hc_list_calls);
+        }
+        check_solved(&s, "L", "1.0.0");
+        check_solved(&s, "M", "1.0.0");
+        wow_solver_destroy(&s);
+
+        /* A tightened root moves only the affected package */
+        wow_solver_init(&s, &prov);
+        wow_gem_constraints_parse(">= 2.0", &rcs[1]);
+        rc = wow_solve(&s, roots, rcs, 2);
+        test_count++;
+        if (rc == 0) {
+            pass_count++;
+        } else {
+            fail_count++;
+            fprintf(stderr, "  FAIL: expected success, got error: %s\n",
+                    s.error_msg);
+        }
+        check_solved(&s, "L", "1.0.0");
+        check_solved(&s, "M", "2.0.0");
+        wow_solver_destroy(&s);
+
+        /* A preferred version that has been yanked is not reused */
+        hc_find(&u, "M")->n_versions = 1;
+        wow_solver_init(&s, &prov);
+        wow_gem_constraints_parse(">= 0", &rcs[1]);
+        rc = wow_solve(&s, roots, rcs, 2);
+        test_count++;
+        if (rc == 0 && s.stats.preferred == 1) {
+            pass_count++;
+        } else {
+            fail_count++;
+            fprintf(stderr, "  FAIL: rc=%d, %d preferred\n",
+                    rc, s.stats.preferred);
+        }
+        check_solved(&s, "L", "1.0.0");
+        check_solved(&s, "M", "2.0.0");
+        wow_solver_destroy(&s);
+    }
+
+    /* --- Test 6: Solution cache --- */
+    printf("\nTest 6: Solution cache (hit, then index change)\n");
+    {
+        char tmp[] = "/tmp/wow-solcache-XXXXXX";
+        char info[64], source[64];
+        const char *old_xdg = getenv("XDG_CACHE_HOME");
+        char *saved = old_xdg ? strdup(old_xdg) : NULL;
+        test_count++;
+        if (!mkdtemp(tmp)) {
+            fail_count++;
+            fprintf(stderr, "  FAIL: mkdtemp\n");
+        } else {
+            pass_count++;
+            setenv("XDG_CACHE_HOME", tmp, 1);
+            snprintf(info, sizeof(info), "%s/info", tmp);
+            snprintf(source, sizeof(source), "file://%s", tmp);
+            mkdir(info, 0755);
+            write_file(info, "sa", "w",
+                       "---\n1.0.0 sb:>= 1.0|checksum:aa\n");
+            write_file(info, "sb", "w",
+                       "---\n1.0.0 |checksum:bb\n1.1.0 |checksum:cc\n");
+
+            static const int want_hit[] = { 0, 1, 0 };
+            static const char *want_b[] = { "1.1.0", "1.1.0", "1.2.0" };
+            for (int round = 0; round < 3; round++) {
+                /* A new release of sb invalidates the stored solution */
+                if (round == 2)
+                    write_file(info, "sb", "a", "1.2.0 |checksum:dd\n");
+
+                wow_solver s;
+                wow_ci_provider ci;
+                int hit = solve_cached(source, &s, &ci);
+                test_count++;
+                if (hit == want_hit[round]) {
+                    pass_count++;
+                } else {
+                    fail_count++;
+                    fprintf(stderr, "  FAIL: round %d: hit=%d, want %d\n",
+                            round, hit, want_hit[round]);
+                }
+                check_solved(&s, "sa", "1.0.0");
+                check_solved(&s, "sb", want_b[round]);
+                wow_solver_destroy(&s);
+                wow_ci_provider_destroy(&ci);
+            }
+
+            char cmd[128];
+            snprintf(cmd, sizeof(cmd), "/bin/rm -rf '%s'", tmp);
+            (void)!system(cmd);
+        }
+        if (saved) setenv("XDG_CACHE_HOME", saved, 1);
+        else unsetenv("XDG_CACHE_HOME");
+        free(saved);
+    }
+
+    /* --- Test 7: Lock-seeded provider --- */
+    printf("\nTest 7: Lock-seeded provider\n");
+    {
+        static struct hc_universe u;
+        memset(&u, 0, sizeof(u));
+
+        hc_add_pkg(&u, "L");
+        hc_add_ver(&u, "L", "2.0.0");
+        hc_add_ver(&u, "L", "1.0.0");
+        hc_add_dep(&u, "L", "1.0.0", "M", ">= 1.0");
+        hc_add_pkg(&u, "M");
+        hc_add_ver(&u, "M", "2.0.0");
+        hc_add_ver(&u, "M", "1.0.0");
+        hc_add_pkg(&u, "N");
+        hc_add_ver(&u, "N", "1.0.0");
+
+        wow_provider inner = {
+            .list_versions = hc_list_versions,
+            .get_deps = hc_get_deps,
+            .ctx = &u,
+        };
+
+        char tmp[] = "/tmp/wow-lockprov-XXXXXX";
+        char lock_path[64];
+        struct wow_lockfile lf;
+        wow_resolved_pkg *locked = NULL;
+        int n_locked = 0;
+        char why[256];
+        const char *plats[] = { "x86_64-linux" };
+        test_count++;
+        if (!mkdtemp(tmp)) {
+            fail_count++;
+            fprintf(stderr, "  FAIL: mkdtemp\n");
+        } else {
+            write_file(tmp, "Gemfile.lock", "w",
+                       "GEM\n"
+                       "  remote: https://rubygems.org/\n"
+                       "  specs:\n"
+                       "    L (1.0.0)\n"
+                       "      M (>= 1.0)\n"
+                       "      N (>= 1.0)\n"
+                       "    M (1.0.0)\n"
+                       "    N (1.0.0)\n"
+                       "    N (1.0.0-x86_64-linux)\n"
+                       "\n"
+                       "PLATFORMS\n"
+                       "  ruby\n"
+                       "  x86_64-linux\n"
+                       "\n"
+                       "DEPENDENCIES\n"
+                       "  L\n");
+            snprintf(lock_path, sizeof(lock_path), "%s/Gemfile.lock", tmp);
+            if (wow_lockfile_parse(lock_path, &lf) == 0 &&
+                wow_lockfile_select(&lf, plats, 1, &locked, &n_locked,
+                                    why, sizeof(why)) == 0 &&
+                n_locked == 3) {
+                pass_count++;
+            } else {
+                fail_count++;
+                fprintf(stderr, "  FAIL: lock not read: %s\n", why);
+                n_locked = 0;
+            }
+        }
+
+        const char *roots[] = { "L" };
+        wow_gem_constraints rcs[1];
+        wow_gem_constraints_parse(">= 0", &rcs[0]);
+
+        for (int round = 0; n_locked > 0 && round < 3; round++) {
+            /* 0: seeded; 1: M 1.0.0 yanked; 2: lock for another source */
+            if (round == 1) hc_find(&u, "M")->n_versions = 1;
+            const char *source = round == 2 ? "https://gems.example.com"
+                                            : "https://rubygems.org";
+            wow_lock_provider lp;
+            test_count++;
+            if (wow_lock_provider_init(&lp, &lf, locked, n_locked, source,
+                                       &inner) != 0 ||
+                lp.n_pkgs != (round == 2 ? 0 : 3)) {
+                fail_count++;
+                fprintf(stderr, "  FAIL: round %d: init\n", round);
+                continue;
+            }
+            pass_count++;
+
+            wow_provider prov = wow_lock_provider_as_provider(&lp);
+            test_count++;
+            if (!prov.preferred_version(prov.ctx, "X") &&
+                (round == 2) == !prov.preferred_version(prov.ctx, "L")) {
+                pass_count++;
+            } else {
+                fail_count++;
+                fprintf(stderr, "  FAIL: round %d: preferred\n", round);
+            }
+
+            wow_solver s;
+            wow_solver_init(&s, &prov);
+            int rc = wow_solve(&s, roots, rcs, 1);
+            test_count++;
+            if (rc == 0) {
+                pass_count++;
+            } else {
+                fail_count++;
+                fprintf(stderr, "  FAIL: round %d: %s\n", round,
+                        s.error_msg);
+            }
+            if (round == 2) {
+                /* Index only: newest L, which has no deps */
+                check_solved(&s, "L", "2.0.0");
+                test_count++;
+                if (s.n_solved == 1) pass_count++;
+                else fail_count++;
+            } else {
+                check_solved(&s, "L", "1.0.0");
+                check_solved(&s, "M", round == 0 ? "1.0.0" : "2.0.0");
+                check_solved(&s, "N", "1.0.0");
+                const char *np = NULL;
+                for (int i = 0; i < s.n_solved; i++)
+                    if (strcmp(s.solution[i].name, "N") == 0)
+                        np = s.solution[i].platform;
+                test_count++;
+                if (np && strcmp(np, "x86_64-linux") == 0) {
+                    pass_count++;
+                } else {
+                    fail_count++;
+                    fprintf(stderr, "  FAIL: N platform %s\n",
+                            np ? np : "(generic)");
+                }
+            }
+            wow_solver_destroy(&s);
+            wow_lock_provider_destroy(&lp);
+        }
+
+        if (n_locked > 0) {
+            free(locked);
+            wow_lockfile_free(&lf);
+        }
+        char cmd[128];
+        snprintf(cmd, sizeof(cmd), "/bin/rm -rf '%s'", tmp);
+        (void)!system(cmd);
+    }
+
+    /* --- Test 8: Lock satisfies Gemfile --- */
+    printf("\nTest 8: Lock satisfies Gemfile\n");
+    {
+        char tmp[] = "/tmp/wow-locksat-XXXXXX";
+        char lock_path[64], why[256] = "";
+        struct wow_lockfile lf;
+        wow_resolved_pkg *locked = NULL;
+        int n_locked = 0;
+        const char *plats[] = { "x86_64-linux" };
+        test_count++;
+        if (!mkdtemp(tmp)) {
+            fail_count++;
+            fprintf(stderr, "  FAIL: mkdtemp\n");
+        } else {
+            write_file(tmp, "Gemfile.lock", "w",
+                       "GEM\n"
+                       "  remote: https://rubygems.org/\n"
+                       "  specs:\n"
+                       "    L (2.0.0)\n"
+                       "      N (>= 1.0)\n"
+                       "    N (1.0.0)\n"
+                       "    N (1.0.0-arm64-darwin)\n"
+                       "      Z (>= 1.0)\n"
+                       "\n"
+                       "PLATFORMS\n"
+                       "  arm64-darwin\n"
+                       "  ruby\n"
+                       "\n"
+                       "DEPENDENCIES\n"
+                       "  L (< 3, >= 1.0)\n");
+            snprintf(lock_path, sizeof(lock_path), "%s/Gemfile.lock", tmp);
+            if (wow_lockfile_parse(lock_path, &lf) == 0 &&
+                wow_lockfile_select(&lf, plats, 1, &locked, &n_locked,
+                                    why, sizeof(why)) == 0) {
+                pass_count++;
+            } else {
+                fail_count++;
+                fprintf(stderr, "  FAIL: lock not read: %s\n", why);
+                n_locked = 0;
+            }
+        }
+
+        char *cs[] = { "< 3, >= 1.0", "<3" };
+        struct wow_gemfile_dep dep = { .name = "L", .constraints = cs,
+                                       .n_constraints = 1 };
+        struct wow_gemfile gf = { .deps = &dep, .n_deps = 1 };
+        if (n_locked > 0) {
+            /* N's darwin variant needs Z, which this host never installs */
+            test_count++;
+            if (wow_lockfile_satisfies(&lf, &gf, "https://rubygems.org",
+                                       locked, n_locked, why,
+                                       sizeof(why)) == 1) {
+                pass_count++;
+            } else {
+                fail_count++;
+                fprintf(stderr, "  FAIL: other variant's deps: %s\n", why);
+            }
+
+            cs[0] = ">= 1.0";
+            dep.n_constraints = 2;
+            test_count++;
+            if (wow_lockfile_satisfies(&lf, &gf, "https://rubygems.org",
+                                       locked, n_locked, why,
+                                       sizeof(why)) == 1) {
+                pass_count++;
+            } else {
+                fail_count++;
+                fprintf(stderr, "  FAIL: reordered constraints: %s\n",
+                        why);
+            }
+
+            cs[1] = "< 2";
+            test_count++;
+            if (wow_lockfile_satisfies(&lf, &gf, "https://rubygems.org",
+                                       locked, n_locked, why,
+                                       sizeof(why)) == 0 &&
+                strstr(why, "constraint for L changed")) {
+                pass_count++;
+            } else {
+                fail_count++;
+                fprintf(stderr, "  FAIL: changed constraint accepted\n");
+            }
+            free(locked);
+            wow_lockfile_free(&lf);
+        }
+        char cmd[128];
+        snprintf(cmd, sizeof(cmd), "/bin/rm -rf '%s'", tmp);
+        (void)!system(cmd);
+    }
+
+    /* --- Test 9: Prefetch --- */
+    printf("\nTest 9: Prefetch (dedup, cached, failed fetch)\n");
+    {
+        char tmp[] = "/tmp/wow-prefetch-XXXXXX";
+        char info[64], source[64], broken[80];
+        test_count++;
+        if (!mkdtemp(tmp)) {
+            fail_count++;
+            fprintf(stderr, "  FAIL: mkdtemp\n");
+        } else {
+            pass_count++;
+            snprintf(info, sizeof(info), "%s/info", tmp);
+            snprintf(source, sizeof(source), "file://%s", tmp);
+            snprintf(broken, sizeof(broken), "%s/broken", info);
+            mkdir(info, 0755);
+            mkdir(broken, 0755);
+            write_file(info, "pa", "w", "---\n1.0.0 |checksum:aa\n");
+            write_file(info, "pb", "w",
+                       "---\n1.0.0 pa:>= 1.0|checksum:bb\n");
+
+            wow_ci_provider ci;
+            wow_ci_provider_init(&ci, source, NULL, NULL);
+            wow_provider prov = wow_ci_provider_as_provider(&ci);
+            const wow_gemver *vers;
+            int n_ver;
+            prov.list_versions(prov.ctx, "pa", &vers, &n_ver);
+
+            const char *names[] = { "pa", "pb", "pb", "broken" };
+            int added = wow_ci_provider_prefetch(&ci, names, 4, 2);
+            test_count++;
+            if (added == 1 && ci.n_pkgs == 2 && ci.stats.prefetched == 1 &&
+                ci.stats.cache_misses == 2) {
+                pass_count++;
+            } else {
+                fail_count++;
+                fprintf(stderr, "  FAIL: added %d, %d cached, %d "
+                        "prefetched, %d misses (want 1, 2, 1, 2)\n",
+                        added, ci.n_pkgs, ci.stats.prefetched,
+                        ci.stats.cache_misses);
+            }
+
+            /* pb is answered from memory; broken is fetched again */
+            int hits = ci.stats.cache_hits;
+            test_count++;
+            if (prov.list_versions(prov.ctx, "pb", &vers, &n_ver) == 0 &&
+                n_ver == 1 && ci.stats.cache_hits == hits + 1) {
+                pass_count++;
+            } else {
+                fail_count++;
+                fprintf(stderr, "  FAIL: prefetched pb not cached\n");
+            }
+            test_count++;
+            if (prov.list_versions(prov.ctx, "broken", &vers,
+                                   &n_ver) != 0 &&
+                ci.n_pkgs == 2 && ci.stats.cache_misses == 3) {
+                pass_count++;
+            } else {
+                fail_count++;
+                fprintf(stderr, "  FAIL: failed fetch was cached\n");
+            }
+            wow_ci_provider_destroy(&ci);
+
+            char cmd[128];
+            snprintf(cmd, sizeof(cmd), "/bin/rm -rf '%s'", tmp);
+            (void)!system(cmd);
+        }
+    }
+
     printf("\n%d tests: %d passed, %d failed\n",
            test_count, pass_count, fail_count);
 
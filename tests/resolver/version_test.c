@@ -86,6 +86,53 @@ static void check_match(const char *constraint, const char *version,
     }
 }
 
+/* Parse the first len bytes of s; must equal a full parse of expect */
+static void check_parse_n(const char *s, size_t len, const char *expect)
+{
+    test_count++;
+    wow_gemver got, want;
+    if (wow_gemver_parse(expect, &want) != 0 ||
+        wow_gemver_parse_n(s, len, &got) != 0) {
+        fail_count++;
+        fprintf(stderr, "  FAIL parse_n \"%.*s\": parse error\n",
+                (int)len, s);
+        return;
+    }
+    if (wow_gemver_cmp(&got, &want) == 0) {
+        pass_count++;
+    } else {
+        fail_count++;
+        fprintf(stderr, "  FAIL parse_n \"%.*s\": expected %s\n",
+                (int)len, s, expect);
+    }
+}
+
+/* Bounded constraint parse: "~> 1.0" out of "~> 1.0&>= 1.0.2" */
+static void check_constraint_n(const char *s, size_t len,
+                               const char *version, bool expect)
+{
+    test_count++;
+    wow_gem_constraints cs;
+    wow_gemver v;
+    cs.count = 1;
+    if (wow_gem_constraint_parse_n(s, len, &cs.items[0]) != 0 ||
+        wow_gemver_parse(version, &v) != 0) {
+        fail_count++;
+        fprintf(stderr, "  FAIL constraint_n \"%.*s\": parse error\n",
+                (int)len, s);
+        return;
+    }
+    bool got = wow_gemver_match(&cs, &v);
+    if (got == expect) {
+        pass_count++;
+    } else {
+        fail_count++;
+        fprintf(stderr, "  FAIL constraint_n \"%.*s\" vs \"%s\": "
+                "expected %s\n", (int)len, s, version,
+                expect ? "true" : "false");
+    }
+}
+
 int cmd_debug_version_test(int argc, char *argv[])
 {
     (void)argc; (void)argv;
@@ -105,6 +152,14 @@ int cmd_debug_version_test(int argc, char *argv[])
     check_parse("", 0);
     check_parse("   ", 0);
 
+    /* Bounded parsing stops at len, not at NUL */
+    check_parse_n("1.2.3|checksum:abc", 5, "1.2.3");
+    check_parse_n("1.2.3-java|", 10, "1.2.3-java");
+    check_parse_n("4.0.0.beta.2,", 12, "4.0.0.beta.2");
+    check_constraint_n("~> 1.0&>= 1.0.2", 6, "1.9", 1);
+    check_constraint_n("~> 1.0&>= 1.0.2", 6, "2.0", 0);
+    check_constraint_n(">= 2.7.0,ruby", 8, "2.7.0", 1);
+
     /* --- Comparison --- */
     printf("Comparison:\n");
     check_cmp("4.1.1", "4.1.1", 0);
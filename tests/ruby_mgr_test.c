@@ -241,6 +241,26 @@ static void test_find_ruby_version(void) {
             check("walked-up version is 3.3.6", strcmp(ver, "3.3.6") == 0);
     }
 
+    /* A blank file and a directory named .ruby-version are skipped
+     * (the shim's own walk makes the same choice) */
+    char blank[TPATH], rvdir[TPATH];
+    snprintf(blank, sizeof(blank), "%s/.ruby-version", bdir);
+    snprintf(rvdir, sizeof(rvdir), "%s/.ruby-version", subdir);
+    f = fopen(blank, "w");
+    if (f) {
+        fputs(" \n", f);
+        fclose(f);
+    }
+    mkdir(rvdir, 0755);
+
+    if (chdir(subdir) == 0) {
+        char ver[32];
+        int rc = wow_find_ruby_version(ver, sizeof(ver));
+        check("find_ruby_version skips blank/dir .ruby-version", rc == 0);
+        if (rc == 0)
+            check("skipped to version 3.3.6", strcmp(ver, "3.3.6") == 0);
+    }
+
     chdir(orig_cwd);
     rm_rf(tmpdir);
 }